@@ -0,0 +1,748 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkPlanarContourToBinaryLabelmapConversionRule.h"
+
+// SegmentationCore includes
+#include <vtkCalculateOversamplingFactor.h>
+#include <vtkClosedSurfaceToBinaryLabelmapConversionRule.h>
+#include <vtkOrientedImageData.h>
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+#include <vtkSegment.h>
+#endif
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkVariant.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Contours with K coordinates closer than this (in voxels) are considered to be on the same plane
+static const double CONTOUR_PLANE_TOLERANCE = 0.01;
+// Large value used as infinite distance in the distance transform
+static const float DISTANCE_INFINITY = 1e20f;
+// Cost reported when the conversion cannot honor the parameters, so that the path through the closed surface is used
+static const unsigned int UNSUPPORTED_PARAMETERS_CONVERSION_COST = 100000;
+
+//----------------------------------------------------------------------------
+// Determine whether an image slice is interpolated between two contour planes, as opposed to taken from the
+// nearest plane (at the ends of the structure, at gaps, or when the slice is on a contour plane)
+static bool IsSliceInterpolated(int planeIndex2, double weight, double planeSpacing)
+{
+  return planeIndex2 >= 0 && std::min(weight, 1.0 - weight) * planeSpacing > CONTOUR_PLANE_TOLERANCE;
+}
+
+//----------------------------------------------------------------------------
+// Exact squared Euclidean distance transform of a sampled function in one dimension (Felzenszwalb & Huttenlocher)
+static void SquaredDistanceTransform1D(const float* f, int n, float* d, int* v, float* z)
+{
+  int k = 0;
+  v[0] = 0;
+  z[0] = -DISTANCE_INFINITY;
+  z[1] = DISTANCE_INFINITY;
+  for (int q = 1; q < n; ++q)
+  {
+    float s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+    while (k > 0 && s <= z[k])
+    {
+      --k;
+      s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k+1] = DISTANCE_INFINITY;
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q)
+  {
+    while (z[k+1] < q)
+    {
+      ++k;
+    }
+    d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+  }
+}
+
+//----------------------------------------------------------------------------
+// Exact Euclidean distance (in voxels) of each voxel of a 2D mask to the nearest voxel with the given value
+static void DistanceTransform2D(const unsigned char* mask, unsigned char featureValue, const int dimensions[2], float* distance)
+{
+  int maximumDimension = std::max(dimensions[0], dimensions[1]);
+  std::vector<float> f(maximumDimension);
+  std::vector<float> d(maximumDimension);
+  std::vector<int> v(maximumDimension);
+  std::vector<float> z(maximumDimension + 1);
+
+  for (int index = 0; index < dimensions[0] * dimensions[1]; ++index)
+  {
+    distance[index] = (mask[index] == featureValue ? 0.0f : DISTANCE_INFINITY);
+  }
+
+  // Columns
+  for (int i = 0; i < dimensions[0]; ++i)
+  {
+    for (int j = 0; j < dimensions[1]; ++j)
+    {
+      f[j] = distance[j * dimensions[0] + i];
+    }
+    SquaredDistanceTransform1D(f.data(), dimensions[1], d.data(), v.data(), z.data());
+    for (int j = 0; j < dimensions[1]; ++j)
+    {
+      distance[j * dimensions[0] + i] = d[j];
+    }
+  }
+
+  // Rows
+  for (int j = 0; j < dimensions[1]; ++j)
+  {
+    float* row = distance + j * dimensions[0];
+    std::copy(row, row + dimensions[0], f.begin());
+    SquaredDistanceTransform1D(f.data(), dimensions[0], row, v.data(), z.data());
+  }
+
+  for (int index = 0; index < dimensions[0] * dimensions[1]; ++index)
+  {
+    distance[index] = (distance[index] >= DISTANCE_INFINITY ? DISTANCE_INFINITY : std::sqrt(distance[index]));
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkSegmentationConverterRuleNewMacro(vtkPlanarContourToBinaryLabelmapConversionRule);
+
+//----------------------------------------------------------------------------
+class vtkPlanarContourToBinaryLabelmapConversionRule::RasterizeContourPlanesFunctor
+{
+public:
+  void operator()(vtkIdType begin, vtkIdType end) const
+  {
+    for (vtkIdType planeIndex = begin; planeIndex < end; ++planeIndex)
+    {
+      unsigned char* mask = this->Masks + planeIndex * this->SliceSize;
+      vtkPlanarContourToBinaryLabelmapConversionRule::RasterizeContourPlane((*this->ContourPlanes)[planeIndex], this->Extent, mask);
+      int distanceMapIndex = (*this->PlaneDistanceMapIndices)[planeIndex];
+      if (distanceMapIndex >= 0)
+      {
+        vtkPlanarContourToBinaryLabelmapConversionRule::ComputeSignedDistanceMap(
+          mask, this->Dimensions, this->SignedDistanceMaps + distanceMapIndex * this->SliceSize);
+      }
+    }
+  }
+
+  const std::vector<ContourPlane>* ContourPlanes{nullptr};
+  /// Index of the signed distance map of each plane, -1 if the plane does not need one
+  const std::vector<int>* PlaneDistanceMapIndices{nullptr};
+  int Extent[4]{0,-1,0,-1};
+  int Dimensions[2]{0,0};
+  vtkIdType SliceSize{0};
+  unsigned char* Masks{nullptr};
+  float* SignedDistanceMaps{nullptr};
+};
+
+//----------------------------------------------------------------------------
+class vtkPlanarContourToBinaryLabelmapConversionRule::FillSlicesFunctor
+{
+public:
+  void operator()(vtkIdType beginK, vtkIdType endK) const
+  {
+    for (vtkIdType k = beginK; k < endK; ++k)
+    {
+      unsigned char* slice = this->Output + (k - this->FirstK) * this->SliceSize;
+      int planeIndex1 = -1;
+      int planeIndex2 = -1;
+      double weight = 0.0;
+      vtkPlanarContourToBinaryLabelmapConversionRule::FindContourPlanesForSlice(
+        *this->ContourPlanes, this->PlaneSpacing, k, planeIndex1, planeIndex2, weight);
+      if (planeIndex1 < 0)
+      {
+        // Outside the contours, output is already cleared
+        continue;
+      }
+      if (!this->SignedDistanceMaps || !IsSliceInterpolated(planeIndex2, weight, this->PlaneSpacing))
+      {
+        // Use the nearest plane
+        int planeIndex = (planeIndex2 >= 0 && weight > 0.5 ? planeIndex2 : planeIndex1);
+        memcpy(slice, this->Masks + planeIndex * this->SliceSize, this->SliceSize);
+        continue;
+      }
+
+      // Interpolate shape between the two planes
+      const float* distanceMap1 = this->SignedDistanceMaps + (*this->PlaneDistanceMapIndices)[planeIndex1] * this->SliceSize;
+      const float* distanceMap2 = this->SignedDistanceMaps + (*this->PlaneDistanceMapIndices)[planeIndex2] * this->SliceSize;
+      float weight1 = static_cast<float>(1.0 - weight);
+      float weight2 = static_cast<float>(weight);
+      for (vtkIdType index = 0; index < this->SliceSize; ++index)
+      {
+        slice[index] = (weight1 * distanceMap1[index] + weight2 * distanceMap2[index] < 0.0f ? 1 : 0);
+      }
+    }
+  }
+
+  const std::vector<ContourPlane>* ContourPlanes{nullptr};
+  double PlaneSpacing{1.0};
+  vtkIdType SliceSize{0};
+  int FirstK{0};
+  const unsigned char* Masks{nullptr};
+  const std::vector<int>* PlaneDistanceMapIndices{nullptr};
+  const float* SignedDistanceMaps{nullptr};
+  unsigned char* Output{nullptr};
+};
+
+//----------------------------------------------------------------------------
+vtkPlanarContourToBinaryLabelmapConversionRule::vtkPlanarContourToBinaryLabelmapConversionRule()
+{
+  this->ConversionParameters->SetParameter(vtkSegmentationConverter::GetReferenceImageGeometryParameterName(), "",
+    "Image geometry description string determining the geometry of the labelmap that is created in course of conversion.");
+  this->ConversionParameters->SetParameter(this->GetCropToReferenceImageGeometryParameterName(), "0",
+    "Crop the labelmap to the extent of the reference geometry.\n"
+    "0 (default) = created labelmap will contain all of the contours.\n"
+    "1 = created labelmap extent will be within reference image extent.");
+  // Same parameter as used by the closed surface to labelmap conversions, so that the setting of the segmentation applies
+  this->ConversionParameters->SetParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(), "1",
+    "Determines the oversampling of the reference image geometry. All segments are oversampled with the same value (value of 1 means no oversampling).\n"
+    "Automatic oversampling (\"A\") needs the closed surface, so conversion through the closed surface is used in that case.");
+
+  this->IncludePartiallyCoveredSlices = false;
+}
+
+//----------------------------------------------------------------------------
+vtkPlanarContourToBinaryLabelmapConversionRule::~vtkPlanarContourToBinaryLabelmapConversionRule() = default;
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlanarContourToBinaryLabelmapConversionRule::GetConversionCost(
+  vtkDataObject* vtkNotUsed(sourceRepresentation)/*=nullptr*/,
+  vtkDataObject* vtkNotUsed(targetRepresentation)/*=nullptr*/)
+{
+  if (!this->IsOversamplingFactorSupported())
+  {
+    return UNSUPPORTED_PARAMETERS_CONVERSION_COST;
+  }
+  // Rough input-independent guess (ms)
+  return 150;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlanarContourToBinaryLabelmapConversionRule::IsOversamplingFactorSupported()
+{
+  std::string oversamplingFactorString = this->GetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName());
+  return oversamplingFactorString.empty() || vtkVariant(oversamplingFactorString).ToDouble() > 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkDataObject* vtkPlanarContourToBinaryLabelmapConversionRule::ConstructRepresentationObjectByRepresentation(std::string representationName)
+{
+  if (!representationName.compare(this->GetSourceRepresentationName()))
+  {
+    return (vtkDataObject*)vtkPolyData::New();
+  }
+  else if (!representationName.compare(this->GetTargetRepresentationName()))
+  {
+    return (vtkDataObject*)vtkOrientedImageData::New();
+  }
+  else
+  {
+    return nullptr;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkDataObject* vtkPlanarContourToBinaryLabelmapConversionRule::ConstructRepresentationObjectByClass(std::string className)
+{
+  if (!className.compare("vtkPolyData"))
+  {
+    return (vtkDataObject*)vtkPolyData::New();
+  }
+  else if (!className.compare("vtkOrientedImageData"))
+  {
+    return (vtkDataObject*)vtkOrientedImageData::New();
+  }
+  else
+  {
+    return nullptr;
+  }
+}
+
+//----------------------------------------------------------------------------
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+bool vtkPlanarContourToBinaryLabelmapConversionRule::Convert(vtkSegment* segment)
+{
+  this->CreateTargetRepresentation(segment);
+#else
+bool vtkPlanarContourToBinaryLabelmapConversionRule::Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation)
+{
+#endif
+  // Check validity of source and target representation objects
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  vtkPolyData* planarContoursPolyData = vtkPolyData::SafeDownCast(segment->GetRepresentation(this->GetSourceRepresentationName()));
+#else
+  vtkPolyData* planarContoursPolyData = vtkPolyData::SafeDownCast(sourceRepresentation);
+#endif
+  if (!planarContoursPolyData)
+  {
+    vtkErrorMacro("Convert: Source representation is not a poly data");
+    return false;
+  }
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  vtkOrientedImageData* binaryLabelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(this->GetTargetRepresentationName()));
+#else
+  vtkOrientedImageData* binaryLabelmap = vtkOrientedImageData::SafeDownCast(targetRepresentation);
+#endif
+  if (!binaryLabelmap)
+  {
+    vtkErrorMacro("Convert: Target representation is not an oriented image data");
+    return false;
+  }
+
+  std::vector<ContourPlane> contourPlanes;
+  if (!this->ExtractContourPlanes(planarContoursPolyData, binaryLabelmap, contourPlanes))
+  {
+    return false;
+  }
+
+  binaryLabelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  binaryLabelmap->GetExtent(extent);
+  if (contourPlanes.empty() || extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+  {
+    // Empty structure
+    return true;
+  }
+  unsigned char* labelmapPtr = static_cast<unsigned char*>(binaryLabelmap->GetScalarPointer());
+  memset(labelmapPtr, 0, binaryLabelmap->GetNumberOfPoints() * sizeof(unsigned char));
+
+  int dimensions[2] = { extent[1] - extent[0] + 1, extent[3] - extent[2] + 1 };
+  vtkIdType sliceSize = static_cast<vtkIdType>(dimensions[0]) * dimensions[1];
+  vtkIdType numberOfPlanes = static_cast<vtkIdType>(contourPlanes.size());
+
+  // Interpolate between the contour planes only if the image slices are denser than the contour planes.
+  // Signed distance maps are only computed for the planes next to an interpolated slice.
+  double planeSpacing = this->GetContourPlaneSpacing(contourPlanes);
+  std::vector<int> planeDistanceMapIndices(numberOfPlanes, -1);
+  int numberOfDistanceMaps = 0;
+  if (planeSpacing > 1.0 + CONTOUR_PLANE_TOLERANCE)
+  {
+    for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+      int planeIndex1 = -1;
+      int planeIndex2 = -1;
+      double weight = 0.0;
+      this->FindContourPlanesForSlice(contourPlanes, planeSpacing, k, planeIndex1, planeIndex2, weight);
+      if (planeIndex1 < 0 || !IsSliceInterpolated(planeIndex2, weight, planeSpacing))
+      {
+        continue;
+      }
+      for (int planeIndex : { planeIndex1, planeIndex2 })
+      {
+        if (planeDistanceMapIndices[planeIndex] < 0)
+        {
+          planeDistanceMapIndices[planeIndex] = numberOfDistanceMaps++;
+        }
+      }
+    }
+  }
+
+  // Rasterize each contour plane in parallel
+  std::vector<unsigned char> planeMasks(numberOfPlanes * sliceSize);
+  std::vector<float> planeSignedDistanceMaps(numberOfDistanceMaps * sliceSize);
+  RasterizeContourPlanesFunctor rasterizeFunctor;
+  rasterizeFunctor.ContourPlanes = &contourPlanes;
+  rasterizeFunctor.PlaneDistanceMapIndices = &planeDistanceMapIndices;
+  std::copy(extent, extent + 4, rasterizeFunctor.Extent);
+  std::copy(dimensions, dimensions + 2, rasterizeFunctor.Dimensions);
+  rasterizeFunctor.SliceSize = sliceSize;
+  rasterizeFunctor.Masks = planeMasks.data();
+  rasterizeFunctor.SignedDistanceMaps = (numberOfDistanceMaps > 0 ? planeSignedDistanceMaps.data() : nullptr);
+  vtkSMPTools::For(0, numberOfPlanes, 1, rasterizeFunctor);
+
+  // Fill the image slices in parallel
+  FillSlicesFunctor fillFunctor;
+  fillFunctor.ContourPlanes = &contourPlanes;
+  fillFunctor.PlaneSpacing = planeSpacing;
+  fillFunctor.SliceSize = sliceSize;
+  fillFunctor.FirstK = extent[4];
+  fillFunctor.Masks = planeMasks.data();
+  fillFunctor.PlaneDistanceMapIndices = &planeDistanceMapIndices;
+  fillFunctor.SignedDistanceMaps = (numberOfDistanceMaps > 0 ? planeSignedDistanceMaps.data() : nullptr);
+  fillFunctor.Output = labelmapPtr;
+  vtkSMPTools::For(extent[4], extent[5] + 1, fillFunctor);
+
+  binaryLabelmap->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlanarContourToBinaryLabelmapConversionRule::ExtractContourPlanes(
+  vtkPolyData* contoursPolyData, vtkOrientedImageData* outputLabelmap, std::vector<ContourPlane>& contourPlanes)
+{
+  contourPlanes.clear();
+  if (!contoursPolyData || !outputLabelmap)
+  {
+    vtkErrorMacro("ExtractContourPlanes: Invalid input");
+    return false;
+  }
+
+  std::string geometryString = this->GetConversionParameter(vtkSegmentationConverter::GetReferenceImageGeometryParameterName());
+  if (geometryString.empty())
+  {
+    vtkErrorMacro("ExtractContourPlanes: Failed to get reference image geometry");
+    return false;
+  }
+  if (!vtkSegmentationConverter::DeserializeImageGeometry(geometryString, outputLabelmap, false))
+  {
+    vtkErrorMacro("ExtractContourPlanes: Failed to deserialize reference image geometry");
+    return false;
+  }
+
+  // Apply oversampling on the reference geometry, as done when converting from closed surface
+  if (!this->IsOversamplingFactorSupported())
+  {
+    vtkWarningMacro("ExtractContourPlanes: Automatic oversampling is not supported for planar contours, no oversampling is applied");
+  }
+  else
+  {
+    std::string oversamplingFactorString = this->GetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName());
+    double oversamplingFactor = (oversamplingFactorString.empty() ? 1.0 : vtkVariant(oversamplingFactorString).ToDouble());
+    if (oversamplingFactor != 1.0)
+    {
+      vtkCalculateOversamplingFactor::ApplyOversamplingOnImageGeometry(outputLabelmap, oversamplingFactor);
+    }
+  }
+  int referenceExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  outputLabelmap->GetExtent(referenceExtent);
+  bool cropToReferenceImageGeometry = (vtkVariant(this->GetConversionParameter(this->GetCropToReferenceImageGeometryParameterName())).ToInt() != 0);
+
+  // Collect the polygons in RAS
+  std::vector<std::vector<double> > polygonsRas;
+  vtkCellArray* lines = contoursPolyData->GetLines();
+  if (lines && contoursPolyData->GetPoints())
+  {
+    vtkSmartPointer<vtkIdList> pointIds = vtkSmartPointer<vtkIdList>::New();
+    lines->InitTraversal();
+    while (lines->GetNextCell(pointIds))
+    {
+      vtkIdType numberOfPoints = pointIds->GetNumberOfIds();
+      if (numberOfPoints > 1 && pointIds->GetId(0) == pointIds->GetId(numberOfPoints - 1))
+      {
+        // Closing point is implicit
+        --numberOfPoints;
+      }
+      if (numberOfPoints < 3)
+      {
+        continue;
+      }
+      std::vector<double> polygon(3 * numberOfPoints);
+      for (vtkIdType pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+      {
+        contoursPolyData->GetPoint(pointIds->GetId(pointIndex), polygon.data() + 3 * pointIndex);
+      }
+      polygonsRas.push_back(polygon);
+    }
+  }
+  if (polygonsRas.empty())
+  {
+    outputLabelmap->SetExtent(0, -1, 0, -1, 0, -1);
+    return true;
+  }
+
+  // Make sure the contour planes are parallel to the image slices. Use the normal of the largest contour.
+  vtkSmartPointer<vtkMatrix4x4> imageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  outputLabelmap->GetImageToWorldMatrix(imageToWorldMatrix);
+  double contourNormal[3] = { 0.0, 0.0, 0.0 };
+  double maximumAreaVectorLength = 0.0;
+  for (const std::vector<double>& polygon : polygonsRas)
+  {
+    // Newell's method
+    double areaVector[3] = { 0.0, 0.0, 0.0 };
+    size_t numberOfPoints = polygon.size() / 3;
+    for (size_t pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      const double* current = polygon.data() + 3 * pointIndex;
+      const double* next = polygon.data() + 3 * ((pointIndex + 1) % numberOfPoints);
+      areaVector[0] += (current[1] - next[1]) * (current[2] + next[2]);
+      areaVector[1] += (current[2] - next[2]) * (current[0] + next[0]);
+      areaVector[2] += (current[0] - next[0]) * (current[1] + next[1]);
+    }
+    double areaVectorLength = vtkMath::Norm(areaVector);
+    if (areaVectorLength > maximumAreaVectorLength)
+    {
+      maximumAreaVectorLength = areaVectorLength;
+      contourNormal[0] = areaVector[0] / areaVectorLength;
+      contourNormal[1] = areaVector[1] / areaVectorLength;
+      contourNormal[2] = areaVector[2] / areaVectorLength;
+    }
+  }
+  double directions[3][3] = { { 0.0 } };
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    for (int row = 0; row < 3; ++row)
+    {
+      directions[axis][row] = imageToWorldMatrix->GetElement(row, axis);
+    }
+    vtkMath::Normalize(directions[axis]);
+  }
+  if (maximumAreaVectorLength > 0.0 && std::fabs(vtkMath::Dot(contourNormal, directions[2])) < 1.0 - 1e-4)
+  {
+    vtkWarningMacro("ExtractContourPlanes: Contour planes are not parallel to the reference image slices, "
+      "labelmap directions are aligned with the contours instead");
+    if (vtkMath::Dot(contourNormal, directions[2]) < 0.0)
+    {
+      vtkMath::MultiplyScalar(contourNormal, -1.0);
+    }
+    double kDirection[3] = { contourNormal[0], contourNormal[1], contourNormal[2] };
+    double iDirection[3] = { directions[0][0], directions[0][1], directions[0][2] };
+    double projection = vtkMath::Dot(iDirection, kDirection);
+    for (int row = 0; row < 3; ++row)
+    {
+      iDirection[row] -= projection * kDirection[row];
+    }
+    if (vtkMath::Normalize(iDirection) == 0.0)
+    {
+      vtkMath::Perpendiculars(kDirection, iDirection, nullptr, 0.0);
+    }
+    double jDirection[3] = { 0.0, 0.0, 0.0 };
+    vtkMath::Cross(kDirection, iDirection, jDirection);
+    if (vtkMath::Dot(jDirection, directions[1]) < 0.0)
+    {
+      vtkMath::MultiplyScalar(jDirection, -1.0);
+    }
+    outputLabelmap->SetDirections(iDirection, jDirection, kDirection);
+    outputLabelmap->GetImageToWorldMatrix(imageToWorldMatrix);
+    // The reference extent is meaningless in the rotated lattice
+    cropToReferenceImageGeometry = false;
+  }
+
+  // Transform the polygons to IJK
+  vtkSmartPointer<vtkMatrix4x4> worldToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(imageToWorldMatrix, worldToImageMatrix);
+  std::vector<std::pair<double, size_t> > polygonKs;
+  std::vector<std::vector<double> > polygonsIj(polygonsRas.size());
+  double boundsIj[4] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+  for (size_t polygonIndex = 0; polygonIndex < polygonsRas.size(); ++polygonIndex)
+  {
+    const std::vector<double>& polygonRas = polygonsRas[polygonIndex];
+    size_t numberOfPoints = polygonRas.size() / 3;
+    std::vector<double>& polygonIj = polygonsIj[polygonIndex];
+    polygonIj.resize(2 * numberOfPoints);
+    double sumK = 0.0;
+    for (size_t pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      double pointRas[4] = { polygonRas[3*pointIndex], polygonRas[3*pointIndex+1], polygonRas[3*pointIndex+2], 1.0 };
+      double pointIjk[4] = { 0.0, 0.0, 0.0, 1.0 };
+      worldToImageMatrix->MultiplyPoint(pointRas, pointIjk);
+      polygonIj[2*pointIndex] = pointIjk[0];
+      polygonIj[2*pointIndex+1] = pointIjk[1];
+      sumK += pointIjk[2];
+      boundsIj[0] = std::min(boundsIj[0], pointIjk[0]);
+      boundsIj[1] = std::max(boundsIj[1], pointIjk[0]);
+      boundsIj[2] = std::min(boundsIj[2], pointIjk[1]);
+      boundsIj[3] = std::max(boundsIj[3], pointIjk[1]);
+    }
+    polygonKs.push_back(std::make_pair(sumK / numberOfPoints, polygonIndex));
+  }
+
+  // Group the polygons by plane
+  std::sort(polygonKs.begin(), polygonKs.end());
+  double planeKSum = 0.0;
+  int numberOfPolygonsInPlane = 0;
+  for (const std::pair<double, size_t>& polygonK : polygonKs)
+  {
+    if (contourPlanes.empty() || polygonK.first - contourPlanes.back().K > CONTOUR_PLANE_TOLERANCE)
+    {
+      contourPlanes.push_back(ContourPlane());
+      planeKSum = 0.0;
+      numberOfPolygonsInPlane = 0;
+    }
+    ContourPlane& contourPlane = contourPlanes.back();
+    contourPlane.Polygons.push_back(polygonsIj[polygonK.second]);
+    planeKSum += polygonK.first;
+    ++numberOfPolygonsInPlane;
+    contourPlane.K = planeKSum / numberOfPolygonsInPlane;
+  }
+
+  // Set output extent to cover the contours, with a margin of one voxel for the distance maps.
+  // End planes cover half of the plane spacing.
+  double planeSpacing = this->GetContourPlaneSpacing(contourPlanes);
+  double endPlaneHalfThickness = (contourPlanes.size() > 1 ? planeSpacing / 2.0 : 0.5);
+  double firstK = contourPlanes.front().K - endPlaneHalfThickness;
+  double lastK = contourPlanes.back().K + endPlaneHalfThickness;
+  int extent[6] =
+  {
+    static_cast<int>(std::floor(boundsIj[0])) - 1, static_cast<int>(std::ceil(boundsIj[1])) + 1,
+    static_cast<int>(std::floor(boundsIj[2])) - 1, static_cast<int>(std::ceil(boundsIj[3])) + 1,
+    static_cast<int>(std::ceil(firstK)), static_cast<int>(std::floor(lastK))
+  };
+  if (this->IncludePartiallyCoveredSlices)
+  {
+    // Slices whose voxels overlap the contour slabs, not only the ones with their centers inside
+    extent[4] = static_cast<int>(std::floor(firstK - 0.5)) + 1;
+    extent[5] = static_cast<int>(std::ceil(lastK + 0.5)) - 1;
+  }
+  if (cropToReferenceImageGeometry)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      extent[2*axis] = std::max(extent[2*axis], referenceExtent[2*axis]);
+      extent[2*axis+1] = std::min(extent[2*axis+1], referenceExtent[2*axis+1]);
+    }
+  }
+  outputLabelmap->SetExtent(extent);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlanarContourToBinaryLabelmapConversionRule::GetContourPlaneSpacing(const std::vector<ContourPlane>& contourPlanes)
+{
+  if (contourPlanes.size() < 2)
+  {
+    return 1.0;
+  }
+  std::vector<double> gaps;
+  for (size_t planeIndex = 1; planeIndex < contourPlanes.size(); ++planeIndex)
+  {
+    gaps.push_back(contourPlanes[planeIndex].K - contourPlanes[planeIndex-1].K);
+  }
+  std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+  return gaps[gaps.size() / 2];
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourToBinaryLabelmapConversionRule::FindContourPlanesForSlice(const std::vector<ContourPlane>& contourPlanes,
+  double planeSpacing, double k, int& planeIndex1, int& planeIndex2, double& weight)
+{
+  planeIndex1 = -1;
+  planeIndex2 = -1;
+  weight = 0.0;
+  if (contourPlanes.empty())
+  {
+    return;
+  }
+
+  // First plane at or above the slice
+  int upperPlaneIndex = static_cast<int>(std::lower_bound(contourPlanes.begin(), contourPlanes.end(), k,
+    [](const ContourPlane& contourPlane, double value) { return contourPlane.K < value; }) - contourPlanes.begin());
+  int lowerPlaneIndex = upperPlaneIndex - 1;
+  int numberOfPlanes = static_cast<int>(contourPlanes.size());
+
+  // Slice between two connected planes
+  if (lowerPlaneIndex >= 0 && upperPlaneIndex < numberOfPlanes)
+  {
+    double gap = contourPlanes[upperPlaneIndex].K - contourPlanes[lowerPlaneIndex].K;
+    if (gap <= 1.5 * planeSpacing)
+    {
+      planeIndex1 = lowerPlaneIndex;
+      planeIndex2 = upperPlaneIndex;
+      weight = (gap > 0.0 ? (k - contourPlanes[lowerPlaneIndex].K) / gap : 0.0);
+      return;
+    }
+  }
+
+  // Slice at the end of the structure or at a gap: use the nearest plane within half of the spacing
+  double halfThickness = (numberOfPlanes > 1 ? planeSpacing / 2.0 : 0.5);
+  double nearestDistance = VTK_DOUBLE_MAX;
+  for (int planeIndex : { lowerPlaneIndex, upperPlaneIndex })
+  {
+    if (planeIndex < 0 || planeIndex >= numberOfPlanes)
+    {
+      continue;
+    }
+    double distance = std::fabs(contourPlanes[planeIndex].K - k);
+    if (distance <= halfThickness && distance < nearestDistance)
+    {
+      nearestDistance = distance;
+      planeIndex1 = planeIndex;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourToBinaryLabelmapConversionRule::RasterizeContourPlane(const ContourPlane& contourPlane, const int extent[4], unsigned char* mask)
+{
+  int dimensions[2] = { extent[1] - extent[0] + 1, extent[3] - extent[2] + 1 };
+  memset(mask, 0, static_cast<size_t>(dimensions[0]) * dimensions[1]);
+
+  // Collect edge crossings for each row of voxel centers. An edge crosses row j if its
+  // end points are on different sides, counting a vertex on the row as above it.
+  std::vector<std::vector<double> > rowCrossings(dimensions[1]);
+  for (const std::vector<double>& polygon : contourPlane.Polygons)
+  {
+    size_t numberOfPoints = polygon.size() / 2;
+    for (size_t pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      const double* start = polygon.data() + 2 * pointIndex;
+      const double* end = polygon.data() + 2 * ((pointIndex + 1) % numberOfPoints);
+      if (start[1] == end[1])
+      {
+        // Horizontal edges do not cross any rows
+        continue;
+      }
+      const double* lower = (start[1] < end[1] ? start : end);
+      const double* upper = (start[1] < end[1] ? end : start);
+      double slope = (upper[0] - lower[0]) / (upper[1] - lower[1]);
+      int firstRow = std::max(static_cast<int>(std::ceil(lower[1])), extent[2]);
+      int lastRow = std::min(static_cast<int>(std::ceil(upper[1])) - 1, extent[3]);
+      for (int row = firstRow; row <= lastRow; ++row)
+      {
+        rowCrossings[row - extent[2]].push_back(lower[0] + (row - lower[1]) * slope);
+      }
+    }
+  }
+
+  // Even-odd filling between pairs of crossings
+  for (int rowIndex = 0; rowIndex < dimensions[1]; ++rowIndex)
+  {
+    std::vector<double>& crossings = rowCrossings[rowIndex];
+    std::sort(crossings.begin(), crossings.end());
+    unsigned char* rowMask = mask + static_cast<size_t>(rowIndex) * dimensions[0];
+    for (size_t crossingIndex = 0; crossingIndex + 1 < crossings.size(); crossingIndex += 2)
+    {
+      // Voxel centers in the half-open interval [start, end)
+      int firstColumn = std::max(static_cast<int>(std::ceil(crossings[crossingIndex])), extent[0]);
+      int lastColumn = std::min(static_cast<int>(std::ceil(crossings[crossingIndex + 1])) - 1, extent[1]);
+      for (int column = firstColumn; column <= lastColumn; ++column)
+      {
+        rowMask[column - extent[0]] = 1;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourToBinaryLabelmapConversionRule::ComputeSignedDistanceMap(
+  const unsigned char* mask, const int dimensions[2], float* signedDistanceMap)
+{
+  vtkIdType sliceSize = static_cast<vtkIdType>(dimensions[0]) * dimensions[1];
+  std::vector<float> distanceToInside(sliceSize);
+  std::vector<float> distanceToOutside(sliceSize);
+  DistanceTransform2D(mask, 1, dimensions, distanceToInside.data());
+  DistanceTransform2D(mask, 0, dimensions, distanceToOutside.data());
+
+  // Boundary is half way between inside and outside voxel centers
+  for (vtkIdType index = 0; index < sliceSize; ++index)
+  {
+    signedDistanceMap[index] = (mask[index] ? 0.5f - distanceToOutside[index] : distanceToInside[index] - 0.5f);
+  }
+}
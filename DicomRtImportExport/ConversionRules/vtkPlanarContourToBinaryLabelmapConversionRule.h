@@ -0,0 +1,145 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkPlanarContourToBinaryLabelmapConversionRule_h
+#define __vtkPlanarContourToBinaryLabelmapConversionRule_h
+
+// Slicer include
+#include <vtkSlicerVersionConfigureMinimal.h>
+
+// SegmentationCore includes
+#include "vtkSegmentationConverterRule.h"
+#include "vtkSegmentationConverter.h"
+
+#include "vtkSlicerDicomRtImportExportConversionRulesExport.h"
+
+// STD includes
+#include <vector>
+
+class vtkOrientedImageData;
+class vtkPolyData;
+
+/// \ingroup DicomRtImportImportExportConversionRules
+/// \brief Convert planar contour representation (vtkPolyData type) directly to
+///   binary labelmap representation (vtkOrientedImageData type), without reconstructing
+///   a closed surface first. Each contour plane is rasterized onto the reference image
+///   slices with even-odd scanline filling (inner contours become holes). If the image
+///   slices are denser than the contour planes, the slices in between are interpolated
+///   from the signed distance maps of the two neighboring planes.
+///   The oversampling factor conversion parameter is shared with the closed surface to labelmap
+///   conversion. Automatic oversampling needs the closed surface, so in that case this rule reports
+///   a high cost and the conversion through the closed surface is used instead.
+class VTK_SLICER_DICOMRTIMPORTEXPORT_CONVERSIONRULES_EXPORT vtkPlanarContourToBinaryLabelmapConversionRule
+  : public vtkSegmentationConverterRule
+{
+public:
+  static vtkPlanarContourToBinaryLabelmapConversionRule* New();
+  vtkTypeMacro(vtkPlanarContourToBinaryLabelmapConversionRule, vtkSegmentationConverterRule);
+  vtkSegmentationConverterRule* CreateRuleInstance() override;
+
+  static const std::string GetCropToReferenceImageGeometryParameterName() { return "Crop to reference image geometry"; };
+
+  /// Constructs representation object from representation name for the supported representation classes
+  /// (typically source and target representation VTK classes, subclasses of vtkDataObject)
+  /// Note: Need to take ownership of the created object! For example using vtkSmartPointer<vtkDataObject>::Take
+  vtkDataObject* ConstructRepresentationObjectByRepresentation(std::string representationName) override;
+
+  /// Constructs representation object from class name for the supported representation classes
+  /// (typically source and target representation VTK classes, subclasses of vtkDataObject)
+  /// Note: Need to take ownership of the created object! For example using vtkSmartPointer<vtkDataObject>::Take
+  vtkDataObject* ConstructRepresentationObjectByClass(std::string className) override;
+
+  /// Update the target representation based on the source representation
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  bool Convert(vtkSegment* segment) override;
+#else
+  bool Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation) override;
+#endif
+
+  /// Get the cost of the conversion. Higher than the conversion through the closed surface if the
+  /// conversion parameters are not supported (automatic oversampling).
+  unsigned int GetConversionCost(vtkDataObject* sourceRepresentation = nullptr, vtkDataObject* targetRepresentation = nullptr) override;
+
+  /// Human-readable name of the converter rule
+  const char* GetName() override { return "Planar contour to binary labelmap"; };
+
+  /// Human-readable name of the source representation
+  const char* GetSourceRepresentationName() override { return vtkSegmentationConverter::GetSegmentationPlanarContourRepresentationName(); };
+
+  /// Human-readable name of the target representation
+  const char* GetTargetRepresentationName() override { return vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(); };
+
+protected:
+  vtkPlanarContourToBinaryLabelmapConversionRule();
+  ~vtkPlanarContourToBinaryLabelmapConversionRule() override;
+
+  /// Contours lying on the same plane, in the IJK coordinate system of the output labelmap
+  struct ContourPlane
+  {
+    /// Continuous K coordinate of the plane
+    double K{0.0};
+    /// Polygons on the plane as flat (I,J) coordinate lists. The closing edge is implicit.
+    std::vector<std::vector<double> > Polygons;
+  };
+
+  /// Set up the output geometry from the reference image geometry (with oversampling applied), transform the contours
+  /// into its IJK coordinate system and group them by plane (sorted by K). If the contour planes
+  /// are not parallel to the reference slices, then the output directions are rotated to match them.
+  /// The output extent is set to cover the contours (and cropped to the reference extent if requested).
+  /// \param contoursPolyData Planar contours in RAS
+  /// \param outputLabelmap Output labelmap, its geometry is set but the scalars are not allocated
+  /// \param contourPlanes Output contour planes
+  /// \return Success flag. An empty structure is a success with no planes.
+  bool ExtractContourPlanes(vtkPolyData* contoursPolyData, vtkOrientedImageData* outputLabelmap, std::vector<ContourPlane>& contourPlanes);
+
+  /// Determine whether the oversampling factor conversion parameter is supported (a fixed positive factor)
+  bool IsOversamplingFactorSupported();
+
+  /// Get typical spacing between contour planes in voxels (median of the gaps)
+  static double GetContourPlaneSpacing(const std::vector<ContourPlane>& contourPlanes);
+
+  /// Find the contour planes that determine an image slice. Planes further apart than the typical
+  /// spacing are considered disconnected, in which case each of them covers half of the typical spacing.
+  /// \param k K coordinate of the image slice
+  /// \param planeIndex1 Output index of the first plane (-1 if the slice is outside the contours)
+  /// \param planeIndex2 Output index of the second plane (-1 if only the first plane covers the slice)
+  /// \param weight Output relative position of the slice between the first (0) and the second (1) plane
+  static void FindContourPlanesForSlice(const std::vector<ContourPlane>& contourPlanes, double planeSpacing, double k,
+    int& planeIndex1, int& planeIndex2, double& weight);
+
+  /// Rasterize the polygons of a contour plane with even-odd scanline filling.
+  /// Voxel centers inside are set to 1, others to 0.
+  /// \param extent In-plane extent (I min, I max, J min, J max) of the mask
+  static void RasterizeContourPlane(const ContourPlane& contourPlane, const int extent[4], unsigned char* mask);
+
+  /// Compute signed distance map (in voxels, negative inside) from a binary mask
+  static void ComputeSignedDistanceMap(const unsigned char* mask, const int dimensions[2], float* signedDistanceMap);
+
+  /// Include slices in the output extent that are only partially covered by the contour slabs.
+  /// Off by default (slices are included if their center is covered), used by fractional output.
+  bool IncludePartiallyCoveredSlices;
+
+  /// Functor rasterizing the contour planes in parallel
+  class RasterizeContourPlanesFunctor;
+  /// Functor filling the output slices from the rasterized contour planes in parallel
+  class FillSlicesFunctor;
+
+private:
+  vtkPlanarContourToBinaryLabelmapConversionRule(const vtkPlanarContourToBinaryLabelmapConversionRule&) = delete;
+  void operator=(const vtkPlanarContourToBinaryLabelmapConversionRule&) = delete;
+};
+
+#endif // __vtkPlanarContourToBinaryLabelmapConversionRule_h
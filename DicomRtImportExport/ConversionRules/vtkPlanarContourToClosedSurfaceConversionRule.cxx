@@ -33,6 +33,8 @@
 #include <vtkPolyDataToImageStencil.h>
 #include <vtkPolygon.h>
 #include <vtkPriorityQueue.h>
+#include <vtkSMPTools.h>
+#include <vtkStaticPointLocator.h>
 #include <vtkStripper.h>
 #include <vtkTextureMapToPlane.h>
 #include <vtkTransform.h>
@@ -45,6 +47,7 @@
 
 // STD includes
 #include <algorithm>
+#include <cstdlib>
 
 // SegmentationCore includes
 #if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
@@ -68,6 +71,39 @@ static const CappingDirection CappingDirections[] = { CAPPING_BELOW, CAPPING_ABO
 //----------------------------------------------------------------------------
 vtkSegmentationConverterRuleNewMacro(vtkPlanarContourToClosedSurfaceConversionRule);
 
+//----------------------------------------------------------------------------
+class vtkPlanarContourToClosedSurfaceConversionRule::TriangulateSlicePairsFunctor
+{
+public:
+  TriangulateSlicePairsFunctor(vtkPlanarContourToClosedSurfaceConversionRule* rule, vtkPolyData* inputContours,
+    std::vector<vtkSmartPointer<vtkIdList> >& line1PointIdLists, std::vector<vtkSmartPointer<vtkIdList> >& line2PointIdLists,
+    std::vector<vtkSmartPointer<vtkCellArray> >& outputPolygons)
+    : Rule(rule)
+    , InputContours(inputContours)
+    , Line1PointIdLists(line1PointIdLists)
+    , Line2PointIdLists(line2PointIdLists)
+    , OutputPolygons(outputPolygons)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType slicePairIndex = begin; slicePairIndex < end; ++slicePairIndex)
+    {
+      // Each slice pair has its own output so that the merged result does not depend on scheduling
+      this->Rule->TriangulateBetweenContours(this->InputContours,
+        this->Line1PointIdLists[slicePairIndex], this->Line2PointIdLists[slicePairIndex], this->OutputPolygons[slicePairIndex]);
+    }
+  }
+
+private:
+  vtkPlanarContourToClosedSurfaceConversionRule* Rule;
+  vtkPolyData* InputContours;
+  std::vector<vtkSmartPointer<vtkIdList> >& Line1PointIdLists;
+  std::vector<vtkSmartPointer<vtkIdList> >& Line2PointIdLists;
+  std::vector<vtkSmartPointer<vtkCellArray> >& OutputPolygons;
+};
+
 //----------------------------------------------------------------------------
 vtkPlanarContourToClosedSurfaceConversionRule::vtkPlanarContourToClosedSurfaceConversionRule()
 {
@@ -90,6 +126,15 @@ vtkPlanarContourToClosedSurfaceConversionRule::vtkPlanarContourToClosedSurfaceCo
     "1 (default) = close surface by generating smooth end caps.\n"
     "2 = close surface by generating straight end caps."
   );
+  this->ConversionParameters->SetParameter(this->GetTriangulationBandWidthParameterName(), "0",
+    "Number of points on either side of the closest point correspondence that are considered when triangulating between contours.\n"
+    "Reduces the memory use and the dynamic programming time of long contours (the closest point search between the contours is not affected).\n"
+    "If the optimal triangulation is not found within the band, the full search is used.\n"
+    "Paths leaving the band are not considered, so in rare cases (e.g. equal scores) the triangulation may differ from the full search.\n"
+    "0 (default) = always search all point pairs."
+  );
+
+  this->TriangulationBandWidth = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -162,6 +207,8 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
     return false;
   }
 
+  this->TriangulationBandWidth = std::max(0, vtkVariant(this->GetConversionParameter(this->GetTriangulationBandWidthParameterName())).ToInt());
+
   // Copy the contours so that we can make modifications without affecting the original
   vtkSmartPointer<vtkPolyData> inputContoursCopy = vtkSmartPointer<vtkPolyData>::New();
 
@@ -194,18 +241,11 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
 
   double spacing = this->GetSpacingBetweenLines(inputContoursCopy);
 
-  std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators(numberOfLines);
-  std::vector<vtkSmartPointer<vtkIdList> > linePointIdLists(numberOfLines);
+  // Store line bounds for the overlap queries
+  std::vector<std::array<double, 6> > lineBounds(numberOfLines);
   for (int lineIndex = 0; lineIndex < numberOfLines; ++lineIndex)
   {
-    vtkSmartPointer<vtkLine> currentLine = vtkSmartPointer<vtkLine>::New();
-    currentLine->DeepCopy(inputContoursCopy->GetCell(lineIndex));
-    linePointIdLists[lineIndex] = currentLine->GetPointIds();
-    vtkSmartPointer<vtkPolyData> linePolyData = vtkSmartPointer<vtkPolyData>::New();
-    linePolyData->SetPoints(currentLine->GetPoints());
-    pointLocators[lineIndex] = vtkSmartPointer<vtkPointLocator>::New();
-    pointLocators[lineIndex]->SetDataSet(linePolyData);
-    pointLocators[lineIndex]->BuildLocator();
+    inputContoursCopy->GetCell(lineIndex)->GetBounds(lineBounds[lineIndex].data());
   }
 
   // Vector of booleans to determine which lines are triangulated from above and from below.
@@ -217,6 +257,11 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
     lineTriganulatedToBelow[i] = false;
   }
 
+  // Branched line pairs to triangulate. The pairs are collected in a serial pass (overlap and branching
+  // decisions), then triangulated in parallel, and finally merged in collection order.
+  std::vector<vtkSmartPointer<vtkIdList> > slicePairLine1PointIds;
+  std::vector<vtkSmartPointer<vtkIdList> > slicePairLine2PointIds;
+
   // Get two consecutive planes.
   vtkIdType firstLineOnPlane1Index = 0; // pointer to first line on plane 1.
   int numberOfLinesInPlane1 = this->GetNumberOfLinesOnPlane(inputContoursCopy, 0, spacing);
@@ -234,27 +279,12 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
     std::vector< std::vector< vtkIdType > > plane1Overlaps(numberOfLinesInPlane1);
     std::vector< std::vector< vtkIdType > > plane2Overlaps(numberOfLinesInPlane2);
 
-    // Loop through the lines in the first plane
-    for (int line1Index = 0; line1Index < numberOfLinesInPlane1; ++line1Index)
-    {
-      vtkSmartPointer<vtkLine> line1 = vtkSmartPointer<vtkLine>::New();
-      line1->DeepCopy(inputContoursCopy->GetCell(firstLineOnPlane1Index + line1Index));
-
-      // Loop through the lines in the second plane
-      for (int line2Index = 0; line2Index < numberOfLinesInPlane2; ++line2Index)
-      {
-        vtkSmartPointer<vtkLine> line2 = vtkSmartPointer<vtkLine>::New();
-        line2->DeepCopy(inputContoursCopy->GetCell(firstLineOnPlane2Index + line2Index));
+    this->FindOverlappingLines(lineBounds, firstLineOnPlane1Index, numberOfLinesInPlane1, firstLineOnPlane2Index, numberOfLinesInPlane2,
+      plane1Overlaps, plane2Overlaps);
 
-        // If the two lines overlap, then add them to the lists
-        if (this->DoLinesOverlap(line1, line2))
-        {
-          // line from plane 1 overlaps with line from plane 2
-          plane1Overlaps[line1Index].push_back(firstLineOnPlane2Index + line2Index);
-          plane2Overlaps[line2Index].push_back(firstLineOnPlane1Index + line1Index);
-        }
-      }
-    }
+    // Point locators for the closest branch queries of the lines on plane 2, built when first needed
+    std::vector< vtkSmartPointer<vtkStaticPointLocator> > plane2BranchPointLocators(numberOfLinesInPlane2);
+    std::vector< std::vector< vtkIdType > > plane2BranchPointLineIds(numberOfLinesInPlane2);
 
     // Loop through all of the lines in the first plane
     for (int line1Index = firstLineOnPlane1Index; line1Index < firstLineOnPlane1Index + numberOfLinesInPlane1; ++line1Index)
@@ -262,15 +292,14 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
       vtkSmartPointer<vtkLine> line1 = vtkSmartPointer<vtkLine>::New();
       line1->DeepCopy(inputContoursCopy->GetCell(line1Index));
 
-      std::vector<vtkSmartPointer<vtkPointLocator> > overlap1PointLocators(plane1Overlaps[line1Index - firstLineOnPlane1Index].size());
-      std::vector<vtkSmartPointer<vtkIdList> > overlap1PointIds(plane1Overlaps[line1Index - firstLineOnPlane1Index].size());
-
-      // Loop through all of the lines in the second plane that overlap with the current line in the first plane
-      for (size_t overlapIndex = 0; overlapIndex < plane1Overlaps[line1Index - firstLineOnPlane1Index].size(); ++overlapIndex) // lines on plane 2 that overlap with line 1
+      // Point locator for the closest branch queries of line 1, only needed if it branches
+      const std::vector< vtkIdType >& line1Overlaps = plane1Overlaps[line1Index - firstLineOnPlane1Index];
+      vtkSmartPointer<vtkStaticPointLocator> line1BranchPointLocator;
+      std::vector< vtkIdType > line1BranchPointLineIds;
+      if (line1Overlaps.size() > 1)
       {
-        vtkIdType j = plane1Overlaps[line1Index - firstLineOnPlane1Index][overlapIndex];
-        overlap1PointLocators[overlapIndex] = pointLocators[j];
-        overlap1PointIds[overlapIndex] = linePointIdLists[j];
+        line1BranchPointLocator = vtkSmartPointer<vtkStaticPointLocator>::New();
+        this->BuildBranchPointLocator(inputContoursCopy, line1Overlaps, line1BranchPointLocator, line1BranchPointLineIds);
       }
 
       // Loop through all of the lines in the second plane that overlap with the current line in the first plane
@@ -281,25 +310,23 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
         vtkSmartPointer<vtkLine> line2 = vtkSmartPointer<vtkLine>::New();
         line2->DeepCopy(inputContoursCopy->GetCell(line2Index));
 
-        std::vector<vtkSmartPointer<vtkPointLocator> > overlap2PointLocators(plane2Overlaps[line2Index - firstLineOnPlane2Index].size());
-        std::vector<vtkSmartPointer<vtkIdList> > overlap2PointIds(plane2Overlaps[line2Index - firstLineOnPlane2Index].size());
-
-        for (size_t i = 0; i < plane2Overlaps[line2Index - firstLineOnPlane2Index].size(); ++i)
-        {
-          int j = plane2Overlaps[line2Index - firstLineOnPlane2Index][i];
-          overlap2PointLocators[i] = pointLocators[j];
-          overlap2PointIds[i] = linePointIdLists[j];
-        }
-
         // Get the portion of line 1 that is close to line 2,
         vtkSmartPointer<vtkLine> dividedLine1 = vtkSmartPointer<vtkLine>::New();
-        this->Branch(inputContoursCopy, line1, line2Index, plane1Overlaps[line1Index - firstLineOnPlane1Index], overlap1PointLocators, overlap1PointIds, dividedLine1);
+        this->Branch(inputContoursCopy, line1, line2Index, line1Overlaps, line1BranchPointLocator, line1BranchPointLineIds, dividedLine1);
         vtkSmartPointer<vtkIdList> dividedPointsInLine1 = dividedLine1->GetPointIds();
         int numberOfdividedPointsInLine1 = dividedLine1->GetNumberOfPoints();
 
         // Get the portion of line 2 that is close to line 1.
+        const std::vector< vtkIdType >& line2Overlaps = plane2Overlaps[line2Index - firstLineOnPlane2Index];
+        vtkSmartPointer<vtkStaticPointLocator>& line2BranchPointLocator = plane2BranchPointLocators[line2Index - firstLineOnPlane2Index];
+        std::vector< vtkIdType >& line2BranchPointLineIds = plane2BranchPointLineIds[line2Index - firstLineOnPlane2Index];
+        if (line2Overlaps.size() > 1 && !line2BranchPointLocator)
+        {
+          line2BranchPointLocator = vtkSmartPointer<vtkStaticPointLocator>::New();
+          this->BuildBranchPointLocator(inputContoursCopy, line2Overlaps, line2BranchPointLocator, line2BranchPointLineIds);
+        }
         vtkSmartPointer<vtkLine> dividedLine2 = vtkSmartPointer<vtkLine>::New();
-        this->Branch(inputContoursCopy, line2, line1Index, plane2Overlaps[line2Index - firstLineOnPlane2Index], overlap2PointLocators, overlap2PointIds, dividedLine2);
+        this->Branch(inputContoursCopy, line2, line1Index, line2Overlaps, line2BranchPointLocator, line2BranchPointLineIds, dividedLine2);
         vtkSmartPointer<vtkIdList> dividedPointsInLine2 = dividedLine2->GetPointIds();
         int numberOfdividedPointsInLine2 = dividedLine2->GetNumberOfPoints();
 
@@ -307,7 +334,8 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
         {
           lineTriganulatedToAbove[line1Index] = true;
           lineTriganulatedToBelow[line2Index] = true;
-          this->TriangulateBetweenContours(inputContoursCopy, dividedPointsInLine1, dividedPointsInLine2, outputPolygons);
+          slicePairLine1PointIds.push_back(dividedPointsInLine1);
+          slicePairLine2PointIds.push_back(dividedPointsInLine2);
         }
 
       }
@@ -318,6 +346,28 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
     numberOfLinesInPlane1 = numberOfLinesInPlane2;
   }
 
+  // Triangulate the slice pairs in parallel
+  vtkIdType numberOfSlicePairs = static_cast<vtkIdType>(slicePairLine1PointIds.size());
+  std::vector<vtkSmartPointer<vtkCellArray> > slicePairPolygons(numberOfSlicePairs);
+  for (vtkIdType slicePairIndex = 0; slicePairIndex < numberOfSlicePairs; ++slicePairIndex)
+  {
+    slicePairPolygons[slicePairIndex] = vtkSmartPointer<vtkCellArray>::New();
+  }
+  TriangulateSlicePairsFunctor triangulateFunctor(this, inputContoursCopy, slicePairLine1PointIds, slicePairLine2PointIds, slicePairPolygons);
+  vtkSMPTools::For(0, numberOfSlicePairs, 1, triangulateFunctor);
+
+  // Merge the triangles in the same order as they would have been created serially
+  vtkSmartPointer<vtkIdList> trianglePointIds = vtkSmartPointer<vtkIdList>::New();
+  for (vtkIdType slicePairIndex = 0; slicePairIndex < numberOfSlicePairs; ++slicePairIndex)
+  {
+    vtkCellArray* currentPolygons = slicePairPolygons[slicePairIndex];
+    currentPolygons->InitTraversal();
+    while (currentPolygons->GetNextCell(trianglePointIds))
+    {
+      outputPolygons->InsertNextCell(trianglePointIds);
+    }
+  }
+
   // Triangulate all contours which are exposed.
   if (vtkVariant(this->GetConversionParameter(this->GetEndCappingParameterName())).ToInt() != EndCappingModes::None)
   {
@@ -411,6 +461,13 @@ void vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContours(v
   int line1EndPoint = this->GetEndLoop(startLine1PointId, numberOfPointsInLine1, line1Closed);
   int line2EndPoint = this->GetEndLoop(startLine2PointId, numberOfPointsInLine2, line2Closed);
 
+  // For long contours, only search a band around the closest point correspondence
+  if (this->TriangulationBandWidth > 0 && this->TriangulateBetweenContoursBanded(inputROIPoints, pointsInLine1, pointsInLine2,
+    line1Closed, line2Closed, startLine2PointId, closestPointFromLine1ToLine2Ids, closestPointFromLine2ToLine1Ids, outputPolygons))
+  {
+    return;
+  }
+
   // Initialize the Dynamic Programming table.
   // Rows represent line 1. Columns represent line 2.
 
@@ -547,6 +604,188 @@ void vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContours(v
   }
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContoursBanded(vtkPolyData* inputROIPoints,
+  vtkIdList* pointsInLine1, vtkIdList* pointsInLine2, bool line1Closed, bool line2Closed, vtkIdType startLine2PointId,
+  const std::vector<int>& closestPointFromLine1ToLine2Ids, const std::vector<int>& closestPointFromLine2ToLine1Ids,
+  vtkCellArray* outputPolygons)
+{
+  int numberOfPointsInLine1 = pointsInLine1->GetNumberOfIds();
+  int numberOfPointsInLine2 = pointsInLine2->GetNumberOfIds();
+  int bandWidth = this->TriangulationBandWidth;
+  if (bandWidth <= 0 || numberOfPointsInLine2 <= 2 * bandWidth + 1)
+  {
+    // The band would cover (almost) the whole table
+    return false;
+  }
+
+  // Locations of the rows (line 1) and columns (line 2) of the table, in the same order as the full table
+  std::vector<vtkIdType> line1Locations(numberOfPointsInLine1);
+  line1Locations[0] = 0;
+  for (int line1PointIndex = 1; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+  {
+    line1Locations[line1PointIndex] = this->GetNextLocation(line1Locations[line1PointIndex - 1], numberOfPointsInLine1, line1Closed);
+  }
+  std::vector<vtkIdType> line2Locations(numberOfPointsInLine2);
+  std::vector<int> line2ColumnOfLocation(numberOfPointsInLine2, -1);
+  line2Locations[0] = startLine2PointId;
+  line2ColumnOfLocation[startLine2PointId] = 0;
+  for (int line2PointIndex = 1; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
+  {
+    line2Locations[line2PointIndex] = this->GetNextLocation(line2Locations[line2PointIndex - 1], numberOfPointsInLine2, line2Closed);
+    if (line2ColumnOfLocation[line2Locations[line2PointIndex]] < 0)
+    {
+      line2ColumnOfLocation[line2Locations[line2PointIndex]] = line2PointIndex;
+    }
+  }
+  if (line2Closed && line2ColumnOfLocation[0] < 0)
+  {
+    // The first location is the same point as the last one, and it is skipped when going around the loop
+    line2ColumnOfLocation[0] = line2ColumnOfLocation[numberOfPointsInLine2 - 1];
+  }
+  int line2LoopLength = (line2Closed ? numberOfPointsInLine2 - 1 : numberOfPointsInLine2);
+
+  // Center the band of each row on the column of the closest point, kept monotonic so that the path can follow it
+  std::vector<int> bandStart(numberOfPointsInLine1);
+  std::vector<int> bandEnd(numberOfPointsInLine1);
+  std::vector<size_t> rowOffsets(numberOfPointsInLine1 + 1, 0);
+  int previousCenter = 0;
+  for (int line1PointIndex = 0; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+  {
+    int center = 0;
+    if (line1PointIndex > 0)
+    {
+      // The closest point may be on the other side of the loop seam, use the nearest unwrapped column
+      int closestColumn = line2ColumnOfLocation[closestPointFromLine1ToLine2Ids[line1Locations[line1PointIndex]]];
+      center = closestColumn;
+      for (int unwrappedColumn : { closestColumn - line2LoopLength, closestColumn + line2LoopLength })
+      {
+        if (std::abs(unwrappedColumn - previousCenter) < std::abs(center - previousCenter))
+        {
+          center = unwrappedColumn;
+        }
+      }
+      center = std::min(std::max(center, previousCenter), numberOfPointsInLine2 - 1);
+    }
+    previousCenter = center;
+
+    bandStart[line1PointIndex] = (line1PointIndex == 0 ? 0 : std::max(0, center - bandWidth));
+    bandEnd[line1PointIndex] = (line1PointIndex == numberOfPointsInLine1 - 1 ? numberOfPointsInLine2 - 1 : std::min(numberOfPointsInLine2 - 1, center + bandWidth));
+    if (line1PointIndex > 0)
+    {
+      // Consecutive bands must overlap
+      bandStart[line1PointIndex] = std::min(bandStart[line1PointIndex], bandEnd[line1PointIndex - 1]);
+    }
+    rowOffsets[line1PointIndex + 1] = rowOffsets[line1PointIndex] + (bandEnd[line1PointIndex] - bandStart[line1PointIndex] + 1);
+  }
+
+  std::vector<double> scoreTable(rowOffsets[numberOfPointsInLine1]);
+  std::vector<BacktrackDirection> backtrackTable(rowOffsets[numberOfPointsInLine1]);
+  auto getScore = [&](int line1PointIndex, int line2PointIndex)
+  {
+    if (line2PointIndex < bandStart[line1PointIndex] || line2PointIndex > bandEnd[line1PointIndex])
+    {
+      return VTK_DOUBLE_MAX;
+    }
+    return scoreTable[rowOffsets[line1PointIndex] + line2PointIndex - bandStart[line1PointIndex]];
+  };
+
+  // Fill the table. Same scoring as the full table, cells outside of the band are not reachable.
+  for (int line1PointIndex = 0; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+  {
+    vtkIdType currentPointIdLine1 = line1Locations[line1PointIndex];
+    double pointOnLine1[3] = { 0,0,0 };
+    inputROIPoints->GetPoint(pointsInLine1->GetId(currentPointIdLine1), pointOnLine1);
+
+    for (int line2PointIndex = bandStart[line1PointIndex]; line2PointIndex <= bandEnd[line1PointIndex]; ++line2PointIndex)
+    {
+      vtkIdType currentPointIdLine2 = line2Locations[line2PointIndex];
+      double pointOnLine2[3] = { 0,0,0 };
+      inputROIPoints->GetPoint(pointsInLine2->GetId(currentPointIdLine2), pointOnLine2);
+
+      double distance = vtkMath::Distance2BetweenPoints(pointOnLine1, pointOnLine2);
+
+      BacktrackDirection direction = DYNAMIC_BACKTRACK_UP;
+      if (line1PointIndex == 0 && line2PointIndex == 0)
+      {
+        direction = DYNAMIC_BACKTRACK_UP;
+      }
+      else if (line1PointIndex == 0)
+      {
+        direction = DYNAMIC_BACKTRACK_LEFT;
+      }
+      else if (line2PointIndex == 0)
+      {
+        direction = DYNAMIC_BACKTRACK_UP;
+      }
+      // Use the pre-calculated closest point.
+      else if (currentPointIdLine1 == closestPointFromLine2ToLine1Ids[line2Locations[line2PointIndex - 1]])
+      {
+        direction = DYNAMIC_BACKTRACK_LEFT;
+      }
+      else if (currentPointIdLine2 == closestPointFromLine1ToLine2Ids[line1Locations[line1PointIndex - 1]])
+      {
+        direction = DYNAMIC_BACKTRACK_UP;
+      }
+      else if (getScore(line1PointIndex, line2PointIndex - 1) <= getScore(line1PointIndex - 1, line2PointIndex))
+      {
+        direction = DYNAMIC_BACKTRACK_LEFT;
+      }
+
+      double previousScore = 0.0;
+      if (line1PointIndex > 0 || line2PointIndex > 0)
+      {
+        previousScore = (direction == DYNAMIC_BACKTRACK_LEFT
+          ? getScore(line1PointIndex, line2PointIndex - 1) : getScore(line1PointIndex - 1, line2PointIndex));
+      }
+      size_t cellIndex = rowOffsets[line1PointIndex] + line2PointIndex - bandStart[line1PointIndex];
+      scoreTable[cellIndex] = (previousScore == VTK_DOUBLE_MAX ? VTK_DOUBLE_MAX : previousScore + distance);
+      backtrackTable[cellIndex] = direction;
+    }
+  }
+
+  // Backtrack. If the path is unreachable or touches the border of the band, then the band was too narrow.
+  std::vector<std::array<vtkIdType, 3> > triangles;
+  triangles.reserve(numberOfPointsInLine1 + numberOfPointsInLine2);
+  int line1PointIndex = numberOfPointsInLine1 - 1;
+  int line2PointIndex = numberOfPointsInLine2 - 1;
+  if (getScore(line1PointIndex, line2PointIndex) == VTK_DOUBLE_MAX)
+  {
+    return false;
+  }
+  while (line1PointIndex > 0 || line2PointIndex > 0)
+  {
+    if ((line2PointIndex == bandStart[line1PointIndex] && bandStart[line1PointIndex] > 0)
+      || (line2PointIndex == bandEnd[line1PointIndex] && bandEnd[line1PointIndex] < numberOfPointsInLine2 - 1))
+    {
+      return false;
+    }
+
+    std::array<vtkIdType, 3> currentTriangle = { {
+      pointsInLine1->GetId(line1Locations[line1PointIndex]), pointsInLine2->GetId(line2Locations[line2PointIndex]), 0 } };
+    if (backtrackTable[rowOffsets[line1PointIndex] + line2PointIndex - bandStart[line1PointIndex]] == DYNAMIC_BACKTRACK_LEFT)
+    {
+      --line2PointIndex;
+      currentTriangle[2] = pointsInLine2->GetId(line2Locations[line2PointIndex]);
+    }
+    else // DYNAMIC_BACKTRACK_UP
+    {
+      --line1PointIndex;
+      currentTriangle[2] = pointsInLine1->GetId(line1Locations[line1PointIndex]);
+    }
+    triangles.push_back(currentTriangle);
+  }
+
+  for (const std::array<vtkIdType, 3>& triangle : triangles)
+  {
+    outputPolygons->InsertNextCell(3);
+    outputPolygons->InsertCellPoint(triangle[0]);
+    outputPolygons->InsertCellPoint(triangle[1]);
+    outputPolygons->InsertCellPoint(triangle[2]);
+  }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 vtkIdType vtkPlanarContourToClosedSurfaceConversionRule::GetEndLoop(vtkIdType startLoopIndex, int numberOfPoints, bool loopClosed)
 {
@@ -973,15 +1212,114 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::DoLinesOverlap(vtkLine* line
   double bounds2[6];
   line2->GetBounds(bounds2);
 
+  return DoLineBoundsOverlap(bounds1, bounds2);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlanarContourToClosedSurfaceConversionRule::DoLineBoundsOverlap(const double bounds1[6], const double bounds2[6])
+{
   return bounds1[0] < bounds2[1] &&
     bounds1[1] > bounds2[0] &&
     bounds1[2] < bounds2[3] &&
     bounds1[3] > bounds2[2];
 }
 
+//----------------------------------------------------------------------------
+void vtkPlanarContourToClosedSurfaceConversionRule::FindOverlappingLines(const std::vector<std::array<double, 6> >& lineBounds,
+  vtkIdType firstLineOnPlane1Index, int numberOfLinesInPlane1, vtkIdType firstLineOnPlane2Index, int numberOfLinesInPlane2,
+  std::vector< std::vector< vtkIdType > >& plane1Overlaps, std::vector< std::vector< vtkIdType > >& plane2Overlaps)
+{
+  plane1Overlaps.assign(numberOfLinesInPlane1, std::vector< vtkIdType >());
+  plane2Overlaps.assign(numberOfLinesInPlane2, std::vector< vtkIdType >());
+
+  // Sweep the lines of both planes in the order of their minimum X bound
+  std::vector< std::pair<double, vtkIdType> > linesByMinimumX;
+  linesByMinimumX.reserve(numberOfLinesInPlane1 + numberOfLinesInPlane2);
+  for (int line1Index = 0; line1Index < numberOfLinesInPlane1; ++line1Index)
+  {
+    linesByMinimumX.push_back(std::make_pair(lineBounds[firstLineOnPlane1Index + line1Index][0], firstLineOnPlane1Index + line1Index));
+  }
+  for (int line2Index = 0; line2Index < numberOfLinesInPlane2; ++line2Index)
+  {
+    linesByMinimumX.push_back(std::make_pair(lineBounds[firstLineOnPlane2Index + line2Index][0], firstLineOnPlane2Index + line2Index));
+  }
+  std::sort(linesByMinimumX.begin(), linesByMinimumX.end());
+
+  // Lines of each plane whose X interval may still overlap with the lines not swept yet
+  std::vector< vtkIdType > activeLineIds[2];
+  for (const std::pair<double, vtkIdType>& sweptLine : linesByMinimumX)
+  {
+    vtkIdType lineId = sweptLine.second;
+    int plane = (lineId >= firstLineOnPlane2Index ? 1 : 0);
+    const double* bounds = lineBounds[lineId].data();
+
+    // Lines of the other plane ending before this one starts cannot overlap with any of the remaining lines
+    std::vector< vtkIdType >& otherPlaneActiveLineIds = activeLineIds[1 - plane];
+    size_t numberOfKeptLines = 0;
+    for (vtkIdType otherLineId : otherPlaneActiveLineIds)
+    {
+      const double* otherBounds = lineBounds[otherLineId].data();
+      if (otherBounds[1] <= bounds[0])
+      {
+        continue;
+      }
+      otherPlaneActiveLineIds[numberOfKeptLines++] = otherLineId;
+      if (DoLineBoundsOverlap(bounds, otherBounds))
+      {
+        vtkIdType line1Id = (plane == 0 ? lineId : otherLineId);
+        vtkIdType line2Id = (plane == 0 ? otherLineId : lineId);
+        plane1Overlaps[line1Id - firstLineOnPlane1Index].push_back(line2Id);
+        plane2Overlaps[line2Id - firstLineOnPlane2Index].push_back(line1Id);
+      }
+    }
+    otherPlaneActiveLineIds.resize(numberOfKeptLines);
+    activeLineIds[plane].push_back(lineId);
+  }
+
+  // Keep the overlaps in line order, so that branching does not depend on the sweep
+  for (std::vector< vtkIdType >& overlappingLineIds : plane1Overlaps)
+  {
+    std::sort(overlappingLineIds.begin(), overlappingLineIds.end());
+  }
+  for (std::vector< vtkIdType >& overlappingLineIds : plane2Overlaps)
+  {
+    std::sort(overlappingLineIds.begin(), overlappingLineIds.end());
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourToClosedSurfaceConversionRule::BuildBranchPointLocator(vtkPolyData* inputROIPoints, const std::vector< vtkIdType >& lineIds,
+  vtkStaticPointLocator* pointLocator, std::vector< vtkIdType >& pointLineIds)
+{
+  pointLineIds.clear();
+  if (!inputROIPoints || !pointLocator)
+  {
+    vtkErrorMacro("BuildBranchPointLocator: Invalid input");
+    return;
+  }
+
+  vtkSmartPointer<vtkPoints> branchPoints = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkIdList> linePointIds = vtkSmartPointer<vtkIdList>::New();
+  for (vtkIdType lineId : lineIds)
+  {
+    inputROIPoints->GetCellPoints(lineId, linePointIds);
+    for (vtkIdType pointIndex = 0; pointIndex < linePointIds->GetNumberOfIds(); ++pointIndex)
+    {
+      branchPoints->InsertNextPoint(inputROIPoints->GetPoint(linePointIds->GetId(pointIndex)));
+      pointLineIds.push_back(lineId);
+    }
+  }
+
+  vtkSmartPointer<vtkPolyData> branchPointsPolyData = vtkSmartPointer<vtkPolyData>::New();
+  branchPointsPolyData->SetPoints(branchPoints);
+  pointLocator->SetDataSet(branchPointsPolyData);
+  pointLocator->BuildLocator();
+}
+
 // TODO: It may be possible to speed up this function by only calling the branch function once. -- need to look into this
 //----------------------------------------------------------------------------
-void vtkPlanarContourToClosedSurfaceConversionRule::Branch(vtkPolyData* inputROIPoints, vtkLine* branchingLine, vtkIdType currentLineId, std::vector< vtkIdType > overlappingLineIds, std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators, std::vector<vtkSmartPointer<vtkIdList> > lineIdLists, vtkLine* outputLine)
+void vtkPlanarContourToClosedSurfaceConversionRule::Branch(vtkPolyData* inputROIPoints, vtkLine* branchingLine, vtkIdType currentLineId, const std::vector< vtkIdType >& overlappingLineIds,
+  vtkAbstractPointLocator* pointLocator, const std::vector< vtkIdType >& pointLineIds, vtkLine* outputLine)
 {
   if (!inputROIPoints)
   {
@@ -1016,7 +1354,7 @@ void vtkPlanarContourToClosedSurfaceConversionRule::Branch(vtkPolyData* inputROI
     inputROIPoints->GetPoint(currentPointId, currentPoint);
 
     // See if the point's closest branch is the input branch.
-    if (this->GetClosestBranch(inputROIPoints, currentPoint, overlappingLineIds, pointLocators, lineIdLists) == currentLineId)
+    if (this->GetClosestBranch(inputROIPoints, currentPoint, overlappingLineIds, pointLocator, pointLineIds) == currentLineId)
     {
       outputLinePointIds->InsertNextId(currentPointId);
       prev = true;
@@ -1046,7 +1384,8 @@ void vtkPlanarContourToClosedSurfaceConversionRule::Branch(vtkPolyData* inputROI
 }
 
 //----------------------------------------------------------------------------
-int vtkPlanarContourToClosedSurfaceConversionRule::GetClosestBranch(vtkPolyData* inputROIPoints, double* originalPoint, std::vector< vtkIdType > overlappingLineIds, std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators, std::vector<vtkSmartPointer<vtkIdList> > lineIdLists)
+int vtkPlanarContourToClosedSurfaceConversionRule::GetClosestBranch(vtkPolyData* inputROIPoints, double* originalPoint, const std::vector< vtkIdType >& overlappingLineIds,
+  vtkAbstractPointLocator* pointLocator, const std::vector< vtkIdType >& pointLineIds)
 {
   if (!inputROIPoints)
   {
@@ -1059,25 +1398,63 @@ int vtkPlanarContourToClosedSurfaceConversionRule::GetClosestBranch(vtkPolyData*
     return overlappingLineIds[0];
   }
 
-  double minimumDistanceSquared = VTK_DOUBLE_MAX;
-  vtkIdType closestLineId = overlappingLineIds[0];
+  if (!pointLocator || !pointLocator->GetDataSet())
+  {
+    vtkErrorMacro("GetClosestBranch: Invalid point locator");
+    return overlappingLineIds[0];
+  }
+  vtkDataSet* locatorDataSet = pointLocator->GetDataSet();
+  vtkIdType numberOfLocatorPoints = locatorDataSet->GetNumberOfPoints();
 
-  // Loop through all of the lines that overlap with the line the original point is on
-  for (size_t currentOverlapIndex = 0; currentOverlapIndex < overlappingLineIds.size(); ++currentOverlapIndex)
+  // Query an increasing number of closest points until one on an overlapping line is found.
+  // The closest such point is on the closest branch.
+  vtkSmartPointer<vtkIdList> closestPointIds = vtkSmartPointer<vtkIdList>::New();
+  vtkIdType numberOfCheckedPoints = 0;
+  vtkIdType numberOfClosestPoints = std::min<vtkIdType>(16, numberOfLocatorPoints);
+  while (numberOfCheckedPoints < numberOfLocatorPoints)
   {
-    vtkIdType closestPointId = pointLocators[currentOverlapIndex]->FindClosestPoint(originalPoint);
-    double currentPoint[3] = { 0,0,0 };
-    inputROIPoints->GetPoint(lineIdLists[currentOverlapIndex]->GetId(closestPointId), currentPoint);
+    pointLocator->FindClosestNPoints(numberOfClosestPoints, originalPoint, closestPointIds);
+    vtkIdType numberOfFoundPoints = closestPointIds->GetNumberOfIds();
+    for (vtkIdType closestPointIndex = numberOfCheckedPoints; closestPointIndex < numberOfFoundPoints; ++closestPointIndex)
+    {
+      std::vector< vtkIdType >::const_iterator overlapIt = std::find(
+        overlappingLineIds.begin(), overlappingLineIds.end(), pointLineIds[closestPointIds->GetId(closestPointIndex)]);
+      if (overlapIt == overlappingLineIds.end())
+      {
+        continue;
+      }
+
+      // Among equally distant points prefer the line that comes first in the overlap list
+      size_t closestOverlapIndex = overlapIt - overlappingLineIds.begin();
+      double closestPoint[3] = { 0,0,0 };
+      locatorDataSet->GetPoint(closestPointIds->GetId(closestPointIndex), closestPoint);
+      double minimumDistanceSquared = vtkMath::Distance2BetweenPoints(closestPoint, originalPoint);
+      for (vtkIdType nextPointIndex = closestPointIndex + 1; nextPointIndex < numberOfFoundPoints; ++nextPointIndex)
+      {
+        double nextPoint[3] = { 0,0,0 };
+        locatorDataSet->GetPoint(closestPointIds->GetId(nextPointIndex), nextPoint);
+        if (vtkMath::Distance2BetweenPoints(nextPoint, originalPoint) > minimumDistanceSquared)
+        {
+          break;
+        }
+        overlapIt = std::find(overlappingLineIds.begin(), overlappingLineIds.end(), pointLineIds[closestPointIds->GetId(nextPointIndex)]);
+        if (overlapIt != overlappingLineIds.end())
+        {
+          closestOverlapIndex = std::min<size_t>(closestOverlapIndex, overlapIt - overlappingLineIds.begin());
+        }
+      }
+      return overlappingLineIds[closestOverlapIndex];
+    }
 
-    double currentDistanceToLineSquared = vtkMath::Distance2BetweenPoints(currentPoint, originalPoint);
-    if (currentDistanceToLineSquared < minimumDistanceSquared)
+    if (numberOfFoundPoints <= numberOfCheckedPoints)
     {
-      minimumDistanceSquared = currentDistanceToLineSquared;
-      closestLineId = overlappingLineIds[currentOverlapIndex];
+      break;
     }
+    numberOfCheckedPoints = numberOfFoundPoints;
+    numberOfClosestPoints = std::min<vtkIdType>(4 * numberOfClosestPoints, numberOfLocatorPoints);
   }
 
-  return closestLineId;
+  return overlappingLineIds[0];
 }
 
 //----------------------------------------------------------------------------
@@ -1131,9 +1508,12 @@ void vtkPlanarContourToClosedSurfaceConversionRule::EndCapping(vtkPolyData* inpu
 
         int numberOfCells = externalLines->GetNumberOfCells();
         std::vector<vtkIdType> overlapLineIds(numberOfCells);
-        std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators(numberOfCells);
         std::vector<vtkSmartPointer<vtkIdList> >  idLists(numberOfCells);
 
+        // Points of the external lines for a shared point locator, with the external line index of each point
+        vtkSmartPointer<vtkPoints> externalLinePoints = vtkSmartPointer<vtkPoints>::New();
+        std::vector<vtkIdType> externalPointLineIds;
+
         // Loop through all of the external lines that were created
         for (int currentLineId = 0; currentLineId < numberOfCells; ++currentLineId)
         {
@@ -1151,20 +1531,28 @@ void vtkPlanarContourToClosedSurfaceConversionRule::EndCapping(vtkPolyData* inpu
 
           this->TriangulateContourInterior(newLine, outputPolygons, direction == CAPPING_ABOVE);
 
-          vtkSmartPointer<vtkPolyData> linePolyData = vtkSmartPointer<vtkPolyData>::New();
-          linePolyData->SetPoints(newLine->GetPoints());
+          for (vtkIdType pointIndex = 0; pointIndex < newLine->GetNumberOfPoints(); ++pointIndex)
+          {
+            externalLinePoints->InsertNextPoint(newLine->GetPoints()->GetPoint(pointIndex));
+            externalPointLineIds.push_back(currentLineId);
+          }
+        }
 
-          vtkSmartPointer<vtkPointLocator> pointLocator = vtkSmartPointer<vtkPointLocator>::New();
-          pointLocator->SetDataSet(linePolyData);
-          pointLocator->BuildLocator();
-          pointLocators[currentLineId] = pointLocator;
+        if (externalLinePoints->GetNumberOfPoints() == 0)
+        {
+          continue;
         }
+        vtkSmartPointer<vtkPolyData> externalLinesPolyData = vtkSmartPointer<vtkPolyData>::New();
+        externalLinesPolyData->SetPoints(externalLinePoints);
+        vtkSmartPointer<vtkStaticPointLocator> externalLinesPointLocator = vtkSmartPointer<vtkStaticPointLocator>::New();
+        externalLinesPointLocator->SetDataSet(externalLinesPolyData);
+        externalLinesPointLocator->BuildLocator();
 
         // Loop through all of the external lines that were created
         for (int currentLineId = 0; currentLineId < numberOfCells; ++currentLineId)
         {
           vtkSmartPointer<vtkLine> dividedLine = vtkSmartPointer<vtkLine>::New();
-          this->Branch(inputROIPoints, currentLine, currentLineId, overlapLineIds, pointLocators, idLists, dividedLine);
+          this->Branch(inputROIPoints, currentLine, currentLineId, overlapLineIds, externalLinesPointLocator, externalPointLineIds, dividedLine);
           if (direction == CAPPING_ABOVE)
           {
             this->TriangulateBetweenContours(inputROIPoints, dividedLine->GetPointIds(), idLists[currentLineId], outputPolygons);
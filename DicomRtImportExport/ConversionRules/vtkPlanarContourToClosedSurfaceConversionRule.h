@@ -33,6 +33,12 @@
 // VTK includes
 #include "vtkPointLocator.h"
 
+// STD includes
+#include <array>
+#include <vector>
+
+class vtkAbstractPointLocator;
+class vtkStaticPointLocator;
 class vtkPolyData;
 class vtkIdList;
 class vtkCellArray;
@@ -58,6 +64,7 @@ public:
 
   static const std::string GetDefaultSliceThicknessParameterName() { return "Default slice thickness"; };
   static const std::string GetEndCappingParameterName() { return "End capping"; };
+  static const std::string GetTriangulationBandWidthParameterName() { return "Triangulation band width"; };
   enum EndCappingModes
   {
     None = 0,
@@ -105,6 +112,22 @@ protected:
   /// \param Cell array that polygons are added to by the triangulation algorithm
   void TriangulateBetweenContours(vtkPolyData* inputROIPoints, vtkIdList* pointsInLine1, vtkIdList* pointsInLine2, vtkCellArray* outputPolygons);
 
+  /// Construct the triangulation between two lines with the dynamic programming algorithm restricted to a
+  /// diagonal band of the table, centered on the closest point correspondence from line 1 to line 2.
+  /// The size of the table and the dynamic programming are linear in the contour length, but the closest point
+  /// correspondence is computed by TriangulateBetweenContours with a search of all point pairs, so the overall
+  /// triangulation still takes quadratic time.
+  /// \param line1Closed, line2Closed Whether the lines are closed loops
+  /// \param startLine2PointId Location on line 2 corresponding to the first point of line 1
+  /// \param closestPointFromLine1ToLine2Ids Closest location on line 2 for each location on line 1
+  /// \param closestPointFromLine2ToLine1Ids Closest location on line 1 for each location on line 2
+  /// \return True if the triangles were added. False if the lines are too short for the band to help,
+  ///   or if the optimal path reached the border of the band, in which case nothing is added.
+  bool TriangulateBetweenContoursBanded(vtkPolyData* inputROIPoints, vtkIdList* pointsInLine1, vtkIdList* pointsInLine2,
+    bool line1Closed, bool line2Closed, vtkIdType startLine2PointId,
+    const std::vector<int>& closestPointFromLine1ToLine2Ids, const std::vector<int>& closestPointFromLine2ToLine1Ids,
+    vtkCellArray* outputPolygons);
+
   /// Find the index of the last point in a contour.
   /// \param startLoopIndex The index of the first point in the contour
   /// \param numberOfPoints The number of points in the contour
@@ -154,24 +177,49 @@ protected:
   /// \param The first line
   /// \param The second line
   bool DoLinesOverlap(vtkLine* line1, vtkLine* line2);
+  /// Determine if two contours overlap in the XY axis based on their bounds.
+  static bool DoLineBoundsOverlap(const double bounds1[6], const double bounds2[6]);
+
+  /// Find the overlapping lines between two adjacent planes. The lines of both planes are swept in the order
+  /// of their minimum X bound, keeping only the lines of the other plane whose X interval is still open,
+  /// so only the line pairs that overlap in X are checked.
+  /// \param lineBounds Bounds of all of the lines in the polydata
+  /// \param firstLineOnPlane1Index, numberOfLinesInPlane1 Line range of the first plane
+  /// \param firstLineOnPlane2Index, numberOfLinesInPlane2 Line range of the second plane
+  /// \param plane1Overlaps Output overlapping line IDs on plane 2 for each line on plane 1 (in increasing order)
+  /// \param plane2Overlaps Output overlapping line IDs on plane 1 for each line on plane 2 (in increasing order)
+  void FindOverlappingLines(const std::vector<std::array<double, 6> >& lineBounds,
+    vtkIdType firstLineOnPlane1Index, int numberOfLinesInPlane1, vtkIdType firstLineOnPlane2Index, int numberOfLinesInPlane2,
+    std::vector< std::vector< vtkIdType > >& plane1Overlaps, std::vector< std::vector< vtkIdType > >& plane2Overlaps);
+
+  /// Build a point locator for the closest branch queries of a line, containing only the points of the lines
+  /// it overlaps with. The closest point in the locator is then always on the closest branch.
+  /// \param inputROIPoints Polydata containing all of the points and contours
+  /// \param lineIds IDs of the overlapping lines
+  /// \param pointLocator Point locator to build
+  /// \param pointLineIds Output line ID for each point in the point locator
+  void BuildBranchPointLocator(vtkPolyData* inputROIPoints, const std::vector< vtkIdType >& lineIds,
+    vtkStaticPointLocator* pointLocator, std::vector< vtkIdType >& pointLineIds);
 
   /// Create a branching pattern for overlapping contours.
   /// \param inputROIPoints Polydata containing all of the points and contours
   /// \param branchingLine The orignal line that is being divided
   /// \param currentLineId The ID of the current line in the input polydata that is being compared
   /// \param overlappingLineIds List of line IDs for lines that overlap with the current line
-  /// \param pointLocators List of point locators for lines in the overlap list
-  /// \param lineIdLists List of vtkIdLists for all of the lines in the overlap list
+  /// \param pointLocator Point locator of the overlapping lines (see BuildBranchPointLocator). Only needed if there are several overlapping lines.
+  /// \param pointLineIds Line ID for each point in the point locator (-1 if the point is not on a line)
   /// \param outputLine The output branched line
-  void Branch(vtkPolyData* inputROIPoints, vtkLine* branchingLine, vtkIdType currentLineId, std::vector< vtkIdType > overlappingLineIds, std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators, std::vector<vtkSmartPointer<vtkIdList> > lineIdLists, vtkLine* outputLine);
+  void Branch(vtkPolyData* inputROIPoints, vtkLine* branchingLine, vtkIdType currentLineId, const std::vector< vtkIdType >& overlappingLineIds,
+    vtkAbstractPointLocator* pointLocator, const std::vector< vtkIdType >& pointLineIds, vtkLine* outputLine);
 
   /// Find the branch closest from the point on the trunk
   /// \param inputROIPoints Polydata containing all of the points and contours
   /// \param originalPoint The point that is being compared
   /// \param overlappingLineIds List of line IDs for lines that overlap with the current line
-  /// \param pointLocators List of point locators for lines in the overlap list
-  /// \param lineIdLists List of vtkIdLists for all of the lines in the overlap list
-  int GetClosestBranch(vtkPolyData* inputROIPoints, double* originalPoint, std::vector< vtkIdType > overlappingLineIds, std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators, std::vector<vtkSmartPointer<vtkIdList> > lineIdLists);
+  /// \param pointLocator Point locator of the overlapping lines (see BuildBranchPointLocator). Only needed if there are several overlapping lines.
+  /// \param pointLineIds Line ID for each point in the point locator (-1 if the point is not on a line)
+  int GetClosestBranch(vtkPolyData* inputROIPoints, double* originalPoint, const std::vector< vtkIdType >& overlappingLineIds,
+    vtkAbstractPointLocator* pointLocator, const std::vector< vtkIdType >& pointLineIds);
 
   /// Seal the exterior contours of the mesh.
   /// \param inputROIPoints Polydata containing all of the points and contours
@@ -276,6 +324,9 @@ protected:
   ///\param minimumContourSize The minimum number of points in contours to be considered
   void CalculateContourNormal(vtkPolyData* inputPolyData, double outputNormal[3], int minimumContourSize);
 
+  /// Functor triangulating independent pairs of branched lines on adjacent planes in parallel
+  class TriangulateSlicePairsFunctor;
+
 protected:
 
   // Spacing that is used for the image in the end-capping process
@@ -287,6 +338,10 @@ protected:
   // Image padding size that is used in the end-capping process
   int ImagePadding[3];
 
+  // Half width of the band used for triangulating between contours (0 = always use the full table, default).
+  // Set from the conversion parameter at the start of the conversion.
+  int TriangulationBandWidth;
+
 private:
   vtkPlanarContourToClosedSurfaceConversionRule(const vtkPlanarContourToClosedSurfaceConversionRule&) = delete;
   void operator=(const vtkPlanarContourToClosedSurfaceConversionRule&) = delete;
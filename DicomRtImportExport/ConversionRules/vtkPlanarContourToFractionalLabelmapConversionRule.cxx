@@ -0,0 +1,439 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkPlanarContourToFractionalLabelmapConversionRule.h"
+
+// SegmentationCore includes
+#include <vtkOrientedImageData.h>
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+#include <vtkSegment.h>
+#endif
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkIntArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+// Fractional labelmap value range, same as used by the closed surface to fractional labelmap conversion
+#define FRACTIONAL_DATA_TYPE VTK_CHAR
+#define FRACTIONAL_MIN -108
+#define FRACTIONAL_MAX 108
+#define FRACTIONAL_STEP_SIZE (FRACTIONAL_MAX - FRACTIONAL_MIN)
+
+//----------------------------------------------------------------------------
+// Antiderivative of clamp(t, 0, 1)
+static inline double IntegralOfClampedRamp(double t)
+{
+  if (t <= 0.0)
+  {
+    return 0.0;
+  }
+  return (t < 1.0 ? 0.5 * t * t : t - 0.5);
+}
+
+//----------------------------------------------------------------------------
+// Add the signed area to the right of an edge to the voxels of a coverage map. Coordinates are in
+// voxel units relative to the corner of the map, so that voxel column c covers [c, c+1).
+// Summing this over the edges of a closed polygon gives the area of the polygon in each voxel.
+// The area to the right of an edge is stored in two parts: the exact area in the voxels the edge
+// passes through, and the full strip height once for all voxels further right (summed per row later).
+static void AccumulateEdgeCoverage(double x0, double y0, double x1, double y1, double weight,
+  int width, int height, double* area, double* cover)
+{
+  if (y0 == y1)
+  {
+    // Horizontal edges do not cover anything
+    return;
+  }
+  // Downward edges add, upward edges subtract, so that counter-clockwise polygons have positive area
+  double direction = (y0 > y1 ? weight : -weight);
+  if (y0 > y1)
+  {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+  }
+  double slope = (x1 - x0) / (y1 - y0);
+
+  // Split the edge where it leaves the map horizontally, the parts outside are clamped to the map border
+  double splitYs[4] = { y0, y1, y1, y1 };
+  int numberOfSplitYs = 2;
+  if (slope != 0.0)
+  {
+    for (double borderX : { 0.0, static_cast<double>(width) })
+    {
+      double splitY = y0 + (borderX - x0) / slope;
+      if (splitY > y0 && splitY < y1)
+      {
+        splitYs[numberOfSplitYs++] = splitY;
+      }
+    }
+    std::sort(splitYs, splitYs + numberOfSplitYs);
+  }
+
+  for (int partIndex = 0; partIndex + 1 < numberOfSplitYs; ++partIndex)
+  {
+    double partStartY = std::max(splitYs[partIndex], 0.0);
+    double partEndY = std::min(splitYs[partIndex + 1], static_cast<double>(height));
+    if (partStartY >= partEndY)
+    {
+      continue;
+    }
+    int firstRow = static_cast<int>(std::floor(partStartY));
+    int lastRow = std::min(static_cast<int>(std::ceil(partEndY)) - 1, height - 1);
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+      double rowStartY = std::max(partStartY, static_cast<double>(row));
+      double rowEndY = std::min(partEndY, static_cast<double>(row + 1));
+      double dy = rowEndY - rowStartY;
+      if (dy <= 0.0)
+      {
+        continue;
+      }
+      double xa = std::min(std::max(x0 + (rowStartY - y0) * slope, 0.0), static_cast<double>(width));
+      double xb = std::min(std::max(x0 + (rowEndY - y0) * slope, 0.0), static_cast<double>(width));
+      double xMin = std::min(xa, xb);
+      double xMax = std::max(xa, xb);
+
+      double* rowArea = area + static_cast<size_t>(row) * width;
+      int firstColumn = static_cast<int>(std::floor(xMin));
+      int endColumn = static_cast<int>(std::ceil(xMax));
+      for (int column = firstColumn; column < std::min(endColumn, width); ++column)
+      {
+        double columnEndX = column + 1.0;
+        double coveredArea = (xMax - xMin > 1e-9
+          ? dy * (IntegralOfClampedRamp(columnEndX - xMin) - IntegralOfClampedRamp(columnEndX - xMax)) / (xMax - xMin)
+          : dy * std::min(std::max(columnEndX - 0.5 * (xMin + xMax), 0.0), 1.0));
+        rowArea[column] += direction * coveredArea;
+      }
+      cover[static_cast<size_t>(row) * (width + 1) + endColumn] += direction * dy;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Even-odd point in polygon test on a flat (x,y) coordinate list
+static bool IsPointInPolygon(const double point[2], const std::vector<double>& polygon)
+{
+  bool inside = false;
+  size_t numberOfPoints = polygon.size() / 2;
+  for (size_t pointIndex = 0, previousIndex = numberOfPoints - 1; pointIndex < numberOfPoints; previousIndex = pointIndex++)
+  {
+    const double* current = polygon.data() + 2 * pointIndex;
+    const double* previous = polygon.data() + 2 * previousIndex;
+    if ((current[1] > point[1]) != (previous[1] > point[1])
+      && point[0] < (previous[0] - current[0]) * (point[1] - current[1]) / (previous[1] - current[1]) + current[0])
+    {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+//----------------------------------------------------------------------------
+vtkSegmentationConverterRuleNewMacro(vtkPlanarContourToFractionalLabelmapConversionRule);
+
+//----------------------------------------------------------------------------
+class vtkPlanarContourToFractionalLabelmapConversionRule::ComputeCoverageMapsFunctor
+{
+public:
+  void operator()(vtkIdType begin, vtkIdType end) const
+  {
+    for (vtkIdType planeIndex = begin; planeIndex < end; ++planeIndex)
+    {
+      vtkPlanarContourToFractionalLabelmapConversionRule::ComputeCoverageMap(
+        (*this->ContourPlanes)[planeIndex], this->Extent, this->CoverageMaps + planeIndex * this->SliceSize);
+    }
+  }
+
+  const std::vector<ContourPlane>* ContourPlanes{nullptr};
+  int Extent[4]{0,-1,0,-1};
+  vtkIdType SliceSize{0};
+  float* CoverageMaps{nullptr};
+};
+
+//----------------------------------------------------------------------------
+class vtkPlanarContourToFractionalLabelmapConversionRule::FillFractionalSlicesFunctor
+{
+public:
+  void operator()(vtkIdType beginK, vtkIdType endK) const
+  {
+    std::vector<float> fractions(this->SliceSize);
+    int numberOfPlanes = static_cast<int>(this->SlabStartKs.size());
+    for (vtkIdType k = beginK; k < endK; ++k)
+    {
+      char* slice = this->Output + (k - this->FirstK) * this->SliceSize;
+      double voxelStartK = k - 0.5;
+      double voxelEndK = k + 0.5;
+
+      // Add the coverage of each contour slab overlapping the voxels, weighted by the overlap
+      std::fill(fractions.begin(), fractions.end(), 0.0f);
+      bool covered = false;
+      int planeIndex = static_cast<int>(std::upper_bound(this->SlabEndKs.begin(), this->SlabEndKs.end(), voxelStartK) - this->SlabEndKs.begin());
+      for (; planeIndex < numberOfPlanes && this->SlabStartKs[planeIndex] < voxelEndK; ++planeIndex)
+      {
+        float overlap = static_cast<float>(
+          std::min(voxelEndK, this->SlabEndKs[planeIndex]) - std::max(voxelStartK, this->SlabStartKs[planeIndex]));
+        if (overlap <= 0.0f)
+        {
+          continue;
+        }
+        covered = true;
+        const float* coverage = this->CoverageMaps + planeIndex * this->SliceSize;
+        for (vtkIdType index = 0; index < this->SliceSize; ++index)
+        {
+          fractions[index] += overlap * coverage[index];
+        }
+      }
+      if (!covered)
+      {
+        // Output is already filled with the minimum value
+        continue;
+      }
+
+      for (vtkIdType index = 0; index < this->SliceSize; ++index)
+      {
+        float fraction = std::min(std::max(fractions[index], 0.0f), 1.0f);
+        slice[index] = static_cast<char>(std::lround(FRACTIONAL_MIN + fraction * FRACTIONAL_STEP_SIZE));
+      }
+    }
+  }
+
+  std::vector<double> SlabStartKs;
+  std::vector<double> SlabEndKs;
+  vtkIdType SliceSize{0};
+  int FirstK{0};
+  const float* CoverageMaps{nullptr};
+  char* Output{nullptr};
+};
+
+//----------------------------------------------------------------------------
+vtkPlanarContourToFractionalLabelmapConversionRule::vtkPlanarContourToFractionalLabelmapConversionRule()
+{
+  this->IncludePartiallyCoveredSlices = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlanarContourToFractionalLabelmapConversionRule::~vtkPlanarContourToFractionalLabelmapConversionRule() = default;
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlanarContourToFractionalLabelmapConversionRule::GetConversionCost(
+  vtkDataObject* vtkNotUsed(sourceRepresentation)/*=nullptr*/,
+  vtkDataObject* vtkNotUsed(targetRepresentation)/*=nullptr*/)
+{
+  if (!this->IsOversamplingFactorSupported())
+  {
+    // Same high cost as the binary rule, so that the conversion through the closed surface is used
+    return this->Superclass::GetConversionCost();
+  }
+  // Rough input-independent guess (ms)
+  return 250;
+}
+
+//----------------------------------------------------------------------------
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+bool vtkPlanarContourToFractionalLabelmapConversionRule::Convert(vtkSegment* segment)
+{
+  this->CreateTargetRepresentation(segment);
+#else
+bool vtkPlanarContourToFractionalLabelmapConversionRule::Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation)
+{
+#endif
+  // Check validity of source and target representation objects
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  vtkPolyData* planarContoursPolyData = vtkPolyData::SafeDownCast(segment->GetRepresentation(this->GetSourceRepresentationName()));
+#else
+  vtkPolyData* planarContoursPolyData = vtkPolyData::SafeDownCast(sourceRepresentation);
+#endif
+  if (!planarContoursPolyData)
+  {
+    vtkErrorMacro("Convert: Source representation is not a poly data");
+    return false;
+  }
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  vtkOrientedImageData* fractionalLabelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(this->GetTargetRepresentationName()));
+#else
+  vtkOrientedImageData* fractionalLabelmap = vtkOrientedImageData::SafeDownCast(targetRepresentation);
+#endif
+  if (!fractionalLabelmap)
+  {
+    vtkErrorMacro("Convert: Target representation is not an oriented image data");
+    return false;
+  }
+
+  std::vector<ContourPlane> contourPlanes;
+  if (!this->ExtractContourPlanes(planarContoursPolyData, fractionalLabelmap, contourPlanes))
+  {
+    return false;
+  }
+
+  fractionalLabelmap->AllocateScalars(FRACTIONAL_DATA_TYPE, 1);
+  char* labelmapPtr = static_cast<char*>(fractionalLabelmap->GetScalarPointer());
+  std::fill(labelmapPtr, labelmapPtr + fractionalLabelmap->GetNumberOfPoints(), static_cast<char>(FRACTIONAL_MIN));
+
+  // Specify the scalar range of values in the labelmap
+  vtkSmartPointer<vtkDoubleArray> scalarRangeArray = vtkSmartPointer<vtkDoubleArray>::New();
+  scalarRangeArray->SetName(vtkSegmentationConverter::GetScalarRangeFieldName());
+  scalarRangeArray->InsertNextValue(FRACTIONAL_MIN);
+  scalarRangeArray->InsertNextValue(FRACTIONAL_MAX);
+  fractionalLabelmap->GetFieldData()->AddArray(scalarRangeArray);
+
+  // Specify the surface threshold value for visualization
+  vtkSmartPointer<vtkDoubleArray> thresholdValueArray = vtkSmartPointer<vtkDoubleArray>::New();
+  thresholdValueArray->SetName(vtkSegmentationConverter::GetThresholdValueFieldName());
+  thresholdValueArray->InsertNextValue((FRACTIONAL_MIN + FRACTIONAL_MAX) / 2.0);
+  fractionalLabelmap->GetFieldData()->AddArray(thresholdValueArray);
+
+  // Specify the interpolation type for visualization
+  vtkSmartPointer<vtkIntArray> interpolationTypeArray = vtkSmartPointer<vtkIntArray>::New();
+  interpolationTypeArray->SetName(vtkSegmentationConverter::GetInterpolationTypeFieldName());
+  interpolationTypeArray->InsertNextValue(VTK_LINEAR_INTERPOLATION);
+  fractionalLabelmap->GetFieldData()->AddArray(interpolationTypeArray);
+
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  fractionalLabelmap->GetExtent(extent);
+  if (contourPlanes.empty() || extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+  {
+    // Empty structure
+    return true;
+  }
+
+  int dimensions[2] = { extent[1] - extent[0] + 1, extent[3] - extent[2] + 1 };
+  vtkIdType sliceSize = static_cast<vtkIdType>(dimensions[0]) * dimensions[1];
+  vtkIdType numberOfPlanes = static_cast<vtkIdType>(contourPlanes.size());
+
+  // Compute in-plane coverage of each contour plane in parallel
+  std::vector<float> coverageMaps(numberOfPlanes * sliceSize);
+  ComputeCoverageMapsFunctor coverageFunctor;
+  coverageFunctor.ContourPlanes = &contourPlanes;
+  std::copy(extent, extent + 4, coverageFunctor.Extent);
+  coverageFunctor.SliceSize = sliceSize;
+  coverageFunctor.CoverageMaps = coverageMaps.data();
+  vtkSMPTools::For(0, numberOfPlanes, 1, coverageFunctor);
+
+  // Combine the contour slabs overlapping each slice in parallel
+  double planeSpacing = this->GetContourPlaneSpacing(contourPlanes);
+  FillFractionalSlicesFunctor fillFunctor;
+  for (int planeIndex = 0; planeIndex < numberOfPlanes; ++planeIndex)
+  {
+    double slabStartK = 0.0;
+    double slabEndK = 0.0;
+    this->GetContourPlaneSlab(contourPlanes, planeSpacing, planeIndex, slabStartK, slabEndK);
+    fillFunctor.SlabStartKs.push_back(slabStartK);
+    fillFunctor.SlabEndKs.push_back(slabEndK);
+  }
+  fillFunctor.SliceSize = sliceSize;
+  fillFunctor.FirstK = extent[4];
+  fillFunctor.CoverageMaps = coverageMaps.data();
+  fillFunctor.Output = labelmapPtr;
+  vtkSMPTools::For(extent[4], extent[5] + 1, fillFunctor);
+
+  fractionalLabelmap->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourToFractionalLabelmapConversionRule::ComputeCoverageMap(const ContourPlane& contourPlane, const int extent[4], float* coverage)
+{
+  int width = extent[1] - extent[0] + 1;
+  int height = extent[3] - extent[2] + 1;
+  std::vector<double> area(static_cast<size_t>(width) * height, 0.0);
+  std::vector<double> cover(static_cast<size_t>(width + 1) * height, 0.0);
+
+  // Voxel (I,J) covers [I-0.5, I+0.5) x [J-0.5, J+0.5)
+  double originX = extent[0] - 0.5;
+  double originY = extent[2] - 0.5;
+
+  size_t numberOfPolygons = contourPlane.Polygons.size();
+  for (size_t polygonIndex = 0; polygonIndex < numberOfPolygons; ++polygonIndex)
+  {
+    const std::vector<double>& polygon = contourPlane.Polygons[polygonIndex];
+    size_t numberOfPoints = polygon.size() / 2;
+
+    // Orientation from the signed area, so that each polygon contributes with positive area
+    double signedArea = 0.0;
+    for (size_t pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      const double* current = polygon.data() + 2 * pointIndex;
+      const double* next = polygon.data() + 2 * ((pointIndex + 1) % numberOfPoints);
+      signedArea += current[0] * next[1] - next[0] * current[1];
+    }
+    if (signedArea == 0.0)
+    {
+      continue;
+    }
+
+    // Polygons nested in an odd number of others are holes (even-odd rule, as in the binary rasterization)
+    int nestingDepth = 0;
+    for (size_t otherPolygonIndex = 0; otherPolygonIndex < numberOfPolygons; ++otherPolygonIndex)
+    {
+      if (otherPolygonIndex != polygonIndex && IsPointInPolygon(polygon.data(), contourPlane.Polygons[otherPolygonIndex]))
+      {
+        ++nestingDepth;
+      }
+    }
+    double weight = (signedArea > 0.0 ? 1.0 : -1.0) * (nestingDepth % 2 ? -1.0 : 1.0);
+
+    for (size_t pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      const double* current = polygon.data() + 2 * pointIndex;
+      const double* next = polygon.data() + 2 * ((pointIndex + 1) % numberOfPoints);
+      AccumulateEdgeCoverage(current[0] - originX, current[1] - originY, next[0] - originX, next[1] - originY,
+        weight, width, height, area.data(), cover.data());
+    }
+  }
+
+  for (int row = 0; row < height; ++row)
+  {
+    const double* rowArea = area.data() + static_cast<size_t>(row) * width;
+    const double* rowCover = cover.data() + static_cast<size_t>(row) * (width + 1);
+    float* rowCoverage = coverage + static_cast<size_t>(row) * width;
+    double accumulatedCover = 0.0;
+    for (int column = 0; column < width; ++column)
+    {
+      accumulatedCover += rowCover[column];
+      rowCoverage[column] = static_cast<float>(std::min(std::max(rowArea[column] + accumulatedCover, 0.0), 1.0));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourToFractionalLabelmapConversionRule::GetContourPlaneSlab(const std::vector<ContourPlane>& contourPlanes,
+  double planeSpacing, int planeIndex, double& slabStartK, double& slabEndK)
+{
+  int numberOfPlanes = static_cast<int>(contourPlanes.size());
+  double planeK = contourPlanes[planeIndex].K;
+  double halfThickness = (numberOfPlanes > 1 ? planeSpacing / 2.0 : 0.5);
+
+  // Same connectivity criterion as used for the binary labelmap slices
+  slabStartK = planeK - halfThickness;
+  if (planeIndex > 0 && planeK - contourPlanes[planeIndex - 1].K <= 1.5 * planeSpacing)
+  {
+    slabStartK = 0.5 * (planeK + contourPlanes[planeIndex - 1].K);
+  }
+  slabEndK = planeK + halfThickness;
+  if (planeIndex + 1 < numberOfPlanes && contourPlanes[planeIndex + 1].K - planeK <= 1.5 * planeSpacing)
+  {
+    slabEndK = 0.5 * (planeK + contourPlanes[planeIndex + 1].K);
+  }
+}
@@ -0,0 +1,83 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkPlanarContourToFractionalLabelmapConversionRule_h
+#define __vtkPlanarContourToFractionalLabelmapConversionRule_h
+
+#include "vtkPlanarContourToBinaryLabelmapConversionRule.h"
+
+/// \ingroup DicomRtImportImportExportConversionRules
+/// \brief Convert planar contour representation (vtkPolyData type) directly to
+///   fractional labelmap representation (vtkOrientedImageData type). The in-plane coverage
+///   of each voxel is computed exactly by clipping the polygons with the voxel boundaries,
+///   and each contour plane contributes to the voxels overlapping its slab (the plane extended
+///   half way to its neighbors), so no oversampling is needed. A fixed oversampling factor is
+///   still applied on the reference geometry, and automatic oversampling is left to the conversion
+///   through the closed surface, as in the binary rule.
+///   Note: as this rule is cheaper than the conversion through the closed surface, it is used for
+///   fractional labelmaps of planar contour segments (e.g. in fractional DVH computation with fixed
+///   oversampling). The voxel fractions are the exact contour slab coverage instead of the fraction of
+///   oversampled voxels inside the closed surface, so the volumes differ slightly from earlier results.
+class VTK_SLICER_DICOMRTIMPORTEXPORT_CONVERSIONRULES_EXPORT vtkPlanarContourToFractionalLabelmapConversionRule
+  : public vtkPlanarContourToBinaryLabelmapConversionRule
+{
+public:
+  static vtkPlanarContourToFractionalLabelmapConversionRule* New();
+  vtkTypeMacro(vtkPlanarContourToFractionalLabelmapConversionRule, vtkPlanarContourToBinaryLabelmapConversionRule);
+  vtkSegmentationConverterRule* CreateRuleInstance() override;
+
+  /// Update the target representation based on the source representation
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  bool Convert(vtkSegment* segment) override;
+#else
+  bool Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation) override;
+#endif
+
+  /// Get the cost of the conversion. Higher than the conversion through the closed surface if the
+  /// conversion parameters are not supported (automatic oversampling).
+  unsigned int GetConversionCost(vtkDataObject* sourceRepresentation = nullptr, vtkDataObject* targetRepresentation = nullptr) override;
+
+  /// Human-readable name of the converter rule
+  const char* GetName() override { return "Planar contour to fractional labelmap"; };
+
+  /// Human-readable name of the target representation
+  const char* GetTargetRepresentationName() override { return vtkSegmentationConverter::GetSegmentationFractionalLabelmapRepresentationName(); };
+
+protected:
+  vtkPlanarContourToFractionalLabelmapConversionRule();
+  ~vtkPlanarContourToFractionalLabelmapConversionRule() override;
+
+  /// Compute the area of each voxel covered by the polygons of a contour plane (0..1).
+  /// Polygons inside an odd number of other polygons are holes.
+  /// \param extent In-plane extent (I min, I max, J min, J max) of the coverage map
+  static void ComputeCoverageMap(const ContourPlane& contourPlane, const int extent[4], float* coverage);
+
+  /// Get the range of K coordinates represented by a contour plane. Connected planes
+  /// meet half way, planes at the ends and at gaps extend by half of the plane spacing.
+  static void GetContourPlaneSlab(const std::vector<ContourPlane>& contourPlanes, double planeSpacing, int planeIndex,
+    double& slabStartK, double& slabEndK);
+
+  /// Functor computing the coverage maps of the contour planes in parallel
+  class ComputeCoverageMapsFunctor;
+  /// Functor filling the output slices from the coverage maps in parallel
+  class FillFractionalSlicesFunctor;
+
+private:
+  vtkPlanarContourToFractionalLabelmapConversionRule(const vtkPlanarContourToFractionalLabelmapConversionRule&) = delete;
+  void operator=(const vtkPlanarContourToFractionalLabelmapConversionRule&) = delete;
+};
+
+#endif // __vtkPlanarContourToFractionalLabelmapConversionRule_h
@@ -30,6 +30,8 @@
 #include "vtkRibbonModelToBinaryLabelmapConversionRule.h"
 #include "vtkPlanarContourToRibbonModelConversionRule.h"
 #include "vtkPlanarContourToClosedSurfaceConversionRule.h"
+#include "vtkPlanarContourToBinaryLabelmapConversionRule.h"
+#include "vtkPlanarContourToFractionalLabelmapConversionRule.h"
 #include "vtkClosedSurfaceToFractionalLabelmapConversionRule.h"
 #include "vtkFractionalLabelmapToClosedSurfaceConversionRule.h"
 
@@ -73,14 +75,13 @@
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
 #include <dcmtk/dcmdata/dcdatset.h>
+#include <dcmtk/dcmdata/dcmetinf.h>
 #include <dcmtk/dcmdata/dcuid.h>
 #include <dcmtk/ofstd/ofcond.h>
 #include <dcmtk/ofstd/ofstring.h>
 #include <dcmtk/ofstd/ofstd.h> // for class OFStandard
-#include <dcmtk/dcmrt/drtdose.h>
-#include <dcmtk/dcmrt/drtimage.h>
-#include <dcmtk/dcmrt/drtplan.h>
-#include <dcmtk/dcmrt/drtstrct.h>
+#include <dcmtk/dcmdata/dcitem.h>
+#include <dcmtk/dcmdata/dcsequen.h>
 
 // MRML includes
 #include <vtkMRMLColorTableNode.h>
@@ -114,12 +115,25 @@
 #include <vtkObjectFactory.h>
 #include <vtkPlane.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
 #include <vtkStringArray.h>
 #include <vtkStripper.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkTable.h>
 #include <vtkDoubleArray.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 
 // ITK includes
 #include <itkImage.h>
@@ -147,7 +161,86 @@ class vtkSlicerDicomRtImportExportModuleLogic::vtkInternal
 {
 public:
   vtkInternal(vtkSlicerDicomRtImportExportModuleLogic* external);
-  ~vtkInternal() = default;
+  ~vtkInternal();
+
+  /// Result of examining a candidate file for loading
+  struct ExaminedFile
+  {
+    /// Whether the file is a supported RT object
+    bool Loadable{false};
+    /// Whether the file is an RT Dose, the name of which is completed by the referenced plan label
+    bool RtDose{false};
+    OFString SOPClassUID;
+    OFString Name;
+    std::vector<OFString> ReferencedSOPInstanceUIDs;
+    /// Size and modification time of the file when it was examined, for validating cached results.
+    /// The modification time has one second resolution, so a file rewritten with the same size within
+    /// the second it was examined in is not detected as changed
+    unsigned long FileSize{0};
+    long ModifiedTime{0};
+    /// Whether the result was taken from the examine cache
+    bool Cached{false};
+  };
+
+  /// Examine a candidate file for loading by parsing only its header. The object type is taken from the file meta
+  /// information, then the dataset is parsed once: structure sets until the ROI contour sequence, plans fully,
+  /// and all other objects until the pixel data. Can be called from multiple threads
+  void ExamineFileHeader(const std::string& fileName, ExaminedFile& examinedFile);
+
+  /// Examine candidate files in parallel. Files that did not change since they were last examined are not parsed
+  class ExamineFileHeadersFunctor
+  {
+  public:
+    vtkInternal* Internal{nullptr};
+    const std::vector<std::string>* FileNames{nullptr};
+    std::vector<ExaminedFile>* ExaminedFiles{nullptr};
+    /// Cached results by file path. Not modified while examining
+    const std::map<std::string, ExaminedFile>* ExamineCache{nullptr};
+    void operator()(vtkIdType begin, vtkIdType end) const
+    {
+      for (vtkIdType fileIndex = begin; fileIndex < end; ++fileIndex)
+      {
+        const std::string& fileName = (*this->FileNames)[fileIndex];
+        ExaminedFile& examinedFile = (*this->ExaminedFiles)[fileIndex];
+        unsigned long fileSize = vtksys::SystemTools::FileLength(fileName);
+        long modifiedTime = vtksys::SystemTools::ModifiedTime(fileName);
+        if (this->ExamineCache)
+        {
+          std::map<std::string, ExaminedFile>::const_iterator cacheIt = this->ExamineCache->find(fileName);
+          if ( cacheIt != this->ExamineCache->end()
+            && cacheIt->second.FileSize == fileSize && cacheIt->second.ModifiedTime == modifiedTime )
+          {
+            examinedFile = cacheIt->second;
+            examinedFile.Cached = true;
+            continue;
+          }
+        }
+        this->Internal->ExamineFileHeader(fileName, examinedFile);
+        examinedFile.FileSize = fileSize;
+        examinedFile.ModifiedTime = modifiedTime;
+      }
+    }
+  };
+
+  /// Get path of the examine cache file. Next to the DICOM database unless specified otherwise
+  std::string GetExamineCacheFilePath();
+
+  /// Read examine cache from file, unless it has already been read from the same file.
+  /// Entries of files that do not exist any more are pruned
+  void ReadExamineCache(const std::string& filePath);
+
+  /// Write new entries of the examine cache to file. The entries are appended to the file, unless it needs
+  /// to be compacted (pruned or repeated entries, outdated format), in which case the whole cache is written
+  /// \param newFilePaths Paths of the files examined since the cache was last written
+  /// \return Success flag
+  bool WriteExamineCache(const std::vector<std::string>& newFilePaths);
+
+  /// Write one line of the examine cache: path, size, modification time, loadable flag, RT dose flag,
+  /// SOP class UID, name, referenced UIDs
+  static void WriteExamineCacheEntry(std::ostream& cacheFile, const std::string& filePath, const ExaminedFile& examinedFile);
+
+  /// Append label of the referenced RT Plan to the name of an RT Dose using the DICOM database
+  void AppendRtPlanLabelToRtDoseName(ctkDICOMDatabase* dicomDatabase, const OFString& referencedSOPInstanceUID, OFString& name);
 
   /// Examine RT Dose dataset and assemble name and referenced SOP instances
   void ExamineRtDoseDataset(DcmDataset* dataset, OFString &name, std::vector<OFString> &referencedSOPInstanceUIDs);
@@ -199,6 +292,62 @@ public:
   /// \return Success flag
   bool LoadRtStructureSet(vtkSlicerDicomRtReader* rtReader, vtkSlicerDICOMLoadable* loadable);
 
+  /// Set up closed surface conversion of a segment without modifying it: a detached segment with a copy of the
+  /// planar contours, and a conversion rule with the conversion parameters of the segmentation
+  /// \return False if the segment has no planar contours or already has a closed surface
+  bool SetupDetachedClosedSurfaceConversion(vtkSegmentation* segmentation, const std::string& segmentID, bool copyPlanarContours,
+    vtkSmartPointer<vtkSegment>& detachedSegment, vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule>& conversionRule);
+
+  /// Create closed surface representation for all segments of a segmentation in parallel, from their planar contours.
+  /// The segments are converted detached from the segmentation, and the results are added in one batch at the end
+  void ConvertSegmentsToClosedSurfaceInParallel(vtkMRMLSegmentationNode* segmentationNode);
+
+  /// Closed surface conversion of a segment in the background conversion queue
+  struct SegmentConversionJob
+  {
+    std::string SegmentationNodeID;
+    std::string SegmentID;
+    vtkSmartPointer<vtkSegment> DetachedSegment;
+    vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule> ConversionRule;
+    bool Success{false};
+  };
+
+  /// Add the segments of a segmentation to the background conversion queue and start the conversion thread if needed
+  void QueueSegmentConversions(vtkMRMLSegmentationNode* segmentationNode);
+
+  /// Convert the queued segments one by one until the queue is empty or the conversions are cancelled.
+  /// Runs on the conversion thread
+  void RunSegmentConversions();
+
+  /// Cancel the queued conversions and wait for the conversion thread to finish
+  void StopSegmentConversions();
+
+  /// Convert detached segments in parallel. Each segment has its own conversion rule instance
+  class ConvertSegmentsFunctor
+  {
+  public:
+    std::vector<vtkSmartPointer<vtkSegment> >* Segments{nullptr};
+    std::vector<vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule> >* ConversionRules{nullptr};
+    /// Success flag for each segment
+    std::vector<char>* ConversionResults{nullptr};
+    void operator()(vtkIdType begin, vtkIdType end) const
+    {
+      for (vtkIdType segmentIndex = begin; segmentIndex < end; ++segmentIndex)
+      {
+        vtkSegment* segment = (*this->Segments)[segmentIndex];
+        vtkPlanarContourToClosedSurfaceConversionRule* rule = (*this->ConversionRules)[segmentIndex];
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+        (*this->ConversionResults)[segmentIndex] = rule->Convert(segment);
+#else
+        vtkSmartPointer<vtkPolyData> closedSurface = vtkSmartPointer<vtkPolyData>::New();
+        (*this->ConversionResults)[segmentIndex] = rule->Convert(
+          segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationPlanarContourRepresentationName()), closedSurface);
+        segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName(), closedSurface);
+#endif
+      }
+    }
+  };
+
   /// Load RT Image and related objects into the MRML scene
   /// \return Success flag
   bool LoadRtImage(vtkSlicerDicomRtReader* rtReader, vtkSlicerDICOMLoadable* loadable);
@@ -232,6 +381,24 @@ public:
 
 public:
   vtkSlicerDicomRtImportExportModuleLogic* External;
+
+  /// Results of examining DICOM files for loading by file path. Stored on disk so that repeated
+  /// examinations of the same files do not need to parse them
+  std::map<std::string, ExaminedFile> ExamineCache;
+  /// File the examine cache was read from
+  std::string ExamineCacheFilePath;
+  /// Whether the examine cache file needs to be rewritten instead of appended to
+  bool ExamineCacheCompactionNeeded{false};
+
+  /// Segments waiting for background conversion, the ones to be converted first are at the front
+  std::deque<SegmentConversionJob> PendingConversionJobs;
+  /// Converted segments waiting to be added to the segmentations on the main thread
+  std::vector<SegmentConversionJob> CompletedConversionJobs;
+  /// Guards the conversion queues and the running flag
+  std::mutex ConversionQueueMutex;
+  std::thread ConversionThread;
+  bool ConversionThreadRunning{false};
+  std::atomic<bool> ConversionsCancelled{false};
 };
 
 //----------------------------------------------------------------------------
@@ -243,6 +410,333 @@ vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::vtkInternal(vtkSlicerDicom
 {
 }
 
+//----------------------------------------------------------------------------
+vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::~vtkInternal()
+{
+  this->StopSegmentConversions();
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ExamineFileHeader(const std::string& fileName, ExaminedFile& examinedFile)
+{
+  examinedFile = ExaminedFile();
+
+  // Get SOP class from the file meta information to decide how much of the dataset needs to be parsed.
+  // Files without meta information are parsed until the pixel data
+  OFString metaSopClass;
+  DcmMetaInfo metaInfo;
+  if (metaInfo.loadFile(fileName.c_str()).good())
+  {
+    metaInfo.findAndGetOFString(DCM_MediaStorageSOPClassUID, metaSopClass);
+  }
+
+  // Parse header in DCMTK. The contours of structure sets are not needed for examining, while the name and
+  // referenced objects of plans may be anywhere in the dataset (e.g. RT plan label and name follow the ROI
+  // contour sequence tag). Pixel data is never needed
+  DcmFileFormat fileformat;
+  OFCondition result;
+  if (metaSopClass == UID_RTStructureSetStorage)
+  {
+    result = fileformat.loadFileUntilTag(fileName.c_str(), EXS_Unknown, EGL_noChange,
+      DCM_MaxReadLength, ERM_autoDetect, DCM_ROIContourSequence);
+  }
+  else if (metaSopClass == UID_RTPlanStorage || metaSopClass == UID_RTIonPlanStorage)
+  {
+    result = fileformat.loadFile(fileName.c_str());
+  }
+  else
+  {
+    result = fileformat.loadFileUntilTag(fileName.c_str(), EXS_Unknown, EGL_noChange,
+      DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+  }
+  if (!result.good())
+  {
+    return; // Failed to parse this file, skip it
+  }
+
+  // Check SOP Class UID for one of the supported RT objects
+  DcmDataset *dataset = fileformat.getDataset();
+  OFString sopClass;
+  if (!dataset->findAndGetOFString(DCM_SOPClassUID, sopClass).good() || sopClass.empty())
+  {
+    return; // Failed to parse this file, skip it
+  }
+  examinedFile.SOPClassUID = sopClass;
+
+  // DICOM parsing is successful, now check if the object is loadable
+  OFString seriesNumber("");
+  dataset->findAndGetOFString(DCM_SeriesNumber, seriesNumber);
+  if (!seriesNumber.empty())
+  {
+    examinedFile.Name += seriesNumber + ": ";
+  }
+
+  // RTDose
+  if (sopClass == UID_RTDoseStorage)
+  {
+    this->ExamineRtDoseDataset(dataset, examinedFile.Name, examinedFile.ReferencedSOPInstanceUIDs);
+    examinedFile.RtDose = true;
+  }
+  // RTPlan
+  else if (sopClass == UID_RTPlanStorage)
+  {
+    this->ExamineRtPlanDataset(dataset, examinedFile.Name, examinedFile.ReferencedSOPInstanceUIDs);
+  }
+  // RTIonPlan
+  else if (sopClass == UID_RTIonPlanStorage)
+  {
+    this->ExamineRtPlanDataset(dataset, examinedFile.Name, examinedFile.ReferencedSOPInstanceUIDs);
+  }
+  // RTStructureSet
+  else if (sopClass == UID_RTStructureSetStorage)
+  {
+    this->ExamineRtStructureSetDataset(dataset, examinedFile.Name, examinedFile.ReferencedSOPInstanceUIDs);
+  }
+  // RTImage
+  else if (sopClass == UID_RTImageStorage)
+  {
+    this->ExamineRtImageDataset(dataset, examinedFile.Name, examinedFile.ReferencedSOPInstanceUIDs);
+  }
+  /* Not yet supported
+  else if (sopClass == UID_RTTreatmentSummaryRecordStorage)
+  else if (sopClass == UID_RTIonBeamsTreatmentRecordStorage)
+  */
+  else
+  {
+    return; // Not an RT file
+  }
+
+  examinedFile.Loadable = true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::AppendRtPlanLabelToRtDoseName(
+  ctkDICOMDatabase* dicomDatabase, const OFString& referencedSOPInstanceUID, OFString& name)
+{
+  // Get RTPlan name to show it with the dose
+  //TODO: Uncomment this line when figured out the reason for the crash, see https://github.com/SlicerRt/SlicerRT/issues/135
+  QString rtPlanLabelTag("300a,0002");
+  QString rtPlanFileName = dicomDatabase->fileForInstance(referencedSOPInstanceUID.c_str());
+  if (!rtPlanFileName.isEmpty())
+  {
+   name += OFString(": ") + OFString(dicomDatabase->fileValue(rtPlanFileName,rtPlanLabelTag).toUtf8().constData());
+  }
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+  const char* EXAMINE_CACHE_FILE_NAME = "/SlicerRtExamineCache.txt";
+  /// Version of the examine results. Increment when ExamineFileHeader or the Examine*Dataset functions change
+  /// what they extract, so that results cached by the previous version are discarded
+  const int EXAMINE_CACHE_VERSION = 2;
+
+  /// Header line of the examine cache file
+  std::string GetExamineCacheHeader()
+  {
+    std::stringstream header;
+    header << "SlicerRT DICOM examine cache " << EXAMINE_CACHE_VERSION;
+    return header.str();
+  }
+
+  /// Escape field separators in a text field of the examine cache
+  std::string EscapeExamineCacheField(const std::string& field)
+  {
+    std::string escapedField;
+    for (char c : field)
+    {
+      switch (c)
+      {
+      case '\\': escapedField += "\\\\"; break;
+      case '\t': escapedField += "\\t"; break;
+      case '\n': escapedField += "\\n"; break;
+      case '\r': escapedField += "\\r"; break;
+      default: escapedField += c; break;
+      }
+    }
+    return escapedField;
+  }
+
+  /// Restore a text field escaped by \sa EscapeExamineCacheField
+  std::string UnescapeExamineCacheField(const std::string& escapedField)
+  {
+    std::string field;
+    for (size_t i = 0; i < escapedField.size(); ++i)
+    {
+      if (escapedField[i] != '\\' || i + 1 >= escapedField.size())
+      {
+        field += escapedField[i];
+        continue;
+      }
+      ++i;
+      switch (escapedField[i])
+      {
+      case 't': field += '\t'; break;
+      case 'n': field += '\n'; break;
+      case 'r': field += '\r'; break;
+      default: field += escapedField[i]; break;
+      }
+    }
+    return field;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::WriteExamineCacheEntry(
+  std::ostream& cacheFile, const std::string& filePath, const ExaminedFile& examinedFile)
+{
+  cacheFile << EscapeExamineCacheField(filePath)
+    << "\t" << examinedFile.FileSize << "\t" << examinedFile.ModifiedTime
+    << "\t" << (examinedFile.Loadable ? "1" : "0") << "\t" << (examinedFile.RtDose ? "1" : "0")
+    << "\t" << examinedFile.SOPClassUID.c_str() << "\t" << EscapeExamineCacheField(examinedFile.Name.c_str()) << "\t";
+  for (std::vector<OFString>::const_iterator uidIt = examinedFile.ReferencedSOPInstanceUIDs.begin();
+    uidIt != examinedFile.ReferencedSOPInstanceUIDs.end(); ++uidIt)
+  {
+    cacheFile << (uidIt != examinedFile.ReferencedSOPInstanceUIDs.begin() ? " " : "") << uidIt->c_str();
+  }
+  cacheFile << "\n";
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::GetExamineCacheFilePath()
+{
+  if (this->External->ExamineCacheFilePath)
+  {
+    return this->External->ExamineCacheFilePath;
+  }
+  QSettings settings;
+  QString databaseDirectory = settings.value("DatabaseDirectory").toString();
+  if (databaseDirectory.isEmpty())
+  {
+    return "";
+  }
+  return std::string(databaseDirectory.toUtf8().constData()) + EXAMINE_CACHE_FILE_NAME;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ReadExamineCache(const std::string& filePath)
+{
+  if (filePath == this->ExamineCacheFilePath)
+  {
+    return;
+  }
+  this->ExamineCache.clear();
+  this->ExamineCacheFilePath = filePath;
+  this->ExamineCacheCompactionNeeded = true;
+
+  std::ifstream cacheFile(filePath.c_str());
+  std::string line;
+  if (!cacheFile.is_open() || !std::getline(cacheFile, line) || line != GetExamineCacheHeader())
+  {
+    return; // No cache yet or outdated format, files are examined again and the cache file is rewritten
+  }
+
+  // One file per line: path, size, modification time, loadable flag, RT dose flag, SOP class UID, name, referenced UIDs.
+  // Entries are appended when files are examined again, so a later line of the same file replaces the earlier one
+  int numberOfLines = 0;
+  while (std::getline(cacheFile, line))
+  {
+    ++numberOfLines;
+    std::vector<std::string> fields;
+    std::stringstream lineStream(line);
+    std::string field;
+    while (std::getline(lineStream, field, '\t'))
+    {
+      fields.push_back(field);
+    }
+    if (fields.size() < 7)
+    {
+      continue;
+    }
+
+    ExaminedFile examinedFile;
+    examinedFile.FileSize = strtoul(fields[1].c_str(), nullptr, 10);
+    examinedFile.ModifiedTime = strtol(fields[2].c_str(), nullptr, 10);
+    examinedFile.Loadable = (fields[3] == "1");
+    examinedFile.RtDose = (fields[4] == "1");
+    examinedFile.SOPClassUID = fields[5].c_str();
+    examinedFile.Name = UnescapeExamineCacheField(fields[6]).c_str();
+    if (fields.size() > 7)
+    {
+      std::stringstream uidStream(fields[7]);
+      std::string uid;
+      while (uidStream >> uid)
+      {
+        examinedFile.ReferencedSOPInstanceUIDs.push_back(uid.c_str());
+      }
+    }
+    this->ExamineCache[UnescapeExamineCacheField(fields[0])] = examinedFile;
+  }
+
+  // Prune entries of removed files
+  for (std::map<std::string, ExaminedFile>::iterator cacheIt = this->ExamineCache.begin(); cacheIt != this->ExamineCache.end(); )
+  {
+    if (vtksys::SystemTools::FileExists(cacheIt->first, true))
+    {
+      ++cacheIt;
+    }
+    else
+    {
+      cacheIt = this->ExamineCache.erase(cacheIt);
+    }
+  }
+  this->ExamineCacheCompactionNeeded = (numberOfLines != static_cast<int>(this->ExamineCache.size()));
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::WriteExamineCache(const std::vector<std::string>& newFilePaths)
+{
+  if (this->ExamineCacheFilePath.empty())
+  {
+    return false;
+  }
+
+  // Append the new entries if the file is up to date otherwise
+  if (!this->ExamineCacheCompactionNeeded)
+  {
+    std::ofstream cacheFile(this->ExamineCacheFilePath.c_str(), std::ios::app);
+    if (!cacheFile.is_open())
+    {
+      return false;
+    }
+    for (std::vector<std::string>::const_iterator pathIt = newFilePaths.begin(); pathIt != newFilePaths.end(); ++pathIt)
+    {
+      std::map<std::string, ExaminedFile>::iterator cacheIt = this->ExamineCache.find(*pathIt);
+      if (cacheIt != this->ExamineCache.end())
+      {
+        WriteExamineCacheEntry(cacheFile, cacheIt->first, cacheIt->second);
+      }
+    }
+    // Entries replaced by the appended ones are removed when the file is compacted
+    return cacheFile.good();
+  }
+
+  // Write the whole cache to a temporary file first so that an interrupted write does not leave a corrupt cache
+  std::string temporaryFilePath = this->ExamineCacheFilePath + ".tmp";
+  {
+    std::ofstream cacheFile(temporaryFilePath.c_str(), std::ios::trunc);
+    if (!cacheFile.is_open())
+    {
+      return false;
+    }
+    cacheFile << GetExamineCacheHeader() << "\n";
+    for (std::map<std::string, ExaminedFile>::iterator cacheIt = this->ExamineCache.begin(); cacheIt != this->ExamineCache.end(); ++cacheIt)
+    {
+      WriteExamineCacheEntry(cacheFile, cacheIt->first, cacheIt->second);
+    }
+    if (!cacheFile.good())
+    {
+      return false;
+    }
+  }
+  if (!vtksys::SystemTools::RenameFile(temporaryFilePath, this->ExamineCacheFilePath))
+  {
+    return false;
+  }
+  this->ExamineCacheCompactionNeeded = false;
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ExamineRtDoseDataset(DcmDataset* dataset, OFString &name, std::vector<OFString> &referencedSOPInstanceUIDs)
 {
@@ -266,46 +760,17 @@ void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ExamineRtDoseDataset(
     name += " [" + instanceNumber + "]";
   }
 
-  // Find RTPlan name for RTDose series
-  OFString referencedSOPInstanceUID("");
-  DRTDoseIOD rtDoseObject;
-  if (rtDoseObject.read(*dataset).good())
+  // Find referenced RTPlan of the RTDose. The plan name is added to the name from the DICOM database
+  // after all files are examined (see ExamineForLoad)
+  DcmItem* referencedRTPlanItem = nullptr;
+  if (dataset->findAndGetSequenceItem(DCM_ReferencedRTPlanSequence, referencedRTPlanItem, 0).good() && referencedRTPlanItem)
   {
-    DRTReferencedRTPlanSequence &referencedRTPlanSequence = rtDoseObject.getReferencedRTPlanSequence();
-    if (referencedRTPlanSequence.gotoFirstItem().good())
+    OFString referencedSOPInstanceUID("");
+    if (referencedRTPlanItem->findAndGetOFString(DCM_ReferencedSOPInstanceUID, referencedSOPInstanceUID).good())
     {
-      DRTReferencedRTPlanSequence::Item &referencedRTPlanSequenceItem = referencedRTPlanSequence.getCurrentItem();
-      if (referencedRTPlanSequenceItem.isValid())
-      {
-        if (referencedRTPlanSequenceItem.getReferencedSOPInstanceUID(referencedSOPInstanceUID).good())
-        {
-          referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
-        }
-      }
+      referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
     }
   }
-
-  // Create and open DICOM database to perform database operations for getting RTPlan name
-  QSettings settings;
-  QString databaseDirectory = settings.value("DatabaseDirectory").toString();
-  QString databaseFile = databaseDirectory + vtkSlicerDicomRtReader::DICOMREADER_DICOM_DATABASE_FILENAME.c_str();
-  ctkDICOMDatabase* dicomDatabase = new ctkDICOMDatabase();
-  dicomDatabase->openDatabase(databaseFile, vtkSlicerDicomRtReader::DICOMREADER_DICOM_CONNECTION_NAME.c_str());
-
-  // Get RTPlan name to show it with the dose
-  //TODO: Uncomment this line when figured out the reason for the crash, see https://github.com/SlicerRt/SlicerRT/issues/135
-  QString rtPlanLabelTag("300a,0002");
-  QString rtPlanFileName = dicomDatabase->fileForInstance(referencedSOPInstanceUID.c_str());
-  if (!rtPlanFileName.isEmpty())
-  {
-   name += OFString(": ") + OFString(dicomDatabase->fileValue(rtPlanFileName,rtPlanLabelTag).toUtf8().constData());
-  }
-
-  // Close and delete DICOM database
-  dicomDatabase->closeDatabase();
-  delete dicomDatabase;
-  QSqlDatabase::removeDatabase(vtkSlicerDicomRtReader::DICOMREADER_DICOM_CONNECTION_NAME.c_str());
-  QSqlDatabase::removeDatabase(QString(vtkSlicerDicomRtReader::DICOMREADER_DICOM_CONNECTION_NAME.c_str()) + "TagCache");
 }
 
 //-----------------------------------------------------------------------------
@@ -361,98 +826,26 @@ void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ExamineRtStructureSet
     name += ": " + structLabel;
   }
 
-  // Get referenced image instance UIDs
-  OFString referencedSOPInstanceUID("");
-  DRTStructureSetIOD rtStructureSetObject;
-  if (rtStructureSetObject.read(*dataset).good())
+  // Get referenced image instance UIDs from the referenced frame of reference sequence. It precedes the
+  // ROI contour sequence, so it is available when only the header of the file is parsed
+  DcmItem* referencedFrameOfReferenceItem = nullptr;
+  DcmItem* referencedStudyItem = nullptr;
+  DcmItem* referencedSeriesItem = nullptr;
+  DcmSequenceOfItems* contourImageSequence = nullptr;
+  if ( dataset->findAndGetSequenceItem(DCM_ReferencedFrameOfReferenceSequence, referencedFrameOfReferenceItem, 0).good()
+    && referencedFrameOfReferenceItem->findAndGetSequenceItem(DCM_RTReferencedStudySequence, referencedStudyItem, 0).good()
+    && referencedStudyItem->findAndGetSequenceItem(DCM_RTReferencedSeriesSequence, referencedSeriesItem, 0).good()
+    && referencedSeriesItem->findAndGetSequence(DCM_ContourImageSequence, contourImageSequence).good() && contourImageSequence )
   {
-    DRTROIContourSequence &rtROIContourSequenceObject = rtStructureSetObject.getROIContourSequence();
-    if (rtROIContourSequenceObject.gotoFirstItem().good())
+    for (unsigned long itemIndex = 0; itemIndex < contourImageSequence->card(); ++itemIndex)
     {
-      do // For all ROIs
+      OFString referencedSOPInstanceUID("");
+      if (contourImageSequence->getItem(itemIndex)->findAndGetOFString(DCM_ReferencedSOPInstanceUID, referencedSOPInstanceUID).good())
       {
-        DRTROIContourSequence::Item &currentRoiObject = rtROIContourSequenceObject.getCurrentItem();
-        if (currentRoiObject.isValid())
-        {
-          DRTContourSequence &rtContourSequenceObject = currentRoiObject.getContourSequence();
-          if (rtContourSequenceObject.gotoFirstItem().good())
-          {
-            do // For all contours
-            {
-              DRTContourSequence::Item &contourItem = rtContourSequenceObject.getCurrentItem();
-              if (!contourItem.isValid())
-              {
-                DRTContourImageSequence &rtContourImageSequenceObject = contourItem.getContourImageSequence();
-                if (rtContourImageSequenceObject.gotoFirstItem().good())
-                {
-                  DRTContourImageSequence::Item &rtContourImageSequenceItem = rtContourImageSequenceObject.getCurrentItem();
-                  if (rtContourImageSequenceItem.isValid())
-                  {
-                    OFString referencedSOPInstanceUID("");
-                    if (rtContourImageSequenceItem.getReferencedSOPInstanceUID(referencedSOPInstanceUID).good())
-                    {
-                      referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
-                    }
-                  }
-                }
-              }
-            } // For all contours
-            while (rtContourSequenceObject.gotoNextItem().good());
-          }
-        }
-      } // For all ROIs
-      while (rtROIContourSequenceObject.gotoNextItem().good());
-    } // End ROIContourSequence
-
-    // If the above tags do not store the referenced instance UIDs, then look at the other possible place
-    if (referencedSOPInstanceUIDs.empty())
-    {
-      DRTReferencedFrameOfReferenceSequence &rtReferencedFrameOfReferenceSequenceObject = rtStructureSetObject.getReferencedFrameOfReferenceSequence();
-      if (rtReferencedFrameOfReferenceSequenceObject.gotoFirstItem().good())
-      {
-        DRTReferencedFrameOfReferenceSequence::Item &currentReferencedFrameOfReferenceSequenceItem = rtReferencedFrameOfReferenceSequenceObject.getCurrentItem();
-        if (currentReferencedFrameOfReferenceSequenceItem.isValid())
-        {
-          DRTRTReferencedStudySequence &rtReferencedStudySequenceObject = currentReferencedFrameOfReferenceSequenceItem.getRTReferencedStudySequence();
-          if (rtReferencedStudySequenceObject.gotoFirstItem().good())
-          {
-            DRTRTReferencedStudySequence::Item &rtReferencedStudySequenceItem = rtReferencedStudySequenceObject.getCurrentItem();
-            if (rtReferencedStudySequenceItem.isValid())
-            {
-              DRTRTReferencedSeriesSequence &rtReferencedSeriesSequenceObject = rtReferencedStudySequenceItem.getRTReferencedSeriesSequence();
-              if (rtReferencedSeriesSequenceObject.gotoFirstItem().good())
-              {
-                if (rtReferencedSeriesSequenceObject.gotoFirstItem().good())
-                {
-                  DRTRTReferencedSeriesSequence::Item &rtReferencedSeriesSequenceItem = rtReferencedSeriesSequenceObject.getCurrentItem();
-                  if (rtReferencedSeriesSequenceItem.isValid())
-                  {
-                    DRTContourImageSequence &rtContourImageSequenceObject = rtReferencedSeriesSequenceItem.getContourImageSequence();
-                    if (rtContourImageSequenceObject.gotoFirstItem().good())
-                    {
-                      do
-                      {
-                        DRTContourImageSequence::Item &rtContourImageSequenceItem = rtContourImageSequenceObject.getCurrentItem();
-                        if (rtContourImageSequenceItem.isValid())
-                        {
-                          OFString referencedSOPInstanceUID("");
-                          if (rtContourImageSequenceItem.getReferencedSOPInstanceUID(referencedSOPInstanceUID).good())
-                          {
-                            referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
-                          }
-                        }
-                      } // For all contours
-                      while (rtContourImageSequenceObject.gotoNextItem().good());
-                    }
-                  }
-                }
-              }
-            }
-          }
-        }
+        referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
       }
-    } // End DRTReferencedFrameOfReferenceSequence
-  } // End finding referenced instance UIDs
+    } // For all contour images
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -473,18 +866,13 @@ void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ExamineRtImageDataset
   }
 
   // Get referenced RTPlan
-  OFString referencedSOPInstanceUID("");
-  DRTImageIOD rtImageObject;
-  if (rtImageObject.read(*dataset).good())
+  DcmItem* referencedRTPlanItem = nullptr;
+  if (dataset->findAndGetSequenceItem(DCM_ReferencedRTPlanSequence, referencedRTPlanItem, 0).good() && referencedRTPlanItem)
   {
-    DRTReferencedRTPlanSequenceInRTImageModule &rtReferencedRtPlanSequenceObject = rtImageObject.getReferencedRTPlanSequence();
-    if (rtReferencedRtPlanSequenceObject.gotoFirstItem().good())
+    OFString referencedSOPInstanceUID("");
+    if (referencedRTPlanItem->findAndGetOFString(DCM_ReferencedSOPInstanceUID, referencedSOPInstanceUID).good())
     {
-      DRTReferencedRTPlanSequenceInRTImageModule::Item &currentReferencedRtPlanSequenceObject = rtReferencedRtPlanSequenceObject.getCurrentItem();
-      if (currentReferencedRtPlanSequenceObject.getReferencedSOPInstanceUID(referencedSOPInstanceUID).good())
-      {
-        referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
-      }
+      referencedSOPInstanceUIDs.push_back(referencedSOPInstanceUID);
     }
   }
 }
@@ -502,28 +890,36 @@ bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::LoadRtDose(vtkSlicerD
   const char* fileName = loadable->GetFiles()->GetValue(0).c_str();
   const char* seriesName = loadable->GetName();
 
-  // Load Volume
-  vtkSmartPointer<vtkMRMLVolumeArchetypeStorageNode> volumeStorageNode = vtkSmartPointer<vtkMRMLVolumeArchetypeStorageNode>::New();
   vtkSmartPointer<vtkMRMLScalarVolumeNode> volumeNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
-  volumeStorageNode->SetFileName(fileName);
-  volumeStorageNode->ResetFileNameList();
-  volumeStorageNode->SetSingleFile(1);
 
-  // Read volume from disk
-  if (!volumeStorageNode->ReadData(volumeNode))
+  // Use the dose volume decoded by the reader if available (already scaled, no second read of the file)
+  bool doseVolumeDecoded = (rtReader->GetDoseImageData() != nullptr && rtReader->GetDoseIJKToRASMatrix() != nullptr);
+  if (doseVolumeDecoded)
   {
-    vtkErrorWithObjectMacro(this->External, "LoadRtDose: Failed to load dose volume file '" << fileName << "' (series name '" << seriesName << "')");
-    return false;
+    volumeNode->SetIJKToRASMatrix(rtReader->GetDoseIJKToRASMatrix());
+  }
+  else
+  {
+    // Read volume from disk
+    vtkSmartPointer<vtkMRMLVolumeArchetypeStorageNode> volumeStorageNode = vtkSmartPointer<vtkMRMLVolumeArchetypeStorageNode>::New();
+    volumeStorageNode->SetFileName(fileName);
+    volumeStorageNode->ResetFileNameList();
+    volumeStorageNode->SetSingleFile(1);
+    if (!volumeStorageNode->ReadData(volumeNode))
+    {
+      vtkErrorWithObjectMacro(this->External, "LoadRtDose: Failed to load dose volume file '" << fileName << "' (series name '" << seriesName << "')");
+      return false;
+    }
+
+    // Set new spacing
+    double* initialSpacing = volumeNode->GetSpacing();
+    double* correctSpacing = rtReader->GetPixelSpacing();
+    volumeNode->SetSpacing(correctSpacing[0], correctSpacing[1], initialSpacing[2]);
   }
 
   volumeNode->SetScene(this->External->GetMRMLScene());
   std::string volumeNodeName = scene->GenerateUniqueName(seriesName);
   volumeNode->SetName(volumeNodeName.c_str());
-
-  // Set new spacing
-  double* initialSpacing = volumeNode->GetSpacing();
-  double* correctSpacing = rtReader->GetPixelSpacing();
-  volumeNode->SetSpacing(correctSpacing[0], correctSpacing[1], initialSpacing[2]);
   volumeNode->SetAttribute(vtkSlicerRtCommon::DICOMRTIMPORT_DOSE_VOLUME_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1");
   scene->AddNode(volumeNode);
 
@@ -534,24 +930,31 @@ bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::LoadRtDose(vtkSlicerD
   }
   double doseGridScaling = vtkVariant(rtReader->GetDoseGridScaling()).ToDouble();
 
-  vtkSmartPointer<vtkImageData> floatVolumeData = vtkSmartPointer<vtkImageData>::New();
-
-  vtkSmartPointer<vtkImageCast> imageCast = vtkSmartPointer<vtkImageCast>::New();
-  imageCast->SetInputData(volumeNode->GetImageData());
-  imageCast->SetOutputScalarTypeToFloat();
-  imageCast->Update();
-  floatVolumeData->DeepCopy(imageCast->GetOutput());
-
-  float value = 0.0;
-  float* floatPtr = (float*)floatVolumeData->GetScalarPointer();
-  for (long i=0; i<floatVolumeData->GetNumberOfPoints(); ++i)
+  if (doseVolumeDecoded)
   {
-    value = (*floatPtr) * doseGridScaling;
-    (*floatPtr) = value;
-    ++floatPtr;
+    volumeNode->SetAndObserveImageData(rtReader->GetDoseImageData());
   }
+  else
+  {
+    vtkSmartPointer<vtkImageData> floatVolumeData = vtkSmartPointer<vtkImageData>::New();
+
+    vtkSmartPointer<vtkImageCast> imageCast = vtkSmartPointer<vtkImageCast>::New();
+    imageCast->SetInputData(volumeNode->GetImageData());
+    imageCast->SetOutputScalarTypeToFloat();
+    imageCast->Update();
+    floatVolumeData->DeepCopy(imageCast->GetOutput());
 
-  volumeNode->SetAndObserveImageData(floatVolumeData);
+    float value = 0.0;
+    float* floatPtr = (float*)floatVolumeData->GetScalarPointer();
+    for (long i=0; i<floatVolumeData->GetNumberOfPoints(); ++i)
+    {
+      value = (*floatPtr) * doseGridScaling;
+      (*floatPtr) = value;
+      ++floatPtr;
+    }
+
+    volumeNode->SetAndObserveImageData(floatVolumeData);
+  }
 
   // Get default isodose color table and default dose color table
   vtkMRMLColorTableNode* defaultIsodoseColorTable = vtkSlicerIsodoseModuleLogic::GetDefaultIsodoseColorTable(scene);
@@ -1755,9 +2158,23 @@ bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::LoadRtStructureSet(vt
     vtkDebugWithObjectMacro(this->External, "LoadRtStructureSet: Maximum number of points in a segment = " << maximumNumberOfPoints << ", Total number of points in segmentation = " << totalNumberOfPoints);
     if (maximumNumberOfPoints < 800000 && totalNumberOfPoints < 3000000)
     {
-      segmentationDisplayNode->SetPreferredDisplayRepresentationName3D(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
-      segmentationDisplayNode->SetPreferredDisplayRepresentationName2D(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
-      segmentationDisplayNode->CalculateAutoOpacitiesForSegments();
+      if (this->External->LazySegmentConversion)
+      {
+        // Show the planar contours until the closed surfaces are created in the background.
+        // Modules that need other representations still convert the segments on demand.
+        this->External->QueueSegmentConversions(segmentationNode);
+      }
+      else
+      {
+        // Create the closed surfaces up front in parallel, so that the display does not convert the segments one by one
+        if (this->External->ConvertSegmentsInParallel)
+        {
+          this->ConvertSegmentsToClosedSurfaceInParallel(segmentationNode);
+        }
+        segmentationDisplayNode->SetPreferredDisplayRepresentationName3D(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
+        segmentationDisplayNode->SetPreferredDisplayRepresentationName2D(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
+        segmentationDisplayNode->CalculateAutoOpacitiesForSegments();
+      }
     }
     else
     {
@@ -1775,6 +2192,209 @@ bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::LoadRtStructureSet(vt
   return true;
 }
 
+//---------------------------------------------------------------------------
+bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::SetupDetachedClosedSurfaceConversion(vtkSegmentation* segmentation,
+  const std::string& segmentID, bool copyPlanarContours,
+  vtkSmartPointer<vtkSegment>& detachedSegment, vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule>& conversionRule)
+{
+  std::string planarContourRepresentationName(vtkSegmentationConverter::GetSegmentationPlanarContourRepresentationName());
+  vtkSegment* segment = segmentation->GetSegment(segmentID);
+  if (!segment || !segment->GetRepresentation(planarContourRepresentationName)
+    || segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()))
+  {
+    return false;
+  }
+
+  detachedSegment = vtkSmartPointer<vtkSegment>::New();
+  vtkDataObject* planarContours = segment->GetRepresentation(planarContourRepresentationName);
+  if (copyPlanarContours)
+  {
+    // The segment may be edited while the detached copy is being converted
+    vtkSmartPointer<vtkPolyData> planarContoursCopy = vtkSmartPointer<vtkPolyData>::New();
+    planarContoursCopy->DeepCopy(planarContours);
+    detachedSegment->AddRepresentation(planarContourRepresentationName, planarContoursCopy);
+  }
+  else
+  {
+    detachedSegment->AddRepresentation(planarContourRepresentationName, planarContours);
+  }
+
+  conversionRule = vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule>::New();
+  const std::string conversionParameterNames[3] =
+  {
+    vtkPlanarContourToClosedSurfaceConversionRule::GetDefaultSliceThicknessParameterName(),
+    vtkPlanarContourToClosedSurfaceConversionRule::GetEndCappingParameterName(),
+    vtkPlanarContourToClosedSurfaceConversionRule::GetTriangulationBandWidthParameterName()
+  };
+  for (const std::string& parameterName : conversionParameterNames)
+  {
+    std::string parameterValue = segmentation->GetConversionParameter(parameterName);
+    if (!parameterValue.empty())
+    {
+      conversionRule->SetConversionParameter(parameterName, parameterValue);
+    }
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ConvertSegmentsToClosedSurfaceInParallel(vtkMRMLSegmentationNode* segmentationNode)
+{
+  if (!segmentationNode || !segmentationNode->GetSegmentation())
+  {
+    vtkErrorWithObjectMacro(this->External, "ConvertSegmentsToClosedSurfaceInParallel: Invalid segmentation node");
+    return;
+  }
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+  std::string closedSurfaceRepresentationName(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
+
+  // Set up a detached segment sharing the planar contours and a conversion rule for each segment to convert.
+  // Segments in the segmentation are observed, so they must not be modified from the worker threads.
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  std::vector<std::string> convertedSegmentIDs;
+  std::vector<vtkSmartPointer<vtkSegment> > detachedSegments;
+  std::vector<vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule> > conversionRules;
+  for (const std::string& segmentID : segmentIDs)
+  {
+    vtkSmartPointer<vtkSegment> detachedSegment;
+    vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule> conversionRule;
+    if (!this->SetupDetachedClosedSurfaceConversion(segmentation, segmentID, false, detachedSegment, conversionRule))
+    {
+      continue;
+    }
+    convertedSegmentIDs.push_back(segmentID);
+    detachedSegments.push_back(detachedSegment);
+    conversionRules.push_back(conversionRule);
+  }
+  if (convertedSegmentIDs.empty())
+  {
+    return;
+  }
+
+  // Convert in parallel, one segment per work item so that large and small structures are balanced
+  std::vector<char> conversionResults(convertedSegmentIDs.size(), 0);
+  ConvertSegmentsFunctor functor;
+  functor.Segments = &detachedSegments;
+  functor.ConversionRules = &conversionRules;
+  functor.ConversionResults = &conversionResults;
+  vtkSMPTools::For(0, static_cast<vtkIdType>(convertedSegmentIDs.size()), 1, functor);
+
+  // Add the results to the segmentation in one batch. Segments that failed are left to be converted on demand
+  int wasModifying = segmentationNode->StartModify();
+  for (size_t segmentIndex = 0; segmentIndex < convertedSegmentIDs.size(); ++segmentIndex)
+  {
+    vtkSegment* segment = segmentation->GetSegment(convertedSegmentIDs[segmentIndex]);
+    vtkDataObject* closedSurface = detachedSegments[segmentIndex]->GetRepresentation(closedSurfaceRepresentationName);
+    if (!conversionResults[segmentIndex] || !closedSurface || !segment)
+    {
+      vtkWarningWithObjectMacro(this->External, "ConvertSegmentsToClosedSurfaceInParallel: Failed to create closed surface for segment "
+        << convertedSegmentIDs[segmentIndex]);
+      continue;
+    }
+    segment->AddRepresentation(closedSurfaceRepresentationName, closedSurface);
+  }
+  segmentationNode->EndModify(wasModifying);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::QueueSegmentConversions(vtkMRMLSegmentationNode* segmentationNode)
+{
+  if (!segmentationNode || !segmentationNode->GetSegmentation() || !segmentationNode->GetID())
+  {
+    vtkErrorWithObjectMacro(this->External, "QueueSegmentConversions: Invalid segmentation node");
+    return;
+  }
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+
+  std::vector<SegmentConversionJob> jobs;
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  for (const std::string& segmentID : segmentIDs)
+  {
+    SegmentConversionJob job;
+    if (!this->SetupDetachedClosedSurfaceConversion(segmentation, segmentID, true, job.DetachedSegment, job.ConversionRule))
+    {
+      continue;
+    }
+    job.SegmentationNodeID = segmentationNode->GetID();
+    job.SegmentID = segmentID;
+    jobs.push_back(job);
+  }
+  if (jobs.empty())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->ConversionQueueMutex);
+    this->PendingConversionJobs.insert(this->PendingConversionJobs.end(), jobs.begin(), jobs.end());
+    if (!this->ConversionThreadRunning)
+    {
+      // Previous conversion thread finished, but it may not have been joined yet
+      if (this->ConversionThread.joinable())
+      {
+        this->ConversionThread.join();
+      }
+      this->ConversionsCancelled = false;
+      this->ConversionThreadRunning = true;
+      this->ConversionThread = std::thread(&vtkInternal::RunSegmentConversions, this);
+    }
+  }
+
+  // Let the module start processing the queue on the main thread
+  this->External->InvokeEvent(SegmentConversionsQueuedEvent);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::RunSegmentConversions()
+{
+  while (!this->ConversionsCancelled)
+  {
+    SegmentConversionJob job;
+    {
+      std::lock_guard<std::mutex> lock(this->ConversionQueueMutex);
+      if (this->PendingConversionJobs.empty())
+      {
+        this->ConversionThreadRunning = false;
+        return;
+      }
+      job = this->PendingConversionJobs.front();
+      this->PendingConversionJobs.pop_front();
+    }
+
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    job.Success = job.ConversionRule->Convert(job.DetachedSegment);
+#else
+    vtkSmartPointer<vtkPolyData> closedSurface = vtkSmartPointer<vtkPolyData>::New();
+    job.Success = job.ConversionRule->Convert(
+      job.DetachedSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationPlanarContourRepresentationName()), closedSurface);
+    job.DetachedSegment->AddRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName(), closedSurface);
+#endif
+
+    std::lock_guard<std::mutex> lock(this->ConversionQueueMutex);
+    this->CompletedConversionJobs.push_back(job);
+  }
+
+  std::lock_guard<std::mutex> lock(this->ConversionQueueMutex);
+  this->ConversionThreadRunning = false;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::StopSegmentConversions()
+{
+  this->ConversionsCancelled = true;
+  if (this->ConversionThread.joinable())
+  {
+    // The segment being converted is finished before the thread stops
+    this->ConversionThread.join();
+  }
+  std::lock_guard<std::mutex> lock(this->ConversionQueueMutex);
+  this->PendingConversionJobs.clear();
+  this->CompletedConversionJobs.clear();
+  this->ConversionThreadRunning = false;
+}
+
 //---------------------------------------------------------------------------
 bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::LoadRtImage(vtkSlicerDicomRtReader* rtReader, vtkSlicerDICOMLoadable* loadable)
 {
@@ -2409,6 +3029,10 @@ vtkSlicerDicomRtImportExportModuleLogic::vtkSlicerDicomRtImportExportModuleLogic
   this->Internal = new vtkInternal(this);
 
   this->BeamModelsInSeparateBranch = true;
+  this->UseExamineCache = true;
+  this->ExamineCacheFilePath = nullptr;
+  this->ConvertSegmentsInParallel = true;
+  this->LazySegmentConversion = false;
 }
 
 //----------------------------------------------------------------------------
@@ -2419,12 +3043,18 @@ vtkSlicerDicomRtImportExportModuleLogic::~vtkSlicerDicomRtImportExportModuleLogi
     delete this->Internal;
     this->Internal = nullptr;
   }
+  this->SetExamineCacheFilePath(nullptr);
 }
 
 //----------------------------------------------------------------------------
 void vtkSlicerDicomRtImportExportModuleLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "UseExamineCache: " << (this->UseExamineCache ? "true" : "false") << "\n";
+  os << indent << "ExamineCacheFilePath: " << (this->ExamineCacheFilePath ? this->ExamineCacheFilePath : "(default)") << "\n";
+  os << indent << "ConvertSegmentsInParallel: " << (this->ConvertSegmentsInParallel ? "true" : "false") << "\n";
+  os << indent << "LazySegmentConversion: " << (this->LazySegmentConversion ? "true" : "false") << "\n";
 }
 
 //---------------------------------------------------------------------------
@@ -2443,6 +3073,132 @@ void vtkSlicerDicomRtImportExportModuleLogic::OnMRMLSceneEndClose()
     vtkErrorMacro("OnMRMLSceneEndClose: Invalid MRML scene");
     return;
   }
+
+  // Segments queued for conversion are not in the scene any more
+  this->Internal->StopSegmentConversions();
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerDicomRtImportExportModuleLogic::QueueSegmentConversions(vtkMRMLSegmentationNode* segmentationNode)
+{
+  this->Internal->QueueSegmentConversions(segmentationNode);
+}
+
+//-----------------------------------------------------------------------------
+int vtkSlicerDicomRtImportExportModuleLogic::ProcessSegmentConversionQueue()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    vtkErrorMacro("ProcessSegmentConversionQueue: Invalid MRML scene");
+    return 0;
+  }
+
+  std::string closedSurfaceRepresentationName(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
+  std::set<std::string> updatedSegmentationNodeIDs;
+  std::vector<vtkInternal::SegmentConversionJob> completedJobs;
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->ConversionQueueMutex);
+    completedJobs.swap(this->Internal->CompletedConversionJobs);
+
+    // Drop the segments that were removed, or got a closed surface in the meantime (converted on demand)
+    std::deque<vtkInternal::SegmentConversionJob>& pendingJobs = this->Internal->PendingConversionJobs;
+    for (std::deque<vtkInternal::SegmentConversionJob>::iterator jobIt = pendingJobs.begin(); jobIt != pendingJobs.end(); )
+    {
+      vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(scene->GetNodeByID(jobIt->SegmentationNodeID));
+      vtkSegment* segment = (segmentationNode ? segmentationNode->GetSegmentation()->GetSegment(jobIt->SegmentID) : nullptr);
+      if (segment && !segment->GetRepresentation(closedSurfaceRepresentationName))
+      {
+        ++jobIt;
+        continue;
+      }
+      if (segmentationNode)
+      {
+        updatedSegmentationNodeIDs.insert(jobIt->SegmentationNodeID);
+      }
+      jobIt = pendingJobs.erase(jobIt);
+    }
+
+    // Convert the currently visible segments first
+    std::stable_partition(this->Internal->PendingConversionJobs.begin(), this->Internal->PendingConversionJobs.end(),
+      [scene](const vtkInternal::SegmentConversionJob& job)
+      {
+        vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(scene->GetNodeByID(job.SegmentationNodeID));
+        vtkMRMLSegmentationDisplayNode* displayNode = (segmentationNode
+          ? vtkMRMLSegmentationDisplayNode::SafeDownCast(segmentationNode->GetDisplayNode()) : nullptr);
+        return displayNode && displayNode->GetVisibility() && displayNode->GetSegmentVisibility(job.SegmentID);
+      });
+  }
+
+  // Add the converted closed surfaces to the segments in one batch per segmentation
+  std::map<std::string, int> modifiedSegmentationNodes; // Segmentation node ID to StartModify result
+  for (const vtkInternal::SegmentConversionJob& job : completedJobs)
+  {
+    vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(scene->GetNodeByID(job.SegmentationNodeID));
+    vtkSegment* segment = (segmentationNode ? segmentationNode->GetSegmentation()->GetSegment(job.SegmentID) : nullptr);
+    vtkDataObject* closedSurface = job.DetachedSegment->GetRepresentation(closedSurfaceRepresentationName);
+    if (!segment)
+    {
+      // Segment was removed in the meantime
+      continue;
+    }
+    if (!job.Success || !closedSurface)
+    {
+      vtkWarningMacro("ProcessSegmentConversionQueue: Failed to create closed surface for segment " << job.SegmentID);
+      continue;
+    }
+    updatedSegmentationNodeIDs.insert(job.SegmentationNodeID);
+    if (segment->GetRepresentation(closedSurfaceRepresentationName))
+    {
+      // Converted on demand in the meantime
+      continue;
+    }
+    if (modifiedSegmentationNodes.find(job.SegmentationNodeID) == modifiedSegmentationNodes.end())
+    {
+      modifiedSegmentationNodes[job.SegmentationNodeID] = segmentationNode->StartModify();
+    }
+    segment->AddRepresentation(closedSurfaceRepresentationName, closedSurface);
+  }
+
+  // Switch display to closed surface when all segments of a segmentation have it. The preferred representation
+  // is set for the whole segmentation, so it cannot be switched segment by segment.
+  for (const std::string& segmentationNodeID : updatedSegmentationNodeIDs)
+  {
+    vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(scene->GetNodeByID(segmentationNodeID));
+    vtkMRMLSegmentationDisplayNode* displayNode = vtkMRMLSegmentationDisplayNode::SafeDownCast(segmentationNode->GetDisplayNode());
+    vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+    bool allSegmentsConverted = (segmentation->GetNumberOfSegments() > 0);
+    for (int segmentIndex = 0; segmentIndex < segmentation->GetNumberOfSegments(); ++segmentIndex)
+    {
+      // Segments without planar contours are not converted
+      vtkSegment* segment = segmentation->GetNthSegment(segmentIndex);
+      if (segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationPlanarContourRepresentationName())
+        && !segment->GetRepresentation(closedSurfaceRepresentationName))
+      {
+        allSegmentsConverted = false;
+        break;
+      }
+    }
+    if (displayNode && allSegmentsConverted)
+    {
+      displayNode->SetPreferredDisplayRepresentationName3D(closedSurfaceRepresentationName.c_str());
+      displayNode->SetPreferredDisplayRepresentationName2D(closedSurfaceRepresentationName.c_str());
+      displayNode->CalculateAutoOpacitiesForSegments();
+    }
+  }
+  for (std::map<std::string, int>::iterator nodeIt = modifiedSegmentationNodes.begin(); nodeIt != modifiedSegmentationNodes.end(); ++nodeIt)
+  {
+    vtkMRMLSegmentationNode::SafeDownCast(scene->GetNodeByID(nodeIt->first))->EndModify(nodeIt->second);
+  }
+
+  std::lock_guard<std::mutex> lock(this->Internal->ConversionQueueMutex);
+  int numberOfRemainingSegments = static_cast<int>(this->Internal->PendingConversionJobs.size() + this->Internal->CompletedConversionJobs.size());
+  if (this->Internal->ConversionThreadRunning && numberOfRemainingSegments == 0)
+  {
+    // The segment being converted
+    numberOfRemainingSegments = 1;
+  }
+  return numberOfRemainingSegments;
 }
 
 //-----------------------------------------------------------------------------
@@ -2461,6 +3217,10 @@ void vtkSlicerDicomRtImportExportModuleLogic::RegisterNodes()
     vtkSmartPointer<vtkPlanarContourToRibbonModelConversionRule>::New() );
   vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
     vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule>::New() );
+  vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
+    vtkSmartPointer<vtkPlanarContourToBinaryLabelmapConversionRule>::New() );
+  vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
+    vtkSmartPointer<vtkPlanarContourToFractionalLabelmapConversionRule>::New() );
 
 }
 
@@ -2473,82 +3233,91 @@ void vtkSlicerDicomRtImportExportModuleLogic::ExamineForLoad(vtkStringArray* fil
   }
   loadables->RemoveAllItems();
 
+  // Examine file headers in parallel
+  std::vector<std::string> fileNames;
   for (int fileIndex=0; fileIndex<fileList->GetNumberOfValues(); ++fileIndex)
   {
-    // Load file in DCMTK
-    DcmFileFormat fileformat;
-    vtkStdString fileName = fileList->GetValue(fileIndex);
-    OFCondition result = fileformat.loadFile(fileName.c_str(), EXS_Unknown);
-    if (!result.good())
-    {
-      continue; // Failed to parse this file, skip it
-    }
+    fileNames.push_back(fileList->GetValue(fileIndex));
+  }
+  std::vector<vtkInternal::ExaminedFile> examinedFiles(fileNames.size());
+  vtkInternal::ExamineFileHeadersFunctor functor;
+  functor.Internal = this->Internal;
+  functor.FileNames = &fileNames;
+  functor.ExaminedFiles = &examinedFiles;
+  if (this->UseExamineCache)
+  {
+    this->Internal->ReadExamineCache(this->Internal->GetExamineCacheFilePath());
+    functor.ExamineCache = &this->Internal->ExamineCache;
+  }
+  vtkSMPTools::For(0, static_cast<vtkIdType>(fileNames.size()), 1, functor);
 
-    // Check SOP Class UID for one of the supported RT objects
-    DcmDataset *dataset = fileformat.getDataset();
-    OFString sopClass;
-    if (!dataset->findAndGetOFString(DCM_SOPClassUID, sopClass).good() || sopClass.empty())
+  // Store new results in the cache, written to file once for the whole batch.
+  // The RTPlan label of doses is not cached, as the plan may be imported later
+  std::vector<std::string> newCachedFileNames;
+  if (this->UseExamineCache && !this->Internal->ExamineCacheFilePath.empty())
+  {
+    for (size_t fileIndex=0; fileIndex<fileNames.size(); ++fileIndex)
     {
-      continue; // Failed to parse this file, skip it
+      if (!examinedFiles[fileIndex].Cached)
+      {
+        this->Internal->ExamineCache[fileNames[fileIndex]] = examinedFiles[fileIndex];
+        newCachedFileNames.push_back(fileNames[fileIndex]);
+      }
     }
+  }
+  if ( (!newCachedFileNames.empty() || (this->UseExamineCache && this->Internal->ExamineCacheCompactionNeeded))
+    && !this->Internal->ExamineCacheFilePath.empty() && !this->Internal->WriteExamineCache(newCachedFileNames) )
+  {
+    vtkWarningMacro("ExamineForLoad: Failed to write DICOM examine cache to " << this->Internal->ExamineCacheFilePath);
+  }
 
-    // DICOM parsing is successful, now check if the object is loadable
-    OFString name("");
-    OFString seriesNumber("");
-    std::vector<OFString> referencedSOPInstanceUIDs;
-    dataset->findAndGetOFString(DCM_SeriesNumber, seriesNumber);
-    if (!seriesNumber.empty())
+  // Create loadables in the order of the files. The DICOM database is only accessed from this thread
+  ctkDICOMDatabase* dicomDatabase = nullptr;
+  for (size_t fileIndex=0; fileIndex<fileNames.size(); ++fileIndex)
+  {
+    vtkInternal::ExaminedFile& examinedFile = examinedFiles[fileIndex];
+    if (!examinedFile.Loadable)
     {
-      name += seriesNumber + ": ";
+      continue;
     }
 
-    // RTDose
-    if (sopClass == UID_RTDoseStorage)
-    {
-      this->Internal->ExamineRtDoseDataset(dataset, name, referencedSOPInstanceUIDs);
-    }
-    // RTPlan
-    else if (sopClass == UID_RTPlanStorage)
-    {
-      this->Internal->ExamineRtPlanDataset(dataset, name, referencedSOPInstanceUIDs);
-    }
-    // RTIonPlan
-    else if (sopClass == UID_RTIonPlanStorage)
+    // Get RTPlan name to show it with the dose
+    if (examinedFile.RtDose && !examinedFile.ReferencedSOPInstanceUIDs.empty())
     {
-      this->Internal->ExamineRtPlanDataset(dataset, name, referencedSOPInstanceUIDs);
-    }
-    // RTStructureSet
-    else if (sopClass == UID_RTStructureSetStorage)
-    {
-      this->Internal->ExamineRtStructureSetDataset(dataset, name, referencedSOPInstanceUIDs);
-    }
-    // RTImage
-    else if (sopClass == UID_RTImageStorage)
-    {
-      this->Internal->ExamineRtImageDataset(dataset, name, referencedSOPInstanceUIDs);
-    }
-    /* Not yet supported
-    else if (sopClass == UID_RTTreatmentSummaryRecordStorage)
-    else if (sopClass == UID_RTIonBeamsTreatmentRecordStorage)
-    */
-    else
-    {
-      continue; // Not an RT file
+      if (!dicomDatabase)
+      {
+        // Create and open DICOM database to perform database operations for getting RTPlan name
+        QSettings settings;
+        QString databaseDirectory = settings.value("DatabaseDirectory").toString();
+        QString databaseFile = databaseDirectory + vtkSlicerDicomRtReader::DICOMREADER_DICOM_DATABASE_FILENAME.c_str();
+        dicomDatabase = new ctkDICOMDatabase();
+        dicomDatabase->openDatabase(databaseFile, vtkSlicerDicomRtReader::DICOMREADER_DICOM_CONNECTION_NAME.c_str());
+      }
+      this->Internal->AppendRtPlanLabelToRtDoseName(dicomDatabase, examinedFile.ReferencedSOPInstanceUIDs[0], examinedFile.Name);
     }
 
     // The file is a loadable RT object, create and set up loadable
     vtkNew<vtkSlicerDICOMLoadable> loadable;
-    loadable->SetName(name.c_str());
-    loadable->AddFile(fileName.c_str());
+    loadable->SetName(examinedFile.Name.c_str());
+    loadable->AddFile(fileNames[fileIndex].c_str());
     loadable->SetConfidence(1.0);
     loadable->SetSelected(true);
     std::vector<OFString>::iterator uidIt;
-    for (uidIt = referencedSOPInstanceUIDs.begin(); uidIt != referencedSOPInstanceUIDs.end(); ++uidIt)
+    for (uidIt = examinedFile.ReferencedSOPInstanceUIDs.begin(); uidIt != examinedFile.ReferencedSOPInstanceUIDs.end(); ++uidIt)
     {
       loadable->AddReferencedInstanceUID(uidIt->c_str());
     }
     loadables->AddItem(loadable);
   }
+
+  // Close and delete DICOM database
+  if (dicomDatabase)
+  {
+    dicomDatabase->closeDatabase();
+    delete dicomDatabase;
+    QSqlDatabase::removeDatabase(vtkSlicerDicomRtReader::DICOMREADER_DICOM_CONNECTION_NAME.c_str());
+    QSqlDatabase::removeDatabase(QString(vtkSlicerDicomRtReader::DICOMREADER_DICOM_CONNECTION_NAME.c_str()) + "TagCache");
+  }
 }
 
 //---------------------------------------------------------------------------
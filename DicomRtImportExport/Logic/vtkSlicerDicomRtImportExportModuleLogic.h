@@ -54,6 +54,13 @@ public:
   vtkTypeMacro(vtkSlicerDicomRtImportExportModuleLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent) override;
 
+  enum
+  {
+    /// Fired when segments are added to the background conversion queue. The module processes the queue
+    /// periodically (see \sa ProcessSegmentConversionQueue) until all queued segments are converted
+    SegmentConversionsQueuedEvent = 62500
+  };
+
   /// Examine a list of file lists and determine what objects can be loaded from them
   /// \param fileList List of files to examine and generate loadables from
   /// \param loadables Collection to store generated (output) loadables
@@ -74,11 +81,52 @@ public:
   /// Insert currently loaded series in the proper place in subject hierarchy
   static void InsertSeriesInSubjectHierarchy(vtkSlicerDicomReaderBase* reader, vtkMRMLScene* scene);
 
+  /// Add the segments of a segmentation that have planar contours but no closed surface to the background
+  /// conversion queue (see \sa LazySegmentConversion), and start the conversion thread if needed.
+  /// Invokes SegmentConversionsQueuedEvent if segments were queued
+  void QueueSegmentConversions(vtkMRMLSegmentationNode* segmentationNode);
+
+  /// Add the closed surfaces created in the background (see \sa LazySegmentConversion) to their segments,
+  /// and switch the display of segmentations to closed surface when all of their segments are converted.
+  /// Also moves visible segments to the front of the queue, and drops the queued segments that got a closed
+  /// surface in the meantime (e.g. converted on demand) or were removed. Must be called from the main thread,
+  /// periodically while there are segments left
+  /// Note: The display representation is set for the whole segmentation, so the planar contours of already
+  ///   converted segments are shown until the last segment of the segmentation is converted.
+  /// \return Number of segments still waiting for conversion
+  int ProcessSegmentConversionQueue();
+
 public:
   vtkSetMacro(BeamModelsInSeparateBranch, bool);
   vtkGetMacro(BeamModelsInSeparateBranch, bool);
   vtkBooleanMacro(BeamModelsInSeparateBranch, bool);
 
+  /// Whether the results of examining files for loading are cached on disk, so that files that did not change
+  /// (same path, size and modification time) are not parsed again. The modification time has one second
+  /// resolution. True by default
+  vtkSetMacro(UseExamineCache, bool);
+  vtkGetMacro(UseExamineCache, bool);
+  vtkBooleanMacro(UseExamineCache, bool);
+
+  /// Path of the examine cache file. If not set, the cache is stored in the DICOM database directory
+  vtkSetStringMacro(ExamineCacheFilePath);
+  vtkGetStringMacro(ExamineCacheFilePath);
+
+  /// Whether the closed surfaces of the structures in a loaded structure set are created in parallel,
+  /// and added to the segmentation in one batch after all of them are done. True by default
+  vtkSetMacro(ConvertSegmentsInParallel, bool);
+  vtkGetMacro(ConvertSegmentsInParallel, bool);
+  vtkBooleanMacro(ConvertSegmentsInParallel, bool);
+
+  /// Whether loaded structure sets keep only their planar contours at load time. Closed surfaces are created
+  /// in the background, visible segments first, and are added to the segments by \sa ProcessSegmentConversionQueue.
+  /// Other representations (and closed surfaces that are needed before the background conversion reaches them)
+  /// are created on demand by the segmentation when a module requests them, in which case the queued conversion
+  /// of the segment is skipped. False by default
+  vtkSetMacro(LazySegmentConversion, bool);
+  vtkGetMacro(LazySegmentConversion, bool);
+  vtkBooleanMacro(LazySegmentConversion, bool);
+
 protected:
   void SetMRMLSceneInternal(vtkMRMLScene* newScene) override;
   void OnMRMLSceneEndClose() override;
@@ -101,6 +149,18 @@ private:
   /// Flag determining whether the generated beam models are arranged in a separate subject hierarchy
   /// branch, or each beam model is added under its corresponding isocenter fiducial
   bool BeamModelsInSeparateBranch;
+
+  /// Flag determining whether the results of examining files for loading are cached on disk
+  bool UseExamineCache;
+
+  /// Path of the examine cache file. The DICOM database directory is used if not set
+  char* ExamineCacheFilePath;
+
+  /// Flag determining whether the closed surfaces of loaded structures are created in parallel
+  bool ConvertSegmentsInParallel;
+
+  /// Flag determining whether the closed surfaces of loaded structures are created in the background
+  bool LazySegmentConversion;
 };
 
 #endif
@@ -29,10 +29,13 @@
 
 // VTK includes
 #include <vtkCellArray.h>
+#include <vtkImageData.h>
 #include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
 #include <vtkPoints.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
 #include <vtkTable.h>
 #include <vtkStringArray.h>
@@ -41,6 +44,7 @@
 
 // STD includes
 #include <array>
+#include <cmath>
 #include <vector>
 #include <map>
 
@@ -389,9 +393,46 @@ public:
   /// List of dose references from external beam plan
   std::vector<DoseReferenceEntry> DoseReferenceSequenceVector;
 
+  /// Dose volume decoded from the RTDOSE pixel data (scaled float values)
+  vtkSmartPointer<vtkImageData> DoseImageData;
+  /// IJK to RAS matrix of the decoded dose volume
+  vtkSmartPointer<vtkMatrix4x4> DoseIJKToRASMatrix;
+
+  /// Functor converting stored RTDOSE pixel values to scaled float dose values.
+  /// Pixel data is accessed as 16-bit words, 32-bit values are assembled from little endian word pairs
+  template <typename PixelType>
+  class DecodeDosePixelsFunctor
+  {
+  public:
+    void operator()(vtkIdType begin, vtkIdType end) const
+    {
+      for (vtkIdType index = begin; index < end; ++index)
+      {
+        PixelType value = 0;
+        if (sizeof(PixelType) == 2)
+        {
+          value = static_cast<PixelType>(this->PixelWords[index]);
+        }
+        else
+        {
+          value = static_cast<PixelType>( static_cast<Uint32>(this->PixelWords[2*index])
+            | (static_cast<Uint32>(this->PixelWords[2*index+1]) << 16) );
+        }
+        this->Output[index] = static_cast<float>(value * this->DoseGridScaling);
+      }
+    }
+
+    const Uint16* PixelWords{nullptr};
+    float* Output{nullptr};
+    double DoseGridScaling{1.0};
+  };
+
 public:
   /// Load RT Dose
   void LoadRTDose(DcmDataset* dataset);
+  /// Decode RT Dose pixel data (all frames) in one pass directly into a scaled float volume
+  /// and compute its geometry from the image plane module and the grid frame offset vector
+  bool DecodeRTDosePixelData(DRTDoseIOD& rtDose, DcmDataset* dataset, double doseGridScaling);
 
   /// Load RT Plan 
   void LoadRTPlan(DcmDataset* dataset);
@@ -409,6 +450,9 @@ public:
 
   /// Load individual contour from RT Structure Set
   vtkSlicerDicomRtReader::vtkInternal::RoiEntry* LoadContour(DRTROIContourSequence::Item &roiObject, DRTStructureSetIOD* rtStructureSet);
+  /// Parse backslash-separated decimal string (DS) values independently of the current locale
+  /// \return True if exactly numberOfValues values were parsed successfully
+  static bool ParseDecimalStringValues(const char* valueString, size_t length, float* values, unsigned long numberOfValues);
   /// Load RT Image
   void LoadRTImage(DcmDataset* dataset);
 
@@ -822,6 +866,17 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTDose(DcmDataset* dataset)
   this->External->SetPixelSpacing(pixelSpacingOFVector[1], pixelSpacingOFVector[0]);
   vtkDebugWithObjectMacro(this->External, "Pixel Spacing: (" << pixelSpacingOFVector[1] << ", " << pixelSpacingOFVector[0] << ")");
 
+  // Decode pixel data. If it fails (e.g. for encapsulated pixel data), the dose volume
+  // can still be read by the generic volume reader, so it is not an error.
+  this->DoseImageData = nullptr;
+  this->DoseIJKToRASMatrix = nullptr;
+  if (!this->DecodeRTDosePixelData(rtDose, dataset, vtkVariant(doseGridScaling.c_str()).ToDouble()))
+  {
+    this->DoseImageData = nullptr;
+    this->DoseIJKToRASMatrix = nullptr;
+    vtkDebugWithObjectMacro(this->External, "LoadRTDose: Pixel data could not be decoded directly, dose volume needs to be read from file");
+  }
+
   // Get referenced RTPlan instance UID
   DRTReferencedRTPlanSequence &referencedRTPlanSequence = rtDose.getReferencedRTPlanSequence();
   if (referencedRTPlanSequence.gotoFirstItem().good())
@@ -852,6 +907,154 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTDose(DcmDataset* dataset)
   this->External->LoadRTDoseSuccessful = true;
 }
 
+//----------------------------------------------------------------------------
+bool vtkSlicerDicomRtReader::vtkInternal::DecodeRTDosePixelData(DRTDoseIOD& rtDose, DcmDataset* dataset, double doseGridScaling)
+{
+  Uint16 rows = 0;
+  Uint16 columns = 0;
+  if (rtDose.getRows(rows).bad() || rtDose.getColumns(columns).bad() || rows == 0 || columns == 0)
+  {
+    vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Failed to get image dimensions for dose object");
+    return false;
+  }
+  Sint32 numberOfFrames = 1;
+  if (rtDose.getNumberOfFrames(numberOfFrames).bad() || numberOfFrames < 1)
+  {
+    numberOfFrames = 1;
+  }
+
+  Uint16 bitsAllocated = 0;
+  Uint16 pixelRepresentation = 0;
+  Uint16 samplesPerPixel = 1;
+  rtDose.getBitsAllocated(bitsAllocated);
+  rtDose.getPixelRepresentation(pixelRepresentation);
+  rtDose.getSamplesPerPixel(samplesPerPixel);
+  if ((bitsAllocated != 16 && bitsAllocated != 32) || samplesPerPixel != 1)
+  {
+    vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Unsupported pixel format (bits allocated: "
+      << bitsAllocated << ", samples per pixel: " << samplesPerPixel << ")");
+    return false;
+  }
+
+  // Geometry
+  OFVector<vtkTypeFloat64> imagePositionOFVector;
+  OFVector<vtkTypeFloat64> imageOrientationOFVector;
+  if ( rtDose.getImagePositionPatient(imagePositionOFVector).bad() || imagePositionOFVector.size() < 3
+    || rtDose.getImageOrientationPatient(imageOrientationOFVector).bad() || imageOrientationOFVector.size() < 6 )
+  {
+    vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Failed to get image position or orientation for dose object");
+    return false;
+  }
+
+  // Slice spacing is defined by the grid frame offset vector. The first frame is always located at the
+  // image position, both for relative (first offset is zero) and absolute (first offset is the z position) offsets.
+  double sliceSpacing = 1.0;
+  if (numberOfFrames > 1)
+  {
+    OFVector<vtkTypeFloat64> gridFrameOffsetOFVector;
+    if (rtDose.getGridFrameOffsetVector(gridFrameOffsetOFVector).bad() || gridFrameOffsetOFVector.size() < static_cast<size_t>(numberOfFrames))
+    {
+      vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Failed to get grid frame offset vector for multi-frame dose object");
+      return false;
+    }
+    sliceSpacing = gridFrameOffsetOFVector[1] - gridFrameOffsetOFVector[0];
+    if (sliceSpacing == 0.0)
+    {
+      vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Invalid grid frame offset vector (zero slice spacing)");
+      return false;
+    }
+    for (Sint32 frameIndex = 2; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      double currentSpacing = gridFrameOffsetOFVector[frameIndex] - gridFrameOffsetOFVector[frameIndex-1];
+      if (fabs(currentSpacing - sliceSpacing) > 1e-3 * fabs(sliceSpacing))
+      {
+        vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Non-uniform slice spacing found in grid frame offset vector, using spacing of the first two frames");
+        break;
+      }
+    }
+  }
+
+  // Pixel data
+  const Uint16* pixelWords = nullptr;
+  unsigned long numberOfWords = 0;
+  if (dataset->findAndGetUint16Array(DCM_PixelData, pixelWords, &numberOfWords).bad() || !pixelWords)
+  {
+    return false;
+  }
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(rows) * columns * numberOfFrames;
+  if (numberOfWords < static_cast<unsigned long>(numberOfVoxels * (bitsAllocated / 16)))
+  {
+    vtkWarningWithObjectMacro(this->External, "DecodeRTDosePixelData: Pixel data is shorter than expected from the image dimensions");
+    return false;
+  }
+
+  vtkSmartPointer<vtkImageData> doseImageData = vtkSmartPointer<vtkImageData>::New();
+  doseImageData->SetExtent(0, columns-1, 0, rows-1, 0, numberOfFrames-1);
+  doseImageData->AllocateScalars(VTK_FLOAT, 1);
+  float* outputPtr = static_cast<float*>(doseImageData->GetScalarPointer());
+
+  // Convert and scale voxels in parallel, straight into the output buffer
+  if (bitsAllocated == 16)
+  {
+    if (pixelRepresentation == 1)
+    {
+      DecodeDosePixelsFunctor<Sint16> decodeFunctor;
+      decodeFunctor.PixelWords = pixelWords;
+      decodeFunctor.Output = outputPtr;
+      decodeFunctor.DoseGridScaling = doseGridScaling;
+      vtkSMPTools::For(0, numberOfVoxels, decodeFunctor);
+    }
+    else
+    {
+      DecodeDosePixelsFunctor<Uint16> decodeFunctor;
+      decodeFunctor.PixelWords = pixelWords;
+      decodeFunctor.Output = outputPtr;
+      decodeFunctor.DoseGridScaling = doseGridScaling;
+      vtkSMPTools::For(0, numberOfVoxels, decodeFunctor);
+    }
+  }
+  else
+  {
+    if (pixelRepresentation == 1)
+    {
+      DecodeDosePixelsFunctor<Sint32> decodeFunctor;
+      decodeFunctor.PixelWords = pixelWords;
+      decodeFunctor.Output = outputPtr;
+      decodeFunctor.DoseGridScaling = doseGridScaling;
+      vtkSMPTools::For(0, numberOfVoxels, decodeFunctor);
+    }
+    else
+    {
+      DecodeDosePixelsFunctor<Uint32> decodeFunctor;
+      decodeFunctor.PixelWords = pixelWords;
+      decodeFunctor.Output = outputPtr;
+      decodeFunctor.DoseGridScaling = doseGridScaling;
+      vtkSMPTools::For(0, numberOfVoxels, decodeFunctor);
+    }
+  }
+
+  // Assemble IJK to RAS matrix (DICOM patient coordinate system is LPS)
+  const double* spacing = this->External->GetPixelSpacing();
+  double rowDirection[3] = { imageOrientationOFVector[0], imageOrientationOFVector[1], imageOrientationOFVector[2] };
+  double columnDirection[3] = { imageOrientationOFVector[3], imageOrientationOFVector[4], imageOrientationOFVector[5] };
+  double sliceDirection[3] = { 0.0, 0.0, 0.0 };
+  vtkMath::Cross(rowDirection, columnDirection, sliceDirection);
+
+  vtkSmartPointer<vtkMatrix4x4> ijkToRasMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int row = 0; row < 3; ++row)
+  {
+    double lpsToRas = (row < 2 ? -1.0 : 1.0);
+    ijkToRasMatrix->SetElement(row, 0, lpsToRas * rowDirection[row] * spacing[0]);
+    ijkToRasMatrix->SetElement(row, 1, lpsToRas * columnDirection[row] * spacing[1]);
+    ijkToRasMatrix->SetElement(row, 2, lpsToRas * sliceDirection[row] * sliceSpacing);
+    ijkToRasMatrix->SetElement(row, 3, lpsToRas * imagePositionOFVector[row]);
+  }
+
+  this->DoseImageData = doseImageData;
+  this->DoseIJKToRASMatrix = ijkToRasMatrix;
+  return true;
+}
+
 //----------------------------------------------------------------------------
 void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
 {
@@ -2426,12 +2629,32 @@ vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkIntern
     return roiEntry;
   }
 
+  // Count contour points first so that point and cell storage can be allocated once for the whole ROI
+  vtkIdType numberOfContours = 0;
+  vtkIdType totalNumberOfPoints = 0;
+  do
+  {
+    DRTContourSequence::Item &contourItem = rtContourSequence.getCurrentItem();
+    Sint32 numberOfPoints = 0;
+    if (contourItem.isValid() && contourItem.getNumberOfContourPoints(numberOfPoints).good() && numberOfPoints > 0)
+    {
+      ++numberOfContours;
+      totalNumberOfPoints += numberOfPoints;
+    }
+  }
+  while (rtContourSequence.gotoNextItem().good());
+
   // Create containers for contour poly data
   vtkSmartPointer<vtkPoints> currentRoiContourPoints = vtkSmartPointer<vtkPoints>::New();
+  currentRoiContourPoints->SetDataTypeToFloat();
+  currentRoiContourPoints->SetNumberOfPoints(totalNumberOfPoints);
+  float* contourPointsPtr = static_cast<float*>(currentRoiContourPoints->GetData()->GetVoidPointer(0));
   vtkSmartPointer<vtkCellArray> currentRoiContourCells = vtkSmartPointer<vtkCellArray>::New();
+  currentRoiContourCells->AllocateExact(numberOfContours, totalNumberOfPoints + numberOfContours);
   vtkIdType pointId = 0;
 
   // Read contour data, iterate over contour sequence
+  rtContourSequence.gotoFirstItem();
   do
   {
     // Get contour
@@ -2442,35 +2665,44 @@ vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkIntern
     }
 
     // Get number of contour points
-    OFString numberOfPointsString("");
-    contourItem.getNumberOfContourPoints(numberOfPointsString);
-    std::stringstream ss;
-    ss << numberOfPointsString;
-    int numberOfPoints;
-    ss >> numberOfPoints;
-
-    // Get contour point data
-    OFVector<vtkTypeFloat64> contourData_LPS;
-    contourItem.getContourData(contourData_LPS);
-    if (contourData_LPS.size() != size_t(numberOfPoints * 3))
-    {
-      vtkErrorWithObjectMacro(this->External, "LoadContour: Contour sequence object item is invalid: "
-        << " number of contour points is " << numberOfPoints << " therefore expected "
-        << numberOfPoints * 3 << " values in contour data but only found " << contourData_LPS.size());
+    Sint32 numberOfPoints = 0;
+    if (contourItem.getNumberOfContourPoints(numberOfPoints).bad() || numberOfPoints <= 0)
+    {
+      vtkErrorWithObjectMacro(this->External, "LoadContour: Contour sequence object item is invalid: missing number of contour points");
       continue;
     }
 
+    // Parse contour point data (still in DICOM LPS) straight into the point array.
+    // Fall back to the DCMTK parser for values the fast parser does not accept.
+    float* currentContourPointsPtr = contourPointsPtr + 3 * pointId;
+    OFString contourDataString("");
+    if ( contourItem.getContourData(contourDataString, -1).bad()
+      || !ParseDecimalStringValues(contourDataString.c_str(), contourDataString.length(), currentContourPointsPtr, 3 * numberOfPoints) )
+    {
+      OFVector<vtkTypeFloat64> contourData_LPS;
+      contourItem.getContourData(contourData_LPS);
+      if (contourData_LPS.size() != size_t(numberOfPoints * 3))
+      {
+        vtkErrorWithObjectMacro(this->External, "LoadContour: Contour sequence object item is invalid: "
+          << " number of contour points is " << numberOfPoints << " therefore expected "
+          << numberOfPoints * 3 << " values in contour data but only found " << contourData_LPS.size());
+        continue;
+      }
+      for (size_t valueIndex = 0; valueIndex < contourData_LPS.size(); ++valueIndex)
+      {
+        currentContourPointsPtr[valueIndex] = static_cast<float>(contourData_LPS[valueIndex]);
+      }
+    }
+
     unsigned int contourIndex = currentRoiContourCells->InsertNextCell(numberOfPoints+1);
-    for (int k=0; k<numberOfPoints; k++)
+    for (vtkIdType k=0; k<numberOfPoints; k++)
     {
-      // Convert from DICOM LPS -> Slicer RAS
-      currentRoiContourPoints->InsertPoint(pointId, -contourData_LPS[3*k], -contourData_LPS[3*k+1], contourData_LPS[3*k+2]);
-      currentRoiContourCells->InsertCellPoint(pointId);
-      pointId++;
+      currentRoiContourCells->InsertCellPoint(pointId + k);
     }
 
     // Close the contour
-    currentRoiContourCells->InsertCellPoint(pointId-numberOfPoints);
+    currentRoiContourCells->InsertCellPoint(pointId);
+    pointId += numberOfPoints;
 
     // Add map to the referenced slice instance UID
     // This is not a mandatory field so no error logged if not found. The reason why
@@ -2500,6 +2732,18 @@ vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkIntern
   }
   while (rtContourSequence.gotoNextItem().good());
 
+  // Convert from DICOM LPS -> Slicer RAS in a single sweep over the whole point array
+  for (vtkIdType pointIndex = 0; pointIndex < pointId; ++pointIndex)
+  {
+    contourPointsPtr[3*pointIndex] = -contourPointsPtr[3*pointIndex];
+    contourPointsPtr[3*pointIndex+1] = -contourPointsPtr[3*pointIndex+1];
+  }
+  if (pointId < totalNumberOfPoints)
+  {
+    // Some contours were skipped as invalid
+    currentRoiContourPoints->SetNumberOfPoints(pointId);
+  }
+
   // Read slice reference UIDs from referenced frame of reference sequence if it was not included in the ROIContourSequence above
   if (contourToSliceInstanceUIDMap.empty())
   {
@@ -2572,6 +2816,131 @@ vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkIntern
   return roiEntry;
 }
 
+//----------------------------------------------------------------------------
+bool vtkSlicerDicomRtReader::vtkInternal::ParseDecimalStringValues(const char* valueString, size_t length, float* values, unsigned long numberOfValues)
+{
+  static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  // Digits beyond this mantissa are below float precision anyway
+  const unsigned long long maximumMantissa = 100000000000000000ULL;
+
+  if (!valueString || !values)
+  {
+    return false;
+  }
+
+  const char* current = valueString;
+  const char* end = valueString + length;
+  unsigned long valueIndex = 0;
+  while (current < end && *current != '\0')
+  {
+    if (valueIndex >= numberOfValues)
+    {
+      return false;
+    }
+
+    // Leading spaces and sign
+    while (current < end && *current == ' ')
+    {
+      ++current;
+    }
+    bool negative = false;
+    if (current < end && (*current == '+' || *current == '-'))
+    {
+      negative = (*current == '-');
+      ++current;
+    }
+
+    // Integer and fractional part
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    bool digitFound = false;
+    for (; current < end && *current >= '0' && *current <= '9'; ++current)
+    {
+      digitFound = true;
+      if (mantissa < maximumMantissa)
+      {
+        mantissa = mantissa * 10 + (*current - '0');
+      }
+      else
+      {
+        ++exponent;
+      }
+    }
+    if (current < end && *current == '.')
+    {
+      ++current;
+      for (; current < end && *current >= '0' && *current <= '9'; ++current)
+      {
+        digitFound = true;
+        if (mantissa < maximumMantissa)
+        {
+          mantissa = mantissa * 10 + (*current - '0');
+          --exponent;
+        }
+      }
+    }
+    if (!digitFound)
+    {
+      return false;
+    }
+
+    // Exponent
+    if (current < end && (*current == 'e' || *current == 'E'))
+    {
+      ++current;
+      bool negativeExponent = false;
+      if (current < end && (*current == '+' || *current == '-'))
+      {
+        negativeExponent = (*current == '-');
+        ++current;
+      }
+      int exponentValue = 0;
+      bool exponentDigitFound = false;
+      for (; current < end && *current >= '0' && *current <= '9'; ++current)
+      {
+        exponentDigitFound = true;
+        if (exponentValue < 1000)
+        {
+          exponentValue = exponentValue * 10 + (*current - '0');
+        }
+      }
+      if (!exponentDigitFound)
+      {
+        return false;
+      }
+      exponent += (negativeExponent ? -exponentValue : exponentValue);
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0)
+    {
+      value = (-exponent <= 22 ? value / powersOfTen[-exponent] : value * std::pow(10.0, exponent));
+    }
+    else if (exponent > 0)
+    {
+      value = (exponent <= 22 ? value * powersOfTen[exponent] : value * std::pow(10.0, exponent));
+    }
+    values[valueIndex++] = static_cast<float>(negative ? -value : value);
+
+    // Trailing spaces and value delimiter
+    while (current < end && *current == ' ')
+    {
+      ++current;
+    }
+    if (current < end && *current != '\0')
+    {
+      if (*current != '\\')
+      {
+        return false;
+      }
+      ++current;
+    }
+  }
+
+  return (valueIndex == numberOfValues);
+}
+
 //----------------------------------------------------------------------------
 void vtkSlicerDicomRtReader::vtkInternal::LoadRTImage(DcmDataset* dataset)
 {
@@ -2940,6 +3309,18 @@ void vtkSlicerDicomRtReader::Update()
   }
 }
 
+//----------------------------------------------------------------------------
+vtkImageData* vtkSlicerDicomRtReader::GetDoseImageData()
+{
+  return this->Internal->DoseImageData;
+}
+
+//----------------------------------------------------------------------------
+vtkMatrix4x4* vtkSlicerDicomRtReader::GetDoseIJKToRASMatrix()
+{
+  return this->Internal->DoseIJKToRASMatrix;
+}
+
 //----------------------------------------------------------------------------
 int vtkSlicerDicomRtReader::GetNumberOfRois()
 {
@@ -39,6 +39,8 @@
 #include <vector>
 #include <array>
 
+class vtkImageData;
+class vtkMatrix4x4;
 class vtkPolyData;
 class vtkTable;
 
@@ -252,6 +254,14 @@ public:
   /// Get pixel spacing for dose volume
   vtkGetVector2Macro(PixelSpacing, double);
 
+  /// Get dose volume decoded directly from the RTDOSE pixel data, with the dose grid scaling
+  /// already applied (float scalars). Origin is zero and spacing is one, the geometry is
+  /// available from \sa GetDoseIJKToRASMatrix.
+  /// Returns nullptr if the pixel data could not be decoded (e.g. compressed transfer syntax)
+  vtkImageData* GetDoseImageData();
+  /// Get IJK to RAS matrix of the decoded dose volume
+  vtkMatrix4x4* GetDoseIJKToRASMatrix();
+
   /// Get dose units
   vtkGetStringMacro(DoseUnits);
   /// Set dose units
@@ -0,0 +1,320 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// DicomRtImportExport includes
+#include "vtkPlanarContourToBinaryLabelmapConversionRule.h"
+
+// SegmentationCore includes
+#include <vtkClosedSurfaceToBinaryLabelmapConversionRule.h>
+#include <vtkOrientedImageData.h>
+#include <vtkSegmentationConverter.h>
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+#include <vtkSegment.h>
+#endif
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace
+{
+  const double CENTER = 32.0;
+
+  //-----------------------------------------------------------------------------
+  /// Get reference geometry with identity IJK to RAS transform and unit spacing
+  std::string GetReferenceGeometry()
+  {
+    vtkNew<vtkOrientedImageData> referenceImage;
+    referenceImage->SetExtent(0, 63, 0, 63, 0, 31);
+    return vtkSegmentationConverter::SerializeImageGeometry(referenceImage);
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Add a closed contour to the contours poly data
+  void AddContour(vtkPolyData* contours, const double* xy, int numberOfPoints, double z)
+  {
+    vtkPoints* points = contours->GetPoints();
+    vtkCellArray* lines = contours->GetLines();
+    vtkIdType firstPointId = points->GetNumberOfPoints();
+    lines->InsertNextCell(numberOfPoints + 1);
+    for (int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      lines->InsertCellPoint(points->InsertNextPoint(xy[2*pointIndex], xy[2*pointIndex+1], z));
+    }
+    lines->InsertCellPoint(firstPointId);
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Add an axis aligned square contour centered on the center of the reference image
+  void AddSquare(vtkPolyData* contours, double halfSize, double z, bool clockwise=false)
+  {
+    double xy[8] =
+    {
+      CENTER - halfSize, CENTER - halfSize,
+      CENTER + halfSize, CENTER - halfSize,
+      CENTER + halfSize, CENTER + halfSize,
+      CENTER - halfSize, CENTER + halfSize
+    };
+    if (clockwise)
+    {
+      std::swap(xy[2], xy[6]);
+      std::swap(xy[3], xy[7]);
+    }
+    AddContour(contours, xy, 4, z);
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Add a circle contour centered on the center of the reference image
+  void AddCircle(vtkPolyData* contours, double radius, double z)
+  {
+    const int numberOfPoints = 128;
+    double xy[2 * numberOfPoints] = { 0.0 };
+    for (int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      double angle = 2.0 * vtkMath::Pi() * pointIndex / numberOfPoints;
+      xy[2*pointIndex] = CENTER + radius * std::cos(angle);
+      xy[2*pointIndex+1] = CENTER + radius * std::sin(angle);
+    }
+    AddContour(contours, xy, numberOfPoints, z);
+  }
+
+  //-----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPolyData> CreateEmptyContours()
+  {
+    vtkSmartPointer<vtkPolyData> contours = vtkSmartPointer<vtkPolyData>::New();
+    vtkNew<vtkPoints> points;
+    vtkNew<vtkCellArray> lines;
+    contours->SetPoints(points);
+    contours->SetLines(lines);
+    return contours;
+  }
+
+  //-----------------------------------------------------------------------------
+  bool ConvertToBinaryLabelmap(vtkPolyData* contours, vtkOrientedImageData* labelmap, const std::string& oversamplingFactor="1")
+  {
+    vtkSmartPointer<vtkPlanarContourToBinaryLabelmapConversionRule> rule = vtkSmartPointer<vtkPlanarContourToBinaryLabelmapConversionRule>::New();
+    rule->SetConversionParameter(vtkSegmentationConverter::GetReferenceImageGeometryParameterName(), GetReferenceGeometry());
+    rule->SetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(), oversamplingFactor);
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    vtkNew<vtkSegment> segment;
+    segment->AddRepresentation(rule->GetSourceRepresentationName(), contours);
+    if (!rule->Convert(segment))
+    {
+      return false;
+    }
+    vtkOrientedImageData* convertedLabelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(rule->GetTargetRepresentationName()));
+    if (!convertedLabelmap)
+    {
+      return false;
+    }
+    labelmap->DeepCopy(convertedLabelmap);
+    return true;
+#else
+    return rule->Convert(contours, labelmap);
+#endif
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Get labelmap value at an IJK position, 0 outside the extent
+  int GetValue(vtkOrientedImageData* labelmap, int i, int j, int k)
+  {
+    int extent[6] = { 0, -1, 0, -1, 0, -1 };
+    labelmap->GetExtent(extent);
+    if (i < extent[0] || i > extent[1] || j < extent[2] || j > extent[3] || k < extent[4] || k > extent[5])
+    {
+      return 0;
+    }
+    return static_cast<int>(labelmap->GetScalarComponentAsDouble(i, j, k, 0));
+  }
+
+  //-----------------------------------------------------------------------------
+  bool CheckValue(vtkOrientedImageData* labelmap, int i, int j, int k, int expectedValue, const char* description)
+  {
+    int value = GetValue(labelmap, i, j, k);
+    if (value != expectedValue)
+    {
+      std::cerr << "ERROR: " << description << ": value at (" << i << ", " << j << ", " << k << ") is "
+        << value << " instead of " << expectedValue << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Outer square with a hole, and an island inside the hole. Orientation of the contours must not matter.
+  bool TestHolesAndNestedContours()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateEmptyContours();
+    AddSquare(contours, 10.5, 16.0);
+    AddSquare(contours, 6.5, 16.0, true);
+    AddSquare(contours, 2.5, 16.0);
+    vtkNew<vtkOrientedImageData> labelmap;
+    if (!ConvertToBinaryLabelmap(contours, labelmap))
+    {
+      std::cerr << "ERROR: Failed to convert nested contours to binary labelmap" << std::endl;
+      return false;
+    }
+
+    const int center = static_cast<int>(CENTER);
+    bool success = true;
+    success &= CheckValue(labelmap, center, center, 16, 1, "Island");
+    success &= CheckValue(labelmap, center + 2, center, 16, 1, "Island edge");
+    success &= CheckValue(labelmap, center + 3, center, 16, 0, "Hole");
+    success &= CheckValue(labelmap, center, center - 6, 16, 0, "Hole edge");
+    success &= CheckValue(labelmap, center + 7, center, 16, 1, "Outer ring");
+    success &= CheckValue(labelmap, center, center - 10, 16, 1, "Outer ring edge");
+    success &= CheckValue(labelmap, center + 11, center, 16, 0, "Outside");
+    success &= CheckValue(labelmap, center + 7, center, 15, 0, "Slice below single contour plane");
+    return success;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// End planes cover half of the plane spacing, and the end slices are copies of the end planes
+  bool TestEndSlabs()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateEmptyContours();
+    AddSquare(contours, 6.5, 4.0);
+    AddSquare(contours, 10.5, 6.0);
+    AddSquare(contours, 4.5, 8.0);
+    vtkNew<vtkOrientedImageData> labelmap;
+    if (!ConvertToBinaryLabelmap(contours, labelmap))
+    {
+      std::cerr << "ERROR: Failed to convert contours to binary labelmap" << std::endl;
+      return false;
+    }
+
+    int extent[6] = { 0, -1, 0, -1, 0, -1 };
+    labelmap->GetExtent(extent);
+    if (extent[4] != 3 || extent[5] != 9)
+    {
+      std::cerr << "ERROR: Slice extent is " << extent[4] << ".." << extent[5] << " instead of 3..9" << std::endl;
+      return false;
+    }
+    for (int j = extent[2]; j <= extent[3]; ++j)
+    {
+      for (int i = extent[0]; i <= extent[1]; ++i)
+      {
+        if (GetValue(labelmap, i, j, 3) != GetValue(labelmap, i, j, 4)
+          || GetValue(labelmap, i, j, 9) != GetValue(labelmap, i, j, 8))
+        {
+          std::cerr << "ERROR: End slice differs from the end contour plane at (" << i << ", " << j << ")" << std::endl;
+          return false;
+        }
+      }
+    }
+
+    const int center = static_cast<int>(CENTER);
+    bool success = true;
+    success &= CheckValue(labelmap, center + 6, center, 3, 1, "First end slab");
+    success &= CheckValue(labelmap, center + 7, center, 3, 0, "First end slab");
+    success &= CheckValue(labelmap, center + 4, center, 9, 1, "Last end slab");
+    success &= CheckValue(labelmap, center + 5, center, 9, 0, "Last end slab");
+    success &= CheckValue(labelmap, center + 10, center, 6, 1, "Middle contour plane");
+    return success;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Slices between contour planes are interpolated from the signed distance maps of the planes
+  bool TestInterpolation()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateEmptyContours();
+    AddCircle(contours, 10.0, 8.0);
+    AddCircle(contours, 18.0, 12.0);
+    vtkNew<vtkOrientedImageData> labelmap;
+    if (!ConvertToBinaryLabelmap(contours, labelmap))
+    {
+      std::cerr << "ERROR: Failed to convert circles to binary labelmap" << std::endl;
+      return false;
+    }
+
+    // The interpolated radius in the middle slice is about 14 voxels
+    const int center = static_cast<int>(CENTER);
+    bool success = true;
+    success &= CheckValue(labelmap, center + 12, center, 10, 1, "Interpolated slice inside");
+    success &= CheckValue(labelmap, center, center - 12, 10, 1, "Interpolated slice inside");
+    success &= CheckValue(labelmap, center + 16, center, 10, 0, "Interpolated slice outside");
+    success &= CheckValue(labelmap, center, center - 16, 10, 0, "Interpolated slice outside");
+    success &= CheckValue(labelmap, center + 12, center, 8, 0, "Contour plane outside");
+    success &= CheckValue(labelmap, center + 16, center, 12, 1, "Contour plane inside");
+    return success;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// The oversampling factor of the segmentation is applied on the reference geometry. Automatic
+  /// oversampling is left to the conversion through the closed surface.
+  bool TestOversampling()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateEmptyContours();
+    AddSquare(contours, 6.5, 16.0);
+    vtkNew<vtkOrientedImageData> labelmap;
+    if (!ConvertToBinaryLabelmap(contours, labelmap, "2"))
+    {
+      std::cerr << "ERROR: Failed to convert contours to oversampled binary labelmap" << std::endl;
+      return false;
+    }
+    double spacing[3] = { 0.0, 0.0, 0.0 };
+    labelmap->GetSpacing(spacing);
+    if (std::fabs(spacing[0] - 0.5) > 1e-6 || std::fabs(spacing[1] - 0.5) > 1e-6 || std::fabs(spacing[2] - 0.5) > 1e-6)
+    {
+      std::cerr << "ERROR: Oversampled spacing is (" << spacing[0] << ", " << spacing[1] << ", " << spacing[2]
+        << ") instead of 0.5" << std::endl;
+      return false;
+    }
+
+    vtkSmartPointer<vtkPlanarContourToBinaryLabelmapConversionRule> rule = vtkSmartPointer<vtkPlanarContourToBinaryLabelmapConversionRule>::New();
+    unsigned int fixedOversamplingCost = rule->GetConversionCost();
+    rule->SetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(), "A");
+    unsigned int automaticOversamplingCost = rule->GetConversionCost();
+    if (automaticOversamplingCost <= fixedOversamplingCost)
+    {
+      std::cerr << "ERROR: Conversion cost with automatic oversampling is not higher than with fixed oversampling" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlanarContourToBinaryLabelmapConversionRuleTest1(int , char * [] )
+{
+  if (!TestHolesAndNestedContours())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestEndSlabs())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestInterpolation())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestOversampling())
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
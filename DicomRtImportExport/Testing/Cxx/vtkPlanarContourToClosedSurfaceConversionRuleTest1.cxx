@@ -0,0 +1,589 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// DicomRtImportExport includes
+#include "vtkPlanarContourToClosedSurfaceConversionRule.h"
+
+// SegmentationCore includes
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+#include <vtkSegment.h>
+#endif
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSMPTools.h>
+#include <vtkStaticPointLocator.h>
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  //-----------------------------------------------------------------------------
+  /// Conversion rule exposing the branching steps for testing
+  class vtkBranchingTestConversionRule : public vtkPlanarContourToClosedSurfaceConversionRule
+  {
+  public:
+    static vtkBranchingTestConversionRule* New();
+    vtkTypeMacro(vtkBranchingTestConversionRule, vtkPlanarContourToClosedSurfaceConversionRule);
+
+    using vtkPlanarContourToClosedSurfaceConversionRule::DoLineBoundsOverlap;
+    using vtkPlanarContourToClosedSurfaceConversionRule::FindOverlappingLines;
+    using vtkPlanarContourToClosedSurfaceConversionRule::GetClosestBranch;
+    using vtkPlanarContourToClosedSurfaceConversionRule::BuildBranchPointLocator;
+
+    /// Triangulate between two lines with the full search
+    void TriangulateFull(vtkPolyData* contours, vtkIdList* pointsInLine1, vtkIdList* pointsInLine2, vtkCellArray* outputPolygons)
+    {
+      this->TriangulationBandWidth = 0;
+      this->TriangulateBetweenContours(contours, pointsInLine1, pointsInLine2, outputPolygons);
+    }
+
+    /// Triangulate between two lines with the banded search only, with the same closest point correspondence
+    /// and orientation as in TriangulateBetweenContours
+    /// \return True if the banded search succeeded
+    bool TriangulateBanded(vtkPolyData* contours, vtkIdList* pointsInLine1, vtkIdList* pointsInLine2, int bandWidth, vtkCellArray* outputPolygons)
+    {
+      std::vector<int> closestPointFromLine1ToLine2Ids(pointsInLine1->GetNumberOfIds());
+      for (vtkIdType line1PointIndex = 0; line1PointIndex < pointsInLine1->GetNumberOfIds(); ++line1PointIndex)
+      {
+        closestPointFromLine1ToLine2Ids[line1PointIndex] = this->GetClosestPoint(contours, contours->GetPoint(pointsInLine1->GetId(line1PointIndex)), pointsInLine2);
+      }
+      std::vector<int> closestPointFromLine2ToLine1Ids(pointsInLine2->GetNumberOfIds());
+      for (vtkIdType line2PointIndex = 0; line2PointIndex < pointsInLine2->GetNumberOfIds(); ++line2PointIndex)
+      {
+        closestPointFromLine2ToLine1Ids[line2PointIndex] = this->GetClosestPoint(contours, contours->GetPoint(pointsInLine2->GetId(line2PointIndex)), pointsInLine1);
+      }
+      bool line1Closed = (pointsInLine1->GetId(0) == pointsInLine1->GetId(pointsInLine1->GetNumberOfIds() - 1));
+      bool line2Closed = (pointsInLine2->GetId(0) == pointsInLine2->GetId(pointsInLine2->GetNumberOfIds() - 1));
+
+      this->TriangulationBandWidth = bandWidth;
+      return this->TriangulateBetweenContoursBanded(contours, pointsInLine1, pointsInLine2, line1Closed, line2Closed,
+        closestPointFromLine1ToLine2Ids[0], closestPointFromLine1ToLine2Ids, closestPointFromLine2ToLine1Ids, outputPolygons);
+    }
+  };
+  vtkStandardNewMacro(vtkBranchingTestConversionRule);
+
+  const double CONTOUR_SPACING = 2.5;
+
+  //-----------------------------------------------------------------------------
+  /// Get the points of an ellipse in the XY plane. Points on the Y axis get an exact zero X coordinate,
+  /// so that they are exactly equidistant from mirrored contours.
+  std::vector<std::array<double, 2> > GetEllipsePoints(double centerX, double centerY, double radiusX, double radiusY, int numberOfPoints)
+  {
+    std::vector<std::array<double, 2> > points(numberOfPoints);
+    for (int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+    {
+      double angle = 2.0 * vtkMath::Pi() * pointIndex / numberOfPoints;
+      double x = radiusX * std::cos(angle);
+      points[pointIndex][0] = centerX + (std::fabs(x) < 1.0e-9 ? 0.0 : x);
+      points[pointIndex][1] = centerY + radiusY * std::sin(angle);
+    }
+    return points;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Mirror contour points on the Y axis
+  std::vector<std::array<double, 2> > GetMirroredPoints(const std::vector<std::array<double, 2> >& points)
+  {
+    std::vector<std::array<double, 2> > mirroredPoints(points);
+    for (std::array<double, 2>& point : mirroredPoints)
+    {
+      point[0] = -point[0];
+    }
+    return mirroredPoints;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Add a closed planar contour (first point repeated at the end) at the given Z coordinate
+  /// \return ID of the added line
+  vtkIdType AddContour(vtkPolyData* contours, const std::vector<std::array<double, 2> >& contourPoints, double z)
+  {
+    vtkPoints* points = contours->GetPoints();
+    vtkNew<vtkIdList> pointIds;
+    for (const std::array<double, 2>& contourPoint : contourPoints)
+    {
+      pointIds->InsertNextId(points->InsertNextPoint(contourPoint[0], contourPoint[1], z));
+    }
+    pointIds->InsertNextId(pointIds->GetId(0));
+    return contours->GetLines()->InsertNextCell(pointIds);
+  }
+
+  //-----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPolyData> CreateEmptyContours()
+  {
+    vtkSmartPointer<vtkPolyData> contours = vtkSmartPointer<vtkPolyData>::New();
+    vtkNew<vtkPoints> points;
+    vtkNew<vtkCellArray> lines;
+    contours->SetPoints(points);
+    contours->SetLines(lines);
+    return contours;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Closest branch as it was found before the shared point locator: the closest point of each overlapping
+  /// line is searched separately, and on equal distances the line that comes first in the overlap list wins.
+  /// \param tie Output flag set if more than one overlapping line is at the minimum distance
+  vtkIdType GetClosestBranchReference(vtkPolyData* contours, const double* originalPoint,
+    const std::vector<vtkIdType>& overlappingLineIds, bool& tie)
+  {
+    tie = false;
+    if (overlappingLineIds.size() == 1)
+    {
+      return overlappingLineIds[0];
+    }
+
+    double minimumDistanceSquared = VTK_DOUBLE_MAX;
+    vtkIdType closestLineId = overlappingLineIds[0];
+    vtkNew<vtkIdList> linePointIds;
+    for (vtkIdType lineId : overlappingLineIds)
+    {
+      contours->GetCellPoints(lineId, linePointIds);
+      double lineDistanceSquared = VTK_DOUBLE_MAX;
+      for (vtkIdType pointIndex = 0; pointIndex < linePointIds->GetNumberOfIds(); ++pointIndex)
+      {
+        double linePoint[3] = { 0.0, 0.0, 0.0 };
+        contours->GetPoint(linePointIds->GetId(pointIndex), linePoint);
+        lineDistanceSquared = std::min(lineDistanceSquared, vtkMath::Distance2BetweenPoints(linePoint, originalPoint));
+      }
+      if (lineDistanceSquared < minimumDistanceSquared)
+      {
+        minimumDistanceSquared = lineDistanceSquared;
+        closestLineId = lineId;
+        tie = false;
+      }
+      else if (lineDistanceSquared == minimumDistanceSquared)
+      {
+        tie = true;
+      }
+    }
+    return closestLineId;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Create a branching structure: a trunk that splits into two mirrored branches, plus a separate island
+  /// that does not overlap with any of them. The branches are exactly symmetric, so the trunk points on the
+  /// Y axis are at the same distance from both.
+  vtkSmartPointer<vtkPolyData> CreateBranchingContours(bool withMergingTrunk)
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateEmptyContours();
+    std::vector<std::array<double, 2> > trunkPoints = GetEllipsePoints(0.0, 0.0, 30.0, 12.0, 240);
+    std::vector<std::array<double, 2> > rightBranchPoints = GetEllipsePoints(15.0, 0.0, 10.0, 10.0, 60);
+    std::vector<std::array<double, 2> > leftBranchPoints = GetMirroredPoints(rightBranchPoints);
+    std::vector<std::array<double, 2> > islandPoints = GetEllipsePoints(80.0, 0.0, 5.0, 5.0, 30);
+
+    AddContour(contours, trunkPoints, 0.0);
+    AddContour(contours, islandPoints, 0.0);
+    AddContour(contours, rightBranchPoints, CONTOUR_SPACING);
+    AddContour(contours, leftBranchPoints, CONTOUR_SPACING);
+    if (withMergingTrunk)
+    {
+      AddContour(contours, rightBranchPoints, 2.0 * CONTOUR_SPACING);
+      AddContour(contours, leftBranchPoints, 2.0 * CONTOUR_SPACING);
+      AddContour(contours, islandPoints, 2.0 * CONTOUR_SPACING);
+      AddContour(contours, trunkPoints, 3.0 * CONTOUR_SPACING);
+      AddContour(contours, islandPoints, 3.0 * CONTOUR_SPACING);
+    }
+    contours->BuildCells();
+    return contours;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compare the closest branches found with the reference implementation for every trunk point and for points far
+  /// from both branches, both with the locator of the overlapping lines used by the conversion and with a locator of
+  /// the whole ROI. With the ROI locator the nearest points are on the trunk itself, so the closest N query is widened
+  /// several times before a branch point is found.
+  bool TestClosestBranch()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateBranchingContours(false);
+    const vtkIdType trunkLineId = 0;
+    const vtkIdType rightBranchLineId = 2;
+    const vtkIdType leftBranchLineId = 3;
+
+    std::vector<vtkIdType> pointLineIds(contours->GetNumberOfPoints(), -1);
+    vtkNew<vtkIdList> linePointIds;
+    for (vtkIdType lineId = 0; lineId < contours->GetNumberOfLines(); ++lineId)
+    {
+      contours->GetCellPoints(lineId, linePointIds);
+      for (vtkIdType pointIndex = 0; pointIndex < linePointIds->GetNumberOfIds(); ++pointIndex)
+      {
+        pointLineIds[linePointIds->GetId(pointIndex)] = lineId;
+      }
+    }
+    vtkNew<vtkPolyData> contourPoints;
+    contourPoints->SetPoints(contours->GetPoints());
+    vtkNew<vtkStaticPointLocator> pointLocator;
+    pointLocator->SetDataSet(contourPoints);
+    pointLocator->BuildLocator();
+
+    vtkNew<vtkBranchingTestConversionRule> rule;
+    std::vector<std::vector<vtkIdType> > overlapLists;
+    overlapLists.push_back(std::vector<vtkIdType>{ rightBranchLineId, leftBranchLineId });
+    overlapLists.push_back(std::vector<vtkIdType>{ leftBranchLineId, rightBranchLineId });
+
+    // Query the points of the trunk, and points far from both branches, for which the closest points
+    // of the whole ROI are on the trunk and the island
+    std::vector<std::array<double, 3> > queryPoints;
+    contours->GetCellPoints(trunkLineId, linePointIds);
+    for (vtkIdType pointIndex = 0; pointIndex < linePointIds->GetNumberOfIds(); ++pointIndex)
+    {
+      std::array<double, 3> trunkPoint = { 0.0, 0.0, 0.0 };
+      contours->GetPoint(linePointIds->GetId(pointIndex), trunkPoint.data());
+      queryPoints.push_back(trunkPoint);
+    }
+    queryPoints.push_back(std::array<double, 3>{ -300.0, 0.0, 0.0 });
+    queryPoints.push_back(std::array<double, 3>{ 0.0, 250.0, 0.0 });
+    queryPoints.push_back(std::array<double, 3>{ 400.0, -350.0, 0.0 });
+
+    int numberOfTies = 0;
+    for (const std::vector<vtkIdType>& overlappingLineIds : overlapLists)
+    {
+      // Locator of the overlapping lines only, as used by the conversion
+      vtkNew<vtkStaticPointLocator> branchPointLocator;
+      std::vector<vtkIdType> branchPointLineIds;
+      rule->BuildBranchPointLocator(contours, overlappingLineIds, branchPointLocator, branchPointLineIds);
+
+      for (std::array<double, 3>& queryPoint : queryPoints)
+      {
+        bool tie = false;
+        vtkIdType expectedLineId = GetClosestBranchReference(contours, queryPoint.data(), overlappingLineIds, tie);
+        vtkIdType closestLineId = rule->GetClosestBranch(contours, queryPoint.data(), overlappingLineIds, pointLocator, pointLineIds);
+        vtkIdType closestLineIdInBranches = rule->GetClosestBranch(contours, queryPoint.data(), overlappingLineIds, branchPointLocator, branchPointLineIds);
+        if (closestLineId != expectedLineId || closestLineIdInBranches != expectedLineId)
+        {
+          std::cerr << "ERROR: Closest branch of point (" << queryPoint[0] << ", " << queryPoint[1] << ") is line "
+            << closestLineId << " (ROI locator) and line " << closestLineIdInBranches << " (branch locator) instead of line "
+            << expectedLineId << (tie ? " (equal distances)" : "") << std::endl;
+          return false;
+        }
+        numberOfTies += (tie ? 1 : 0);
+      }
+    }
+    if (numberOfTies == 0)
+    {
+      std::cerr << "ERROR: Equally distant branches are not covered by the test" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compare the overlaps found with the X interval sweep with the pairwise overlap checks on randomly placed
+  /// islands. Bounds are rounded to whole millimeters so that equal and touching bounds occur.
+  bool TestOverlappingLines()
+  {
+    std::mt19937 randomGenerator(42);
+    std::uniform_int_distribution<int> positionDistribution(0, 100);
+    std::uniform_int_distribution<int> sizeDistribution(0, 25);
+
+    const int numberOfLinesInPlane1 = 40;
+    const int numberOfLinesInPlane2 = 55;
+    std::vector<std::array<double, 6> > lineBounds(numberOfLinesInPlane1 + numberOfLinesInPlane2);
+    for (size_t lineIndex = 0; lineIndex < lineBounds.size(); ++lineIndex)
+    {
+      std::array<double, 6>& bounds = lineBounds[lineIndex];
+      bounds[0] = positionDistribution(randomGenerator);
+      bounds[1] = bounds[0] + sizeDistribution(randomGenerator);
+      bounds[2] = positionDistribution(randomGenerator);
+      bounds[3] = bounds[2] + sizeDistribution(randomGenerator);
+      bounds[4] = bounds[5] = (static_cast<int>(lineIndex) < numberOfLinesInPlane1 ? 0.0 : CONTOUR_SPACING);
+    }
+
+    std::vector<std::vector<vtkIdType> > expectedPlane1Overlaps(numberOfLinesInPlane1);
+    std::vector<std::vector<vtkIdType> > expectedPlane2Overlaps(numberOfLinesInPlane2);
+    for (vtkIdType line1Id = 0; line1Id < numberOfLinesInPlane1; ++line1Id)
+    {
+      for (vtkIdType line2Id = numberOfLinesInPlane1; line2Id < numberOfLinesInPlane1 + numberOfLinesInPlane2; ++line2Id)
+      {
+        if (vtkBranchingTestConversionRule::DoLineBoundsOverlap(lineBounds[line1Id].data(), lineBounds[line2Id].data()))
+        {
+          expectedPlane1Overlaps[line1Id].push_back(line2Id);
+          expectedPlane2Overlaps[line2Id - numberOfLinesInPlane1].push_back(line1Id);
+        }
+      }
+    }
+
+    vtkNew<vtkBranchingTestConversionRule> rule;
+    std::vector<std::vector<vtkIdType> > plane1Overlaps;
+    std::vector<std::vector<vtkIdType> > plane2Overlaps;
+    rule->FindOverlappingLines(lineBounds, 0, numberOfLinesInPlane1, numberOfLinesInPlane1, numberOfLinesInPlane2,
+      plane1Overlaps, plane2Overlaps);
+    if (plane1Overlaps != expectedPlane1Overlaps || plane2Overlaps != expectedPlane2Overlaps)
+    {
+      std::cerr << "ERROR: Overlapping lines differ from the pairwise overlap checks" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  bool ConvertToClosedSurface(vtkPolyData* contours, vtkPolyData* closedSurface, const std::string& triangulationBandWidth="")
+  {
+    vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule> rule = vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule>::New();
+    if (!triangulationBandWidth.empty())
+    {
+      rule->SetConversionParameter(rule->GetTriangulationBandWidthParameterName(), triangulationBandWidth);
+    }
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    vtkNew<vtkSegment> segment;
+    segment->AddRepresentation(rule->GetSourceRepresentationName(), contours);
+    if (!rule->Convert(segment))
+    {
+      return false;
+    }
+    vtkPolyData* convertedSurface = vtkPolyData::SafeDownCast(segment->GetRepresentation(rule->GetTargetRepresentationName()));
+    if (!convertedSurface)
+    {
+      return false;
+    }
+    closedSurface->DeepCopy(convertedSurface);
+    return true;
+#else
+    return rule->Convert(contours, closedSurface);
+#endif
+  }
+
+  //-----------------------------------------------------------------------------
+  bool ArePolyDataEqual(vtkPolyData* polyData1, vtkPolyData* polyData2)
+  {
+    if (polyData1->GetNumberOfPoints() != polyData2->GetNumberOfPoints()
+      || polyData1->GetNumberOfCells() != polyData2->GetNumberOfCells())
+    {
+      return false;
+    }
+    for (vtkIdType pointId = 0; pointId < polyData1->GetNumberOfPoints(); ++pointId)
+    {
+      double point1[3] = { 0.0, 0.0, 0.0 };
+      double point2[3] = { 0.0, 0.0, 0.0 };
+      polyData1->GetPoint(pointId, point1);
+      polyData2->GetPoint(pointId, point2);
+      if (point1[0] != point2[0] || point1[1] != point2[1] || point1[2] != point2[2])
+      {
+        return false;
+      }
+    }
+    vtkNew<vtkIdList> cellPointIds1;
+    vtkNew<vtkIdList> cellPointIds2;
+    for (vtkIdType cellId = 0; cellId < polyData1->GetNumberOfCells(); ++cellId)
+    {
+      polyData1->GetCellPoints(cellId, cellPointIds1);
+      polyData2->GetCellPoints(cellId, cellPointIds2);
+      if (polyData1->GetCellType(cellId) != polyData2->GetCellType(cellId)
+        || cellPointIds1->GetNumberOfIds() != cellPointIds2->GetNumberOfIds())
+      {
+        return false;
+      }
+      for (vtkIdType idIndex = 0; idIndex < cellPointIds1->GetNumberOfIds(); ++idIndex)
+      {
+        if (cellPointIds1->GetId(idIndex) != cellPointIds2->GetId(idIndex))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Convert a structure that branches, merges again, and has a separate island. Slice pairs are triangulated
+  /// in parallel, so the output must be the same polygons in the same order in every conversion, and the same as
+  /// in a conversion with a single thread.
+  bool TestMultiIslandConversion()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateBranchingContours(true);
+    vtkNew<vtkPolyData> closedSurface;
+    if (!ConvertToClosedSurface(contours, closedSurface))
+    {
+      std::cerr << "ERROR: Failed to convert branching contours to closed surface" << std::endl;
+      return false;
+    }
+    if (closedSurface->GetNumberOfPolys() == 0)
+    {
+      std::cerr << "ERROR: Closed surface of branching contours is empty" << std::endl;
+      return false;
+    }
+
+    double bounds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    closedSurface->GetBounds(bounds);
+    if (bounds[0] > -29.0 || bounds[1] < 84.0)
+    {
+      std::cerr << "ERROR: Closed surface does not cover the trunk and the island, X bounds are "
+        << bounds[0] << ", " << bounds[1] << std::endl;
+      return false;
+    }
+
+    for (int conversionIndex = 0; conversionIndex < 3; ++conversionIndex)
+    {
+      vtkNew<vtkPolyData> repeatedClosedSurface;
+      if (!ConvertToClosedSurface(contours, repeatedClosedSurface) || !ArePolyDataEqual(closedSurface, repeatedClosedSurface))
+      {
+        std::cerr << "ERROR: Closed surface differs in repeated conversion " << conversionIndex << std::endl;
+        return false;
+      }
+    }
+
+    vtkSMPTools::Initialize(1);
+    vtkNew<vtkPolyData> serialClosedSurface;
+    bool serialConversionSucceeded = ConvertToClosedSurface(contours, serialClosedSurface);
+    vtkSMPTools::Initialize(0);
+    if (!serialConversionSucceeded || !ArePolyDataEqual(closedSurface, serialClosedSurface))
+    {
+      std::cerr << "ERROR: Closed surface differs in conversion with a single thread" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compare the point IDs of two cell arrays
+  bool AreCellArraysEqual(vtkCellArray* cells1, vtkCellArray* cells2)
+  {
+    if (cells1->GetNumberOfCells() != cells2->GetNumberOfCells())
+    {
+      return false;
+    }
+    vtkNew<vtkIdList> cellPointIds1;
+    vtkNew<vtkIdList> cellPointIds2;
+    cells1->InitTraversal();
+    cells2->InitTraversal();
+    while (cells1->GetNextCell(cellPointIds1) && cells2->GetNextCell(cellPointIds2))
+    {
+      if (cellPointIds1->GetNumberOfIds() != cellPointIds2->GetNumberOfIds())
+      {
+        return false;
+      }
+      for (vtkIdType pointIndex = 0; pointIndex < cellPointIds1->GetNumberOfIds(); ++pointIndex)
+      {
+        if (cellPointIds1->GetId(pointIndex) != cellPointIds2->GetId(pointIndex))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Triangulate a stack of long, irregular contours with different numbers of points and start points.
+  /// The optimal triangulation follows the closest point correspondence, so searching only a band around
+  /// it must give the same surface as the full search. Narrow bands fall back to the full search.
+  /// The banded search is also run directly on each contour pair, to make sure that it is not always
+  /// the fallback that produces the surface.
+  bool TestBandedTriangulation()
+  {
+    vtkSmartPointer<vtkPolyData> contours = CreateEmptyContours();
+    const int numberOfContours = 6;
+    for (int contourIndex = 0; contourIndex < numberOfContours; ++contourIndex)
+    {
+      int numberOfPoints = 300 + 37 * contourIndex;
+      double startAngle = 0.7 * contourIndex;
+      std::vector<std::array<double, 2> > contourPoints(numberOfPoints);
+      for (int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+      {
+        double angle = startAngle + 2.0 * vtkMath::Pi() * pointIndex / numberOfPoints;
+        double radius = 40.0 + 2.0 * contourIndex + 6.0 * std::sin(3.0 * angle + 0.4 * contourIndex);
+        contourPoints[pointIndex][0] = 1.3 * radius * std::cos(angle);
+        contourPoints[pointIndex][1] = radius * std::sin(angle);
+      }
+      AddContour(contours, contourPoints, contourIndex * CONTOUR_SPACING);
+    }
+
+    vtkNew<vtkPolyData> fullClosedSurface;
+    if (!ConvertToClosedSurface(contours, fullClosedSurface, "0"))
+    {
+      std::cerr << "ERROR: Failed to convert long contours to closed surface" << std::endl;
+      return false;
+    }
+    for (const char* bandWidth : { "2", "8", "32" })
+    {
+      vtkNew<vtkPolyData> bandedClosedSurface;
+      if (!ConvertToClosedSurface(contours, bandedClosedSurface, bandWidth))
+      {
+        std::cerr << "ERROR: Failed to convert long contours to closed surface with band width " << bandWidth << std::endl;
+        return false;
+      }
+      if (!ArePolyDataEqual(fullClosedSurface, bandedClosedSurface))
+      {
+        std::cerr << "ERROR: Closed surface with band width " << bandWidth << " differs from the full search" << std::endl;
+        return false;
+      }
+    }
+
+    vtkNew<vtkBranchingTestConversionRule> rule;
+    vtkNew<vtkIdList> pointsInLine1;
+    vtkNew<vtkIdList> pointsInLine2;
+    int numberOfBandedPairs = 0;
+    for (vtkIdType line1Id = 0; line1Id + 1 < contours->GetNumberOfLines(); ++line1Id)
+    {
+      contours->GetCellPoints(line1Id, pointsInLine1);
+      contours->GetCellPoints(line1Id + 1, pointsInLine2);
+      vtkNew<vtkCellArray> fullPolygons;
+      rule->TriangulateFull(contours, pointsInLine1, pointsInLine2, fullPolygons);
+      vtkNew<vtkCellArray> bandedPolygons;
+      if (!rule->TriangulateBanded(contours, pointsInLine1, pointsInLine2, 32, bandedPolygons))
+      {
+        continue;
+      }
+      if (!AreCellArraysEqual(fullPolygons, bandedPolygons))
+      {
+        std::cerr << "ERROR: Banded triangulation between lines " << line1Id << " and " << line1Id + 1 << " differs from the full search" << std::endl;
+        return false;
+      }
+      ++numberOfBandedPairs;
+    }
+    if (numberOfBandedPairs == 0)
+    {
+      std::cerr << "ERROR: Banded triangulation fell back to the full search for all contour pairs" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlanarContourToClosedSurfaceConversionRuleTest1(int , char * [] )
+{
+  if (!TestOverlappingLines())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestClosestBranch())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestMultiIslandConversion())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestBandedTriangulation())
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// DicomRtImportExport includes
+#include "vtkPlanarContourToFractionalLabelmapConversionRule.h"
+
+// SegmentationCore includes
+#include <vtkClosedSurfaceToBinaryLabelmapConversionRule.h>
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  //-----------------------------------------------------------------------------
+  /// Conversion rule exposing the coverage computation for testing
+  class vtkCoverageTestConversionRule : public vtkPlanarContourToFractionalLabelmapConversionRule
+  {
+  public:
+    static vtkCoverageTestConversionRule* New();
+    vtkTypeMacro(vtkCoverageTestConversionRule, vtkPlanarContourToFractionalLabelmapConversionRule);
+
+    using vtkPlanarContourToFractionalLabelmapConversionRule::ContourPlane;
+    using vtkPlanarContourToFractionalLabelmapConversionRule::ComputeCoverageMap;
+  };
+  vtkStandardNewMacro(vtkCoverageTestConversionRule);
+
+  typedef vtkCoverageTestConversionRule::ContourPlane ContourPlane;
+
+  const double COVERAGE_TOLERANCE = 1e-5;
+
+  //-----------------------------------------------------------------------------
+  /// Get axis aligned rectangle polygon as flat (I,J) list, counterclockwise unless requested otherwise
+  std::vector<double> GetRectangle(double minI, double maxI, double minJ, double maxJ, bool clockwise=false)
+  {
+    std::vector<double> polygon = { minI, minJ, maxI, minJ, maxI, maxJ, minI, maxJ };
+    if (clockwise)
+    {
+      std::swap(polygon[2], polygon[6]);
+      std::swap(polygon[3], polygon[7]);
+    }
+    return polygon;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Reverse the point order of a polygon
+  std::vector<double> GetReversedPolygon(const std::vector<double>& polygon)
+  {
+    std::vector<double> reversedPolygon;
+    for (size_t pointIndex = polygon.size() / 2; pointIndex > 0; --pointIndex)
+    {
+      reversedPolygon.push_back(polygon[2 * (pointIndex - 1)]);
+      reversedPolygon.push_back(polygon[2 * (pointIndex - 1) + 1]);
+    }
+    return reversedPolygon;
+  }
+
+  //-----------------------------------------------------------------------------
+  std::vector<float> ComputeCoverage(const ContourPlane& contourPlane, const int extent[4])
+  {
+    std::vector<float> coverage((extent[1] - extent[0] + 1) * (extent[3] - extent[2] + 1), -1.0f);
+    vtkCoverageTestConversionRule::ComputeCoverageMap(contourPlane, extent, coverage.data());
+    return coverage;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compare coverage map with expected values, given row by row (J major)
+  bool CheckCoverage(const std::vector<float>& coverage, const std::vector<float>& expectedCoverage, const char* description)
+  {
+    if (coverage.size() != expectedCoverage.size())
+    {
+      std::cerr << "ERROR: " << description << ": coverage map size is " << coverage.size()
+        << " instead of " << expectedCoverage.size() << std::endl;
+      return false;
+    }
+    for (size_t index = 0; index < coverage.size(); ++index)
+    {
+      if (std::fabs(coverage[index] - expectedCoverage[index]) > COVERAGE_TOLERANCE)
+      {
+        std::cerr << "ERROR: " << description << ": coverage of voxel " << index << " is "
+          << coverage[index] << " instead of " << expectedCoverage[index] << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Voxel (I,J) covers [I-0.5, I+0.5) x [J-0.5, J+0.5)
+  bool TestPartialCoverage()
+  {
+    const int extent[4] = { 0, 2, 0, 1 };
+    ContourPlane contourPlane;
+    contourPlane.Polygons.push_back(GetRectangle(-0.5, 1.0, -0.5, 0.75));
+    return CheckCoverage(ComputeCoverage(contourPlane, extent),
+      { 1.0f,  0.5f,   0.0f,
+        0.25f, 0.125f, 0.0f }, "Half covered voxel");
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Polygons inside another polygon are holes, polygons inside a hole are islands
+  bool TestHoles()
+  {
+    const int extent[4] = { 0, 4, 0, 4 };
+    ContourPlane contourPlane;
+    contourPlane.Polygons.push_back(GetRectangle(-0.5, 4.5, -0.5, 4.5));
+    contourPlane.Polygons.push_back(GetRectangle(0.5, 3.5, 0.5, 3.5));
+    contourPlane.Polygons.push_back(GetRectangle(1.5, 2.5, 1.5, 2.0));
+    return CheckCoverage(ComputeCoverage(contourPlane, extent),
+      { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 0.5f, 0.0f, 1.0f,
+        1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 1.0f, 1.0f, 1.0f }, "Hole with island");
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Polygons extending beyond the extent are clipped, voxels at the extent boundary are covered
+  bool TestExtentClipping()
+  {
+    const int extent[4] = { 2, 4, 2, 3 };
+    ContourPlane contourPlane;
+    contourPlane.Polygons.push_back(GetRectangle(-10.0, 3.0, -10.0, 10.0));
+    return CheckCoverage(ComputeCoverage(contourPlane, extent),
+      { 1.0f, 0.5f, 0.0f,
+        1.0f, 0.5f, 0.0f }, "Polygon clipped by the extent");
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Coverage does not depend on the orientation of the polygons, including the holes
+  bool TestOrientation()
+  {
+    const int extent[4] = { 0, 5, 0, 5 };
+    std::vector<double> triangle = { -0.3, 0.1, 5.2, 1.7, 2.1, 4.9 };
+    std::vector<double> hole = { 1.4, 1.6, 3.3, 2.2, 2.0, 3.1 };
+
+    ContourPlane counterclockwisePlane;
+    counterclockwisePlane.Polygons.push_back(triangle);
+    counterclockwisePlane.Polygons.push_back(hole);
+    ContourPlane clockwisePlane;
+    clockwisePlane.Polygons.push_back(GetReversedPolygon(triangle));
+    clockwisePlane.Polygons.push_back(GetReversedPolygon(hole));
+    ContourPlane mixedPlane;
+    mixedPlane.Polygons.push_back(triangle);
+    mixedPlane.Polygons.push_back(GetReversedPolygon(hole));
+
+    std::vector<float> coverage = ComputeCoverage(counterclockwisePlane, extent);
+    double totalCoverage = 0.0;
+    for (float voxelCoverage : coverage)
+    {
+      totalCoverage += voxelCoverage;
+    }
+    // Area of the triangle minus area of the hole (shoelace formula)
+    double expectedTotalCoverage = 0.5 * ((5.2 + 0.3) * (4.9 - 0.1) - (2.1 + 0.3) * (1.7 - 0.1))
+      - 0.5 * ((3.3 - 1.4) * (3.1 - 1.6) - (2.0 - 1.4) * (2.2 - 1.6));
+    if (std::fabs(totalCoverage - expectedTotalCoverage) > coverage.size() * COVERAGE_TOLERANCE)
+    {
+      std::cerr << "ERROR: Total coverage is " << totalCoverage << " instead of " << expectedTotalCoverage << std::endl;
+      return false;
+    }
+    return CheckCoverage(ComputeCoverage(clockwisePlane, extent), coverage, "Clockwise polygons")
+      && CheckCoverage(ComputeCoverage(mixedPlane, extent), coverage, "Mixed orientation polygons");
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Automatic oversampling is left to the conversion through the closed surface
+  bool TestConversionCost()
+  {
+    vtkSmartPointer<vtkPlanarContourToFractionalLabelmapConversionRule> rule = vtkSmartPointer<vtkPlanarContourToFractionalLabelmapConversionRule>::New();
+    unsigned int fixedOversamplingCost = rule->GetConversionCost();
+    rule->SetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(), "A");
+    unsigned int automaticOversamplingCost = rule->GetConversionCost();
+    if (automaticOversamplingCost <= fixedOversamplingCost)
+    {
+      std::cerr << "ERROR: Conversion cost with automatic oversampling is not higher than with fixed oversampling" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlanarContourToFractionalLabelmapConversionRuleTest1(int , char * [] )
+{
+  if (!TestPartialCoverage())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestHoles())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestExtentClipping())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestOrientation())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestConversionCost())
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
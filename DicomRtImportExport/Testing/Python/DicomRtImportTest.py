@@ -38,6 +38,7 @@ class DicomRtImportTest(unittest.TestCase):
     self.TestSection_ImportStudy()
     self.TestSection_SelectLoadables()
     self.TestSection_LoadIntoSlicer()
+    self.TestSection_CheckClosedSurfaces()
     self.TestSection_SaveScene()
     self.TestSection_ClearDatabase()
 
@@ -156,6 +157,55 @@ class DicomRtImportTest(unittest.TestCase):
     shNode = slicer.vtkMRMLSubjectHierarchyNode.GetSubjectHierarchyNode(slicer.mrmlScene)
     self.assertEqual( shNode.GetNumberOfItems(), 28 )
 
+  #------------------------------------------------------------------------------
+  def TestSection_CheckClosedSurfaces(self):
+    # slicer.util.delayDisplay("Check closed surfaces",self.delayMs)
+    logging.info("Check closed surfaces")
+
+    # Closed surfaces are created for all structures in parallel on load
+    logic = slicer.modules.dicomrtimportexport.logic()
+    self.assertTrue( logic.GetConvertSegmentsInParallel() )
+    self.assertFalse( logic.GetLazySegmentConversion() )
+
+    planarContourName = slicer.vtkSegmentationConverter.GetSegmentationPlanarContourRepresentationName()
+    closedSurfaceName = slicer.vtkSegmentationConverter.GetSegmentationClosedSurfaceRepresentationName()
+    segmentation = slicer.util.getNode('vtkMRMLSegmentationNode*').GetSegmentation()
+    self.assertGreater( segmentation.GetNumberOfSegments(), 0 )
+
+    for segmentIndex in range(segmentation.GetNumberOfSegments()):
+      segment = segmentation.GetNthSegment(segmentIndex)
+      planarContours = segment.GetRepresentation(planarContourName)
+      self.assertIsNotNone( planarContours )
+      closedSurface = segment.GetRepresentation(closedSurfaceName)
+      self.assertIsNotNone( closedSurface, 'No closed surface for segment ' + segment.GetName() )
+
+      # The closed surface must be the same as the one converted on demand by the segmentation
+      onDemandSegmentation = slicer.vtkSegmentation()
+      if hasattr(onDemandSegmentation, 'SetSourceRepresentationName'):
+        onDemandSegmentation.SetSourceRepresentationName(planarContourName)
+      else:
+        onDemandSegmentation.SetMasterRepresentationName(planarContourName)
+      onDemandSegmentation.CopyConversionParameters(segmentation)
+      onDemandSegment = slicer.vtkSegment()
+      onDemandSegment.AddRepresentation(planarContourName, planarContours)
+      onDemandSegmentation.AddSegment(onDemandSegment)
+      self.assertTrue( onDemandSegmentation.CreateRepresentation(closedSurfaceName) )
+      onDemandClosedSurface = onDemandSegment.GetRepresentation(closedSurfaceName)
+      self.assertIsNotNone( onDemandClosedSurface )
+      self.assertTrue( self.arePolyDataEqual(closedSurface, onDemandClosedSurface),
+        'Closed surface of segment ' + segment.GetName() + ' differs from on-demand conversion' )
+
+  #------------------------------------------------------------------------------
+  def arePolyDataEqual(self, polyData1, polyData2):
+    import numpy
+    from vtk.util.numpy_support import vtk_to_numpy
+    if polyData1.GetNumberOfPoints() != polyData2.GetNumberOfPoints() or polyData1.GetNumberOfPolys() != polyData2.GetNumberOfPolys():
+      return False
+    if polyData1.GetNumberOfPoints() == 0:
+      return True
+    return ( numpy.array_equal(vtk_to_numpy(polyData1.GetPoints().GetData()), vtk_to_numpy(polyData2.GetPoints().GetData()))
+      and numpy.array_equal(vtk_to_numpy(polyData1.GetPolys().GetData()), vtk_to_numpy(polyData2.GetPolys().GetData())) )
+
   #------------------------------------------------------------------------------
   def TestSection_SaveScene(self):
     # slicer.util.delayDisplay("Save scene",self.delayMs)
@@ -0,0 +1,135 @@
+import math
+import time
+import unittest
+import vtk, qt, ctk, slicer
+import logging
+
+class DicomRtLazySegmentConversionTest(unittest.TestCase):
+  def setUp(self):
+    """ Do whatever is needed to reset the state - typically a scene clear will be enough.
+    """
+    slicer.mrmlScene.Clear(0)
+    self.logic = slicer.modules.dicomrtimportexport.logic()
+    self.planarContourName = slicer.vtkSegmentationConverter.GetSegmentationPlanarContourRepresentationName()
+    self.closedSurfaceName = slicer.vtkSegmentationConverter.GetSegmentationClosedSurfaceRepresentationName()
+
+  #------------------------------------------------------------------------------
+  def runTest(self):
+    """Run as few or as many tests as needed here.
+    """
+    self.setUp()
+    self.test_DicomRtLazySegmentConversion_ConversionQueue()
+    self.setUp()
+    self.test_DicomRtLazySegmentConversion_CancelOnSceneClose()
+
+  #------------------------------------------------------------------------------
+  def test_DicomRtLazySegmentConversion_ConversionQueue(self):
+    segmentationNode = self.createSegmentationNode(3, 20, 60)
+    segmentation = segmentationNode.GetSegmentation()
+    displayNode = segmentationNode.GetDisplayNode()
+
+    self.logic.QueueSegmentConversions(segmentationNode)
+
+    # Segment converted on demand while it is queued is not converted again
+    onDemandSegment = segmentation.GetNthSegment(2)
+    onDemandClosedSurface = vtk.vtkPolyData()
+    onDemandSegment.AddRepresentation(self.closedSurfaceName, onDemandClosedSurface)
+
+    self.waitForSegmentConversions()
+
+    self.assertIs( onDemandSegment.GetRepresentation(self.closedSurfaceName), onDemandClosedSurface )
+    for segmentIndex in range(2):
+      segment = segmentation.GetNthSegment(segmentIndex)
+      closedSurface = segment.GetRepresentation(self.closedSurfaceName)
+      self.assertIsNotNone( closedSurface, 'No closed surface for segment ' + segment.GetName() )
+      self.assertTrue( self.arePolyDataEqual(closedSurface, self.convertOnDemand(segmentation, segment)),
+        'Closed surface of segment ' + segment.GetName() + ' differs from on-demand conversion' )
+
+    # Display is switched to closed surface once all segments are converted
+    self.assertEqual( displayNode.GetPreferredDisplayRepresentationName3D(), self.closedSurfaceName )
+    self.assertEqual( displayNode.GetPreferredDisplayRepresentationName2D(), self.closedSurfaceName )
+
+    # Segments that already have closed surface are not queued again
+    self.logic.QueueSegmentConversions(segmentationNode)
+    self.assertEqual( self.logic.ProcessSegmentConversionQueue(), 0 )
+
+  #------------------------------------------------------------------------------
+  def test_DicomRtLazySegmentConversion_CancelOnSceneClose(self):
+    segmentationNode = self.createSegmentationNode(20, 40, 400)
+    self.logic.QueueSegmentConversions(segmentationNode)
+    self.assertGreater( self.logic.ProcessSegmentConversionQueue(), 0 )
+
+    # Closing the scene waits for the segment being converted and drops the rest of the queue
+    slicer.mrmlScene.Clear(0)
+    self.assertEqual( self.logic.ProcessSegmentConversionQueue(), 0 )
+
+  #------------------------------------------------------------------------------
+  def createSegmentationNode(self, numberOfSegments, numberOfContours, numberOfPointsPerContour):
+    """Create segmentation with planar contour source representation. Each segment is a stack of ellipses.
+    """
+    segmentationNode = slicer.mrmlScene.AddNewNodeByClass('vtkMRMLSegmentationNode')
+    segmentationNode.CreateDefaultDisplayNodes()
+    segmentation = segmentationNode.GetSegmentation()
+    if hasattr(segmentation, 'SetSourceRepresentationName'):
+      segmentation.SetSourceRepresentationName(self.planarContourName)
+    else:
+      segmentation.SetMasterRepresentationName(self.planarContourName)
+
+    for segmentIndex in range(numberOfSegments):
+      points = vtk.vtkPoints()
+      lines = vtk.vtkCellArray()
+      for contourIndex in range(numberOfContours):
+        radius = 10.0 + 5.0 * math.sin(math.pi * contourIndex / numberOfContours)
+        lines.InsertNextCell(numberOfPointsPerContour + 1)
+        firstPointId = points.GetNumberOfPoints()
+        for pointIndex in range(numberOfPointsPerContour):
+          angle = 2.0 * math.pi * pointIndex / numberOfPointsPerContour
+          lines.InsertCellPoint(points.InsertNextPoint(40.0 * segmentIndex + 1.5 * radius * math.cos(angle),
+            radius * math.sin(angle), 2.5 * contourIndex))
+        lines.InsertCellPoint(firstPointId)
+      planarContours = vtk.vtkPolyData()
+      planarContours.SetPoints(points)
+      planarContours.SetLines(lines)
+
+      segment = slicer.vtkSegment()
+      segment.SetName('Segment_' + str(segmentIndex))
+      segment.AddRepresentation(self.planarContourName, planarContours)
+      segmentation.AddSegment(segment)
+
+    displayNode = segmentationNode.GetDisplayNode()
+    displayNode.SetPreferredDisplayRepresentationName3D(self.planarContourName)
+    displayNode.SetPreferredDisplayRepresentationName2D(self.planarContourName)
+    return segmentationNode
+
+  #------------------------------------------------------------------------------
+  def waitForSegmentConversions(self, timeoutSec=60.0):
+    startTime = time.time()
+    while self.logic.ProcessSegmentConversionQueue() > 0:
+      self.assertLess( time.time() - startTime, timeoutSec, 'Background segment conversion timed out' )
+      slicer.app.processEvents()
+      time.sleep(0.05)
+
+  #------------------------------------------------------------------------------
+  def convertOnDemand(self, segmentation, segment):
+    onDemandSegmentation = slicer.vtkSegmentation()
+    if hasattr(onDemandSegmentation, 'SetSourceRepresentationName'):
+      onDemandSegmentation.SetSourceRepresentationName(self.planarContourName)
+    else:
+      onDemandSegmentation.SetMasterRepresentationName(self.planarContourName)
+    onDemandSegmentation.CopyConversionParameters(segmentation)
+    onDemandSegment = slicer.vtkSegment()
+    onDemandSegment.AddRepresentation(self.planarContourName, segment.GetRepresentation(self.planarContourName))
+    onDemandSegmentation.AddSegment(onDemandSegment)
+    self.assertTrue( onDemandSegmentation.CreateRepresentation(self.closedSurfaceName) )
+    return onDemandSegment.GetRepresentation(self.closedSurfaceName)
+
+  #------------------------------------------------------------------------------
+  def arePolyDataEqual(self, polyData1, polyData2):
+    import numpy
+    from vtk.util.numpy_support import vtk_to_numpy
+    if polyData1.GetNumberOfPoints() != polyData2.GetNumberOfPoints() or polyData1.GetNumberOfPolys() != polyData2.GetNumberOfPolys():
+      return False
+    if polyData1.GetNumberOfPoints() == 0:
+      return True
+    return ( numpy.array_equal(vtk_to_numpy(polyData1.GetPoints().GetData()), vtk_to_numpy(polyData2.GetPoints().GetData()))
+      and numpy.array_equal(vtk_to_numpy(polyData1.GetPolys().GetData()), vtk_to_numpy(polyData2.GetPolys().GetData())) )
@@ -26,6 +26,7 @@
 
 // Qt includes
 #include <QDebug> 
+#include <QTimer>
 
 // Slicer includes
 #include <qSlicerCoreApplication.h>
@@ -53,6 +54,10 @@ class qSlicerDicomRtImportExportModulePrivate
 {
 public:
   qSlicerDicomRtImportExportModulePrivate();
+
+  /// Timer processing the background segment conversion queue of the logic while it is not empty.
+  /// Owned by the module so that it lives as long as the logic
+  QTimer* SegmentConversionTimer{nullptr};
 };
 
 //-----------------------------------------------------------------------------
@@ -115,14 +120,43 @@ void qSlicerDicomRtImportExportModule::setup()
 {
   this->Superclass::setup();
 
+  Q_D(qSlicerDicomRtImportExportModule);
+
   vtkSlicerDicomRtImportExportModuleLogic* dicomRtImportExportLogic = vtkSlicerDicomRtImportExportModuleLogic::SafeDownCast(this->logic());
-  Q_UNUSED(dicomRtImportExportLogic);
+
+  // Add the closed surfaces created in the background (lazy segment conversion) to the segments on the main thread
+  d->SegmentConversionTimer = new QTimer(this);
+  d->SegmentConversionTimer->setInterval(200);
+  connect(d->SegmentConversionTimer, SIGNAL(timeout()), this, SLOT(processSegmentConversionQueue()));
+  qvtkConnect(dicomRtImportExportLogic, vtkSlicerDicomRtImportExportModuleLogic::SegmentConversionsQueuedEvent,
+    this, SLOT(onSegmentConversionsQueued()));
 
   // Register Subject Hierarchy plugins
   qSlicerSubjectHierarchyPluginHandler::instance()->registerPlugin(new qSlicerSubjectHierarchyRtImagePlugin());
   qSlicerSubjectHierarchyPluginHandler::instance()->registerPlugin(new qSlicerSubjectHierarchyRtDoseVolumePlugin());
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerDicomRtImportExportModule::onSegmentConversionsQueued()
+{
+  Q_D(qSlicerDicomRtImportExportModule);
+  if (d->SegmentConversionTimer && !d->SegmentConversionTimer->isActive())
+  {
+    d->SegmentConversionTimer->start();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerDicomRtImportExportModule::processSegmentConversionQueue()
+{
+  Q_D(qSlicerDicomRtImportExportModule);
+  vtkSlicerDicomRtImportExportModuleLogic* dicomRtImportExportLogic = vtkSlicerDicomRtImportExportModuleLogic::SafeDownCast(this->logic());
+  if (!dicomRtImportExportLogic || dicomRtImportExportLogic->ProcessSegmentConversionQueue() == 0)
+  {
+    d->SegmentConversionTimer->stop();
+  }
+}
+
 //-----------------------------------------------------------------------------
 qSlicerAbstractModuleRepresentation * qSlicerDicomRtImportExportModule::createWidgetRepresentation()
 {
@@ -41,23 +41,127 @@
 #include <vtkMRMLSelectionNode.h>
 #include <vtkMRMLScene.h>
 
-// Slicer includes
-#include <vtkSlicerVolumesLogic.h>
-
 // VTK includes
 #include <vtkNew.h>
-#include <vtkImageMathematics.h>
 #include <vtkImageData.h>
 #include <vtkSmartPointer.h>
 #include <vtkImageReslice.h>
 #include <vtkGeneralTransform.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
 
 //----------------------------------------------------------------------------
 const std::string vtkSlicerDoseAccumulationModuleLogic::DOSEACCUMULATION_ATTRIBUTE_PREFIX = "DoseAccumulation.";
 const std::string vtkSlicerDoseAccumulationModuleLogic::DOSEACCUMULATION_DOSE_VOLUME_NODE_NAME_ATTRIBUTE_NAME = vtkSlicerDoseAccumulationModuleLogic::DOSEACCUMULATION_ATTRIBUTE_PREFIX + "DoseVolumeNodeName";
 const std::string vtkSlicerDoseAccumulationModuleLogic::DOSEACCUMULATION_OUTPUT_BASE_NAME_PREFIX = "Accumulated_";
 
+//----------------------------------------------------------------------------
+namespace
+{
+
+/// Input dose volume of the accumulation with its weight and sampling geometry
+struct WeightedDoseInput
+{
+  vtkSmartPointer<vtkImageData> ImageData;
+  double Weight{1.0};
+  /// Transform from reference IJK to input IJK coordinates
+  double ReferenceIjkToInputIjk[4][4];
+};
+
+//----------------------------------------------------------------------------
+/// Add weighted input dose to slices [kBegin,kEnd) of the accumulator.
+/// Uses nearest neighbor interpolation with the same rounding and border handling as vtkImageReslice
+template <class T>
+void AccumulateWeightedDoseSlices(const WeightedDoseInput& input, const T* inputScalars,
+  float* accumulator, const int referenceExtent[6], vtkIdType kBegin, vtkIdType kEnd)
+{
+  int inputExtent[6] = {0, -1, 0, -1, 0, -1};
+  input.ImageData->GetExtent(inputExtent);
+  vtkIdType inputIncrements[3] = {0, 0, 0};
+  input.ImageData->GetIncrements(inputIncrements);
+
+  // Points within half a voxel outside the input extent are clamped to the boundary voxels
+  double inputBounds[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    inputBounds[2*axis] = inputExtent[2*axis] - 0.5;
+    inputBounds[2*axis+1] = inputExtent[2*axis+1] + 0.5;
+  }
+
+  const double (*m)[4] = input.ReferenceIjkToInputIjk;
+  vtkIdType rowLength = referenceExtent[1] - referenceExtent[0] + 1;
+  vtkIdType sliceSize = rowLength * (referenceExtent[3] - referenceExtent[2] + 1);
+  for (vtkIdType k = kBegin; k < kEnd; ++k)
+  {
+    for (int j = referenceExtent[2]; j <= referenceExtent[3]; ++j)
+    {
+      float* outPtr = accumulator + (k - referenceExtent[4]) * sliceSize + (j - referenceExtent[2]) * rowLength;
+      // Input position of the first voxel of the row, then stepping along the row
+      double position[3] = {0.0, 0.0, 0.0};
+      for (int row = 0; row < 3; ++row)
+      {
+        position[row] = m[row][0] * referenceExtent[0] + m[row][1] * j + m[row][2] * k + m[row][3];
+      }
+      for (int i = referenceExtent[0]; i <= referenceExtent[1]; ++i, ++outPtr)
+      {
+        double x = position[0] + m[0][0] * (i - referenceExtent[0]);
+        double y = position[1] + m[1][0] * (i - referenceExtent[0]);
+        double z = position[2] + m[2][0] * (i - referenceExtent[0]);
+        if ( x < inputBounds[0] || x > inputBounds[1]
+          || y < inputBounds[2] || y > inputBounds[3]
+          || z < inputBounds[4] || z > inputBounds[5] )
+        {
+          continue;
+        }
+        int inputI = std::min(std::max(vtkMath::Floor(x + 0.5), inputExtent[0]), inputExtent[1]);
+        int inputJ = std::min(std::max(vtkMath::Floor(y + 0.5), inputExtent[2]), inputExtent[3]);
+        int inputK = std::min(std::max(vtkMath::Floor(z + 0.5), inputExtent[4]), inputExtent[5]);
+        const T* inPtr = inputScalars + (inputI - inputExtent[0]) * inputIncrements[0]
+          + (inputJ - inputExtent[2]) * inputIncrements[1] + (inputK - inputExtent[4]) * inputIncrements[2];
+        (*outPtr) += static_cast<float>(static_cast<double>(*inPtr) * input.Weight);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Accumulate all weighted input doses slice by slice in parallel.
+/// The inputs are added in the same order for every voxel, so the sum does not depend on the number of threads
+class WeightedDoseAccumulationFunctor
+{
+public:
+  WeightedDoseAccumulationFunctor(const std::vector<WeightedDoseInput>& inputs, vtkImageData* accumulatedImageData)
+    : Inputs(inputs)
+  {
+    accumulatedImageData->GetExtent(this->ReferenceExtent);
+    this->Accumulator = static_cast<float*>(accumulatedImageData->GetScalarPointer());
+  }
+
+  void operator()(vtkIdType kBegin, vtkIdType kEnd)
+  {
+    for (std::vector<WeightedDoseInput>::const_iterator inputIt = this->Inputs.begin(); inputIt != this->Inputs.end(); ++inputIt)
+    {
+      switch (inputIt->ImageData->GetScalarType())
+      {
+        vtkTemplateMacro(AccumulateWeightedDoseSlices<VTK_TT>(*inputIt, static_cast<const VTK_TT*>(inputIt->ImageData->GetScalarPointer()),
+          this->Accumulator, this->ReferenceExtent, kBegin, kEnd));
+      }
+    }
+  }
+
+private:
+  const std::vector<WeightedDoseInput>& Inputs;
+  float* Accumulator{nullptr};
+  int ReferenceExtent[6];
+};
+
+} // namespace
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerDoseAccumulationModuleLogic);
 
@@ -203,11 +307,20 @@ std::string vtkSlicerDoseAccumulationModuleLogic::AccumulateDoseVolumes(vtkMRMLD
   }
 
   // Get reference image info
-  int referenceDimensions[3] = {0, 0, 0};
-  referenceDoseVolumeNode->GetImageData()->GetDimensions(referenceDimensions);
+  vtkImageData* referenceImageData = referenceDoseVolumeNode->GetImageData();
+  if (!referenceImageData)
+  {
+    std::string errorMessage("No image data in reference volume");
+    vtkErrorMacro("AccumulateDoseVolumes: " << errorMessage);
+    return errorMessage;
+  }
+  int referenceExtent[6] = {0, -1, 0, -1, 0, -1};
+  referenceImageData->GetExtent(referenceExtent);
+  vtkNew<vtkMatrix4x4> referenceIjkToRasMatrix;
+  referenceDoseVolumeNode->GetIJKToRASMatrix(referenceIjkToRasMatrix);
 
-  // Apply weight and accumulate input dose volumes
-  vtkSmartPointer<vtkImageData> accumulatedImageData = vtkSmartPointer<vtkImageData>::New();
+  // Get the weight of each input dose volume and its mapping from the reference grid
+  std::vector<WeightedDoseInput> inputs(numberOfInputDoseVolumes);
   for (int inputVolumeIndex = 0; inputVolumeIndex<numberOfInputDoseVolumes; inputVolumeIndex++)
   {
     vtkMRMLScalarVolumeNode* currentInputDoseVolumeNode = parameterNode->GetNthSelectedInputVolumeNode(inputVolumeIndex);
@@ -218,41 +331,64 @@ std::string vtkSlicerDoseAccumulationModuleLogic::AccumulateDoseVolumes(vtkMRMLD
       vtkErrorMacro("AccumulateDoseVolumes: " << errorMessage.str());
       return errorMessage.str().c_str();
     }
+    WeightedDoseInput& input = inputs[inputVolumeIndex];
     std::map<std::string,double>* volumeNodeIdsToWeightsMap = parameterNode->GetVolumeNodeIdsToWeightsMap();
-    double currentWeight = (*volumeNodeIdsToWeightsMap)[currentInputDoseVolumeNode->GetID()];
-
-    vtkMRMLScalarVolumeNode* resampledInputDoseVolumeNode = 
-      vtkSlicerVolumesLogic::ResampleVolumeToReferenceVolume(currentInputDoseVolumeNode, referenceDoseVolumeNode);
-
-    // Apply weight
-    vtkSmartPointer<vtkImageMathematics> multiplyFilter = vtkSmartPointer<vtkImageMathematics>::New();
-    multiplyFilter->SetInputConnection(resampledInputDoseVolumeNode->GetImageDataConnection());
-    multiplyFilter->SetConstantK(currentWeight);
-    multiplyFilter->SetOperationToMultiplyByK();
-    multiplyFilter->Update();
-
-    // Add (accumulate) current input volume to the intermediate accumulated volume
-    if (inputVolumeIndex > 0)
+    input.Weight = (*volumeNodeIdsToWeightsMap)[currentInputDoseVolumeNode->GetID()];
+
+    // Get transformation from the reference volume to the input volume
+    vtkNew<vtkGeneralTransform> referenceToInputTransform;
+    vtkMRMLTransformNode::GetTransformBetweenNodes(referenceDoseVolumeNode->GetParentTransformNode(),
+      currentInputDoseVolumeNode->GetParentTransformNode(), referenceToInputTransform);
+    vtkNew<vtkMatrix4x4> inputRasToIjkMatrix;
+    currentInputDoseVolumeNode->GetRASToIJKMatrix(inputRasToIjkMatrix);
+
+    vtkNew<vtkMatrix4x4> referenceIjkToInputIjkMatrix;
+    vtkNew<vtkMatrix4x4> referenceToInputMatrix;
+    if (vtkMRMLTransformNode::IsGeneralTransformLinear(referenceToInputTransform, referenceToInputMatrix))
     {
-      vtkSmartPointer<vtkImageMathematics> addFilter = vtkSmartPointer<vtkImageMathematics>::New(); 
-      addFilter->SetInput1Data(accumulatedImageData);
-      addFilter->SetInput2Data(multiplyFilter->GetOutput());
-      addFilter->SetOperationToAdd();
-      addFilter->Update();
-
-      accumulatedImageData->DeepCopy(addFilter->GetOutput());
+      // Input is sampled on the fly
+      vtkMatrix4x4::Multiply4x4(referenceToInputMatrix, referenceIjkToRasMatrix, referenceIjkToInputIjkMatrix);
+      vtkMatrix4x4::Multiply4x4(inputRasToIjkMatrix, referenceIjkToInputIjkMatrix, referenceIjkToInputIjkMatrix);
+      input.ImageData = currentInputDoseVolumeNode->GetImageData();
     }
-    // If intermediate accumulated volume is empty (first iteration)
-    // then just copy the weighted input dose volume in it
     else
     {
-      accumulatedImageData->DeepCopy(multiplyFilter->GetOutput());
+      // Input is resampled to the reference grid if the transform is not linear (without adding a node to the scene)
+      vtkNew<vtkGeneralTransform> referenceIjkToInputIjkTransform;
+      referenceIjkToInputIjkTransform->PostMultiply();
+      referenceIjkToInputIjkTransform->Concatenate(referenceIjkToRasMatrix);
+      referenceIjkToInputIjkTransform->Concatenate(referenceToInputTransform);
+      referenceIjkToInputIjkTransform->Concatenate(inputRasToIjkMatrix);
+
+      vtkNew<vtkImageReslice> resliceFilter;
+      resliceFilter->SetInputData(currentInputDoseVolumeNode->GetImageData());
+      resliceFilter->SetOutputOrigin(0, 0, 0);
+      resliceFilter->SetOutputSpacing(1, 1, 1);
+      resliceFilter->SetOutputExtent(referenceExtent);
+      resliceFilter->SetResliceTransform(referenceIjkToInputIjkTransform);
+      resliceFilter->Update();
+      input.ImageData = resliceFilter->GetOutput();
+      referenceIjkToInputIjkMatrix->Identity();
+    }
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        input.ReferenceIjkToInputIjk[row][column] = referenceIjkToInputIjkMatrix->GetElement(row, column);
+      }
     }
-
-    // Remove the resample dose currentNode from scene and release the memory
-    this->GetMRMLScene()->RemoveNode(resampledInputDoseVolumeNode);
   }
 
+  // Apply weight and accumulate input dose volumes in one pass over the reference grid
+  vtkSmartPointer<vtkImageData> accumulatedImageData = vtkSmartPointer<vtkImageData>::New();
+  accumulatedImageData->SetExtent(referenceExtent);
+  accumulatedImageData->AllocateScalars(VTK_FLOAT, 1);
+  float* accumulator = static_cast<float*>(accumulatedImageData->GetScalarPointer());
+  std::fill(accumulator, accumulator + accumulatedImageData->GetNumberOfPoints(), 0.0f);
+
+  WeightedDoseAccumulationFunctor accumulationFunctor(inputs, accumulatedImageData);
+  vtkSMPTools::For(referenceExtent[4], referenceExtent[5] + 1, accumulationFunctor);
+
   // Create display currentNode for the accumulated volume
   vtkSmartPointer<vtkMRMLScalarVolumeDisplayNode> outputAccumulatedDoseVolumeDisplayNode = vtkSmartPointer<vtkMRMLScalarVolumeDisplayNode>::New();
   this->GetMRMLScene()->AddNode(outputAccumulatedDoseVolumeDisplayNode); 
@@ -50,7 +50,8 @@ public:
   vtkTypeMacro(vtkSlicerDoseAccumulationModuleLogic,vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent) override;
 
-  /// Accumulates dose volumes with the given IDs and corresponding weights
+  /// Accumulates dose volumes with the given IDs and corresponding weights.
+  /// The inputs are resampled to the reference dose volume on the fly and summed into a float volume in one multithreaded pass
   /// \return Error message on failure, nullptr otherwise
   std::string AccumulateDoseVolumes(vtkMRMLDoseAccumulationNode* parameterNode);
 
@@ -43,6 +43,9 @@
 #include <vtkImageAccumulate.h>
 #include <vtkMatrix4x4.h>
 #include <vtkImageMathematics.h>
+#include <vtkImageReslice.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
 
 // ITK includes
 #if ITK_VERSION_MAJOR > 3
@@ -50,6 +53,8 @@
 #endif
 
 // STD includes
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 // VTKSYS includes
@@ -217,7 +222,6 @@ int vtkSlicerDoseAccumulationModuleLogicTest1( int argc, char * argv[] )
   }
 
   // Subtract the dose volume from the accumulated volume and check if we get back the original dose volume
-  // TODO: Add test that dose the same thing using different weights
   vtkSmartPointer<vtkImageMathematics> math = vtkSmartPointer<vtkImageMathematics>::New();
   math->SetInput1Data(doseScalarVolumeNode->GetImageData());
   math->SetInput2Data(accumulatedDoseVolumeNode->GetImageData());
@@ -236,6 +240,88 @@ int vtkSlicerDoseAccumulationModuleLogicTest1( int argc, char * argv[] )
     return EXIT_FAILURE;
   }
 
+  // Accumulate with different weights and a shifted input, and compare the result with resampling and weighting
+  // each input volume separately then adding them up (the way the doses were accumulated before the single pass)
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> shiftedDoseVolumeNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+  shiftedDoseVolumeNode->SetName("ShiftedDose");
+  shiftedDoseVolumeNode->Copy(doseScalarVolumeNode);
+  double shiftedOrigin[3] = {0.0, 0.0, 0.0};
+  doseScalarVolumeNode->GetOrigin(shiftedOrigin);
+  shiftedOrigin[0] += 3.7;
+  shiftedOrigin[1] -= 1.2;
+  shiftedOrigin[2] += 5.1;
+  shiftedDoseVolumeNode->SetOrigin(shiftedOrigin);
+  mrmlScene->AddNode(shiftedDoseVolumeNode);
+
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> weightedOutputVolumeNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+  weightedOutputVolumeNode->SetName("WeightedOutputDose");
+  mrmlScene->AddNode(weightedOutputVolumeNode);
+
+  vtkSmartPointer<vtkMRMLDoseAccumulationNode> weightedParamNode = vtkSmartPointer<vtkMRMLDoseAccumulationNode>::New();
+  mrmlScene->AddNode(weightedParamNode);
+  weightedParamNode->AddSelectedInputVolumeNode(doseScalarVolumeNode, 0.3);
+  weightedParamNode->AddSelectedInputVolumeNode(shiftedDoseVolumeNode, 1.7);
+  weightedParamNode->SetAndObserveAccumulatedDoseVolumeNode(weightedOutputVolumeNode);
+  weightedParamNode->SetAndObserveReferenceDoseVolumeNode(doseScalarVolumeNode);
+
+  errorMessage = doseAccumulationLogic->AccumulateDoseVolumes(weightedParamNode);
+  if (!errorMessage.empty())
+  {
+    std::cerr << "ERROR: " << errorMessage << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkImageData* weightedImageData = weightedParamNode->GetAccumulatedDoseVolumeNode()->GetImageData();
+
+  int referenceExtent[6] = {0, -1, 0, -1, 0, -1};
+  doseScalarVolumeNode->GetImageData()->GetExtent(referenceExtent);
+  vtkNew<vtkMatrix4x4> referenceIjkToRasMatrix;
+  doseScalarVolumeNode->GetIJKToRASMatrix(referenceIjkToRasMatrix);
+  vtkNew<vtkImageData> perVolumeImageData;
+  perVolumeImageData->SetExtent(referenceExtent);
+  perVolumeImageData->AllocateScalars(VTK_DOUBLE, 1);
+  double* perVolumePtr = static_cast<double*>(perVolumeImageData->GetScalarPointer());
+  std::fill(perVolumePtr, perVolumePtr + perVolumeImageData->GetNumberOfPoints(), 0.0);
+  for (int inputVolumeIndex = 0; inputVolumeIndex < weightedParamNode->GetNumberOfSelectedInputVolumeNodes(); ++inputVolumeIndex)
+  {
+    vtkMRMLScalarVolumeNode* inputVolumeNode = weightedParamNode->GetNthSelectedInputVolumeNode(inputVolumeIndex);
+    double weight = (*weightedParamNode->GetVolumeNodeIdsToWeightsMap())[inputVolumeNode->GetID()];
+    vtkNew<vtkMatrix4x4> referenceIjkToInputIjkMatrix;
+    inputVolumeNode->GetRASToIJKMatrix(referenceIjkToInputIjkMatrix);
+    vtkMatrix4x4::Multiply4x4(referenceIjkToInputIjkMatrix, referenceIjkToRasMatrix, referenceIjkToInputIjkMatrix);
+
+    vtkNew<vtkImageReslice> resliceFilter;
+    resliceFilter->SetInputData(inputVolumeNode->GetImageData());
+    resliceFilter->SetOutputOrigin(0, 0, 0);
+    resliceFilter->SetOutputSpacing(1, 1, 1);
+    resliceFilter->SetOutputExtent(referenceExtent);
+    resliceFilter->SetResliceAxes(referenceIjkToInputIjkMatrix);
+    resliceFilter->SetOutputScalarType(VTK_DOUBLE);
+    resliceFilter->Update();
+    double* resampledPtr = static_cast<double*>(resliceFilter->GetOutput()->GetScalarPointer());
+    for (vtkIdType voxel = 0; voxel < perVolumeImageData->GetNumberOfPoints(); ++voxel)
+    {
+      perVolumePtr[voxel] += weight * resampledPtr[voxel];
+    }
+  }
+
+  // The single pass accumulates in float, so allow the rounding error of float
+  const double relativeTolerance = 1e-5;
+  if (!weightedImageData || weightedImageData->GetNumberOfPoints() != perVolumeImageData->GetNumberOfPoints())
+  {
+    std::cerr << "ERROR: Accumulated dose with different weights does not have the reference geometry" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (vtkIdType voxel = 0; voxel < perVolumeImageData->GetNumberOfPoints(); ++voxel)
+  {
+    double accumulatedValue = weightedImageData->GetPointData()->GetScalars()->GetTuple1(voxel);
+    if (std::fabs(accumulatedValue - perVolumePtr[voxel]) > relativeTolerance * std::max(1.0, std::fabs(perVolumePtr[voxel])))
+    {
+      std::cerr << "ERROR: Accumulated dose " << accumulatedValue << " differs from the sum of separately resampled doses "
+        << perVolumePtr[voxel] << " at voxel " << voxel << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,655 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkGammaDoseComparison.h"
+
+// Segmentations includes
+#include "vtkOrientedImageDataResample.h"
+
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkImageCast.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+namespace
+{
+
+/// Offset of a compare voxel from the reference voxel within the search radius
+struct GammaSearchOffset
+{
+  int Offset[3];
+  /// Offset in mm
+  double PositionMm[3];
+  /// Squared distance of the compare voxel in mm^2
+  double DistanceSquaredMm;
+  /// Lower bound of the squared distance of the compare points examined for this offset, in mm^2.
+  /// Equals DistanceSquaredMm, except for interpolated search where the segments to the neighbors are examined as well
+  double SearchDistanceSquaredMm;
+};
+
+/// Criterion parameters used in the search
+struct GammaSearchCriterion
+{
+  double DoseDifferenceTolerance{0.0};
+  double InverseDta{0.0};
+  double InverseDtaSquared{0.0};
+  float* Gamma{nullptr};
+};
+
+//----------------------------------------------------------------------------
+/// Image scalars with extent and increments for voxel lookups
+template <class T>
+struct GammaImageAccessor
+{
+  const T* Scalars{nullptr};
+  int Extent[6] = {0, -1, 0, -1, 0, -1};
+  vtkIdType Increments[3] = {0, 0, 0};
+
+  void Initialize(vtkImageData* imageData)
+  {
+    this->Scalars = static_cast<const T*>(imageData->GetScalarPointer());
+    imageData->GetExtent(this->Extent);
+    imageData->GetIncrements(this->Increments);
+  }
+  bool Contains(int i, int j, int k) const
+  {
+    return i >= this->Extent[0] && i <= this->Extent[1]
+      && j >= this->Extent[2] && j <= this->Extent[3]
+      && k >= this->Extent[4] && k <= this->Extent[5];
+  }
+  T GetValue(int i, int j, int k) const
+  {
+    return this->Scalars[ (i - this->Extent[0]) * this->Increments[0]
+      + (j - this->Extent[2]) * this->Increments[1] + (k - this->Extent[4]) * this->Increments[2] ];
+  }
+};
+
+//----------------------------------------------------------------------------
+/// Computes gamma of all criteria for the reference voxels of a range of slices
+class GammaFunctor
+{
+public:
+  GammaImageAccessor<float> Reference;
+  GammaImageAccessor<float> Compare;
+  GammaImageAccessor<unsigned char> Mask;
+  bool UseMask{false};
+  const std::vector<GammaSearchOffset>* Offsets{nullptr};
+  const std::vector<GammaSearchCriterion>* Criteria{nullptr};
+  /// Spacing, i.e. length of the segments to the next voxel along each axis, in mm
+  double AxisStepsMm[3] = {0.0, 0.0, 0.0};
+
+  double ReferenceDose{0.0};
+  double AnalysisThresholdDose{0.0};
+  bool ThresholdOnReferenceOnly{false};
+  double MaximumGamma{2.0};
+  bool LocalGamma{false};
+  bool InterpolatedSearch{false};
+
+  unsigned char* Analyzed{nullptr};
+  /// Number of slices completed by all threads, for progress reporting
+  std::atomic<int>* NumberOfCompletedSlices{nullptr};
+
+  void operator()(vtkIdType kBegin, vtkIdType kEnd) const
+  {
+    const int* extent = this->Reference.Extent;
+    vtkIdType rowLength = extent[1] - extent[0] + 1;
+    vtkIdType sliceSize = rowLength * (extent[3] - extent[2] + 1);
+    size_t numberOfCriteria = this->Criteria->size();
+    std::vector<double> inverseDoseTolerances(numberOfCriteria, 0.0);
+    std::vector<double> minimumGammaSquared(numberOfCriteria, 0.0);
+    for (int k = static_cast<int>(kBegin); k < static_cast<int>(kEnd); ++k)
+    {
+      for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+        vtkIdType outputIndex = (k - extent[4]) * sliceSize + (j - extent[2]) * rowLength;
+        for (int i = extent[0]; i <= extent[1]; ++i, ++outputIndex)
+        {
+          bool analyzed = this->ComputeVoxelGamma(i, j, k, inverseDoseTolerances.data(), minimumGammaSquared.data());
+          this->Analyzed[outputIndex] = (analyzed ? 1 : 0);
+          for (size_t criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+          {
+            (*this->Criteria)[criterionIndex].Gamma[outputIndex] = (analyzed ? static_cast<float>(sqrt(minimumGammaSquared[criterionIndex])) : 0.0f);
+          }
+        }
+      }
+      ++(*this->NumberOfCompletedSlices);
+    }
+  }
+
+  /// Get compare dose if the voxel is within the compare volume
+  bool GetCompareDose(int i, int j, int k, double& dose) const
+  {
+    if (!this->Compare.Contains(i, j, k))
+    {
+      return false;
+    }
+    dose = this->Compare.GetValue(i, j, k);
+    return true;
+  }
+
+  /// Compute squared gamma of a reference voxel for all criteria
+  /// \param inverseDoseTolerances Buffer for the inverse dose tolerances, one item per criterion
+  /// \param minimumGammaSquared Output squared gamma values, one item per criterion
+  /// \return False if the voxel is not analyzed
+  bool ComputeVoxelGamma(int i, int j, int k, double* inverseDoseTolerances, double* minimumGammaSquared) const
+  {
+    if (this->UseMask && (!this->Mask.Contains(i, j, k) || this->Mask.GetValue(i, j, k) == 0))
+    {
+      return false;
+    }
+    double referenceVoxelDose = this->Reference.GetValue(i, j, k);
+    if (referenceVoxelDose < this->AnalysisThresholdDose)
+    {
+      double compareVoxelDose = 0.0;
+      if ( this->ThresholdOnReferenceOnly || !this->GetCompareDose(i, j, k, compareVoxelDose)
+        || compareVoxelDose < this->AnalysisThresholdDose )
+      {
+        return false;
+      }
+    }
+
+    const std::vector<GammaSearchCriterion>& criteria = *this->Criteria;
+    size_t numberOfCriteria = criteria.size();
+    for (size_t criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+    {
+      double doseTolerance = criteria[criterionIndex].DoseDifferenceTolerance * (this->LocalGamma ? referenceVoxelDose : this->ReferenceDose);
+      if (doseTolerance <= 0.0)
+      {
+        doseTolerance = VTK_DBL_EPSILON;
+      }
+      inverseDoseTolerances[criterionIndex] = 1.0 / doseTolerance;
+      minimumGammaSquared[criterionIndex] = this->MaximumGamma * this->MaximumGamma;
+    }
+
+    // Offsets are sorted by distance, so the search for a criterion can stop when the distance term alone
+    // is not smaller than its current minimum. The search ends when all criteria have finished.
+    double nextDoses[3] = {0.0, 0.0, 0.0};
+    bool nextDoseValid[3] = {false, false, false};
+    for (std::vector<GammaSearchOffset>::const_iterator offsetIt = this->Offsets->begin(); offsetIt != this->Offsets->end(); ++offsetIt)
+    {
+      bool searching = false;
+      for (size_t criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+      {
+        if (offsetIt->SearchDistanceSquaredMm * criteria[criterionIndex].InverseDtaSquared < minimumGammaSquared[criterionIndex])
+        {
+          searching = true;
+          break;
+        }
+      }
+      if (!searching)
+      {
+        break;
+      }
+
+      int compareI = i + offsetIt->Offset[0];
+      int compareJ = j + offsetIt->Offset[1];
+      int compareK = k + offsetIt->Offset[2];
+      double compareDose = 0.0;
+      if (!this->GetCompareDose(compareI, compareJ, compareK, compareDose))
+      {
+        continue;
+      }
+      double doseDifference = compareDose - referenceVoxelDose;
+      if (this->InterpolatedSearch)
+      {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          nextDoseValid[axis] = this->GetCompareDose( compareI + (axis == 0 ? 1 : 0), compareJ + (axis == 1 ? 1 : 0),
+            compareK + (axis == 2 ? 1 : 0), nextDoses[axis] );
+        }
+      }
+
+      for (size_t criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+      {
+        const GammaSearchCriterion& criterion = criteria[criterionIndex];
+        double& criterionMinimumGammaSquared = minimumGammaSquared[criterionIndex];
+        if (offsetIt->SearchDistanceSquaredMm * criterion.InverseDtaSquared >= criterionMinimumGammaSquared)
+        {
+          continue;
+        }
+        double inverseDoseTolerance = inverseDoseTolerances[criterionIndex];
+        double normalizedDoseDifference = doseDifference * inverseDoseTolerance;
+        double gammaSquared = offsetIt->DistanceSquaredMm * criterion.InverseDtaSquared + normalizedDoseDifference * normalizedDoseDifference;
+        criterionMinimumGammaSquared = std::min(criterionMinimumGammaSquared, gammaSquared);
+
+        if (!this->InterpolatedSearch)
+        {
+          continue;
+        }
+        // Find the closest point to the origin on the segments to the next voxel along each axis
+        // in the space of normalized position and dose difference
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          if (!nextDoseValid[axis])
+          {
+            continue;
+          }
+          double segment[4] = {0.0, 0.0, 0.0, (nextDoses[axis] - compareDose) * inverseDoseTolerance};
+          segment[axis] = this->AxisStepsMm[axis] * criterion.InverseDta;
+          double start[4] = { offsetIt->PositionMm[0] * criterion.InverseDta, offsetIt->PositionMm[1] * criterion.InverseDta,
+            offsetIt->PositionMm[2] * criterion.InverseDta, normalizedDoseDifference };
+          double segmentLengthSquared = 0.0;
+          double startDotSegment = 0.0;
+          for (int component = 0; component < 4; ++component)
+          {
+            segmentLengthSquared += segment[component] * segment[component];
+            startDotSegment += start[component] * segment[component];
+          }
+          if (segmentLengthSquared <= 0.0)
+          {
+            continue;
+          }
+          double t = std::min(std::max(-startDotSegment / segmentLengthSquared, 0.0), 1.0);
+          double closestDistanceSquared = 0.0;
+          for (int component = 0; component < 4; ++component)
+          {
+            double closest = start[component] + t * segment[component];
+            closestDistanceSquared += closest * closest;
+          }
+          criterionMinimumGammaSquared = std::min(criterionMinimumGammaSquared, closestDistanceSquared);
+        }
+      }
+    }
+
+    return true;
+  }
+};
+
+} // namespace
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkGammaDoseComparison);
+
+//----------------------------------------------------------------------------
+vtkGammaDoseComparison::vtkGammaDoseComparison()
+{
+  this->ReferenceDoseVolume = nullptr;
+  this->CompareDoseVolume = nullptr;
+  this->MaskVolume = nullptr;
+
+  this->DtaDistanceToleranceMm = 3.0;
+  this->DoseDifferenceTolerance = 0.03;
+  this->ReferenceDose = 50.0;
+  this->UseMaximumDose = true;
+  this->AnalysisThreshold = 0.1;
+  this->ThresholdOnReferenceOnly = false;
+  this->MaximumGamma = 2.0;
+  this->LocalGamma = false;
+  this->InterpolatedSearch = true;
+
+  this->InitializeCriteria();
+}
+
+//----------------------------------------------------------------------------
+vtkGammaDoseComparison::~vtkGammaDoseComparison()
+{
+  this->SetReferenceDoseVolume(nullptr);
+  this->SetCompareDoseVolume(nullptr);
+  this->SetMaskVolume(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkGammaDoseComparison::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "DtaDistanceToleranceMm: " << this->DtaDistanceToleranceMm << "\n";
+  os << indent << "DoseDifferenceTolerance: " << this->DoseDifferenceTolerance << "\n";
+  os << indent << "ReferenceDose: " << this->ReferenceDose << "\n";
+  os << indent << "UseMaximumDose: " << (this->UseMaximumDose ? "true" : "false") << "\n";
+  os << indent << "AnalysisThreshold: " << this->AnalysisThreshold << "\n";
+  os << indent << "ThresholdOnReferenceOnly: " << (this->ThresholdOnReferenceOnly ? "true" : "false") << "\n";
+  os << indent << "MaximumGamma: " << this->MaximumGamma << "\n";
+  os << indent << "LocalGamma: " << (this->LocalGamma ? "true" : "false") << "\n";
+  os << indent << "InterpolatedSearch: " << (this->InterpolatedSearch ? "true" : "false") << "\n";
+  os << indent << "Criteria:\n";
+  for (std::vector<GammaCriterion>::iterator criterionIt = this->Criteria.begin(); criterionIt != this->Criteria.end(); ++criterionIt)
+  {
+    os << indent.GetNextIndent() << criterionIt->DoseDifferenceTolerance * 100.0 << "% / " << criterionIt->DtaDistanceToleranceMm
+      << " mm, PassFraction: " << criterionIt->PassFraction << "\n";
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkGammaDoseComparison::AddCriterion(double doseDifferenceTolerance, double dtaDistanceToleranceMm)
+{
+  this->AddedCriteria.push_back(std::make_pair(doseDifferenceTolerance, dtaDistanceToleranceMm));
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkGammaDoseComparison::RemoveAllCriteria()
+{
+  this->AddedCriteria.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkGammaDoseComparison::GetNumberOfCriteria()
+{
+  return (this->AddedCriteria.empty() ? 1 : static_cast<int>(this->AddedCriteria.size()));
+}
+
+//----------------------------------------------------------------------------
+vtkOrientedImageData* vtkGammaDoseComparison::GetOutputGammaVolume(int criterionIndex/*=0*/)
+{
+  if (criterionIndex < 0 || criterionIndex >= static_cast<int>(this->Criteria.size()))
+  {
+    vtkErrorMacro("GetOutputGammaVolume: Invalid criterion index " << criterionIndex);
+    return nullptr;
+  }
+  return this->Criteria[criterionIndex].OutputGammaVolume;
+}
+
+//----------------------------------------------------------------------------
+double vtkGammaDoseComparison::GetPassFraction(int criterionIndex/*=0*/)
+{
+  if (criterionIndex < 0 || criterionIndex >= static_cast<int>(this->Criteria.size()))
+  {
+    vtkErrorMacro("GetPassFraction: Invalid criterion index " << criterionIndex);
+    return 0.0;
+  }
+  return this->Criteria[criterionIndex].PassFraction;
+}
+
+//----------------------------------------------------------------------------
+void vtkGammaDoseComparison::InitializeCriteria()
+{
+  std::vector<std::pair<double, double> > criteriaParameters(this->AddedCriteria);
+  if (criteriaParameters.empty())
+  {
+    criteriaParameters.push_back(std::make_pair(this->DoseDifferenceTolerance, this->DtaDistanceToleranceMm));
+  }
+
+  this->Criteria.resize(criteriaParameters.size());
+  for (size_t criterionIndex = 0; criterionIndex < criteriaParameters.size(); ++criterionIndex)
+  {
+    GammaCriterion& criterion = this->Criteria[criterionIndex];
+    criterion.DoseDifferenceTolerance = criteriaParameters[criterionIndex].first;
+    criterion.DtaDistanceToleranceMm = criteriaParameters[criterionIndex].second;
+    if (!criterion.OutputGammaVolume)
+    {
+      criterion.OutputGammaVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+    }
+    criterion.PassFraction = 0.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkGammaDoseComparison::ComputeGamma()
+{
+  this->InitializeCriteria();
+  this->ReportString.clear();
+
+  if (!this->ReferenceDoseVolume || !this->CompareDoseVolume || !this->ReferenceDoseVolume->GetPointData()->GetScalars())
+  {
+    std::string errorMessage("Reference and compare dose volumes need to be set");
+    vtkErrorMacro("ComputeGamma: " << errorMessage);
+    return errorMessage;
+  }
+  double maximumDtaMm = 0.0;
+  for (std::vector<GammaCriterion>::iterator criterionIt = this->Criteria.begin(); criterionIt != this->Criteria.end(); ++criterionIt)
+  {
+    if (criterionIt->DtaDistanceToleranceMm <= 0.0 || criterionIt->DoseDifferenceTolerance <= 0.0)
+    {
+      std::string errorMessage("DTA tolerance and dose difference tolerance need to be positive");
+      vtkErrorMacro("ComputeGamma: " << errorMessage);
+      return errorMessage;
+    }
+    maximumDtaMm = std::max(maximumDtaMm, criterionIt->DtaDistanceToleranceMm);
+  }
+  if (this->MaximumGamma <= 0.0)
+  {
+    std::string errorMessage("Maximum gamma needs to be positive");
+    vtkErrorMacro("ComputeGamma: " << errorMessage);
+    return errorMessage;
+  }
+
+  // Get reference dose as float
+  vtkSmartPointer<vtkOrientedImageData> referenceDose = this->ReferenceDoseVolume;
+  if (referenceDose->GetScalarType() != VTK_FLOAT)
+  {
+    vtkNew<vtkImageCast> referenceCast;
+    referenceCast->SetInputData(this->ReferenceDoseVolume);
+    referenceCast->SetOutputScalarTypeToFloat();
+    referenceCast->Update();
+    referenceDose = vtkSmartPointer<vtkOrientedImageData>::New();
+    referenceDose->ShallowCopy(referenceCast->GetOutput());
+    referenceDose->CopyDirections(this->ReferenceDoseVolume);
+  }
+
+  // Resample compare dose to the reference geometry using linear interpolation
+  vtkSmartPointer<vtkOrientedImageData> compareDose = vtkSmartPointer<vtkOrientedImageData>::New();
+  if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+    this->CompareDoseVolume, referenceDose, compareDose, true ) )
+  {
+    std::string errorMessage("Failed to resample compare dose volume");
+    vtkErrorMacro("ComputeGamma: " << errorMessage);
+    return errorMessage;
+  }
+  if (compareDose->GetScalarType() != VTK_FLOAT)
+  {
+    vtkNew<vtkImageCast> compareCast;
+    compareCast->SetInputData(compareDose);
+    compareCast->SetOutputScalarTypeToFloat();
+    compareCast->Update();
+    compareDose->ShallowCopy(compareCast->GetOutput());
+  }
+
+  // Resample mask to the reference geometry using nearest neighbor interpolation
+  vtkSmartPointer<vtkOrientedImageData> mask;
+  if (this->MaskVolume)
+  {
+    mask = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(this->MaskVolume, referenceDose, mask, false))
+    {
+      std::string errorMessage("Failed to resample mask volume");
+      vtkErrorMacro("ComputeGamma: " << errorMessage);
+      return errorMessage;
+    }
+    if (mask->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+      vtkNew<vtkImageCast> maskCast;
+      maskCast->SetInputData(mask);
+      maskCast->SetOutputScalarTypeToUnsignedChar();
+      maskCast->Update();
+      mask->ShallowCopy(maskCast->GetOutput());
+    }
+  }
+
+  // Get reference dose
+  double referenceDoseValue = this->ReferenceDose;
+  if (this->UseMaximumDose)
+  {
+    double referenceRange[2] = {0.0, 0.0};
+    referenceDose->GetScalarRange(referenceRange);
+    referenceDoseValue = referenceRange[1];
+  }
+
+  // Search offsets within the maximum gamma times the largest DTA, sorted by distance.
+  // For interpolated search the segments from a voxel can get closer to the reference voxel by one voxel size
+  double spacing[3] = {1.0, 1.0, 1.0};
+  referenceDose->GetSpacing(spacing);
+  double maximumSpacing = std::max(spacing[0], std::max(spacing[1], spacing[2]));
+  double searchRadiusMm = this->MaximumGamma * maximumDtaMm + (this->InterpolatedSearch ? maximumSpacing : 0.0);
+  int searchRadiusVoxels[3] = {0, 0, 0};
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    searchRadiusVoxels[axis] = static_cast<int>(ceil(searchRadiusMm / spacing[axis]));
+  }
+  std::vector<GammaSearchOffset> offsets;
+  for (int k = -searchRadiusVoxels[2]; k <= searchRadiusVoxels[2]; ++k)
+  {
+    for (int j = -searchRadiusVoxels[1]; j <= searchRadiusVoxels[1]; ++j)
+    {
+      for (int i = -searchRadiusVoxels[0]; i <= searchRadiusVoxels[0]; ++i)
+      {
+        GammaSearchOffset offset;
+        offset.Offset[0] = i;
+        offset.Offset[1] = j;
+        offset.Offset[2] = k;
+        offset.DistanceSquaredMm = 0.0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          offset.PositionMm[axis] = offset.Offset[axis] * spacing[axis];
+          offset.DistanceSquaredMm += offset.PositionMm[axis] * offset.PositionMm[axis];
+        }
+        double distanceMm = sqrt(offset.DistanceSquaredMm);
+        if (distanceMm > searchRadiusMm)
+        {
+          continue;
+        }
+        offset.SearchDistanceSquaredMm = offset.DistanceSquaredMm;
+        if (this->InterpolatedSearch)
+        {
+          double searchDistanceMm = std::max(0.0, distanceMm - maximumSpacing);
+          offset.SearchDistanceSquaredMm = searchDistanceMm * searchDistanceMm;
+        }
+        offsets.push_back(offset);
+      }
+    }
+  }
+  std::stable_sort(offsets.begin(), offsets.end(),
+    [](const GammaSearchOffset& a, const GammaSearchOffset& b) { return a.SearchDistanceSquaredMm < b.SearchDistanceSquaredMm; });
+
+  // Allocate outputs
+  int extent[6] = {0, -1, 0, -1, 0, -1};
+  referenceDose->GetExtent(extent);
+  std::vector<GammaSearchCriterion> searchCriteria(this->Criteria.size());
+  for (size_t criterionIndex = 0; criterionIndex < this->Criteria.size(); ++criterionIndex)
+  {
+    vtkOrientedImageData* outputGammaVolume = this->Criteria[criterionIndex].OutputGammaVolume;
+    outputGammaVolume->Initialize();
+    outputGammaVolume->SetExtent(extent);
+    outputGammaVolume->SetOrigin(referenceDose->GetOrigin());
+    outputGammaVolume->SetSpacing(referenceDose->GetSpacing());
+    outputGammaVolume->CopyDirections(referenceDose);
+    outputGammaVolume->AllocateScalars(VTK_FLOAT, 1);
+
+    GammaSearchCriterion& searchCriterion = searchCriteria[criterionIndex];
+    searchCriterion.DoseDifferenceTolerance = this->Criteria[criterionIndex].DoseDifferenceTolerance;
+    searchCriterion.InverseDta = 1.0 / this->Criteria[criterionIndex].DtaDistanceToleranceMm;
+    searchCriterion.InverseDtaSquared = searchCriterion.InverseDta * searchCriterion.InverseDta;
+    searchCriterion.Gamma = static_cast<float*>(outputGammaVolume->GetScalarPointer());
+  }
+  vtkIdType numberOfVoxels = referenceDose->GetNumberOfPoints();
+  std::vector<unsigned char> analyzed(numberOfVoxels, 0);
+
+  GammaFunctor functor;
+  functor.Reference.Initialize(referenceDose);
+  functor.Compare.Initialize(compareDose);
+  if (mask)
+  {
+    functor.Mask.Initialize(mask);
+    functor.UseMask = true;
+  }
+  functor.Offsets = &offsets;
+  functor.Criteria = &searchCriteria;
+  referenceDose->GetSpacing(functor.AxisStepsMm);
+  functor.ReferenceDose = referenceDoseValue;
+  functor.AnalysisThresholdDose = this->AnalysisThreshold * referenceDoseValue;
+  functor.ThresholdOnReferenceOnly = this->ThresholdOnReferenceOnly;
+  functor.MaximumGamma = this->MaximumGamma;
+  functor.LocalGamma = this->LocalGamma;
+  functor.InterpolatedSearch = this->InterpolatedSearch;
+  functor.Analyzed = analyzed.data();
+  std::atomic<int> numberOfCompletedSlices{0};
+  functor.NumberOfCompletedSlices = &numberOfCompletedSlices;
+
+  // The slices are processed in a few sequential chunks, each in a parallel loop on the calling thread, so that
+  // progress is reported from the calling thread (the observers may update the GUI) between the chunks.
+  // Each chunk has several slices per thread, so that the threads stay busy until the end of the chunk.
+  const int numberOfProgressSteps = 10;
+  int numberOfSlices = extent[5] - extent[4] + 1;
+  int numberOfSlicesPerChunk = std::max(
+    (numberOfSlices + numberOfProgressSteps - 1) / numberOfProgressSteps, 4 * vtkSMPTools::GetEstimatedNumberOfThreads());
+  for (int chunkStartSlice = extent[4]; chunkStartSlice <= extent[5]; chunkStartSlice += numberOfSlicesPerChunk)
+  {
+    vtkSMPTools::For(chunkStartSlice, std::min(chunkStartSlice + numberOfSlicesPerChunk, extent[5] + 1), functor);
+    double progress = static_cast<double>(numberOfCompletedSlices) / numberOfSlices;
+    this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+  }
+
+  vtkIdType numberOfAnalyzedVoxels = 0;
+  for (vtkIdType voxelIndex = 0; voxelIndex < numberOfVoxels; ++voxelIndex)
+  {
+    numberOfAnalyzedVoxels += analyzed[voxelIndex];
+  }
+
+  std::ostringstream report;
+  report << "Reference dose: " << referenceDoseValue << (this->UseMaximumDose ? " (maximum dose)" : "") << "\n"
+    << "Dose difference: " << (this->LocalGamma ? "local" : "global") << "\n"
+    << "Analysis threshold: " << this->AnalysisThreshold * 100.0 << " % (" << functor.AnalysisThresholdDose << ")"
+    << (this->ThresholdOnReferenceOnly ? " on reference only" : "") << "\n"
+    << "Maximum gamma: " << this->MaximumGamma << "\n"
+    << "Interpolated search: " << (this->InterpolatedSearch ? "yes" : "no") << "\n"
+    << "Number of voxels analyzed: " << numberOfAnalyzedVoxels << "\n";
+
+  // Count passing voxels and assemble gamma histogram for each criterion
+  const int numberOfHistogramBins = 10;
+  for (size_t criterionIndex = 0; criterionIndex < this->Criteria.size(); ++criterionIndex)
+  {
+    GammaCriterion& criterion = this->Criteria[criterionIndex];
+    const float* gammaValues = searchCriteria[criterionIndex].Gamma;
+    std::vector<vtkIdType> histogram(numberOfHistogramBins, 0);
+    vtkIdType numberOfPassingVoxels = 0;
+    for (vtkIdType voxelIndex = 0; voxelIndex < numberOfVoxels; ++voxelIndex)
+    {
+      if (!analyzed[voxelIndex])
+      {
+        continue;
+      }
+      double gamma = gammaValues[voxelIndex];
+      if (gamma <= 1.0)
+      {
+        ++numberOfPassingVoxels;
+      }
+      int bin = std::min(static_cast<int>(gamma / this->MaximumGamma * numberOfHistogramBins), numberOfHistogramBins - 1);
+      ++histogram[bin];
+    }
+    criterion.PassFraction = (numberOfAnalyzedVoxels > 0 ? static_cast<double>(numberOfPassingVoxels) / numberOfAnalyzedVoxels : 0.0);
+
+    report << "Criterion " << criterion.DoseDifferenceTolerance * 100.0 << " % / " << criterion.DtaDistanceToleranceMm << " mm\n"
+      << "  Number of voxels passed: " << numberOfPassingVoxels << "\n"
+      << "  Pass rate: " << criterion.PassFraction * 100.0 << " %\n"
+      << "  Gamma histogram:\n";
+    for (int bin = 0; bin < numberOfHistogramBins; ++bin)
+    {
+      report << "    " << this->MaximumGamma * bin / numberOfHistogramBins << " - "
+        << this->MaximumGamma * (bin + 1) / numberOfHistogramBins << ": " << histogram[bin] << "\n";
+    }
+  }
+  this->ReportString = report.str();
+
+  return "";
+}
@@ -0,0 +1,171 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#ifndef __vtkGammaDoseComparison_h
+#define __vtkGammaDoseComparison_h
+
+// Segmentations includes
+#include "vtkOrientedImageData.h"
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerDoseComparisonModuleLogicExport.h"
+
+/// \ingroup SlicerRt_QtModules_DoseComparison
+/// \brief Gamma dose comparison computed on the voxels of the reference dose volume.
+///
+/// The compare dose volume is resampled to the reference geometry using linear interpolation.
+/// For each analyzed reference voxel the compare voxels are searched within MaximumGamma times the DTA
+/// in the order of increasing distance, and the search stops when the distance term alone exceeds the
+/// smallest gamma found so far. Reference voxels are processed in parallel.
+/// Multiple (dose difference, DTA) criteria can be evaluated in the same search, which then
+/// extends to the largest DTA, and one gamma volume and pass fraction is produced for each criterion.
+/// Progress is reported using vtkCommand::ProgressEvent.
+class VTK_SLICER_DOSECOMPARISON_LOGIC_EXPORT vtkGammaDoseComparison : public vtkObject
+{
+public:
+  static vtkGammaDoseComparison *New();
+  vtkTypeMacro(vtkGammaDoseComparison, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Compute gamma volume and pass fraction
+  /// \return Error message, empty string if no error
+  std::string ComputeGamma();
+
+  /// Reference dose volume. The gamma volume has the same geometry
+  vtkGetObjectMacro(ReferenceDoseVolume, vtkOrientedImageData);
+  vtkSetObjectMacro(ReferenceDoseVolume, vtkOrientedImageData);
+
+  /// Compare dose volume
+  vtkGetObjectMacro(CompareDoseVolume, vtkOrientedImageData);
+  vtkSetObjectMacro(CompareDoseVolume, vtkOrientedImageData);
+
+  /// Optional mask labelmap. Only voxels with nonzero mask value are analyzed
+  vtkGetObjectMacro(MaskVolume, vtkOrientedImageData);
+  vtkSetObjectMacro(MaskVolume, vtkOrientedImageData);
+
+  /// Output gamma volume of a criterion. The first criterion is used by default
+  vtkOrientedImageData* GetOutputGammaVolume(int criterionIndex=0);
+
+  /// Add (dose difference tolerance, DTA) criterion. Dose difference tolerance is a fraction of the reference dose.
+  /// If no criteria are added, then DoseDifferenceTolerance and DtaDistanceToleranceMm define the single criterion
+  void AddCriterion(double doseDifferenceTolerance, double dtaDistanceToleranceMm);
+  /// Remove all added criteria
+  void RemoveAllCriteria();
+  /// Get number of criteria evaluated by \sa ComputeGamma
+  int GetNumberOfCriteria();
+
+  /// Distance to agreement (DTA) tolerance, in mm
+  vtkGetMacro(DtaDistanceToleranceMm, double);
+  vtkSetMacro(DtaDistanceToleranceMm, double);
+
+  /// Dose difference tolerance as a fraction of the reference dose (0.03 for 3%)
+  vtkGetMacro(DoseDifferenceTolerance, double);
+  vtkSetMacro(DoseDifferenceTolerance, double);
+
+  /// Reference (prescription) dose. Only used if UseMaximumDose is off
+  vtkGetMacro(ReferenceDose, double);
+  vtkSetMacro(ReferenceDose, double);
+
+  /// Use the maximum of the reference dose volume as reference dose
+  vtkGetMacro(UseMaximumDose, bool);
+  vtkSetMacro(UseMaximumDose, bool);
+  vtkBooleanMacro(UseMaximumDose, bool);
+
+  /// Analysis threshold as a fraction of the reference dose. Voxels below it are not analyzed
+  vtkGetMacro(AnalysisThreshold, double);
+  vtkSetMacro(AnalysisThreshold, double);
+
+  /// Apply the analysis threshold only on the reference dose. If off, voxels are analyzed if either dose is above the threshold
+  vtkGetMacro(ThresholdOnReferenceOnly, bool);
+  vtkSetMacro(ThresholdOnReferenceOnly, bool);
+  vtkBooleanMacro(ThresholdOnReferenceOnly, bool);
+
+  /// Maximum gamma. Limits the search radius, and larger values are clamped
+  vtkGetMacro(MaximumGamma, double);
+  vtkSetMacro(MaximumGamma, double);
+
+  /// Use the reference voxel dose instead of the reference dose for the dose difference tolerance
+  vtkGetMacro(LocalGamma, bool);
+  vtkSetMacro(LocalGamma, bool);
+  vtkBooleanMacro(LocalGamma, bool);
+
+  /// Search the minimum gamma on the segments between neighboring compare voxels as well (Ju et al 2008), not only at the voxels
+  vtkGetMacro(InterpolatedSearch, bool);
+  vtkSetMacro(InterpolatedSearch, bool);
+  vtkBooleanMacro(InterpolatedSearch, bool);
+
+  /// Fraction of analyzed voxels with gamma not greater than 1 for a criterion (output)
+  double GetPassFraction(int criterionIndex=0);
+
+  /// Report listing the parameters, voxel counts, and gamma histogram (output)
+  std::string GetReportString() { return this->ReportString; };
+
+protected:
+  /// Gamma criterion with its outputs
+  struct GammaCriterion
+  {
+    double DoseDifferenceTolerance;
+    double DtaDistanceToleranceMm;
+    vtkSmartPointer<vtkOrientedImageData> OutputGammaVolume;
+    double PassFraction;
+  };
+
+  /// Set up criteria list used by the computation from the added criteria or the single criterion parameters
+  void InitializeCriteria();
+
+protected:
+  vtkOrientedImageData* ReferenceDoseVolume;
+  vtkOrientedImageData* CompareDoseVolume;
+  vtkOrientedImageData* MaskVolume;
+
+  /// Criteria added using \sa AddCriterion
+  std::vector<std::pair<double, double> > AddedCriteria;
+  /// Criteria evaluated in the last computation
+  std::vector<GammaCriterion> Criteria;
+
+  double DtaDistanceToleranceMm;
+  double DoseDifferenceTolerance;
+  double ReferenceDose;
+  bool UseMaximumDose;
+  double AnalysisThreshold;
+  bool ThresholdOnReferenceOnly;
+  double MaximumGamma;
+  bool LocalGamma;
+  bool InterpolatedSearch;
+
+  std::string ReportString;
+
+protected:
+  vtkGammaDoseComparison();
+  ~vtkGammaDoseComparison() override;
+
+private:
+  vtkGammaDoseComparison(const vtkGammaDoseComparison&) = delete;
+  void operator=(const vtkGammaDoseComparison&) = delete;
+};
+
+#endif
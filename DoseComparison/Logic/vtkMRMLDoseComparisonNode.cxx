@@ -38,6 +38,7 @@ static const char* REFERENCE_DOSE_VOLUME_REFERENCE_ROLE = "referenceDoseVolumeRe
 static const char* COMPARE_DOSE_VOLUME_REFERENCE_ROLE = "compareDoseVolumeRef";
 static const char* MASK_SEGMENTATION_REFERENCE_ROLE = "maskSegmentationRef";
 static const char* GAMMA_VOLUME_REFERENCE_ROLE = "outputGammaVolumeRef";
+static const char* GAMMA_CRITERION_VOLUME_REFERENCE_ROLE = "outputGammaCriterionVolumeRef";
 
 //------------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLDoseComparisonNode);
@@ -53,6 +54,7 @@ vtkMRMLDoseComparisonNode::vtkMRMLDoseComparisonNode()
   this->MaximumGamma = 2.0;
   this->UseMaximumDose = true;
   this->UseGeometricGammaCalculation = true;
+  this->UseNativeGammaEngine = false;
   this->DoseThresholdOnReferenceOnly = false;
   this->PassFractionPercent = -1.0;
   this->ResultsValid = false;
@@ -82,9 +84,18 @@ void vtkMRMLDoseComparisonNode::WriteXML(ostream& of, int nIndent)
   of << " MaximumGamma=\"" << this->MaximumGamma << "\"";
   of << " UseMaximumDose=\"" << (this->UseMaximumDose ? "true" : "false") << "\"";
   of << " UseGeometricGammaCalculation=\"" << (this->UseGeometricGammaCalculation ? "true" : "false") << "\"";
+  of << " UseNativeGammaEngine=\"" << (this->UseNativeGammaEngine ? "true" : "false") << "\"";
   of << " LocalDoseDifference=\"" << (this->LocalDoseDifference ? "true" : "false") << "\"";
   of << " DoseThresholdOnReferenceOnly=\"" << (this->DoseThresholdOnReferenceOnly ? "true" : "false") << "\"";
   of << " PassFractionPercent=\"" << this->PassFractionPercent << "\"";
+
+  of << " GammaCriteria=\"";
+  for (std::vector<GammaCriterion>::iterator criterionIt = this->GammaCriteria.begin(); criterionIt != this->GammaCriteria.end(); ++criterionIt)
+    {
+    of << (criterionIt != this->GammaCriteria.begin() ? ";" : "") << criterionIt->DoseDifferenceTolerancePercent
+      << " " << criterionIt->DtaDistanceToleranceMm << " " << criterionIt->PassFractionPercent;
+    }
+  of << "\"";
   of << " ResultsValid=\"" << (this->ResultsValid ? "true" : "false") << "\"";
   of << " ReportString=\"" << (this->ReportString ? this->ReportString : "") << "\"";
 }
@@ -135,6 +146,10 @@ void vtkMRMLDoseComparisonNode::ReadXMLAttributes(const char** atts)
       {
       this->UseGeometricGammaCalculation = (strcmp(attValue,"true") ? false : true);
       }
+    else if (!strcmp(attName, "UseNativeGammaEngine"))
+      {
+      this->UseNativeGammaEngine = (strcmp(attValue,"true") ? false : true);
+      }
     else if (!strcmp(attName, "LocalDoseDifference"))
       {
       this->LocalDoseDifference = (strcmp(attValue,"true") ? false : true);
@@ -147,6 +162,19 @@ void vtkMRMLDoseComparisonNode::ReadXMLAttributes(const char** atts)
       {
       this->PassFractionPercent = vtkVariant(attValue).ToDouble();
       }
+    else if (!strcmp(attName, "GammaCriteria"))
+      {
+      this->GammaCriteria.clear();
+      std::stringstream criteriaStream(attValue);
+      std::string criterionString;
+      while (std::getline(criteriaStream, criterionString, ';'))
+        {
+        GammaCriterion criterion = { 0.0, 0.0, -1.0 };
+        std::istringstream criterionStream(criterionString);
+        criterionStream >> criterion.DoseDifferenceTolerancePercent >> criterion.DtaDistanceToleranceMm >> criterion.PassFractionPercent;
+        this->GammaCriteria.push_back(criterion);
+        }
+      }
     else if (!strcmp(attName, "ResultsValid"))
       {
       this->ResultsValid = (strcmp(attValue,"true") ? false : true);
@@ -173,8 +201,10 @@ void vtkMRMLDoseComparisonNode::Copy(vtkMRMLNode *anode)
   this->AnalysisThresholdPercent = node->AnalysisThresholdPercent;
   this->MaximumGamma = node->MaximumGamma;
   this->PassFractionPercent = node->PassFractionPercent;
+  this->GammaCriteria = node->GammaCriteria;
   this->UseMaximumDose = node->UseMaximumDose;
   this->UseGeometricGammaCalculation = node->UseGeometricGammaCalculation;
+  this->UseNativeGammaEngine = node->UseNativeGammaEngine;
   this->LocalDoseDifference = node->LocalDoseDifference;
   this->DoseThresholdOnReferenceOnly = node->DoseThresholdOnReferenceOnly;
   this->ResultsValid = node->ResultsValid;
@@ -197,9 +227,16 @@ void vtkMRMLDoseComparisonNode::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "MaximumGamma:   " << this->MaximumGamma << "\n";
   os << indent << "UseMaximumDose:   " << (this->UseMaximumDose ? "true" : "false") << "\n";
   os << indent << "UseGeometricGammaCalculation:   " << (this->UseGeometricGammaCalculation ? "true" : "false") << "\n";
+  os << indent << "UseNativeGammaEngine:   " << (this->UseNativeGammaEngine ? "true" : "false") << "\n";
   os << indent << "LocalDoseDifference:   " << (this->LocalDoseDifference ? "true" : "false") << "\n";
   os << indent << "DoseThresholdOnReferenceOnly:   " << (this->DoseThresholdOnReferenceOnly ? "true" : "false") << "\n";
   os << indent << "PassFractionPercent:   " << this->PassFractionPercent << "\n";
+  os << indent << "GammaCriteria:\n";
+  for (std::vector<GammaCriterion>::iterator criterionIt = this->GammaCriteria.begin(); criterionIt != this->GammaCriteria.end(); ++criterionIt)
+    {
+    os << indent.GetNextIndent() << criterionIt->DoseDifferenceTolerancePercent << "% / " << criterionIt->DtaDistanceToleranceMm
+      << " mm, PassFractionPercent: " << criterionIt->PassFractionPercent << "\n";
+    }
   os << indent << "ResultsValid:   " << (this->ResultsValid ? "true" : "false") << "\n";
   os << indent << "ReportString:   " << (this->ReportString ? this->ReportString : "") << "\n";
 }
@@ -275,3 +312,91 @@ void vtkMRMLDoseComparisonNode::SetAndObserveGammaVolumeNode(vtkMRMLScalarVolume
 
   this->SetNodeReferenceID(GAMMA_VOLUME_REFERENCE_ROLE, (node ? node->GetID() : nullptr));
 }
+
+//----------------------------------------------------------------------------
+void vtkMRMLDoseComparisonNode::AddGammaCriterion(double doseDifferenceTolerancePercent, double dtaDistanceToleranceMm)
+{
+  GammaCriterion criterion = { doseDifferenceTolerancePercent, dtaDistanceToleranceMm, -1.0 };
+  this->GammaCriteria.push_back(criterion);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLDoseComparisonNode::RemoveAllGammaCriteria()
+{
+  this->GammaCriteria.clear();
+  this->RemoveNodeReferenceIDs(GAMMA_CRITERION_VOLUME_REFERENCE_ROLE);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLDoseComparisonNode::GetNumberOfGammaCriteria()
+{
+  return static_cast<int>(this->GammaCriteria.size());
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLDoseComparisonNode::GetGammaCriterionDoseDifferenceTolerancePercent(int criterionIndex)
+{
+  if (criterionIndex < 0 || criterionIndex >= this->GetNumberOfGammaCriteria())
+    {
+    vtkErrorMacro("GetGammaCriterionDoseDifferenceTolerancePercent: Invalid criterion index " << criterionIndex);
+    return 0.0;
+    }
+  return this->GammaCriteria[criterionIndex].DoseDifferenceTolerancePercent;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLDoseComparisonNode::GetGammaCriterionDtaDistanceToleranceMm(int criterionIndex)
+{
+  if (criterionIndex < 0 || criterionIndex >= this->GetNumberOfGammaCriteria())
+    {
+    vtkErrorMacro("GetGammaCriterionDtaDistanceToleranceMm: Invalid criterion index " << criterionIndex);
+    return 0.0;
+    }
+  return this->GammaCriteria[criterionIndex].DtaDistanceToleranceMm;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLDoseComparisonNode::GetGammaCriterionPassFractionPercent(int criterionIndex)
+{
+  if (criterionIndex < 0 || criterionIndex >= this->GetNumberOfGammaCriteria())
+    {
+    vtkErrorMacro("GetGammaCriterionPassFractionPercent: Invalid criterion index " << criterionIndex);
+    return -1.0;
+    }
+  return this->GammaCriteria[criterionIndex].PassFractionPercent;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLDoseComparisonNode::SetGammaCriterionPassFractionPercent(int criterionIndex, double passFractionPercent)
+{
+  if (criterionIndex < 0 || criterionIndex >= this->GetNumberOfGammaCriteria())
+    {
+    vtkErrorMacro("SetGammaCriterionPassFractionPercent: Invalid criterion index " << criterionIndex);
+    return;
+    }
+  if (this->GammaCriteria[criterionIndex].PassFractionPercent != passFractionPercent)
+    {
+    this->GammaCriteria[criterionIndex].PassFractionPercent = passFractionPercent;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkMRMLDoseComparisonNode::GetGammaCriterionVolumeNode(int criterionIndex)
+{
+  return vtkMRMLScalarVolumeNode::SafeDownCast( this->GetNthNodeReference(GAMMA_CRITERION_VOLUME_REFERENCE_ROLE, criterionIndex) );
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLDoseComparisonNode::SetAndObserveGammaCriterionVolumeNode(int criterionIndex, vtkMRMLScalarVolumeNode* node)
+{
+  if (node && this->Scene != node->GetScene())
+    {
+    vtkErrorMacro("Cannot set reference: the referenced and referencing node are not in the same scene");
+    return;
+    }
+
+  this->SetNthNodeReferenceID(GAMMA_CRITERION_VOLUME_REFERENCE_ROLE, criterionIndex, (node ? node->GetID() : nullptr));
+}
@@ -122,6 +122,13 @@ public:
   /// Set use geometric gamma calculation flag
   vtkBooleanMacro(UseGeometricGammaCalculation, bool);
 
+  /// Get use native gamma engine flag
+  vtkGetMacro(UseNativeGammaEngine, bool);
+  /// Set use native gamma engine flag
+  vtkSetMacro(UseNativeGammaEngine, bool);
+  /// Set use native gamma engine flag
+  vtkBooleanMacro(UseNativeGammaEngine, bool);
+
   /// Get dose threshold on reference flag
   vtkGetMacro(DoseThresholdOnReferenceOnly, bool);
   /// Set dose threshold on reference flag
@@ -153,12 +160,42 @@ public:
   /// Set report string
   vtkSetStringMacro(ReportString);
 
+  /// Add (dose difference tolerance, DTA) criterion for multi-criteria gamma evaluation.
+  /// If criteria are specified, then gamma is computed for all of them in a single search using the native gamma engine,
+  /// and the single criterion given by DtaDistanceToleranceMm and DoseDifferenceTolerancePercent is ignored.
+  void AddGammaCriterion(double doseDifferenceTolerancePercent, double dtaDistanceToleranceMm);
+  /// Remove all gamma criteria, and the references to their gamma volumes
+  void RemoveAllGammaCriteria();
+  /// Get number of gamma criteria. Zero if multi-criteria evaluation is not used
+  int GetNumberOfGammaCriteria();
+  /// Get dose difference tolerance of a gamma criterion in percent
+  double GetGammaCriterionDoseDifferenceTolerancePercent(int criterionIndex);
+  /// Get DTA tolerance of a gamma criterion in mm
+  double GetGammaCriterionDtaDistanceToleranceMm(int criterionIndex);
+  /// Get pass fraction of a gamma criterion in percent (output)
+  double GetGammaCriterionPassFractionPercent(int criterionIndex);
+  /// Set pass fraction of a gamma criterion in percent
+  void SetGammaCriterionPassFractionPercent(int criterionIndex, double passFractionPercent);
+  /// Get output gamma volume node of a gamma criterion
+  vtkMRMLScalarVolumeNode* GetGammaCriterionVolumeNode(int criterionIndex);
+  /// Set and observe output gamma volume node of a gamma criterion
+  void SetAndObserveGammaCriterionVolumeNode(int criterionIndex, vtkMRMLScalarVolumeNode* node);
+
 protected:
   vtkMRMLDoseComparisonNode();
   ~vtkMRMLDoseComparisonNode();
   vtkMRMLDoseComparisonNode(const vtkMRMLDoseComparisonNode&);
   void operator=(const vtkMRMLDoseComparisonNode&);
 
+protected:
+  /// Gamma criterion used in multi-criteria evaluation
+  struct GammaCriterion
+  {
+    double DoseDifferenceTolerancePercent;
+    double DtaDistanceToleranceMm;
+    double PassFractionPercent;
+  };
+
 protected:
   /// Mask segment ID in mask segmentation node
   char* MaskSegmentID;
@@ -193,6 +230,10 @@ protected:
   /// Default value is true. On false value nearest neighbor is used.
   bool UseGeometricGammaCalculation;
 
+  /// Flag determining whether the multithreaded gamma engine of the module (vtkGammaDoseComparison) is used
+  /// instead of the Plastimatch gamma dose comparison. Default value is false.
+  bool UseNativeGammaEngine;
+
   /// Flag determining whether local dose difference is used in the gamma calculation. Global if false (default).
   bool LocalDoseDifference;
 
@@ -200,9 +241,13 @@ protected:
   /// Default value is false, meaning that both images will be used
   bool DoseThresholdOnReferenceOnly;
 
-  /// Percentage of voxels that passed (output)
+  /// Percentage of voxels that passed (output).
+  /// In multi-criteria evaluation it is the pass fraction of the first criterion
   double PassFractionPercent;
 
+  /// Criteria for multi-criteria gamma evaluation. Empty if a single criterion is used
+  std::vector<GammaCriterion> GammaCriteria;
+
   /// Flag indicating if the results are valid
   bool ResultsValid;
 
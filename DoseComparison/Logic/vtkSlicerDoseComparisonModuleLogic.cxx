@@ -21,6 +21,7 @@
 // DoseComparison includes
 #include "vtkSlicerDoseComparisonModuleLogic.h"
 #include "vtkMRMLDoseComparisonNode.h"
+#include "vtkGammaDoseComparison.h"
 
 // SlicerRT includes
 #include "vtkSlicerRtCommon.h"
@@ -51,6 +52,7 @@
 #include <vtkSlicerSubjectHierarchyModuleLogic.h>
 
 // VTK includes
+#include <vtkCallbackCommand.h>
 #include <vtkNew.h>
 #include <vtkTimerLog.h>
 #include <vtkLookupTable.h>
@@ -64,6 +66,8 @@
 
 // STD includes
 #include <iostream>
+#include <sstream>
+#include <vector>
 
 //---------------------------------------------------------------------------
 const char* vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_GAMMA_VOLUME_IDENTIFIER_ATTRIBUTE_NAME = "DoseComparison.GammaVolume"; // Identifier
@@ -82,6 +86,17 @@ void GammaProgressCallback(float progress)
   }
 }
 
+//---------------------------------------------------------------------------
+void NativeGammaProgressCallback(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid), void* clientData, void* callData)
+{
+  vtkSlicerDoseComparisonModuleLogic* logic = reinterpret_cast<vtkSlicerDoseComparisonModuleLogic*>(clientData);
+  double* progress = reinterpret_cast<double*>(callData);
+  if (logic && progress)
+  {
+    logic->GammaProgressUpdated(static_cast<float>(*progress));
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerDoseComparisonModuleLogic);
 
@@ -205,10 +220,9 @@ std::string vtkSlicerDoseComparisonModuleLogic::ComputeGammaDoseDifference(vtkMR
 
   double checkpointConvertStart = timer->GetUniversalTime();
   vtkMRMLScalarVolumeNode* referenceDoseVolumeNode = parameterNode->GetReferenceDoseVolumeNode();
-  Plm_image::Pointer referenceDose = PlmCommon::ConvertVolumeNodeToPlmImage(referenceDoseVolumeNode);
-  Plm_image::Pointer compareDose = PlmCommon::ConvertVolumeNodeToPlmImage(parameterNode->GetCompareDoseVolumeNode());
+  vtkMRMLScalarVolumeNode* compareDoseVolumeNode = parameterNode->GetCompareDoseVolumeNode();
 
-  Plm_image::Pointer maskVolume;
+  vtkSmartPointer<vtkOrientedImageData> maskLabelmap;
   vtkMRMLSegmentationNode* maskSegmentationNode = parameterNode->GetMaskSegmentationNode();
   const char* maskSegmentID = parameterNode->GetMaskSegmentID();
   if (maskSegmentationNode && maskSegmentID)
@@ -257,86 +271,154 @@ std::string vtkSlicerDoseComparisonModuleLogic::ComputeGammaDoseDifference(vtkMR
       return errorMessage;
     }
 
-    // Convert mask to Plm image
-    maskVolume = PlmCommon::ConvertVtkOrientedImageDataToPlmImage(maskSegmentLabelmap);
-    if (!maskVolume)
-    {
-      std::string errorMessage("Failed to convert mask segment labelmap into Plm_image");
-      vtkErrorMacro("ComputeGammaDoseDifference: " << errorMessage);
-      return errorMessage;
-    }
-  }
-
-  // Compute gamma dose volume
-  double checkpointGammaStart = timer->GetUniversalTime();
-  Gamma_dose_comparison gamma;
-  gamma.set_reference_image(referenceDose->itk_float());
-  gamma.set_compare_image(compareDose->itk_float());
-  if (maskSegmentationNode && maskSegmentID)
-  {
-    gamma.set_mask_image(maskVolume->itk_uchar());
+    maskLabelmap = static_cast<vtkOrientedImageData*>(maskSegmentLabelmap);
   }
-  gamma.set_spatial_tolerance(parameterNode->GetDtaDistanceToleranceMm());
-  gamma.set_dose_difference_tolerance(parameterNode->GetDoseDifferenceTolerancePercent() / 100.0);
-  gamma.set_resample_nn(false); // Note: This used to be driven by the interpolation checkbox
-  gamma.set_interp_search(parameterNode->GetUseGeometricGammaCalculation());
-  gamma.set_local_gamma(parameterNode->GetLocalDoseDifference());
-  if (!parameterNode->GetUseMaximumDose())
-  {
-    gamma.set_reference_dose(parameterNode->GetReferenceDoseGy());
-  }
-  gamma.set_analysis_threshold(parameterNode->GetAnalysisThresholdPercent() / 100.0 );
-  gamma.set_gamma_max(parameterNode->GetMaximumGamma());
-  gamma.set_ref_only_threshold(parameterNode->GetDoseThresholdOnReferenceOnly());
-  gamma.set_progress_callback(&GammaProgressCallback);
-
-  gamma.run();
-
-  itk::Image<float, 3>::Pointer gammaVolumeItk = gamma.get_gamma_image_itk();
-  parameterNode->SetPassFractionPercent( gamma.get_pass_fraction() * 100.0 );
-  parameterNode->SetReportString(gamma.get_report_string().c_str());
-
-  // Convert output to VTK
-  double checkpointVtkConvertStart = timer->GetUniversalTime();
 
+  // In multi-criteria mode each criterion has its own gamma volume, which are created if not specified
+  int numberOfGammaCriteria = parameterNode->GetNumberOfGammaCriteria();
   vtkMRMLScalarVolumeNode* gammaVolumeNode = parameterNode->GetGammaVolumeNode();
-  if (gammaVolumeNode == nullptr)
+  if (numberOfGammaCriteria == 0 && gammaVolumeNode == nullptr)
   {
     std::string errorMessage("Invalid gamma volume node in parameter set node");
     vtkErrorMacro("ComputeGammaDoseDifference: " << errorMessage);
     return errorMessage;
   }
+  std::vector<vtkMRMLScalarVolumeNode*> outputGammaVolumeNodes;
 
-  vtkSlicerRtCommon::ConvertItkImageToVolumeNode<float>(gammaVolumeItk, gammaVolumeNode, VTK_FLOAT);
-  gammaVolumeNode->SetAttribute(vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_GAMMA_VOLUME_IDENTIFIER_ATTRIBUTE_NAME, "1");
-
-  // Set default colormap to red
-  if (gammaVolumeNode->GetVolumeDisplayNode() == nullptr)
-  {
-    vtkSmartPointer<vtkMRMLScalarVolumeDisplayNode> displayNode = vtkSmartPointer<vtkMRMLScalarVolumeDisplayNode>::New();
-    displayNode->SetScene(this->GetMRMLScene());
-    this->GetMRMLScene()->AddNode(displayNode);
-    gammaVolumeNode->SetAndObserveDisplayNodeID(displayNode->GetID());
-  }
-  if (gammaVolumeNode->GetVolumeDisplayNode())
+  double checkpointGammaStart = 0.0;
+  double checkpointVtkConvertStart = 0.0;
+  if (parameterNode->GetUseNativeGammaEngine() || numberOfGammaCriteria > 0)
   {
-    vtkMRMLScalarVolumeDisplayNode* gammaScalarVolumeDisplayNode = vtkMRMLScalarVolumeDisplayNode::SafeDownCast(gammaVolumeNode->GetVolumeDisplayNode());
-    gammaScalarVolumeDisplayNode->SetAutoWindowLevel(0);
-    gammaScalarVolumeDisplayNode->SetWindowLevelMinMax(0.0, parameterNode->GetMaximumGamma());
+    // Get dose volumes as oriented image data with transforms applied
+    vtkSmartPointer<vtkOrientedImageData> referenceDose = vtkSmartPointer<vtkOrientedImageData>::Take(
+      vtkSlicerSegmentationsModuleLogic::CreateOrientedImageDataFromVolumeNode(referenceDoseVolumeNode) );
+    vtkSmartPointer<vtkOrientedImageData> compareDose = vtkSmartPointer<vtkOrientedImageData>::Take(
+      vtkSlicerSegmentationsModuleLogic::CreateOrientedImageDataFromVolumeNode(compareDoseVolumeNode) );
+    if (!referenceDose || !compareDose)
+    {
+      std::string errorMessage("Failed to get image data from dose volumes");
+      vtkErrorMacro("ComputeGammaDoseDifference: " << errorMessage);
+      return errorMessage;
+    }
 
-    if (this->DefaultGammaColorTableNodeId)
+    // Compute gamma dose volume
+    checkpointGammaStart = timer->GetUniversalTime();
+    vtkNew<vtkGammaDoseComparison> gamma;
+    gamma->SetReferenceDoseVolume(referenceDose);
+    gamma->SetCompareDoseVolume(compareDose);
+    gamma->SetMaskVolume(maskLabelmap);
+    gamma->SetDtaDistanceToleranceMm(parameterNode->GetDtaDistanceToleranceMm());
+    gamma->SetDoseDifferenceTolerance(parameterNode->GetDoseDifferenceTolerancePercent() / 100.0);
+    gamma->SetInterpolatedSearch(parameterNode->GetUseGeometricGammaCalculation());
+    gamma->SetLocalGamma(parameterNode->GetLocalDoseDifference());
+    gamma->SetUseMaximumDose(parameterNode->GetUseMaximumDose());
+    gamma->SetReferenceDose(parameterNode->GetReferenceDoseGy());
+    gamma->SetAnalysisThreshold(parameterNode->GetAnalysisThresholdPercent() / 100.0);
+    gamma->SetMaximumGamma(parameterNode->GetMaximumGamma());
+    gamma->SetThresholdOnReferenceOnly(parameterNode->GetDoseThresholdOnReferenceOnly());
+    for (int criterionIndex = 0; criterionIndex < numberOfGammaCriteria; ++criterionIndex)
     {
-      gammaScalarVolumeDisplayNode->SetAndObserveColorNodeID(this->DefaultGammaColorTableNodeId);
+      gamma->AddCriterion( parameterNode->GetGammaCriterionDoseDifferenceTolerancePercent(criterionIndex) / 100.0,
+        parameterNode->GetGammaCriterionDtaDistanceToleranceMm(criterionIndex) );
     }
-    else
+    vtkNew<vtkCallbackCommand> progressCommand;
+    progressCommand->SetClientData(this);
+    progressCommand->SetCallback(NativeGammaProgressCallback);
+    gamma->AddObserver(vtkCommand::ProgressEvent, progressCommand);
+
+    std::string errorMessage = gamma->ComputeGamma();
+    if (!errorMessage.empty())
+    {
+      vtkErrorMacro("ComputeGammaDoseDifference: Gamma computation failed: " << errorMessage);
+      return errorMessage;
+    }
+    parameterNode->SetPassFractionPercent( gamma->GetPassFraction() * 100.0 );
+    parameterNode->SetReportString(gamma->GetReportString().c_str());
+
+    checkpointVtkConvertStart = timer->GetUniversalTime();
+    if (numberOfGammaCriteria == 0)
+    {
+      outputGammaVolumeNodes.push_back(gammaVolumeNode);
+    }
+    for (int criterionIndex = 0; criterionIndex < numberOfGammaCriteria; ++criterionIndex)
+    {
+      parameterNode->SetGammaCriterionPassFractionPercent(criterionIndex, gamma->GetPassFraction(criterionIndex) * 100.0);
+      vtkMRMLScalarVolumeNode* criterionGammaVolumeNode = parameterNode->GetGammaCriterionVolumeNode(criterionIndex);
+      if (!criterionGammaVolumeNode)
+      {
+        std::ostringstream nameStream;
+        nameStream << vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_OUTPUT_BASE_NAME_PREFIX
+          << (referenceDoseVolumeNode->GetName() ? referenceDoseVolumeNode->GetName() : "") << "_"
+          << parameterNode->GetGammaCriterionDoseDifferenceTolerancePercent(criterionIndex) << "%_"
+          << parameterNode->GetGammaCriterionDtaDistanceToleranceMm(criterionIndex) << "mm";
+        criterionGammaVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(
+          this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLScalarVolumeNode", nameStream.str()) );
+        parameterNode->SetAndObserveGammaCriterionVolumeNode(criterionIndex, criterionGammaVolumeNode);
+      }
+      outputGammaVolumeNodes.push_back(criterionGammaVolumeNode);
+    }
+    for (size_t outputIndex = 0; outputIndex < outputGammaVolumeNodes.size(); ++outputIndex)
     {
-      vtkWarningMacro("ComputeGammaDoseDifference: Loading gamma color table failed, stock color table is used!");
-      gammaScalarVolumeDisplayNode->SetAndObserveColorNodeID("vtkMRMLColorTableNodeRainbow");
+      if ( !vtkSlicerSegmentationsModuleLogic::CopyOrientedImageDataToVolumeNode(
+        gamma->GetOutputGammaVolume(static_cast<int>(outputIndex)), outputGammaVolumeNodes[outputIndex] ) )
+      {
+        errorMessage = "Failed to set gamma image to volume node";
+        vtkErrorMacro("ComputeGammaDoseDifference: " << errorMessage);
+        return errorMessage;
+      }
     }
   }
   else
   {
-    vtkWarningMacro("ComputeGammaDoseDifference: Display node is not available for gamma volume node. The default color table will be used.");
+    Plm_image::Pointer referenceDose = PlmCommon::ConvertVolumeNodeToPlmImage(referenceDoseVolumeNode);
+    Plm_image::Pointer compareDose = PlmCommon::ConvertVolumeNodeToPlmImage(compareDoseVolumeNode);
+
+    // Convert mask to Plm image
+    Plm_image::Pointer maskVolume;
+    if (maskLabelmap)
+    {
+      maskVolume = PlmCommon::ConvertVtkOrientedImageDataToPlmImage(maskLabelmap);
+      if (!maskVolume)
+      {
+        std::string errorMessage("Failed to convert mask segment labelmap into Plm_image");
+        vtkErrorMacro("ComputeGammaDoseDifference: " << errorMessage);
+        return errorMessage;
+      }
+    }
+
+    // Compute gamma dose volume
+    checkpointGammaStart = timer->GetUniversalTime();
+    Gamma_dose_comparison gamma;
+    gamma.set_reference_image(referenceDose->itk_float());
+    gamma.set_compare_image(compareDose->itk_float());
+    if (maskVolume)
+    {
+      gamma.set_mask_image(maskVolume->itk_uchar());
+    }
+    gamma.set_spatial_tolerance(parameterNode->GetDtaDistanceToleranceMm());
+    gamma.set_dose_difference_tolerance(parameterNode->GetDoseDifferenceTolerancePercent() / 100.0);
+    gamma.set_resample_nn(false); // Note: This used to be driven by the interpolation checkbox
+    gamma.set_interp_search(parameterNode->GetUseGeometricGammaCalculation());
+    gamma.set_local_gamma(parameterNode->GetLocalDoseDifference());
+    if (!parameterNode->GetUseMaximumDose())
+    {
+      gamma.set_reference_dose(parameterNode->GetReferenceDoseGy());
+    }
+    gamma.set_analysis_threshold(parameterNode->GetAnalysisThresholdPercent() / 100.0 );
+    gamma.set_gamma_max(parameterNode->GetMaximumGamma());
+    gamma.set_ref_only_threshold(parameterNode->GetDoseThresholdOnReferenceOnly());
+    gamma.set_progress_callback(&GammaProgressCallback);
+
+    gamma.run();
+
+    itk::Image<float, 3>::Pointer gammaVolumeItk = gamma.get_gamma_image_itk();
+    parameterNode->SetPassFractionPercent( gamma.get_pass_fraction() * 100.0 );
+    parameterNode->SetReportString(gamma.get_report_string().c_str());
+
+    // Convert output to VTK
+    checkpointVtkConvertStart = timer->GetUniversalTime();
+    vtkSlicerRtCommon::ConvertItkImageToVolumeNode<float>(gammaVolumeItk, gammaVolumeNode, VTK_FLOAT);
+    outputGammaVolumeNodes.push_back(gammaVolumeNode);
   }
 
   // Get common ancestor of the two input dose volumes in subject hierarchy
@@ -355,21 +437,57 @@ std::string vtkSlicerDoseComparisonModuleLogic::ComputeGammaDoseDifference(vtkMR
     commonAncestorItemID = shNode->GetSceneItemID();
   }
 
-  // Setup gamma volume subject hierarchy item
-  shNode->CreateItem(commonAncestorItemID, gammaVolumeNode);
+  for (std::vector<vtkMRMLScalarVolumeNode*>::iterator gammaVolumeNodeIt = outputGammaVolumeNodes.begin();
+    gammaVolumeNodeIt != outputGammaVolumeNodes.end(); ++gammaVolumeNodeIt)
+  {
+    vtkMRMLScalarVolumeNode* outputGammaVolumeNode = (*gammaVolumeNodeIt);
+    outputGammaVolumeNode->SetAttribute(vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_GAMMA_VOLUME_IDENTIFIER_ATTRIBUTE_NAME, "1");
 
-  // Add connection attribute to input dose volume nodes
-  gammaVolumeNode->AddNodeReferenceID( vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_REFERENCE_DOSE_VOLUME_REFERENCE_ROLE.c_str(),
-    parameterNode->GetReferenceDoseVolumeNode()->GetID() );
-  gammaVolumeNode->AddNodeReferenceID( vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_COMPARE_DOSE_VOLUME_REFERENCE_ROLE.c_str(),
-    parameterNode->GetCompareDoseVolumeNode()->GetID() );
+    // Set default colormap to red
+    if (outputGammaVolumeNode->GetVolumeDisplayNode() == nullptr)
+    {
+      vtkSmartPointer<vtkMRMLScalarVolumeDisplayNode> displayNode = vtkSmartPointer<vtkMRMLScalarVolumeDisplayNode>::New();
+      displayNode->SetScene(this->GetMRMLScene());
+      this->GetMRMLScene()->AddNode(displayNode);
+      outputGammaVolumeNode->SetAndObserveDisplayNodeID(displayNode->GetID());
+    }
+    if (outputGammaVolumeNode->GetVolumeDisplayNode())
+    {
+      vtkMRMLScalarVolumeDisplayNode* gammaScalarVolumeDisplayNode = vtkMRMLScalarVolumeDisplayNode::SafeDownCast(outputGammaVolumeNode->GetVolumeDisplayNode());
+      gammaScalarVolumeDisplayNode->SetAutoWindowLevel(0);
+      gammaScalarVolumeDisplayNode->SetWindowLevelMinMax(0.0, parameterNode->GetMaximumGamma());
+
+      if (this->DefaultGammaColorTableNodeId)
+      {
+        gammaScalarVolumeDisplayNode->SetAndObserveColorNodeID(this->DefaultGammaColorTableNodeId);
+      }
+      else
+      {
+        vtkWarningMacro("ComputeGammaDoseDifference: Loading gamma color table failed, stock color table is used!");
+        gammaScalarVolumeDisplayNode->SetAndObserveColorNodeID("vtkMRMLColorTableNodeRainbow");
+      }
+    }
+    else
+    {
+      vtkWarningMacro("ComputeGammaDoseDifference: Display node is not available for gamma volume node. The default color table will be used.");
+    }
+
+    // Setup gamma volume subject hierarchy item
+    shNode->CreateItem(commonAncestorItemID, outputGammaVolumeNode);
+
+    // Add connection attribute to input dose volume nodes
+    outputGammaVolumeNode->AddNodeReferenceID( vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_REFERENCE_DOSE_VOLUME_REFERENCE_ROLE.c_str(),
+      parameterNode->GetReferenceDoseVolumeNode()->GetID() );
+    outputGammaVolumeNode->AddNodeReferenceID( vtkSlicerDoseComparisonModuleLogic::DOSECOMPARISON_COMPARE_DOSE_VOLUME_REFERENCE_ROLE.c_str(),
+      parameterNode->GetCompareDoseVolumeNode()->GetID() );
+  }
 
-  // Select as active volume
-  if (this->GetApplicationLogic()!=nullptr)
+  // Select first gamma volume as active volume
+  if (this->GetApplicationLogic()!=nullptr && !outputGammaVolumeNodes.empty())
   {
     if (this->GetApplicationLogic()->GetSelectionNode()!=nullptr)
     {
-      this->GetApplicationLogic()->GetSelectionNode()->SetReferenceActiveVolumeID(gammaVolumeNode->GetID());
+      this->GetApplicationLogic()->GetSelectionNode()->SetReferenceActiveVolumeID(outputGammaVolumeNodes[0]->GetID());
       this->GetApplicationLogic()->PropagateVolumeSelection();
     }
   }
@@ -36,16 +36,151 @@
 #include <vtkImageData.h>
 #include <vtkMatrix4x4.h>
 #include <vtkImageMathematics.h>
+#include <vtkVariant.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
 
 // ITK includes
 #include "itkFactoryRegistration.h"
 
 // STD includes
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 // VTKSYS includes
 #include <vtksys/SystemTools.hxx>
 
+namespace
+{
+  //-----------------------------------------------------------------------------
+  /// Get the largest absolute difference of two gamma volumes, or -1 if their dimensions differ
+  double GetMaximumGammaDifference(vtkImageData* gamma1, vtkImageData* gamma2)
+  {
+    if (!gamma1 || !gamma2 || gamma1->GetNumberOfPoints() != gamma2->GetNumberOfPoints())
+    {
+      return -1.0;
+    }
+    double maximumDifference = 0.0;
+    for (vtkIdType voxel = 0; voxel < gamma1->GetNumberOfPoints(); ++voxel)
+    {
+      double difference = std::fabs(gamma1->GetPointData()->GetScalars()->GetTuple1(voxel) - gamma2->GetPointData()->GetScalars()->GetTuple1(voxel));
+      maximumDifference = std::max(maximumDifference, difference);
+    }
+    return maximumDifference;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Evaluate multiple criteria in one pass, and compare the gamma volumes and pass rates with evaluating each criterion separately
+  bool TestMultipleGammaCriteria(vtkSlicerDoseComparisonModuleLogic* doseComparisonLogic, vtkMRMLDoseComparisonNode* paramNode, std::ostream& errorStream)
+  {
+    const double criteria[3][2] = { {3.0, 3.0}, {2.0, 2.0}, {1.0, 1.0} };
+    const int numberOfCriteria = 3;
+
+    paramNode->RemoveAllGammaCriteria();
+    for (int criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+    {
+      paramNode->AddGammaCriterion(criteria[criterionIndex][0], criteria[criterionIndex][1]);
+    }
+    std::string errorMessage = doseComparisonLogic->ComputeGammaDoseDifference(paramNode);
+    if (!errorMessage.empty())
+    {
+      errorStream << "ERROR: Multi-criteria gamma computation failed: " << errorMessage << std::endl;
+      return false;
+    }
+    std::vector<vtkSmartPointer<vtkImageData> > multiCriteriaGammaVolumes;
+    std::vector<double> multiCriteriaPassFractions;
+    for (int criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+    {
+      vtkMRMLScalarVolumeNode* criterionGammaVolumeNode = paramNode->GetGammaCriterionVolumeNode(criterionIndex);
+      if (!criterionGammaVolumeNode || !criterionGammaVolumeNode->GetImageData())
+      {
+        errorStream << "ERROR: No gamma volume for criterion " << criterionIndex << std::endl;
+        return false;
+      }
+      vtkSmartPointer<vtkImageData> gammaVolume = vtkSmartPointer<vtkImageData>::New();
+      gammaVolume->DeepCopy(criterionGammaVolumeNode->GetImageData());
+      multiCriteriaGammaVolumes.push_back(gammaVolume);
+      multiCriteriaPassFractions.push_back(paramNode->GetGammaCriterionPassFractionPercent(criterionIndex));
+    }
+
+    paramNode->RemoveAllGammaCriteria();
+    for (int criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+    {
+      paramNode->SetDoseDifferenceTolerancePercent(criteria[criterionIndex][0]);
+      paramNode->SetDtaDistanceToleranceMm(criteria[criterionIndex][1]);
+      errorMessage = doseComparisonLogic->ComputeGammaDoseDifference(paramNode);
+      if (!errorMessage.empty())
+      {
+        errorStream << "ERROR: Single criterion gamma computation failed: " << errorMessage << std::endl;
+        return false;
+      }
+      double maximumDifference = GetMaximumGammaDifference(paramNode->GetGammaVolumeNode()->GetImageData(), multiCriteriaGammaVolumes[criterionIndex]);
+      if (maximumDifference < 0.0 || maximumDifference > 1e-6)
+      {
+        errorStream << "ERROR: Gamma volume of criterion " << criteria[criterionIndex][0] << "% / " << criteria[criterionIndex][1]
+          << " mm differs between multi-criteria and single criterion computation by " << maximumDifference << std::endl;
+        return false;
+      }
+      if (paramNode->GetPassFractionPercent() != multiCriteriaPassFractions[criterionIndex])
+      {
+        errorStream << "ERROR: Pass rate of criterion " << criteria[criterionIndex][0] << "% / " << criteria[criterionIndex][1]
+          << " mm is " << multiCriteriaPassFractions[criterionIndex] << " in multi-criteria computation instead of "
+          << paramNode->GetPassFractionPercent() << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Save gamma criteria with their pass rates in a scene and read them back
+  bool TestGammaCriteriaSerialization(std::ostream& errorStream)
+  {
+    const double criteria[3][3] = { {3.0, 3.0, 97.25}, {2.0, 1.5, 88.5}, {1.0, 1.0, -1.0} };
+    const int numberOfCriteria = 3;
+
+    vtkSmartPointer<vtkMRMLScene> scene = vtkSmartPointer<vtkMRMLScene>::New();
+    vtkSmartPointer<vtkMRMLDoseComparisonNode> paramNode = vtkSmartPointer<vtkMRMLDoseComparisonNode>::New();
+    scene->AddNode(paramNode);
+    for (int criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+    {
+      paramNode->AddGammaCriterion(criteria[criterionIndex][0], criteria[criterionIndex][1]);
+      paramNode->SetGammaCriterionPassFractionPercent(criterionIndex, criteria[criterionIndex][2]);
+    }
+    scene->SetSaveToXMLString(1);
+    scene->Commit();
+
+    vtkSmartPointer<vtkMRMLScene> loadedScene = vtkSmartPointer<vtkMRMLScene>::New();
+    loadedScene->RegisterNodeClass(vtkSmartPointer<vtkMRMLDoseComparisonNode>::New());
+    loadedScene->SetLoadFromXMLString(1);
+    loadedScene->SetSceneXMLString(scene->GetSceneXMLString());
+    loadedScene->Import();
+    vtkMRMLDoseComparisonNode* loadedParamNode = vtkMRMLDoseComparisonNode::SafeDownCast(
+      loadedScene->GetFirstNodeByClass("vtkMRMLDoseComparisonNode") );
+    if (!loadedParamNode || loadedParamNode->GetNumberOfGammaCriteria() != numberOfCriteria)
+    {
+      errorStream << "ERROR: Gamma criteria were not read back from the scene" << std::endl;
+      return false;
+    }
+    for (int criterionIndex = 0; criterionIndex < numberOfCriteria; ++criterionIndex)
+    {
+      if ( loadedParamNode->GetGammaCriterionDoseDifferenceTolerancePercent(criterionIndex) != criteria[criterionIndex][0]
+        || loadedParamNode->GetGammaCriterionDtaDistanceToleranceMm(criterionIndex) != criteria[criterionIndex][1]
+        || loadedParamNode->GetGammaCriterionPassFractionPercent(criterionIndex) != criteria[criterionIndex][2] )
+      {
+        errorStream << "ERROR: Gamma criterion " << criterionIndex << " read back as "
+          << loadedParamNode->GetGammaCriterionDoseDifferenceTolerancePercent(criterionIndex) << " "
+          << loadedParamNode->GetGammaCriterionDtaDistanceToleranceMm(criterionIndex) << " "
+          << loadedParamNode->GetGammaCriterionPassFractionPercent(criterionIndex) << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
 //-----------------------------------------------------------------------------
 int vtkSlicerDoseComparisonModuleLogicTest1( int argc, char * argv[] )
 {
@@ -53,6 +188,36 @@ int vtkSlicerDoseComparisonModuleLogicTest1( int argc, char * argv[] )
   std::ostream& outputStream = std::cout;
   std::ostream& errorStream = std::cerr;
 
+  // UseNativeGammaEngine, UseGeometricGammaCalculation and GammaTolerance (optional)
+  bool useNativeGammaEngine = false;
+  bool useGeometricGammaCalculation = false;
+  double gammaTolerance = 0.0;
+  while (argc > argIndex)
+  {
+    if (STRCASECMP(argv[argIndex], "-UseNativeGammaEngine") == 0)
+    {
+      useNativeGammaEngine = true;
+      outputStream << "Use native gamma engine" << std::endl;
+      argIndex += 1;
+    }
+    else if (STRCASECMP(argv[argIndex], "-UseGeometricGammaCalculation") == 0)
+    {
+      useGeometricGammaCalculation = true;
+      outputStream << "Use geometric gamma calculation" << std::endl;
+      argIndex += 1;
+    }
+    else if (argc > argIndex+1 && STRCASECMP(argv[argIndex], "-GammaTolerance") == 0)
+    {
+      gammaTolerance = vtkVariant(argv[argIndex+1]).ToDouble();
+      outputStream << "Gamma tolerance: " << gammaTolerance << std::endl;
+      argIndex += 2;
+    }
+    else
+    {
+      break;
+    }
+  }
+
   // TestSceneFile
   const char *testSceneFileName  = nullptr;
   if (argc > argIndex+1)
@@ -146,7 +311,8 @@ int vtkSlicerDoseComparisonModuleLogicTest1( int argc, char * argv[] )
   paramNode->SetAndObserveReferenceDoseVolumeNode(day1DoseScalarVolumeNode);
   paramNode->SetAndObserveCompareDoseVolumeNode(day2DoseScalarVolumeNode);
   paramNode->SetAndObserveGammaVolumeNode(outputGammaVolumeNode);
-  paramNode->SetUseGeometricGammaCalculation(false);
+  paramNode->SetUseGeometricGammaCalculation(useGeometricGammaCalculation);
+  paramNode->SetUseNativeGammaEngine(useNativeGammaEngine);
 
   // Disable symmetric dose threshold (it is the new default)
   paramNode->SetDoseThresholdOnReferenceOnly(true);
@@ -181,7 +347,28 @@ int vtkSlicerDoseComparisonModuleLogicTest1( int argc, char * argv[] )
   vtkImageData* comparison = math->GetOutput();
   double range[2];
   comparison->GetScalarRange(range);
-  if (range[0] != 0.0 || range[1] != 0.0)
+  if (useGeometricGammaCalculation)
+  {
+    // The baseline is computed without geometric calculation. Searching the interpolated compare dose
+    // can only find closer points, so the gamma cannot be larger than the baseline
+    if (range[1] > gammaTolerance)
+    {
+      errorStream << "ERROR: Geometric gamma is larger than the baseline! Difference range: " << range[0] << " - " << range[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  else if (range[0] < -gammaTolerance || range[1] > gammaTolerance)
+  {
+    errorStream << "ERROR: Gamma volume differs from baseline! Difference range: " << range[0] << " - " << range[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Multiple criteria are only supported by the native gamma engine
+  if (useNativeGammaEngine && !TestMultipleGammaCriteria(doseComparisonLogic, paramNode, errorStream))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestGammaCriteriaSerialization(errorStream))
   {
     return EXIT_FAILURE;
   }
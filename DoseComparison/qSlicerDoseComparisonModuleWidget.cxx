@@ -257,6 +257,7 @@ void qSlicerDoseComparisonModuleWidget::updateWidgetFromMRML()
     d->doubleSpinBox_AnalysisThreshold->setValue(paramNode->GetAnalysisThresholdPercent());
     d->checkBox_GeometricGammaCalculation->setChecked(paramNode->GetUseGeometricGammaCalculation());
     d->checkBox_Local->setChecked(paramNode->GetLocalDoseDifference());
+    d->checkBox_NativeGammaEngine->setChecked(paramNode->GetUseNativeGammaEngine());
     d->doubleSpinBox_MaximumGamma->setValue(paramNode->GetMaximumGamma());
     if (paramNode->GetUseMaximumDose())
     {
@@ -297,6 +298,7 @@ void qSlicerDoseComparisonModuleWidget::setup()
   connect( d->doubleSpinBox_AnalysisThreshold, SIGNAL(valueChanged(double)), this, SLOT(analysisThresholdChanged(double)) );
   connect( d->checkBox_GeometricGammaCalculation, SIGNAL(stateChanged(int)), this, SLOT(geometricGammaCalculationCheckedStateChanged(int)) );
   connect( d->checkBox_Local, SIGNAL(stateChanged(int)), this, SLOT(localDoseDifferenceCheckedStateChanged(int)) );
+  connect( d->checkBox_NativeGammaEngine, SIGNAL(stateChanged(int)), this, SLOT(nativeGammaEngineCheckedStateChanged(int)) );
   connect( d->doubleSpinBox_MaximumGamma, SIGNAL(valueChanged(double)), this, SLOT(maximumGammaChanged(double)) );
   connect( d->radioButton_ReferenceDose_MaximumDose, SIGNAL(toggled(bool)), this, SLOT(referenceDoseUseMaximumDoseChanged(bool)) );
   connect( d->checkBox_ThresholdReferenceOnly, SIGNAL(stateChanged(int)), this, SLOT(doseThresholdOnReferenceOnlyCheckedStateChanged(int)) );
@@ -626,6 +628,30 @@ void qSlicerDoseComparisonModuleWidget::localDoseDifferenceCheckedStateChanged(i
   this->invalidateResults();
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerDoseComparisonModuleWidget::nativeGammaEngineCheckedStateChanged(int state)
+{
+  Q_D(qSlicerDoseComparisonModuleWidget);
+
+  if (!this->mrmlScene())
+  {
+    qCritical() << Q_FUNC_INFO << ": Invalid scene";
+    return;
+  }
+
+  vtkMRMLDoseComparisonNode* paramNode = vtkMRMLDoseComparisonNode::SafeDownCast(d->MRMLNodeComboBox_ParameterSet->currentNode());
+  if (!paramNode || !d->ModuleWindowInitialized)
+  {
+    return;
+  }
+
+  paramNode->DisableModifiedEventOn();
+  paramNode->SetUseNativeGammaEngine(state);
+  paramNode->DisableModifiedEventOff();
+
+  this->invalidateResults();
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerDoseComparisonModuleWidget::maximumGammaChanged(double value)
 {
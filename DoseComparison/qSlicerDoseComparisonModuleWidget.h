@@ -69,6 +69,7 @@ protected slots:
   void analysisThresholdChanged(double);
   void geometricGammaCalculationCheckedStateChanged(int);
   void localDoseDifferenceCheckedStateChanged(int);
+  void nativeGammaEngineCheckedStateChanged(int);
   void maximumGammaChanged(double);
   void doseThresholdOnReferenceOnlyCheckedStateChanged(int);
 
@@ -46,6 +46,7 @@
 #include <vtkMRMLPlotChartNode.h>
 #include <vtkMRMLPlotViewNode.h>
 #include <vtkMRMLTableNode.h>
+#include <vtkMRMLTransformNode.h>
 #include <vtkMRMLScalarVolumeNode.h>
 #include <vtkMRMLScene.h>
 #include <vtkEventBroker.h>
@@ -56,16 +57,20 @@
 #include <vtkDelimitedTextWriter.h>
 #include <vtkDoubleArray.h>
 #include <vtkFieldData.h>
+#include <vtkGeneralTransform.h>
 #include <vtkImageAccumulate.h>
+#include <vtkImageClip.h>
 #include <vtkImageConstantPad.h>
 #include <vtkImageDilateErode3D.h>
 #include <vtkImageMathematics.h>
 #include <vtkImageStencilData.h>
+#include <vtkImageThreshold.h>
 #include <vtkImageToImageStencil.h>
 #include <vtkMath.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
-#include <vtkPiecewiseFunction.h>
+#include <vtkPolyData.h>
 #include <vtkStringArray.h>
 #include <vtkTable.h>
 #include <vtkTimerLog.h>
@@ -75,7 +80,11 @@
 #include <vtksys/SystemTools.hxx>
 
 // STD includes
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <set>
 
 // Slicer includes
@@ -120,392 +129,879 @@ public:
   vtkWeakPointer<vtkMRMLDoseVolumeHistogramNode> ParameterNode;
 };
 
-//----------------------------------------------------------------------------
-vtkSlicerDoseVolumeHistogramModuleLogic::vtkSlicerDoseVolumeHistogramModuleLogic()
+//---------------------------------------------------------------------------
+namespace
 {
-  this->StartValue = 0.1;
-  this->StepSize = 0.2;
-  this->NumberOfSamplesForNonDoseVolumes = 100;
-  this->DefaultDoseVolumeOversamplingFactor = 2.0;
-  this->UseLinearInterpolationForDoseVolume = true;
+  /// Number of distinct metric strings kept parsed (a few V and D metric strings are used at a time)
+  const size_t MAXIMUM_NUMBER_OF_PARSED_METRIC_STRINGS = 16;
+
+  /// Dose statistics of one segment accumulated in a shared sweep over the dose volume.
+  /// Reproduces the arithmetic of vtkImageAccumulate and vtkFractionalImageAccumulate, summing in raster order.
+  /// The results are identical for binary labelmaps. vtkFractionalImageAccumulate adds up partial sums of slabs,
+  /// so with fractional labelmaps the sums differ by floating point rounding (relative difference below 1e-12).
+  struct DvhAccumulator
+  {
+    /// Prepared segment labelmap on the lattice of the dose volume (not padded)
+    vtkOrientedImageData* Labelmap{nullptr};
+    /// Voxels with label value greater or equal than this are in the segment (same as the stencil threshold)
+    double Threshold{1e-10};
+    bool UseFractionalLabelmap{false};
+    double MinimumFractionalValue{0.0};
+    double MaximumFractionalValue{1.0};
+
+    vtkIdType VoxelCount{0};
+    double FractionalVoxelCount{0.0};
+    double Sum{0.0};
+    double Min{VTK_DOUBLE_MAX};
+    double Max{VTK_DOUBLE_MIN};
+
+    double StartValue{0.0};
+    double StepSize{1.0};
+    double VoxelsBelowStartValue{0.0};
+    std::vector<double> Histogram;
+  };
+
+  //---------------------------------------------------------------------------
+  template <class DoseType>
+  void vtkCopyDoseRow(const DoseType* dosePtr, int numberOfVoxels, double* doseRow)
+  {
+    for (int index=0; index<numberOfVoxels; ++index)
+    {
+      doseRow[index] = static_cast<double>(dosePtr[index]);
+    }
+  }
 
-  this->LogSpeedMeasurements = false;
+  //---------------------------------------------------------------------------
+  template <class LabelType>
+  void vtkAccumulateDvhRow(const LabelType* labelPtr, const double* doseRow, int numberOfVoxels,
+    bool computeStatistics, bool computeHistogram, DvhAccumulator& accumulator)
+  {
+    int numberOfBins = static_cast<int>(accumulator.Histogram.size());
+    for (int index=0; index<numberOfVoxels; ++index)
+    {
+      if (static_cast<double>(labelPtr[index]) < accumulator.Threshold)
+      {
+        continue;
+      }
+
+      double v = doseRow[index];
+      double f = 1.0;
+      if (accumulator.UseFractionalLabelmap)
+      {
+        f = ( labelPtr[index] - accumulator.MinimumFractionalValue ) / (accumulator.MaximumFractionalValue - accumulator.MinimumFractionalValue);
+      }
+
+      if (computeStatistics)
+      {
+        accumulator.Sum += v*f;
+        if (v > accumulator.Max)
+        {
+          accumulator.Max = v;
+        }
+        if (v < accumulator.Min)
+        {
+          accumulator.Min = v;
+        }
+        ++accumulator.VoxelCount;
+        accumulator.FractionalVoxelCount += f;
+      }
+
+      if (computeHistogram)
+      {
+        // Voxels with smaller dose than the start value (the first bin of a two-bin histogram with origin 0)
+        if (vtkMath::Floor(v / accumulator.StartValue) == 0)
+        {
+          accumulator.VoxelsBelowStartValue += f;
+        }
+        int binIndex = vtkMath::Floor((v - accumulator.StartValue) / accumulator.StepSize);
+        if (binIndex >= 0 && binIndex < numberOfBins)
+        {
+          accumulator.Histogram[binIndex] += f;
+        }
+      }
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  /// Sweep through the dose volume once and accumulate the voxels of each row into the segments containing them.
+  /// The labelmaps are treated as if they were padded to the dose extent with background value
+  void vtkAccumulateDvhSinglePass(vtkOrientedImageData* doseVolume, std::vector<DvhAccumulator*>& accumulators,
+    bool computeStatistics, bool computeHistogram)
+  {
+    int doseExtent[6] = {0,-1,0,-1,0,-1};
+    doseVolume->GetExtent(doseExtent);
+    int rowLength = doseExtent[1] - doseExtent[0] + 1;
+    if (rowLength <= 0)
+    {
+      return;
+    }
+    std::vector<double> doseRow(rowLength);
+    std::vector<DvhAccumulator*> rowAccumulators;
+
+    for (int z=doseExtent[4]; z<=doseExtent[5]; ++z)
+    {
+      for (int y=doseExtent[2]; y<=doseExtent[3]; ++y)
+      {
+        // Rows that are not covered by any labelmap are skipped
+        rowAccumulators.clear();
+        for (DvhAccumulator* accumulator : accumulators)
+        {
+          int* labelmapExtent = accumulator->Labelmap->GetExtent();
+          if ( y >= labelmapExtent[2] && y <= labelmapExtent[3] && z >= labelmapExtent[4] && z <= labelmapExtent[5]
+            && labelmapExtent[0] <= doseExtent[1] && labelmapExtent[1] >= doseExtent[0] )
+          {
+            rowAccumulators.push_back(accumulator);
+          }
+        }
+        if (rowAccumulators.empty())
+        {
+          continue;
+        }
+
+        // Convert dose row once, it is then shared by all segments
+        void* dosePtr = doseVolume->GetScalarPointer(doseExtent[0], y, z);
+        switch (doseVolume->GetScalarType())
+        {
+          vtkTemplateMacro(vtkCopyDoseRow(static_cast<VTK_TT*>(dosePtr), rowLength, doseRow.data()));
+        }
+
+        for (DvhAccumulator* accumulator : rowAccumulators)
+        {
+          int* labelmapExtent = accumulator->Labelmap->GetExtent();
+          int xMin = std::max(doseExtent[0], labelmapExtent[0]);
+          int xMax = std::min(doseExtent[1], labelmapExtent[1]);
+
+          void* labelPtr = accumulator->Labelmap->GetScalarPointer(xMin, y, z);
+          switch (accumulator->Labelmap->GetScalarType())
+          {
+            vtkTemplateMacro(vtkAccumulateDvhRow(static_cast<VTK_TT*>(labelPtr), doseRow.data() + (xMin - doseExtent[0]),
+              xMax - xMin + 1, computeStatistics, computeHistogram, *accumulator));
+          }
+        }
+      }
+    }
+  }
 }
 
+//---------------------------------------------------------------------------
+class vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal
+{
+public:
+  vtkInternal(vtkSlicerDoseVolumeHistogramModuleLogic* external);
+  ~vtkInternal() = default;
+
+  /// Dose volumes resampled to the geometry of automatically oversampled segment labelmaps.
+  /// Shared by the worker threads, so access is serialized
+  struct OversampledDoseCache
+  {
+    /// Get the cached dose volume for a serialized labelmap geometry, nullptr if not found
+    vtkSmartPointer<vtkOrientedImageData> Find(const std::string& geometry)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      std::map<std::string, vtkSmartPointer<vtkOrientedImageData> >::iterator volumeIt = this->Volumes.find(geometry);
+      return (volumeIt != this->Volumes.end() ? volumeIt->second : nullptr);
+    }
+    void Add(const std::string& geometry, vtkOrientedImageData* doseVolume)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Volumes[geometry] = doseVolume;
+    }
+    void Clear()
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Volumes.clear();
+    }
+
+    std::map<std::string, vtkSmartPointer<vtkOrientedImageData> > Volumes;
+    std::mutex Mutex;
+  };
+
+  /// Segment labelmap converted to the dose geometry
+  struct SegmentLabelmapCacheEntry
+  {
+    /// Inputs of the conversion (source representation, conversion parameters, dose geometry, oversampling)
+    std::string Key;
+    vtkSmartPointer<vtkOrientedImageData> Labelmap;
+    int LabelValue{1};
+    /// Flag indicating that the labelmap could not be converted to the dose geometry, so it needs to be resampled
+    bool ResamplingRequired{false};
+    /// Value of the use counter when the entry was last added or found, for evicting the least recently used entries
+    unsigned long LastUsed{0};
+  };
+
+  /// Settings of the DVH computation that are common for all segments.
+  /// Assembled on the main thread, then only read by the worker threads.
+  struct DvhComputationSettings
+  {
+    bool IsDoseVolume{true};
+    bool UseFractionalLabelmap{false};
+    bool DoseSurfaceHistogram{false};
+    bool UseInsideDoseSurface{true};
+    bool AutomaticOversampling{false};
+    bool UseLinearInterpolationForDoseVolume{true};
+    bool UseSegmentExtentCropping{true};
+    double StartValue{0.1};
+    double StepSize{0.2};
+    int NumberOfSamplesForNonDoseVolumes{100};
+    /// Maximum dose determining the number of DVH bins
+    double MaxDose{0.0};
+    /// Segmentation to world transform if the segmentation is transformed, nullptr otherwise
+    vtkSmartPointer<vtkAbstractTransform> SegmentationToWorldTransform;
+    /// Fixed oversampled dose volume, used as reference geometry when the labelmaps need to be resampled
+    vtkSmartPointer<vtkOrientedImageData> FixedOversampledDoseVolume;
+    /// Cache of the automatically oversampled dose volumes, nullptr if caching is disabled
+    OversampledDoseCache* DoseCache{nullptr};
+    /// Flag indicating that progress events are invoked. Disabled when the computation runs on a worker thread
+    bool ReportProgress{true};
+  };
+
+  /// Dose statistics within a segment, from which the DVH table and the default metrics are created
+  struct DvhStatistics
+  {
+    /// Number of voxels in the segment (sum of the voxel fractions if fractional labelmap is used)
+    double VoxelCount{0.0};
+    double CubicMMPerVoxel{0.0};
+    double MeanDose{0.0};
+    double MinDose{0.0};
+    double MaxDose{0.0};
+    /// Dose axis of the DVH
+    double StartValue{0.0};
+    double StepSize{0.0};
+    /// Number of voxels with smaller dose than the start value
+    double VoxelsBelowStartValue{0.0};
+    /// Number of voxels in each dose bin
+    std::vector<double> Histogram;
+  };
+
+  /// DVH computation of one segment
+  struct SegmentDvhJob
+  {
+    std::string SegmentID;
+    /// Labelmap representation of the segment in the segmentation copy (shallow copy owned by the job)
+    vtkSmartPointer<vtkOrientedImageData> SegmentLabelmap;
+    /// Label value of the segment in its binary labelmap layer
+    int LabelValue{1};
+    /// Flag indicating that the labelmap is not on the lattice of the oversampled dose and needs to be resampled
+    bool ResamplingRequired{false};
+    /// Flag indicating that the labelmap has already been prepared (shared by the dose volumes of the same geometry)
+    bool LabelmapPrepared{false};
+    /// Value of the voxels outside the segment in the prepared labelmap
+    double BackgroundValue{0.0};
+    /// Fixed oversampled dose volume, or the original dose volume if oversampling is automatic (shallow copy owned by the job)
+    vtkSmartPointer<vtkOrientedImageData> DoseVolume;
+    /// Computed statistics
+    DvhStatistics Statistics;
+    /// Error message, empty string if no error
+    std::string ErrorMessage;
+  };
+
+  /// Function processing one job
+  typedef void (*SegmentDvhJobFunction)(SegmentDvhJob& job, const DvhComputationSettings& settings);
+
+  /// Queue of DVH jobs processed by the worker threads
+  struct SegmentDvhJobQueue
+  {
+    std::vector<SegmentDvhJob>* Jobs{nullptr};
+    const DvhComputationSettings* Settings{nullptr};
+    SegmentDvhJobFunction JobFunction{nullptr};
+    vtkSlicerDoseVolumeHistogramModuleLogic* Logic{nullptr};
+    /// Progress reported when all jobs are completed
+    double ProgressScale{1.0};
+    std::atomic<size_t> NextJobIndex{0};
+    std::atomic<size_t> NumberOfCompletedJobs{0};
+    /// Set when a job fails so that no further jobs are started
+    std::atomic<bool> Failed{false};
+  };
+
+  /// DVH computation of the selected segments on one dose volume of a batch
+  struct DoseDvhTask
+  {
+    /// Dose volume node, only accessed on the main thread
+    vtkMRMLScalarVolumeNode* DoseVolumeNode{nullptr};
+    vtkSmartPointer<vtkOrientedImageData> DoseImageData;
+    DvhComputationSettings Settings;
+    /// Dose volumes resampled to the automatically oversampled labelmaps, shared by the segments of this dose
+    OversampledDoseCache DoseCache;
+    /// Segment jobs with the labelmaps already prepared on the lattice of the dose
+    std::vector<SegmentDvhJob> Jobs;
+    /// Flag indicating that the dose is processed slab by slab because of the memory limit
+    bool Streaming{false};
+    /// Oversampling factor of each segment, only used if the dose is processed slab by slab
+    std::vector<double> OversamplingFactors;
+    /// Error message, empty string if no error
+    std::string ErrorMessage;
+  };
+
+  /// Queue of batch dose volumes processed by the worker threads
+  struct DoseDvhTaskQueue
+  {
+    std::vector<DoseDvhTask*>* Tasks{nullptr};
+    vtkInternal* Internal{nullptr};
+    std::atomic<size_t> NextTaskIndex{0};
+    std::atomic<size_t> NumberOfCompletedTasks{0};
+  };
+
+  /// DVH metric requested in the parameter node, parsed from the metric strings
+  struct DvhMetricQuery
+  {
+    enum QueryType
+    {
+      /// Volume (cc) receiving at least the given dose
+      VolumeCc,
+      /// Volume (% of structure volume) receiving at least the given dose
+      VolumePercent,
+      /// Minimum dose of the hottest given volume (cc)
+      DoseForVolumeCc,
+      /// Minimum dose of the hottest volume given in % of structure volume
+      DoseForVolumePercent
+    };
+    QueryType Type{VolumeCc};
+    double Value{0.0};
+  };
+
+  /// Dose and cumulative volume columns of a DVH table, arranged for binary search lookups.
+  /// Only rebuilt if the table is modified
+  struct DvhTableIndex
+  {
+    vtkMTimeType MTime{0};
+    /// Dose values in increasing order
+    std::vector<double> Doses;
+    /// Volume (% of structure volume) receiving at least the dose, forced to be non-increasing
+    std::vector<double> VolumesPercent;
+  };
+
+  /// DVH referenced from the metrics table, with its metrics table row and structure volume
+  struct DvhMetricTarget
+  {
+    const DvhTableIndex* Index{nullptr};
+    int TableRow{-1};
+    double StructureVolume{0.0};
+  };
+
+  /// Assemble the key identifying the inputs of converting a segment to labelmap at the dose geometry
+  static std::string GetSegmentLabelmapCacheKey(vtkSegmentation* segmentation, std::string segmentID,
+    std::string representationName, std::string doseGeometry, std::string oversampling);
+
+  /// Get cached labelmap of a segment
+  /// \return True if the labelmap is cached and its key matches the key in the given entry
+  bool FindCachedSegmentLabelmap(vtkMRMLSegmentationNode* segmentationNode, std::string segmentID, SegmentLabelmapCacheEntry& entry);
+
+  /// Add or replace cached labelmap of a segment
+  void AddCachedSegmentLabelmap(vtkMRMLSegmentationNode* segmentationNode, std::string segmentID, const SegmentLabelmapCacheEntry& entry);
+
+  /// Remove the cached labelmaps of segmentation nodes and segments that no longer exist, then remove the least
+  /// recently used labelmaps until the total size of the cached labelmaps is within the given limit
+  /// \param sizeLimitMB Maximum total size of the cached labelmaps. No limit if zero
+  void PruneSegmentLabelmapCache(vtkMRMLScene* scene, int sizeLimitMB);
+
+  /// Remove the cached labelmaps and dose volumes, so that they do not take up memory needed by the slab-wise computation
+  void ReleaseCachedImages();
+
+  /// Remove cached dose volumes if the dose volume or the settings of resampling it changed
+  void UpdateDoseCacheKey(const std::string& doseKey);
+
+  /// Remove all cached data
+  void ClearCache();
+
+  /// Assemble computation settings from the parameter node and the logic properties
+  void InitializeComputationSettings(vtkMRMLDoseVolumeHistogramNode* parameterNode, vtkMRMLScalarVolumeNode* doseVolumeNode,
+    double maxDose, DvhComputationSettings& settings);
+
+  /// Extract segment labelmap and bring it to the lattice of the fixed oversampled dose (without padding).
+  /// The prepared labelmap replaces the input labelmap in the job.
+  /// Does not access the MRML scene so that it can run on a worker thread
+  static void PrepareSegmentLabelmapJob(SegmentDvhJob& job, const DvhComputationSettings& settings);
+
+  /// Prepare segment labelmap, oversample the dose if needed, and compute the DVH statistics.
+  /// Does not access the MRML scene so that it can run on a worker thread
+  static void ComputeSegmentDvhJob(SegmentDvhJob& job, const DvhComputationSettings& settings);
+
+  /// Determine the dose axis of the DVH from the dose range within the segment
+  /// \return Error message, empty string if no error
+  static std::string ComputeDvhBins(const DvhComputationSettings& settings, double rangeMin, double rangeMax,
+    double& startValue, double& stepSize, int& numberOfSamples);
+
+  /// Get the extent of the segment within the dose extent, extended by a margin so that the dose
+  /// surface histogram sees the same neighborhood as on the full extent
+  /// \return False if the segment is empty within the dose extent
+  static bool GetCroppedExtent(vtkOrientedImageData* segmentLabelmap, double backgroundValue, int doseExtent[6], int croppedExtent[6]);
+
+  /// Compute DVH statistics of a segment labelmap on the dose volume of the same geometry
+  /// \return Error message, empty string if no error
+  static std::string ComputeDvhStatistics(vtkOrientedImageData* segmentLabelmap, vtkOrientedImageData* oversampledDoseVolume,
+    const DvhComputationSettings& settings, DvhStatistics& statistics);
+
+  /// Execute DVH jobs using the given number of threads (0 means one thread per processor core).
+  /// Progress is reported by the calling thread
+  void ComputeSegmentDvhJobs(std::vector<SegmentDvhJob>& jobs, const DvhComputationSettings& settings, int numberOfThreads,
+    SegmentDvhJobFunction jobFunction=ComputeSegmentDvhJob, double progressScale=1.0);
+
+  /// Compute the DVH statistics of all jobs in one sweep over the fixed oversampled dose volume.
+  /// The labelmaps are prepared in parallel, then the histograms are accumulated together.
+  /// Requires fixed oversampling and no dose surface histogram
+  void ComputeSegmentDvhJobsSinglePass(std::vector<SegmentDvhJob>& jobs, const DvhComputationSettings& settings, int numberOfThreads);
+
+  /// Get the name of the labelmap representation the DVH is computed from
+  static const char* GetLabelmapRepresentationName(bool useFractionalLabelmap);
+
+  /// Set the labelmap of an accumulator and the foreground definition (same as the stencil in \sa ComputeDvhStatistics)
+  static void InitializeDvhAccumulator(DvhAccumulator& accumulator, vtkOrientedImageData* segmentLabelmap, const DvhComputationSettings& settings);
+
+  /// Assemble the DVH statistics from an accumulator, with the same error checks as in \sa ComputeDvhStatistics
+  /// \param doseExtent Extent of the oversampled dose volume the statistics were accumulated on
+  /// \return Error message, empty string if no error
+  static std::string GetDvhStatisticsFromAccumulator(DvhAccumulator& accumulator, int doseExtent[6], double cubicMMPerVoxel,
+    const DvhComputationSettings& settings, DvhStatistics& statistics);
+
+  /// Get the labelmaps of the selected segments at the dose geometry, from the cache or by converting the segments.
+  /// Also stores the automatic oversampling factors in the parameter node.
+  /// \return Error message, empty string if no error
+  std::string GetSegmentLabelmaps(vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+    vtkOrientedImageData* doseImageData, const DvhComputationSettings& settings, std::vector<SegmentLabelmapCacheEntry>& segmentLabelmaps);
+
+  /// Convert segments to labelmap at the dose geometry, oversample the dose volume, and compute the DVH statistics
+  /// of the selected segments with the whole dose volume in memory
+  /// \return Error message, empty string if no error
+  std::string ComputeSegmentDvhJobsInCore(vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+    vtkOrientedImageData* doseImageData, DvhComputationSettings& settings, std::vector<SegmentDvhJob>& jobs);
+
+  /// Determine if the in-core computation would exceed the memory limit set in the parameter node.
+  /// Slab-wise computation is not supported for dose surface histograms and transformed segmentations,
+  /// and with automatic oversampling it requires closed surface source representation.
+  /// \param oversamplingFactors Output oversampling factor of each segment
+  bool IsStreamingRequired(vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+    vtkOrientedImageData* doseImageData, const DvhComputationSettings& settings, std::vector<double>& oversamplingFactors);
+
+  /// Create image with the geometry of the given image oversampled by the given factor, without allocating scalars
+  static vtkSmartPointer<vtkOrientedImageData> CreateOversampledGeometry(vtkOrientedImageData* imageData, double oversamplingFactor);
+
+  /// Get the number of slices that can be processed at once on the given lattice within the memory limit
+  static int GetNumberOfSlicesPerSlab(vtkOrientedImageData* geometry, int doseScalarSize, int memoryLimitMB);
+
+  /// Convert a segment to labelmap on the lattice of a slab and prepare it for accumulation.
+  /// The prepared labelmap is set to the job, or nullptr if the segment does not intersect the slab
+  /// \param segmentation Segmentation containing only the segment of the job
+  /// \return Error message, empty string if no error
+  static std::string RasterizeSegmentSlab(vtkSegmentation* segmentation, vtkOrientedImageData* slabGeometry,
+    const DvhComputationSettings& settings, SegmentDvhJob& job);
+
+  /// Compute the DVH statistics of the selected segments slab by slab along the third axis of the oversampled dose,
+  /// so that only the dose and the labelmap of one segment within the current slab are in memory.
+  /// The histograms are accumulated in the same order as in the in-core computation. The results are identical for
+  /// binary labelmaps, and differ by floating point rounding for fractional labelmaps (relative difference below 1e-12)
+  /// \return Error message, empty string if no error
+  std::string ComputeSegmentDvhJobsStreaming(vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+    const std::vector<double>& oversamplingFactors, vtkOrientedImageData* doseImageData, const DvhComputationSettings& settings,
+    std::vector<SegmentDvhJob>& jobs);
+
+  /// Process jobs from the queue until it is empty
+  static void ProcessSegmentDvhJobQueue(SegmentDvhJobQueue* queue, bool reportProgress);
+
+  /// Thread function for \sa ComputeSegmentDvhJobs
+  static VTK_THREAD_RETURN_TYPE ComputeSegmentDvhJobsThreadFunction(void* arg);
+
+  /// Oversample the dose of a batch task and compute the DVH statistics of its prepared segment jobs.
+  /// Does not access the MRML scene so that it can run on a worker thread
+  void ComputeDoseDvhTask(DoseDvhTask& task);
+
+  /// Execute batch dose tasks using the given number of threads (0 means one thread per processor core).
+  /// Progress is reported by the calling thread
+  void ComputeDoseDvhTasks(std::vector<DoseDvhTask*>& tasks, int numberOfThreads);
+
+  /// Process batch dose tasks from the queue until it is empty
+  static void ProcessDoseDvhTaskQueue(DoseDvhTaskQueue* queue, bool reportProgress);
+
+  /// Thread function for \sa ComputeDoseDvhTasks
+  static VTK_THREAD_RETURN_TYPE ComputeDoseDvhTasksThreadFunction(void* arg);
+
+  /// Get the numbers in a comma-separated metric string. Each distinct string is only parsed once
+  const std::vector<double>& GetMetricNumbers(const char* metricString);
+
+  /// Get the lookup index of a DVH table, rebuilt only if the table was modified since the last call.
+  /// \return nullptr if the table does not contain a DVH
+  const DvhTableIndex* GetDvhTableIndex(vtkMRMLTableNode* dvhTableNode);
+
+  /// Collect the DVHs referenced from the metrics table
+  /// \param callerName Name of the calling function for the error messages
+  void GetDvhMetricTargets(vtkMRMLTableNode* metricsTableNode, const char* callerName, std::vector<DvhMetricTarget>& targets);
+
+  /// Evaluate all queries on all DVHs in one loop. Results are stored DVH by DVH, in the order of the queries
+  static void EvaluateDvhMetricQueries(const std::vector<DvhMetricQuery>& queries,
+    const std::vector<DvhMetricTarget>& targets, std::vector<double>& results);
+
+  /// Write results of \sa EvaluateDvhMetricQueries into the metrics table column by column, starting at the given column
+  static void WriteDvhMetricResults(vtkTable* metricsTable, int firstColumn, size_t numberOfQueries,
+    const std::vector<DvhMetricTarget>& targets, const std::vector<double>& results);
+
+  /// Get volume (% of structure volume) receiving at least the given dose, interpolated linearly
+  static double LookupVolumePercent(const DvhTableIndex& index, double dose);
+
+  /// Get minimum dose of the hottest given volume (cc), interpolated linearly
+  static double LookupDose(const DvhTableIndex& index, double volumeCc, double structureVolume);
+
+  /// Create DVH table for the segment (or update if already exists) and set its metrics in the metrics table.
+  /// Accesses the MRML scene, so it must be called on the main thread
+  /// \return Error message, empty string if no error
+  std::string StoreDvhStatistics(vtkMRMLDoseVolumeHistogramNode* parameterNode, vtkMRMLScalarVolumeNode* doseVolumeNode,
+    std::string segmentID, const DvhStatistics& statistics);
+
+public:
+  vtkSlicerDoseVolumeHistogramModuleLogic* External;
+
+  /// Segment labelmaps converted to the dose geometry. Map key is segmentation node ID and segment ID
+  std::map<std::string, SegmentLabelmapCacheEntry> SegmentLabelmapCache;
+  /// Incremented each time a cached labelmap is added or found
+  unsigned long SegmentLabelmapCacheUseCount{0};
+
+  /// Key of the dose volume the cached oversampled dose volumes were created from
+  std::string DoseCacheKey;
+  /// Dose volume oversampled with the fixed factor, and the oversampling factor
+  vtkSmartPointer<vtkOrientedImageData> FixedOversampledDoseVolume;
+  double FixedOversamplingFactor{0.0};
+  /// Dose volumes resampled to the automatically oversampled segment labelmaps
+  OversampledDoseCache AutomaticOversampledDoseVolumes;
+
+  /// Parsed metric strings. Map key is the metric string. Emptied when the number of strings reaches the maximum
+  std::map<std::string, std::vector<double> > ParsedMetricStrings;
+  /// Lookup indices of the DVH tables. Map key is the DVH table node ID, the index is rebuilt if the table was modified.
+  /// Entries are removed together with the table nodes
+  std::map<std::string, DvhTableIndex> DvhTableIndices;
+};
+
 //----------------------------------------------------------------------------
-vtkSlicerDoseVolumeHistogramModuleLogic::~vtkSlicerDoseVolumeHistogramModuleLogic() = default;
+// vtkInternal methods
 
-//---------------------------------------------------------------------------
-void vtkSlicerDoseVolumeHistogramModuleLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+//----------------------------------------------------------------------------
+vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::vtkInternal(vtkSlicerDoseVolumeHistogramModuleLogic* external)
+  : External(external)
 {
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::EndCloseEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEvents(newScene, events.GetPointer());
 }
 
-//-----------------------------------------------------------------------------
-void vtkSlicerDoseVolumeHistogramModuleLogic::RegisterNodes()
+//----------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetSegmentLabelmapCacheKey(vtkSegmentation* segmentation,
+  std::string segmentID, std::string representationName, std::string doseGeometry, std::string oversampling)
 {
-  vtkMRMLScene* scene = this->GetMRMLScene();
-  if (!scene)
+#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
+  std::string sourceRepresentationName = segmentation->GetSourceRepresentationName();
+#else
+  std::string sourceRepresentationName = segmentation->GetMasterRepresentationName();
+#endif
+  vtkSegment* segment = segmentation->GetSegment(segmentID);
+  vtkDataObject* sourceRepresentation = (segment ? segment->GetRepresentation(sourceRepresentationName) : nullptr);
+  if (!sourceRepresentation)
   {
-    vtkErrorMacro("RegisterNodes: Invalid MRML scene");
-    return;
+    return "";
   }
-  if (!scene->IsNodeClassRegistered("vtkMRMLDoseVolumeHistogramNode"))
+
+  std::ostringstream keyStream;
+  keyStream << sourceRepresentationName << ":" << sourceRepresentation << ":" << sourceRepresentation->GetMTime()
+    << "|" << segmentation->SerializeAllConversionParameters()
+    << "|" << representationName << "|" << doseGeometry << "|" << oversampling;
+  return keyStream.str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::FindCachedSegmentLabelmap(
+  vtkMRMLSegmentationNode* segmentationNode, std::string segmentID, SegmentLabelmapCacheEntry& entry)
+{
+  std::map<std::string, SegmentLabelmapCacheEntry>::iterator entryIt =
+    this->SegmentLabelmapCache.find(std::string(segmentationNode->GetID()) + "|" + segmentID);
+  if (entry.Key.empty() || entryIt == this->SegmentLabelmapCache.end() || entryIt->second.Key != entry.Key)
   {
-    scene->RegisterNodeClass(vtkSmartPointer<vtkMRMLDoseVolumeHistogramNode>::New());
+    return false;
   }
+  entryIt->second.LastUsed = ++this->SegmentLabelmapCacheUseCount;
+  entry = entryIt->second;
+  return true;
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerDoseVolumeHistogramModuleLogic::OnMRMLSceneEndClose()
+//----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::AddCachedSegmentLabelmap(
+  vtkMRMLSegmentationNode* segmentationNode, std::string segmentID, const SegmentLabelmapCacheEntry& entry)
 {
-  if (!this->GetMRMLScene())
+  if (entry.Key.empty())
   {
-    vtkErrorMacro("OnMRMLSceneEndClose: Invalid MRML scene");
     return;
   }
-
-  this->Modified();
+  SegmentLabelmapCacheEntry& cachedEntry = this->SegmentLabelmapCache[std::string(segmentationNode->GetID()) + "|" + segmentID];
+  cachedEntry = entry;
+  cachedEntry.LastUsed = ++this->SegmentLabelmapCacheUseCount;
 }
 
-//---------------------------------------------------------------------------
-std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolumeHistogramNode* parameterNode)
+//----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::PruneSegmentLabelmapCache(vtkMRMLScene* scene, int sizeLimitMB)
 {
-  if (!this->GetMRMLScene() || !parameterNode)
-  {
-    std::string errorMessage("Invalid MRML scene or parameter set node");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+  unsigned long totalSizeKB = 0;
+  std::map<std::string, SegmentLabelmapCacheEntry>::iterator entryIt = this->SegmentLabelmapCache.begin();
+  while (entryIt != this->SegmentLabelmapCache.end())
+  {
+    // Segmentation node IDs do not contain the separator, so the segment ID is the rest of the map key
+    size_t separatorPosition = entryIt->first.find('|');
+    std::string segmentationNodeID = entryIt->first.substr(0, separatorPosition);
+    std::string segmentID = entryIt->first.substr(separatorPosition + 1);
+    vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(
+      scene ? scene->GetNodeByID(segmentationNodeID) : nullptr );
+    if (!segmentationNode || !segmentationNode->GetSegmentation() || !segmentationNode->GetSegmentation()->GetSegment(segmentID))
+    {
+      this->SegmentLabelmapCache.erase(entryIt++);
+      continue;
+    }
+    totalSizeKB += (entryIt->second.Labelmap ? entryIt->second.Labelmap->GetActualMemorySize() : 0);
+    ++entryIt;
   }
 
-  parameterNode->ClearAutomaticOversamplingFactors();
-  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
-  vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
-  if ( !segmentationNode || !doseVolumeNode )
+  if (sizeLimitMB <= 0)
   {
-    std::string errorMessage("Both segmentation node and dose volume node need to be set");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    return;
   }
+  unsigned long sizeLimitKB = static_cast<unsigned long>(sizeLimitMB) * 1024;
+  while (totalSizeKB > sizeLimitKB && !this->SegmentLabelmapCache.empty())
+  {
+    std::map<std::string, SegmentLabelmapCacheEntry>::iterator leastRecentlyUsedIt = this->SegmentLabelmapCache.begin();
+    for (entryIt = this->SegmentLabelmapCache.begin(); entryIt != this->SegmentLabelmapCache.end(); ++entryIt)
+    {
+      if (entryIt->second.LastUsed < leastRecentlyUsedIt->second.LastUsed)
+      {
+        leastRecentlyUsedIt = entryIt;
+      }
+    }
+    unsigned long entrySizeKB = (leastRecentlyUsedIt->second.Labelmap ? leastRecentlyUsedIt->second.Labelmap->GetActualMemorySize() : 0);
+    totalSizeKB -= std::min(totalSizeKB, entrySizeKB);
+    this->SegmentLabelmapCache.erase(leastRecentlyUsedIt);
+  }
+}
 
-  // Fire only one modified event when the computation is done
-  this->SetDisableModifiedEvent(1);
-  int disabledNodeModify = parameterNode->StartModify();
-
-  // Get maximum dose from dose volume for number of DVH bins
-  vtkNew<vtkImageAccumulate> doseStat;
-  doseStat->SetInputData(doseVolumeNode->GetImageData());
-  doseStat->Update();
-  double maxDose = doseStat->GetMax()[0];
-
-  // Get selected segmentation
-  vtkSegmentation* selectedSegmentation = segmentationNode->GetSegmentation();
+//----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ReleaseCachedImages()
+{
+  this->SegmentLabelmapCache.clear();
+  this->UpdateDoseCacheKey("");
+}
 
-  // If segment IDs list is empty then include all segments
-  std::vector<std::string> segmentIDs;
-  parameterNode->GetSelectedSegmentIDs(segmentIDs);
-  if (segmentIDs.empty())
+//----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::UpdateDoseCacheKey(const std::string& doseKey)
+{
+  if (doseKey == this->DoseCacheKey)
   {
-    selectedSegmentation->GetSegmentIDs(segmentIDs);
+    return;
   }
+  this->DoseCacheKey = doseKey;
+  this->FixedOversampledDoseVolume = nullptr;
+  this->FixedOversamplingFactor = 0.0;
+  this->AutomaticOversampledDoseVolumes.Clear();
+}
 
-  // Create oriented image data from dose volume
-  vtkSmartPointer<vtkOrientedImageData> doseImageData = vtkSmartPointer<vtkOrientedImageData>::Take(
-    vtkSlicerSegmentationsModuleLogic::CreateOrientedImageDataFromVolumeNode(doseVolumeNode) );
-  if (!doseImageData.GetPointer())
+//----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ClearCache()
+{
+  this->SegmentLabelmapCache.clear();
+  this->DvhTableIndices.clear();
+  this->UpdateDoseCacheKey("");
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::InitializeComputationSettings(
+  vtkMRMLDoseVolumeHistogramNode* parameterNode, vtkMRMLScalarVolumeNode* doseVolumeNode, double maxDose, DvhComputationSettings& settings)
+{
+  settings.IsDoseVolume = vtkSlicerRtCommon::IsDoseVolumeNode(doseVolumeNode);
+  settings.UseFractionalLabelmap = parameterNode->GetUseFractionalLabelmap();
+  settings.DoseSurfaceHistogram = parameterNode->GetDoseSurfaceHistogram();
+  settings.UseInsideDoseSurface = parameterNode->GetUseInsideDoseSurface();
+  settings.AutomaticOversampling = parameterNode->GetAutomaticOversampling();
+  settings.UseLinearInterpolationForDoseVolume = this->External->UseLinearInterpolationForDoseVolume;
+  settings.UseSegmentExtentCropping = this->External->UseSegmentExtentCropping;
+  settings.StartValue = this->External->StartValue;
+  settings.StepSize = this->External->StepSize;
+  settings.NumberOfSamplesForNonDoseVolumes = this->External->NumberOfSamplesForNonDoseVolumes;
+  settings.MaxDose = maxDose;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::PrepareSegmentLabelmapJob(SegmentDvhJob& job, const DvhComputationSettings& settings)
+{
+  if (job.LabelmapPrepared)
   {
-    std::string errorMessage("Failed to get image data from dose volume");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    return;
   }
-
-  // Temporarily duplicate selected segments to contain binary labelmap of a different geometry (tied to dose volume)
-  vtkSmartPointer<vtkSegmentation> segmentationCopy = vtkSmartPointer<vtkSegmentation>::New();
-#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
-  segmentationCopy->SetSourceRepresentationName(selectedSegmentation->GetSourceRepresentationName());
-#else
-  segmentationCopy->SetMasterRepresentationName(selectedSegmentation->GetMasterRepresentationName());
-#endif
-  segmentationCopy->CopyConversionParameters(selectedSegmentation);
-  for (std::vector<std::string>::iterator segmentIt = segmentIDs.begin(); segmentIt != segmentIDs.end(); ++segmentIt)
+  vtkSmartPointer<vtkOrientedImageData> segmentLabelmap = job.SegmentLabelmap;
+  if (!segmentLabelmap)
   {
-    segmentationCopy->CopySegmentFromSegmentation(selectedSegmentation, (*segmentIt));
+    job.ErrorMessage = "Failed to get labelmap for segments";
+    return;
   }
 
-  // Use dose volume geometry as reference, with oversampling of fixed 2 or automatic (as selected)
-  std::string doseGeometryString = vtkSegmentationConverter::SerializeImageGeometry(doseImageData);
-  segmentationCopy->SetConversionParameter( vtkSegmentationConverter::GetReferenceImageGeometryParameterName(),
-    doseGeometryString );
-  std::stringstream fixedOversamplingValueStream;
-  fixedOversamplingValueStream << this->DefaultDoseVolumeOversamplingFactor;
-  segmentationCopy->SetConversionParameter( vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(),
-    parameterNode->GetAutomaticOversampling() ? "A" : fixedOversamplingValueStream.str().c_str() );
 #if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
-  // We don't want to try to merge the labelmaps since if they have different oversampling factors, they would conflict.
-  // Could perhaps leave the labelmaps merged if there is a performance increase, but for now merging will be disabled for DVH calculation.
-  segmentationCopy->SetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetCollapseLabelmapsParameterName(), "0");
+  if (!settings.UseFractionalLabelmap)
+  {
+    // Extract the segment from its (possibly shared) binary labelmap layer
+    vtkSmartPointer<vtkOrientedImageData> mergedLabelmap = segmentLabelmap;
+    vtkNew<vtkImageThreshold> threshold;
+    threshold->SetInputData(mergedLabelmap);
+    threshold->ThresholdBetween(job.LabelValue, job.LabelValue);
+    threshold->SetInValue(1);
+    threshold->SetOutValue(0);
+    threshold->SetOutputScalarTypeToUnsignedChar();
+    threshold->Update();
+    segmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    segmentLabelmap->ShallowCopy(threshold->GetOutput());
+    segmentLabelmap->CopyDirections(mergedLabelmap);
+  }
 #endif
 
-  char* representationName = 0;
-  bool useFractionalLabelmap = parameterNode->GetUseFractionalLabelmap();
-  if (useFractionalLabelmap)
+  double minimumValue = 0.0;
+  vtkDoubleArray* scalarRange = vtkDoubleArray::SafeDownCast(
+    segmentLabelmap->GetFieldData()->GetAbstractArray(vtkSegmentationConverter::GetScalarRangeFieldName()));
+  if (scalarRange && scalarRange->GetNumberOfValues() == 2)
   {
-    representationName = (char*)vtkSegmentationConverter::GetSegmentationFractionalLabelmapRepresentationName();
+    minimumValue = scalarRange->GetValue(0);
   }
-  else
+  job.BackgroundValue = minimumValue;
+
+  // Apply parent transformation if necessary
+  bool resamplingRequired = job.ResamplingRequired;
+  if (settings.SegmentationToWorldTransform)
   {
-    representationName = (char*)vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+    double backgroundValue[4] = {minimumValue, minimumValue, minimumValue, 0.0};
+    vtkOrientedImageDataResample::TransformOrientedImage(segmentLabelmap, settings.SegmentationToWorldTransform,
+      false, false, settings.UseFractionalLabelmap, backgroundValue);
+    resamplingRequired = true;
   }
-
-  bool resamplingRequired = false;
-  if ( !segmentationCopy->CreateRepresentation(representationName, true) )
+  // Resample labelmap if necessary (if it was master, and could not be re-converted using the oversampled geometry, or if there was a parent transform)
+  if (resamplingRequired)
   {
-    // If conversion failed and there is no binary labelmap in the segmentation, then cannot calculate DVH
-    if (!segmentationCopy->ContainsRepresentation(representationName) )
+    if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+      segmentLabelmap, settings.FixedOversampledDoseVolume, segmentLabelmap, settings.UseFractionalLabelmap, false, nullptr, minimumValue ) )
     {
-      std::string errorMessage("Unable to acquire binary labelmap from segmentation");
-      vtkErrorMacro("ComputeDvh: " << errorMessage);
-      return errorMessage;
+      job.ErrorMessage = "Failed to resample segment binary labelmap";
+      return;
     }
-
-    // If conversion failed, then resample binary labelmaps in the segments
-    resamplingRequired = true;
   }
 
-  // Calculate and store oversampling factors if automatically calculated for reporting purposes
-  if (parameterNode->GetAutomaticOversampling())
+  job.SegmentLabelmap = segmentLabelmap;
+  job.LabelmapPrepared = true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeSegmentDvhJob(SegmentDvhJob& job, const DvhComputationSettings& settings)
+{
+  PrepareSegmentLabelmapJob(job, settings);
+  if (!job.ErrorMessage.empty())
   {
-    // Get spacing for dose volume
-    double doseSpacing[3] = {0.0,0.0,0.0};
-    doseVolumeNode->GetSpacing(doseSpacing);
+    return;
+  }
+  vtkSmartPointer<vtkOrientedImageData> segmentLabelmap = job.SegmentLabelmap;
 
-    // Calculate oversampling factors for all segments (need to calculate as it is not stored per segment)
-    std::vector< std::string > segmentIDsCopy;
-    segmentationCopy->GetSegmentIDs(segmentIDsCopy);
-    for (std::vector< std::string >::const_iterator segmentIdIt = segmentIDsCopy.begin(); segmentIdIt != segmentIDsCopy.end(); ++segmentIdIt)
+  // Get oversampled dose volume
+  vtkSmartPointer<vtkOrientedImageData> oversampledDoseVolume = job.DoseVolume;
+  // Resample dose volume to match automatically oversampled segment labelmap geometry
+  if (settings.AutomaticOversampling)
+  {
+    // Segments with the same labelmap geometry share the resampled dose
+    std::string labelmapGeometry;
+    vtkSmartPointer<vtkOrientedImageData> cachedDoseVolume;
+    if (settings.DoseCache)
     {
-      std::string segmentID = *segmentIdIt;
-      vtkSegment* currentSegment = segmentationCopy->GetSegment(*segmentIdIt);
-
-      vtkOrientedImageData* currentLabelmap = vtkOrientedImageData::SafeDownCast(
-        currentSegment->GetRepresentation(representationName) );
-      if (!currentLabelmap)
+      labelmapGeometry = vtkSegmentationConverter::SerializeImageGeometry(segmentLabelmap);
+      cachedDoseVolume = settings.DoseCache->Find(labelmapGeometry);
+    }
+    oversampledDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (cachedDoseVolume)
+    {
+      oversampledDoseVolume->ShallowCopy(cachedDoseVolume);
+    }
+    else
+    {
+      if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+        job.DoseVolume, segmentLabelmap, oversampledDoseVolume, settings.UseLinearInterpolationForDoseVolume ) )
       {
-        std::string errorMessage("Representation missing after converting with automatic oversampling factor");
-        vtkErrorMacro("ComputeDvh: " << errorMessage);
-        return errorMessage;
+        job.ErrorMessage = "Failed to resample dose volume";
+        return;
+      }
+      if (settings.DoseCache)
+      {
+        vtkSmartPointer<vtkOrientedImageData> doseVolumeToCache = vtkSmartPointer<vtkOrientedImageData>::New();
+        doseVolumeToCache->ShallowCopy(oversampledDoseVolume);
+        settings.DoseCache->Add(labelmapGeometry, doseVolumeToCache);
       }
-      double currentSpacing[3] = {0.0,0.0,0.0};
-      currentLabelmap->GetSpacing(currentSpacing);
-
-      double voxelSizeRatio = ((doseSpacing[0]*doseSpacing[1]*doseSpacing[2]) / (currentSpacing[0]*currentSpacing[1]*currentSpacing[2]));
-      // Round oversampling to two decimals
-      // Note: We need to round to some degree, because e.g. pow(64,1/3) is not exactly 4. It may be debated whether to round to integer or to a certain number of decimals
-      double oversamplingFactor = vtkMath::Round( pow( voxelSizeRatio, 1.0/3.0 ) * 100.0 ) / 100.0;
-      parameterNode->AddAutomaticOversamplingFactor(segmentID, oversamplingFactor);
     }
   }
 
-  // Use the same resampled dose volume if oversampling is fixed
-  vtkSmartPointer<vtkOrientedImageData> fixedOversampledDoseVolume;
-  if (!parameterNode->GetAutomaticOversampling())
+  // Make sure the segment labelmap is the same dimension as the dose volume
+  int extent[6] = {0,-1,0,-1,0,-1};
+  oversampledDoseVolume->GetExtent(extent);
+  if (settings.UseSegmentExtentCropping)
   {
-    // Get geometry of oversampled dose volume
-    fixedOversampledDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
-    fixedOversampledDoseVolume->ShallowCopy(doseImageData);
-    vtkCalculateOversamplingFactor::ApplyOversamplingOnImageGeometry(fixedOversampledDoseVolume, this->DefaultDoseVolumeOversamplingFactor);
-
-    // Resample dose volume using linear interpolation
-    if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
-      doseImageData, fixedOversampledDoseVolume, fixedOversampledDoseVolume, true ) )
+    // Only evaluate the part of the dose volume that the segment covers, so that the temporary images
+    // scale with the size of the structure instead of the dose grid. The voxels outside the segment
+    // are not in the stencil, so the results are the same as with the full extent.
+    int croppedExtent[6] = {0,-1,0,-1,0,-1};
+    if (GetCroppedExtent(segmentLabelmap, job.BackgroundValue, extent, croppedExtent))
     {
-      std::string errorMessage("Failed to resample dose volume");
-      vtkErrorMacro("ComputeDvh: " << errorMessage);
-      return errorMessage;
+      vtkNew<vtkImageClip> doseClipper;
+      doseClipper->SetInputData(oversampledDoseVolume);
+      doseClipper->SetOutputWholeExtent(croppedExtent);
+      doseClipper->ClipDataOn();
+      doseClipper->Update();
+      vtkSmartPointer<vtkOrientedImageData> croppedDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+      croppedDoseVolume->ShallowCopy(doseClipper->GetOutput());
+      croppedDoseVolume->CopyDirections(oversampledDoseVolume);
+      oversampledDoseVolume = croppedDoseVolume;
+      std::copy(croppedExtent, croppedExtent+6, extent);
     }
   }
+  vtkNew<vtkImageConstantPad> padder;
+  padder->SetInputData(segmentLabelmap);
+  padder->SetConstant(job.BackgroundValue);
+  padder->SetOutputWholeExtent(extent);
+  padder->Update();
+  segmentLabelmap->vtkImageData::DeepCopy(padder->GetOutput());
 
-  //
-  // Compute DVH for each selected segment
-  //
-  int counter = 1; // Start at one so that progress can reach 100%
-  int numberOfSelectedSegments = segmentationCopy->GetNumberOfSegments();
-  for (std::vector< std::string >::const_iterator segmentIdIt = segmentIDs.begin(); segmentIdIt != segmentIDs.end(); ++segmentIdIt, ++counter)
-  {
-    std::string segmentID = *segmentIdIt;
-    vtkSegment* segment = segmentationCopy->GetSegment(*segmentIdIt);
+  // Calculate DVH for current segment
+  job.ErrorMessage = ComputeDvhStatistics(segmentLabelmap, oversampledDoseVolume, settings, job.Statistics);
 
-    // Get segment labelmap
-#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
-    vtkSmartPointer<vtkOrientedImageData> segmentLabelmap = vtkOrientedImageData::SafeDownCast( segment->GetRepresentation(
-      representationName ) );
-    if (representationName == vtkSegmentationConverter::GetBinaryLabelmapRepresentationName())
-    {
-      vtkSmartPointer<vtkOrientedImageData> mergedLabelmap = segmentLabelmap;
-      vtkNew<vtkImageThreshold> threshold;
-      threshold->SetInputData(mergedLabelmap);
-      threshold->ThresholdBetween(segment->GetLabelValue(), segment->GetLabelValue());
-      threshold->SetInValue(1);
-      threshold->SetOutValue(0);
-      threshold->SetOutputScalarTypeToUnsignedChar();
-      threshold->Update();
-      segmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
-      segmentLabelmap->ShallowCopy(threshold->GetOutput());
-      segmentLabelmap->CopyDirections(mergedLabelmap);
-    }
-#else
-    vtkOrientedImageData* segmentLabelmap = vtkOrientedImageData::SafeDownCast( segment->GetRepresentation(
-      representationName ) );
-#endif
-
-    if (!segmentLabelmap)
-    {
-      std::string errorMessage("Failed to get labelmap for segments");
-      vtkErrorMacro("ComputeDvh: " << errorMessage);
-      return errorMessage;
-    }
-
-    double minimumValue = 0.0;
-    vtkDoubleArray* scalarRange = vtkDoubleArray::SafeDownCast(
-      segmentLabelmap->GetFieldData()->GetAbstractArray(vtkSegmentationConverter::GetScalarRangeFieldName()));
-    if (scalarRange && scalarRange->GetNumberOfValues() == 2)
-    {
-      minimumValue = scalarRange->GetValue(0);
-    }
-
-    // Apply parent transformation nodes if necessary
-    if (segmentationNode->GetParentTransformNode())
-    {
-      double backgroundValue[4] = {minimumValue, minimumValue, minimumValue, 0.0};
-      if (!vtkSlicerSegmentationsModuleLogic::ApplyParentTransformToOrientedImageData(segmentationNode, segmentLabelmap, useFractionalLabelmap, backgroundValue))
-      {
-        std::string errorMessage("Failed to apply parent transformation to segment");
-        vtkErrorMacro("ComputeDvh: " << errorMessage);
-        return errorMessage;
-      }
-      resamplingRequired = true;
-    }
-    // Resample labelmap if necessary (if it was master, and could not be re-converted using the oversampled geometry, or if there was a parent transform)
-    if (resamplingRequired)
-    {
-      // Resample segmentation labelmap volume
-      if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
-        segmentLabelmap, fixedOversampledDoseVolume, segmentLabelmap, useFractionalLabelmap, false, nullptr, minimumValue ) )
-      {
-        std::string errorMessage("Failed to resample segment binary labelmap");
-        vtkErrorMacro("ComputeDvh: " << errorMessage);
-        return errorMessage;
-      }
-    }
-
-    // Get oversampled dose volume
-    vtkSmartPointer<vtkOrientedImageData> oversampledDoseVolume;
-    // Use the same resampled dose volume if oversampling is fixed
-    if (!parameterNode->GetAutomaticOversampling())
-    {
-      oversampledDoseVolume = fixedOversampledDoseVolume;
-    }
-    // Resample dose volume to match automatically oversampled segment labelmap geometry
-    else
-    {
-      oversampledDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
-      if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
-        doseImageData, segmentLabelmap, oversampledDoseVolume, this->UseLinearInterpolationForDoseVolume ) )
-      {
-        std::string errorMessage("Failed to resample dose volume");
-        vtkErrorMacro("ComputeDvh: " << errorMessage);
-        return errorMessage;
-      }
-    }
-
-    // Make sure the segment labelmap is the same dimension as the dose volume
-    vtkSmartPointer<vtkImageConstantPad> padder = vtkSmartPointer<vtkImageConstantPad>::New();
-    padder->SetInputData(segmentLabelmap);
-    padder->SetConstant(minimumValue);
-    int extent[6] = {0,-1,0,-1,0,-1};
-    oversampledDoseVolume->GetExtent(extent);
-    padder->SetOutputWholeExtent(extent);
-    padder->Update();
-    segmentLabelmap->vtkImageData::DeepCopy(padder->GetOutput());
-
-    // Calculate DVH for current segment
-    std::string errorMessage = this->ComputeDvh(parameterNode, segmentLabelmap, oversampledDoseVolume, segmentID, maxDose);
-    if (!errorMessage.empty())
-    {
-      vtkErrorMacro("ComputeDvh: " << errorMessage);
-      return errorMessage;
-    }
-
-    // Update progress bar
-    double progress = (double)counter / (double)numberOfSelectedSegments;
-    this->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
-  } // For each segment
-
-  // Fire only one modified event when the computation is done
-  this->SetDisableModifiedEvent(0);
-  this->Modified();
-  parameterNode->EndModify(disabledNodeModify);
-  // Trigger update of table
-  if (parameterNode->GetMetricsTableNode())
-  {
-    parameterNode->GetMetricsTableNode()->Modified();
-  }
-
-  return "";
-}
+  // Release the input images as soon as possible
+  job.SegmentLabelmap = nullptr;
+  job.DoseVolume = nullptr;
+}
 
 //---------------------------------------------------------------------------
-std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolumeHistogramNode* parameterNode, vtkOrientedImageData* segmentLabelmap, vtkOrientedImageData* oversampledDoseVolume, std::string segmentID, double maxDoseGy)
+bool vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetCroppedExtent(
+  vtkOrientedImageData* segmentLabelmap, double backgroundValue, int doseExtent[6], int croppedExtent[6])
 {
-  if (!this->GetMRMLScene() || !parameterNode)
-  {
-    std::string errorMessage("Invalid MRML scene or parameter set node");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
-  }
-  if (!segmentLabelmap)
-  {
-    std::string errorMessage("Invalid segment labelmap");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
-  }
-  if (!oversampledDoseVolume)
+  const int margin = 1;
+  int effectiveExtent[6] = {0,-1,0,-1,0,-1};
+  if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(segmentLabelmap, effectiveExtent, backgroundValue))
   {
-    std::string errorMessage("Invalid oversampled dose volume");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    return false;
   }
-  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
-  vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
-  if ( !segmentationNode || !doseVolumeNode )
+  for (int axis=0; axis<3; ++axis)
   {
-    std::string errorMessage("Both segmentation node and dose volume node need to be set");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    croppedExtent[axis*2] = std::max(effectiveExtent[axis*2] - margin, doseExtent[axis*2]);
+    croppedExtent[axis*2+1] = std::min(effectiveExtent[axis*2+1] + margin, doseExtent[axis*2+1]);
+    if (croppedExtent[axis*2] > croppedExtent[axis*2+1])
+    {
+      return false;
+    }
   }
-  std::string segmentName = parameterNode->GetSegmentationNode()->GetSegmentation()->GetSegment(segmentID)->GetName();
-  bool isDoseVolume = vtkSlicerRtCommon::IsDoseVolumeNode(doseVolumeNode);
-
-  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
-  double checkpointStart = timer->GetUniversalTime();
-  UNUSED_VARIABLE(checkpointStart); // Although it is used later, a warning is logged so needs to be suppressed
+  return true;
+}
 
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeDvhStatistics(
+  vtkOrientedImageData* segmentLabelmap, vtkOrientedImageData* oversampledDoseVolume,
+  const DvhComputationSettings& settings, DvhStatistics& statistics)
+{
   // If the user has enabled the flag to calculate the dose surface histogram, then extract the surface from the labelmap
-  if (parameterNode->GetDoseSurfaceHistogram())
+  if (settings.DoseSurfaceHistogram)
   {
-    if (parameterNode->GetUseFractionalLabelmap())
+    if (settings.UseFractionalLabelmap)
     {
-      std::string errorMessage("Dose surface histogram is not currently supported for fractional labelmaps");
-      vtkErrorMacro("ComputeDvh: " << errorMessage);
-      return errorMessage;
+      return "Dose surface histogram is not currently supported for fractional labelmaps";
     }
 
     double dilateValue = 0.0;
     double erodeValue = 1.0;
-    if (!parameterNode->GetUseInsideDoseSurface())
+    if (!settings.UseInsideDoseSurface)
     {
       dilateValue = 1.0;
       erodeValue = 0.0;
@@ -522,7 +1018,7 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
 
     vtkNew<vtkImageMathematics> imageMathematics;
     imageMathematics->SetOperationToSubtract();
-    if (parameterNode->GetUseInsideDoseSurface())
+    if (settings.UseInsideDoseSurface)
     {
       imageMathematics->SetInput1Data(segmentLabelmap);
       imageMathematics->SetInputConnection(1, dilateErodeFilter->GetOutputPort());
@@ -546,7 +1042,6 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
   // which is a rare scenario, but may still happen.
   double minimumValue = 0.0;
   double maximumValue = 1.0;
-  segmentLabelmap->GetFieldData();
   vtkDoubleArray* scalarRange = vtkDoubleArray::SafeDownCast(
     segmentLabelmap->GetFieldData()->GetAbstractArray( vtkSegmentationConverter::GetScalarRangeFieldName() )
     );
@@ -556,7 +1051,7 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
     maximumValue = scalarRange->GetValue(1);
   }
 
-  bool useFractionalLabelmap = parameterNode->GetUseFractionalLabelmap();
+  bool useFractionalLabelmap = settings.UseFractionalLabelmap;
   if (useFractionalLabelmap)
   {
     stencil->ThresholdByUpper(minimumValue + 1e-10);
@@ -574,9 +1069,7 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
   structureStencil->GetExtent(stencilExtent);
   if (stencilExtent[1]-stencilExtent[0] <= 0 || stencilExtent[3]-stencilExtent[2] <= 0 || stencilExtent[5]-stencilExtent[4] <= 0)
   {
-    std::string errorMessage("Invalid stenciled dose volume");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    return "Invalid stenciled dose volume";
   }
 
   // Compute statistics
@@ -600,243 +1093,1845 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
   // Report error if there are no voxels in the stenciled dose volume (no non-zero voxels in the resampled labelmap)
   if (structureStat->GetVoxelCount() < 1)
   {
-    std::string errorMessage("Dose volume and the structure do not overlap"); // User-friendly error to help troubleshooting
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return "Dose volume and the structure do not overlap"; // User-friendly error to help troubleshooting
+  }
+
+  // Get spacing and voxel volume
+  double* segmentLabelmapSpacing = segmentLabelmap->GetSpacing();
+  statistics.CubicMMPerVoxel = segmentLabelmapSpacing[0] * segmentLabelmapSpacing[1] * segmentLabelmapSpacing[2];
+  if (useFractionalLabelmap)
+  {
+    statistics.VoxelCount = vtkFractionalImageAccumulate::SafeDownCast(structureStat)->GetFractionalVoxelCount();
+  }
+  else
+  {
+    statistics.VoxelCount = structureStat->GetVoxelCount();
+  }
+  statistics.MeanDose = structureStat->GetMean()[0];
+  statistics.MinDose = structureStat->GetMin()[0];
+  statistics.MaxDose = structureStat->GetMax()[0];
+
+  // Create DVH plot values
+  int numSamples = 0;
+  double startValue = 0.0;
+  double stepSize = 0.0;
+  std::string errorMessage = ComputeDvhBins(settings, structureStat->GetMin()[0], structureStat->GetMax()[0], startValue, stepSize, numSamples);
+  if (!errorMessage.empty())
+  {
     return errorMessage;
   }
+  statistics.StartValue = startValue;
+  statistics.StepSize = stepSize;
 
-  // Get metrics table for the parameter node; Create one if missing
-  vtkMRMLTableNode* metricsTableNode = parameterNode->GetMetricsTableNode();
-  vtkTable* metricsTable = metricsTableNode->GetTable();
-  // Setup table if empty
-  if (metricsTable->GetNumberOfColumns() == 0)
+  // Get the number of voxels with smaller dose than at the start value
+  structureStat->SetComponentExtent(0,1,0,0,0,0);
+  structureStat->SetComponentOrigin(0,0,0);
+  structureStat->SetComponentSpacing(startValue,1,1);
+  structureStat->Update();
+  statistics.VoxelsBelowStartValue = structureStat->GetOutput()->GetScalarComponentAsDouble(0,0,0,0);
+
+  structureStat->SetComponentExtent(0,numSamples-1,0,0,0,0);
+  structureStat->SetComponentOrigin(startValue,0,0);
+  structureStat->SetComponentSpacing(stepSize,1,1);
+  structureStat->Update();
+
+  vtkImageData* statArray = structureStat->GetOutput();
+  statistics.Histogram.resize(std::max(numSamples, 0));
+  for (int sampleIndex=0; sampleIndex<numSamples; ++sampleIndex)
   {
-    this->InitializeMetricsTable(parameterNode);
+    statistics.Histogram[sampleIndex] = statArray->GetScalarComponentAsDouble(sampleIndex,0,0,0);
   }
 
-  // Get DVH table node for the inputs (dose volume, segmentation, segment).
-  // If found, then it gets overwritten by the new computation, otherwise
-  std::string structureDvhNodeRef = parameterNode->AssembleDvhNodeReference(segmentID);
-  vtkMRMLTableNode* tableNode = vtkMRMLTableNode::SafeDownCast(metricsTableNode->GetNodeReference(structureDvhNodeRef.c_str()));
-  int tableRow = -1;
-  if (!tableNode)
+  return ""; // No error
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeDvhBins(const DvhComputationSettings& settings,
+  double rangeMin, double rangeMax, double& startValue, double& stepSize, int& numberOfSamples)
+{
+  if (settings.IsDoseVolume)
   {
-    // Create DVH table node
-    tableNode = vtkMRMLTableNode::New();
-    std::string dvhTableNodeName = segmentID + DVH_TABLE_NODE_NAME_POSTFIX;
-    dvhTableNodeName = this->GetMRMLScene()->GenerateUniqueName(dvhTableNodeName);
-    tableNode->SetName(dvhTableNodeName.c_str());
-    tableNode->SetAttribute(DVH_DVH_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1");
-    vtkNew<vtkTable> table;
-    tableNode->SetAndObserveTable(table);
-    this->GetMRMLScene()->AddNode(tableNode);
+    if (rangeMin<0)
+    {
+      return "The dose volume contains negative dose values";
+    }
 
-    //TODO: Add schema?
+    startValue = settings.StartValue;
+    stepSize = settings.StepSize;
+    numberOfSamples = (int)ceil( (settings.MaxDose-startValue)/stepSize ) + 1;
+  }
+  else
+  {
+    startValue = rangeMin;
+    numberOfSamples = settings.NumberOfSamplesForNonDoseVolumes;
+    stepSize = (rangeMax - rangeMin) / (double)(numberOfSamples-1);
+  }
+  return ""; // No error
+}
 
-    // Add new row in metrics table
-    tableRow = metricsTable->GetNumberOfRows();
-    std::stringstream ss;
-    ss << tableRow;
-    tableNode->SetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str(), ss.str().c_str());
-    tableNode->Delete(); // Release ownership to scene only
-    metricsTable->InsertNextBlankRow();
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeSegmentDvhJobs(
+  std::vector<SegmentDvhJob>& jobs, const DvhComputationSettings& settings, int numberOfThreads,
+  SegmentDvhJobFunction jobFunction/*=ComputeSegmentDvhJob*/, double progressScale/*=1.0*/)
+{
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  }
+  numberOfThreads = std::min(numberOfThreads, static_cast<int>(jobs.size()));
 
-    // Dose surface histogram attributes
-    if (parameterNode->GetDoseSurfaceHistogram())
+  SegmentDvhJobQueue queue;
+  queue.Jobs = &jobs;
+  queue.Settings = &settings;
+  queue.JobFunction = jobFunction;
+  queue.Logic = this->External;
+  queue.ProgressScale = progressScale;
+
+  if (numberOfThreads <= 1)
+  {
+    // Compute segments one after the other on the calling thread
+    ProcessSegmentDvhJobQueue(&queue, true);
+    return;
+  }
+
+  // The calling thread also processes jobs (as thread 0) and it is the only one reporting progress
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(vtkInternal::ComputeSegmentDvhJobsThreadFunction, &queue);
+  threader->SingleMethodExecute();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ProcessSegmentDvhJobQueue(SegmentDvhJobQueue* queue, bool reportProgress)
+{
+  size_t numberOfJobs = queue->Jobs->size();
+  for (size_t jobIndex = queue->NextJobIndex++; jobIndex < numberOfJobs && !queue->Failed; jobIndex = queue->NextJobIndex++)
+  {
+    SegmentDvhJob& job = (*queue->Jobs)[jobIndex];
+    queue->JobFunction(job, *queue->Settings);
+    if (!job.ErrorMessage.empty())
     {
-      tableNode->SetAttribute(DVH_SURFACE_ATTRIBUTE_NAME.c_str(), "1");
-      tableNode->SetAttribute(DVH_SURFACE_INSIDE_ATTRIBUTE_NAME.c_str(), parameterNode->GetUseInsideDoseSurface() ? "1" : "0");
+      // Results are stored in the order of the segments until the first failure, so the rest is not needed
+      queue->Failed = true;
     }
 
-    // Set node references
-    metricsTableNode->SetNodeReferenceID(structureDvhNodeRef.c_str(), tableNode->GetID());
-    tableNode->SetNodeReferenceID(vtkMRMLDoseVolumeHistogramNode::DOSE_VOLUME_REFERENCE_ROLE, doseVolumeNode->GetID());
-    tableNode->SetNodeReferenceID(vtkMRMLDoseVolumeHistogramNode::SEGMENTATION_REFERENCE_ROLE, segmentationNode->GetID());
-    tableNode->SetNodeReferenceID(vtkMRMLDoseVolumeHistogramNode::DVH_METRICS_TABLE_REFERENCE_ROLE, metricsTableNode->GetID());
+    size_t numberOfCompletedJobs = ++queue->NumberOfCompletedJobs;
+    if (reportProgress && queue->Settings->ReportProgress)
+    {
+      double progress = queue->ProgressScale * (double)numberOfCompletedJobs / (double)numberOfJobs;
+      queue->Logic->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
+    }
   }
-  else if (tableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str()))
+}
+
+//---------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeSegmentDvhJobsThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  SegmentDvhJobQueue* queue = static_cast<SegmentDvhJobQueue*>(threadInfo->UserData);
+  ProcessSegmentDvhJobQueue(queue, threadInfo->WorkID == 0);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeDoseDvhTask(DoseDvhTask& task)
+{
+  DvhComputationSettings& settings = task.Settings;
+
+  // Resample the dose to the fixed oversampled geometry the labelmaps were prepared on
+  if (!settings.AutomaticOversampling)
   {
-    tableRow = vtkVariant(tableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str())).ToInt();
+    vtkSmartPointer<vtkOrientedImageData> fixedOversampledDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+    if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+      task.DoseImageData, settings.FixedOversampledDoseVolume, fixedOversampledDoseVolume, true ) )
+    {
+      task.ErrorMessage = "Failed to resample dose volume";
+      return;
+    }
+    settings.FixedOversampledDoseVolume = fixedOversampledDoseVolume;
+  }
+
+  for (SegmentDvhJob& job : task.Jobs)
+  {
+    job.DoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+    job.DoseVolume->ShallowCopy(settings.AutomaticOversampling ? task.DoseImageData.GetPointer() : settings.FixedOversampledDoseVolume.GetPointer());
+  }
+
+  // The segments of the dose are computed on the current thread
+  if (this->External->UseSinglePassAccumulation && !settings.AutomaticOversampling && !settings.DoseSurfaceHistogram)
+  {
+    this->ComputeSegmentDvhJobsSinglePass(task.Jobs, settings, 1);
   }
   else
   {
-    std::string errorMessage("Failed to find metrics table row for structure " + segmentName);
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    this->ComputeSegmentDvhJobs(task.Jobs, settings, 1);
   }
 
-  // Set table node attributes:
-  // Structure name and segment color for visualization in the chart view
-  tableNode->SetAttribute(DVH_SEGMENT_ID_ATTRIBUTE_NAME.c_str(), segmentID.c_str());
-  // Oversampling factor
-  std::ostringstream oversamplingAttrValueStream;
-  oversamplingAttrValueStream << (parameterNode->GetAutomaticOversampling() ? (-1.0) : this->DefaultDoseVolumeOversamplingFactor);
-  tableNode->SetAttribute(DVH_DOSE_VOLUME_OVERSAMPLING_FACTOR_ATTRIBUTE_NAME.c_str(), oversamplingAttrValueStream.str().c_str());
+  // Release the dose volumes as soon as possible
+  settings.FixedOversampledDoseVolume = nullptr;
+  task.DoseImageData = nullptr;
+  task.DoseCache.Clear();
+}
 
-  // Get spacing and voxel volume
-  double* segmentLabelmapSpacing = segmentLabelmap->GetSpacing();
-  double cubicMMPerVoxel = segmentLabelmapSpacing[0] * segmentLabelmapSpacing[1] * segmentLabelmapSpacing[2];
-  double ccPerCubicMM = 0.001;
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeDoseDvhTasks(std::vector<DoseDvhTask*>& tasks, int numberOfThreads)
+{
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  }
+  numberOfThreads = std::min(numberOfThreads, static_cast<int>(tasks.size()));
 
-  // Set default column values
+  DoseDvhTaskQueue queue;
+  queue.Tasks = &tasks;
+  queue.Internal = this;
 
-  // Structure name
-  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnStructure, vtkVariant(segmentName));
-  // Volume name
-  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnDoseVolume, vtkVariant(doseVolumeNode->GetName()));
-  // Volume (cc) - save as attribute too (the DVH contains percentages that often need to be converted to volume)
-  double volumeCc = 0;
-  if (useFractionalLabelmap)
+  if (numberOfThreads <= 1)
   {
-    volumeCc = vtkFractionalImageAccumulate::SafeDownCast(structureStat)->GetFractionalVoxelCount() * cubicMMPerVoxel * ccPerCubicMM;
+    ProcessDoseDvhTaskQueue(&queue, true);
+    return;
   }
-  else
+
+  // The calling thread also processes tasks (as thread 0) and it is the only one reporting progress
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(vtkInternal::ComputeDoseDvhTasksThreadFunction, &queue);
+  threader->SingleMethodExecute();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ProcessDoseDvhTaskQueue(DoseDvhTaskQueue* queue, bool reportProgress)
+{
+  size_t numberOfTasks = queue->Tasks->size();
+  for (size_t taskIndex = queue->NextTaskIndex++; taskIndex < numberOfTasks; taskIndex = queue->NextTaskIndex++)
   {
-    volumeCc = structureStat->GetVoxelCount() * cubicMMPerVoxel * ccPerCubicMM;
+    queue->Internal->ComputeDoseDvhTask(*(*queue->Tasks)[taskIndex]);
+
+    size_t numberOfCompletedTasks = ++queue->NumberOfCompletedTasks;
+    if (reportProgress)
+    {
+      double progress = (double)numberOfCompletedTasks / (double)numberOfTasks;
+      queue->Internal->External->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeDoseDvhTasksThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  DoseDvhTaskQueue* queue = static_cast<DoseDvhTaskQueue*>(threadInfo->UserData);
+  ProcessDoseDvhTaskQueue(queue, threadInfo->WorkID == 0);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeSegmentDvhJobsSinglePass(
+  std::vector<SegmentDvhJob>& jobs, const DvhComputationSettings& settings, int numberOfThreads)
+{
+  if (jobs.empty())
+  {
+    return;
+  }
+  vtkOrientedImageData* doseVolume = settings.FixedOversampledDoseVolume;
+  if (!doseVolume)
+  {
+    jobs[0].ErrorMessage = "Invalid oversampled dose volume";
+    return;
+  }
+
+  // Bring the labelmaps to the lattice of the oversampled dose volume (first half of the progress)
+  this->ComputeSegmentDvhJobs(jobs, settings, numberOfThreads, PrepareSegmentLabelmapJob, 0.5);
+
+  // Only the segments before the first failure are needed, as the results are stored in segment order
+  std::vector<DvhAccumulator> accumulators(jobs.size());
+  std::vector<DvhAccumulator*> activeAccumulators;
+  for (size_t jobIndex = 0; jobIndex < jobs.size() && jobs[jobIndex].ErrorMessage.empty(); ++jobIndex)
+  {
+    DvhAccumulator& accumulator = accumulators[jobIndex];
+    InitializeDvhAccumulator(accumulator, jobs[jobIndex].SegmentLabelmap, settings);
+    activeAccumulators.push_back(&accumulator);
+  }
+  size_t numberOfActiveJobs = activeAccumulators.size();
+
+  // The dose axis is known in advance for dose volumes, so statistics and histograms are accumulated in the same sweep.
+  // For other volumes the axis depends on the intensity range within the segment, so an additional sweep is needed
+  double startValue = 0.0;
+  double stepSize = 0.0;
+  int numberOfSamples = 0;
+  if (settings.IsDoseVolume)
+  {
+    ComputeDvhBins(settings, 0.0, 0.0, startValue, stepSize, numberOfSamples);
+    for (DvhAccumulator* accumulator : activeAccumulators)
+    {
+      accumulator->StartValue = startValue;
+      accumulator->StepSize = stepSize;
+      accumulator->Histogram.assign(std::max(numberOfSamples, 0), 0.0);
+    }
+    vtkAccumulateDvhSinglePass(doseVolume, activeAccumulators, true, true);
+  }
+  else
+  {
+    vtkAccumulateDvhSinglePass(doseVolume, activeAccumulators, true, false);
+    std::vector<DvhAccumulator*> nonEmptyAccumulators;
+    for (DvhAccumulator* accumulator : activeAccumulators)
+    {
+      if (accumulator->VoxelCount < 1)
+      {
+        continue;
+      }
+      ComputeDvhBins(settings, accumulator->Min, accumulator->Max, startValue, stepSize, numberOfSamples);
+      accumulator->StartValue = startValue;
+      accumulator->StepSize = stepSize;
+      accumulator->Histogram.assign(std::max(numberOfSamples, 0), 0.0);
+      nonEmptyAccumulators.push_back(accumulator);
+    }
+    vtkAccumulateDvhSinglePass(doseVolume, nonEmptyAccumulators, false, true);
+  }
+
+  // Assemble statistics, with the same error checks as in ComputeDvhStatistics
+  int doseExtent[6] = {0,-1,0,-1,0,-1};
+  doseVolume->GetExtent(doseExtent);
+  for (size_t jobIndex = 0; jobIndex < numberOfActiveJobs; ++jobIndex)
+  {
+    SegmentDvhJob& job = jobs[jobIndex];
+    DvhAccumulator& accumulator = accumulators[jobIndex];
+    double* segmentLabelmapSpacing = accumulator.Labelmap->GetSpacing();
+    job.ErrorMessage = GetDvhStatisticsFromAccumulator(accumulator, doseExtent,
+      segmentLabelmapSpacing[0] * segmentLabelmapSpacing[1] * segmentLabelmapSpacing[2], settings, job.Statistics);
+    if (!job.ErrorMessage.empty())
+    {
+      break;
+    }
+  }
+
+  // Release the prepared labelmaps
+  for (SegmentDvhJob& job : jobs)
+  {
+    job.SegmentLabelmap = nullptr;
+    job.DoseVolume = nullptr;
+  }
+
+  if (settings.ReportProgress)
+  {
+    double progress = 1.0;
+    this->External->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
+  }
+}
+
+//---------------------------------------------------------------------------
+const char* vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetLabelmapRepresentationName(bool useFractionalLabelmap)
+{
+  if (useFractionalLabelmap)
+  {
+    return vtkSegmentationConverter::GetSegmentationFractionalLabelmapRepresentationName();
+  }
+  return vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::InitializeDvhAccumulator(
+  DvhAccumulator& accumulator, vtkOrientedImageData* segmentLabelmap, const DvhComputationSettings& settings)
+{
+  double minimumValue = 0.0;
+  double maximumValue = 1.0;
+  vtkDoubleArray* scalarRange = vtkDoubleArray::SafeDownCast(
+    segmentLabelmap->GetFieldData()->GetAbstractArray( vtkSegmentationConverter::GetScalarRangeFieldName() ) );
+  if (scalarRange && scalarRange->GetNumberOfValues() == 2)
+  {
+    minimumValue = scalarRange->GetValue(0);
+    maximumValue = scalarRange->GetValue(1);
+  }
+
+  accumulator.Labelmap = segmentLabelmap;
+  accumulator.UseFractionalLabelmap = settings.UseFractionalLabelmap;
+  accumulator.Threshold = (settings.UseFractionalLabelmap ? minimumValue + 1e-10 : 1e-10);
+  accumulator.MinimumFractionalValue = minimumValue;
+  accumulator.MaximumFractionalValue = maximumValue;
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetDvhStatisticsFromAccumulator(DvhAccumulator& accumulator,
+  int doseExtent[6], double cubicMMPerVoxel, const DvhComputationSettings& settings, DvhStatistics& statistics)
+{
+  if (doseExtent[1]-doseExtent[0] <= 0 || doseExtent[3]-doseExtent[2] <= 0 || doseExtent[5]-doseExtent[4] <= 0)
+  {
+    return "Invalid stenciled dose volume";
+  }
+  if (accumulator.VoxelCount < 1)
+  {
+    return "Dose volume and the structure do not overlap"; // User-friendly error to help troubleshooting
+  }
+  double startValue = 0.0;
+  double stepSize = 0.0;
+  int numberOfSamples = 0;
+  std::string errorMessage = ComputeDvhBins(settings, accumulator.Min, accumulator.Max, startValue, stepSize, numberOfSamples);
+  if (!errorMessage.empty())
+  {
+    return errorMessage;
+  }
+
+  statistics.CubicMMPerVoxel = cubicMMPerVoxel;
+  double voxelCount = (settings.UseFractionalLabelmap ? accumulator.FractionalVoxelCount : static_cast<double>(accumulator.VoxelCount));
+  statistics.VoxelCount = voxelCount;
+  statistics.MeanDose = (voxelCount != 0.0 ? accumulator.Sum / voxelCount : 0.0);
+  statistics.MinDose = accumulator.Min;
+  statistics.MaxDose = accumulator.Max;
+  statistics.StartValue = accumulator.StartValue;
+  statistics.StepSize = accumulator.StepSize;
+  statistics.VoxelsBelowStartValue = accumulator.VoxelsBelowStartValue;
+  statistics.Histogram.swap(accumulator.Histogram);
+  return ""; // No error
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetSegmentLabelmaps(
+  vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+  vtkOrientedImageData* doseImageData, const DvhComputationSettings& settings, std::vector<SegmentLabelmapCacheEntry>& segmentLabelmaps)
+{
+  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
+  vtkSegmentation* selectedSegmentation = segmentationNode->GetSegmentation();
+
+  // Use dose volume geometry as reference, with oversampling of fixed 2 or automatic (as selected)
+  std::string doseGeometryString = vtkSegmentationConverter::SerializeImageGeometry(doseImageData);
+  std::stringstream fixedOversamplingValueStream;
+  fixedOversamplingValueStream << this->External->DefaultDoseVolumeOversamplingFactor;
+  std::string oversamplingValue = (parameterNode->GetAutomaticOversampling() ? "A" : fixedOversamplingValueStream.str());
+
+  const char* representationName = GetLabelmapRepresentationName(settings.UseFractionalLabelmap);
+
+  // Reuse the labelmaps of the segments that have not changed since the last computation on the same dose geometry
+  if (!this->External->UseComputationCache)
+  {
+    this->ClearCache();
+  }
+  segmentLabelmaps.clear();
+  segmentLabelmaps.resize(segmentIDs.size());
+  std::vector<std::string> segmentIDsToConvert;
+  for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+  {
+    if (this->External->UseComputationCache)
+    {
+      segmentLabelmaps[segmentIndex].Key = GetSegmentLabelmapCacheKey(selectedSegmentation, segmentIDs[segmentIndex],
+        representationName, doseGeometryString, oversamplingValue);
+      if (this->FindCachedSegmentLabelmap(segmentationNode, segmentIDs[segmentIndex], segmentLabelmaps[segmentIndex]))
+      {
+        continue;
+      }
+    }
+    segmentIDsToConvert.push_back(segmentIDs[segmentIndex]);
+  }
+
+  if (!segmentIDsToConvert.empty())
+  {
+    // Temporarily duplicate selected segments to contain binary labelmap of a different geometry (tied to dose volume)
+    vtkSmartPointer<vtkSegmentation> segmentationCopy = vtkSmartPointer<vtkSegmentation>::New();
+#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
+    segmentationCopy->SetSourceRepresentationName(selectedSegmentation->GetSourceRepresentationName());
+#else
+    segmentationCopy->SetMasterRepresentationName(selectedSegmentation->GetMasterRepresentationName());
+#endif
+    segmentationCopy->CopyConversionParameters(selectedSegmentation);
+    for (std::vector<std::string>::iterator segmentIt = segmentIDsToConvert.begin(); segmentIt != segmentIDsToConvert.end(); ++segmentIt)
+    {
+      segmentationCopy->CopySegmentFromSegmentation(selectedSegmentation, (*segmentIt));
+    }
+
+    segmentationCopy->SetConversionParameter( vtkSegmentationConverter::GetReferenceImageGeometryParameterName(),
+      doseGeometryString );
+    segmentationCopy->SetConversionParameter( vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(),
+      oversamplingValue );
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    // We don't want to try to merge the labelmaps since if they have different oversampling factors, they would conflict.
+    // Could perhaps leave the labelmaps merged if there is a performance increase, but for now merging will be disabled for DVH calculation.
+    segmentationCopy->SetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetCollapseLabelmapsParameterName(), "0");
+#endif
+
+    bool resamplingRequired = false;
+    if ( !segmentationCopy->CreateRepresentation(representationName, true) )
+    {
+      // If conversion failed and there is no binary labelmap in the segmentation, then cannot calculate DVH
+      if (!segmentationCopy->ContainsRepresentation(representationName) )
+      {
+        return "Unable to acquire binary labelmap from segmentation";
+      }
+
+      // If conversion failed, then resample binary labelmaps in the segments
+      resamplingRequired = true;
+    }
+
+    for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+    {
+      SegmentLabelmapCacheEntry& segmentLabelmap = segmentLabelmaps[segmentIndex];
+      vtkSegment* segment = segmentationCopy->GetSegment(segmentIDs[segmentIndex]);
+      if (segmentLabelmap.Labelmap || !segment)
+      {
+        continue;
+      }
+      segmentLabelmap.Labelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(representationName));
+      if (!segmentLabelmap.Labelmap)
+      {
+        return "Failed to get labelmap for segments";
+      }
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+      segmentLabelmap.LabelValue = segment->GetLabelValue();
+#endif
+      segmentLabelmap.ResamplingRequired = resamplingRequired;
+      if (this->External->UseComputationCache)
+      {
+        this->AddCachedSegmentLabelmap(segmentationNode, segmentIDs[segmentIndex], segmentLabelmap);
+      }
+    }
+  }
+  if (this->External->UseComputationCache)
+  {
+    // The labelmaps of the current computation are referenced by the output, so evicting them only affects later computations
+    this->PruneSegmentLabelmapCache(this->External->GetMRMLScene(), parameterNode->GetMemoryLimitMB());
+  }
+
+  // Calculate and store oversampling factors if automatically calculated for reporting purposes
+  if (parameterNode->GetAutomaticOversampling())
+  {
+    // Get spacing for dose volume
+    double doseSpacing[3] = {0.0,0.0,0.0};
+    doseImageData->GetSpacing(doseSpacing);
+
+    // Calculate oversampling factors for all segments (need to calculate as it is not stored per segment)
+    for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+    {
+      std::string segmentID = segmentIDs[segmentIndex];
+      vtkOrientedImageData* currentLabelmap = segmentLabelmaps[segmentIndex].Labelmap;
+      if (!currentLabelmap)
+      {
+        return "Representation missing after converting with automatic oversampling factor";
+      }
+      double currentSpacing[3] = {0.0,0.0,0.0};
+      currentLabelmap->GetSpacing(currentSpacing);
+
+      double voxelSizeRatio = ((doseSpacing[0]*doseSpacing[1]*doseSpacing[2]) / (currentSpacing[0]*currentSpacing[1]*currentSpacing[2]));
+      // Round oversampling to two decimals
+      // Note: We need to round to some degree, because e.g. pow(64,1/3) is not exactly 4. It may be debated whether to round to integer or to a certain number of decimals
+      double oversamplingFactor = vtkMath::Round( pow( voxelSizeRatio, 1.0/3.0 ) * 100.0 ) / 100.0;
+      parameterNode->AddAutomaticOversamplingFactor(segmentID, oversamplingFactor);
+    }
+  }
+
+  return ""; // No error
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeSegmentDvhJobsInCore(
+  vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+  vtkOrientedImageData* doseImageData, DvhComputationSettings& settings, std::vector<SegmentDvhJob>& jobs)
+{
+  std::vector<SegmentLabelmapCacheEntry> segmentLabelmaps;
+  std::string errorMessage = this->GetSegmentLabelmaps(parameterNode, segmentIDs, doseImageData, settings, segmentLabelmaps);
+  if (!errorMessage.empty())
+  {
+    return errorMessage;
+  }
+
+  // Cached oversampled dose volumes are valid while the dose voxels, its geometry, and the interpolation are unchanged
+  if (this->External->UseComputationCache)
+  {
+    vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
+    std::string doseGeometryString = vtkSegmentationConverter::SerializeImageGeometry(doseImageData);
+    std::ostringstream doseKeyStream;
+    doseKeyStream << doseVolumeNode->GetID() << "|" << doseVolumeNode->GetImageData()->GetMTime()
+      << "|" << doseGeometryString << "|" << this->External->UseLinearInterpolationForDoseVolume;
+    this->UpdateDoseCacheKey(doseKeyStream.str());
+  }
+
+  // Use the same resampled dose volume if oversampling is fixed
+  vtkSmartPointer<vtkOrientedImageData> fixedOversampledDoseVolume;
+  if (!parameterNode->GetAutomaticOversampling())
+  {
+    if ( this->External->UseComputationCache && this->FixedOversampledDoseVolume
+      && this->FixedOversamplingFactor == this->External->DefaultDoseVolumeOversamplingFactor )
+    {
+      fixedOversampledDoseVolume = this->FixedOversampledDoseVolume;
+    }
+    else
+    {
+      // Get geometry of oversampled dose volume
+      fixedOversampledDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+      fixedOversampledDoseVolume->ShallowCopy(doseImageData);
+      vtkCalculateOversamplingFactor::ApplyOversamplingOnImageGeometry(fixedOversampledDoseVolume, this->External->DefaultDoseVolumeOversamplingFactor);
+
+      // Resample dose volume using linear interpolation
+      if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+        doseImageData, fixedOversampledDoseVolume, fixedOversampledDoseVolume, true ) )
+      {
+        return "Failed to resample dose volume";
+      }
+      if (this->External->UseComputationCache)
+      {
+        this->FixedOversampledDoseVolume = fixedOversampledDoseVolume;
+        this->FixedOversamplingFactor = this->External->DefaultDoseVolumeOversamplingFactor;
+      }
+    }
+  }
+
+  settings.FixedOversampledDoseVolume = fixedOversampledDoseVolume;
+  settings.DoseCache = (this->External->UseComputationCache ? &this->AutomaticOversampledDoseVolumes : nullptr);
+
+  // Each job gets its own shallow copy of the input images so that the worker threads do not share data objects
+  jobs.resize(segmentIDs.size());
+  for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+  {
+    SegmentDvhJob& job = jobs[segmentIndex];
+    job.SegmentID = segmentIDs[segmentIndex];
+
+    // Get segment labelmap
+    vtkOrientedImageData* segmentLabelmap = segmentLabelmaps[segmentIndex].Labelmap;
+    if (!segmentLabelmap)
+    {
+      return "Failed to get labelmap for segments";
+    }
+    job.SegmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    job.SegmentLabelmap->ShallowCopy(segmentLabelmap);
+    job.LabelValue = segmentLabelmaps[segmentIndex].LabelValue;
+    job.ResamplingRequired = segmentLabelmaps[segmentIndex].ResamplingRequired;
+
+    // Use the same resampled dose volume if oversampling is fixed, otherwise the dose is resampled to the segment labelmap
+    job.DoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+    job.DoseVolume->ShallowCopy(parameterNode->GetAutomaticOversampling() ? doseImageData : fixedOversampledDoseVolume.GetPointer());
+  }
+
+  if (this->External->UseSinglePassAccumulation && !settings.AutomaticOversampling && !settings.DoseSurfaceHistogram)
+  {
+    // All labelmaps are on the lattice of the fixed oversampled dose, so the dose can be swept through once for all segments
+    this->ComputeSegmentDvhJobsSinglePass(jobs, settings, parameterNode->GetNumberOfThreads());
+  }
+  else
+  {
+    this->ComputeSegmentDvhJobs(jobs, settings, parameterNode->GetNumberOfThreads());
+  }
+
+
+  return ""; // No error
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::IsStreamingRequired(vtkMRMLDoseVolumeHistogramNode* parameterNode,
+  const std::vector<std::string>& segmentIDs, vtkOrientedImageData* doseImageData, const DvhComputationSettings& settings,
+  std::vector<double>& oversamplingFactors)
+{
+  int memoryLimitMB = parameterNode->GetMemoryLimitMB();
+  if (memoryLimitMB <= 0 || segmentIDs.empty())
+  {
+    return false;
+  }
+  if (settings.DoseSurfaceHistogram || settings.SegmentationToWorldTransform)
+  {
+    vtkWarningWithObjectMacro(this->External, "IsStreamingRequired: Slab-wise DVH computation is not supported for dose surface histograms "
+      "and transformed segmentations, so the memory limit is ignored");
+    return false;
+  }
+
+  vtkSegmentation* segmentation = parameterNode->GetSegmentationNode()->GetSegmentation();
+  oversamplingFactors.assign(segmentIDs.size(), this->External->DefaultDoseVolumeOversamplingFactor);
+  if (settings.AutomaticOversampling)
+  {
+    // Determine the oversampling factors from the closed surfaces the same way as the conversion does, without converting the segments
+#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
+    std::string sourceRepresentationName = segmentation->GetSourceRepresentationName();
+#else
+    std::string sourceRepresentationName = segmentation->GetMasterRepresentationName();
+#endif
+    if (sourceRepresentationName != vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName())
+    {
+      vtkWarningWithObjectMacro(this->External, "IsStreamingRequired: Slab-wise DVH computation with automatic oversampling "
+        "requires closed surface source representation, so the memory limit is ignored");
+      return false;
+    }
+    for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+    {
+      vtkSegment* segment = segmentation->GetSegment(segmentIDs[segmentIndex]);
+      vtkPolyData* closedSurface = (segment ? vtkPolyData::SafeDownCast(segment->GetRepresentation(sourceRepresentationName)) : nullptr);
+      double oversamplingFactor = 1.0;
+      vtkNew<vtkCalculateOversamplingFactor> oversamplingCalculator;
+      oversamplingCalculator->SetInputPolyData(closedSurface);
+      oversamplingCalculator->SetReferenceGeometryImageData(doseImageData);
+      if (closedSurface && oversamplingCalculator->CalculateOversamplingFactor())
+      {
+        oversamplingFactor = oversamplingCalculator->GetOutputOversamplingFactor();
+      }
+      oversamplingFactors[segmentIndex] = oversamplingFactor;
+    }
+  }
+
+  // Estimate the memory needed by the oversampled dose volumes and the segment labelmaps
+  int* doseExtent = doseImageData->GetExtent();
+  double numberOfDoseVoxels = static_cast<double>(doseExtent[1]-doseExtent[0]+1)
+    * static_cast<double>(doseExtent[3]-doseExtent[2]+1) * static_cast<double>(doseExtent[5]-doseExtent[4]+1);
+  std::set<double> distinctOversamplingFactors;
+  double requiredBytes = 0.0;
+  for (double oversamplingFactor : oversamplingFactors)
+  {
+    double numberOfVoxels = numberOfDoseVoxels * oversamplingFactor * oversamplingFactor * oversamplingFactor;
+    requiredBytes += numberOfVoxels * sizeof(unsigned char);
+    if (distinctOversamplingFactors.insert(oversamplingFactor).second)
+    {
+      requiredBytes += numberOfVoxels * doseImageData->GetScalarSize();
+    }
+  }
+  return (requiredBytes > memoryLimitMB * 1024.0 * 1024.0);
+}
+
+//---------------------------------------------------------------------------
+vtkSmartPointer<vtkOrientedImageData> vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::CreateOversampledGeometry(
+  vtkOrientedImageData* imageData, double oversamplingFactor)
+{
+  vtkSmartPointer<vtkOrientedImageData> geometry = vtkSmartPointer<vtkOrientedImageData>::New();
+  geometry->SetExtent(imageData->GetExtent());
+  geometry->SetOrigin(imageData->GetOrigin());
+  geometry->SetSpacing(imageData->GetSpacing());
+  geometry->CopyDirections(imageData);
+  vtkCalculateOversamplingFactor::ApplyOversamplingOnImageGeometry(geometry, oversamplingFactor);
+  return geometry;
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetNumberOfSlicesPerSlab(vtkOrientedImageData* geometry, int doseScalarSize, int memoryLimitMB)
+{
+  int* extent = geometry->GetExtent();
+  double numberOfVoxelsPerSlice = static_cast<double>(extent[1]-extent[0]+1) * static_cast<double>(extent[3]-extent[2]+1);
+  // Resampled dose, and the converted and the extracted labelmap of one segment
+  double bytesPerSlice = numberOfVoxelsPerSlice * (doseScalarSize + 2 * sizeof(unsigned char));
+  double numberOfSlices = floor(memoryLimitMB * 1024.0 * 1024.0 / std::max(bytesPerSlice, 1.0));
+  return static_cast<int>(std::max(1.0, std::min(numberOfSlices, static_cast<double>(extent[5]-extent[4]+1))));
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::RasterizeSegmentSlab(vtkSegmentation* segmentation,
+  vtkOrientedImageData* slabGeometry, const DvhComputationSettings& settings, SegmentDvhJob& job)
+{
+  const char* representationName = GetLabelmapRepresentationName(settings.UseFractionalLabelmap);
+
+  // The job is reused for every slab, so the labelmap prepared for the previous slab is discarded
+  job.SegmentLabelmap = nullptr;
+  job.LabelmapPrepared = false;
+
+  // The slab geometry is already oversampled
+  segmentation->SetConversionParameter( vtkSegmentationConverter::GetReferenceImageGeometryParameterName(),
+    vtkSegmentationConverter::SerializeImageGeometry(slabGeometry) );
+  segmentation->SetConversionParameter( vtkClosedSurfaceToBinaryLabelmapConversionRule::GetOversamplingFactorParameterName(), "1" );
+
+  bool resamplingRequired = false;
+  if ( !segmentation->CreateRepresentation(representationName, true) )
+  {
+    if (!segmentation->ContainsRepresentation(representationName) )
+    {
+      return "Unable to acquire binary labelmap from segmentation";
+    }
+    resamplingRequired = true;
+  }
+
+  vtkSegment* segment = segmentation->GetSegment(job.SegmentID);
+  vtkOrientedImageData* segmentLabelmap = (segment ? vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(representationName)) : nullptr);
+  if (!segmentLabelmap)
+  {
+    return "Failed to get labelmap for segments";
+  }
+  job.SegmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  job.SegmentLabelmap->ShallowCopy(segmentLabelmap);
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+  job.LabelValue = segment->GetLabelValue();
+#endif
+  job.ResamplingRequired = resamplingRequired;
+  if (!resamplingRequired)
+  {
+    // Only keep the labelmap of the current slab in memory
+    segmentation->RemoveRepresentation(representationName);
+  }
+
+  // Segment does not intersect the slab
+  int* labelmapExtent = job.SegmentLabelmap->GetExtent();
+  if (labelmapExtent[0] > labelmapExtent[1] || labelmapExtent[2] > labelmapExtent[3] || labelmapExtent[4] > labelmapExtent[5])
+  {
+    job.SegmentLabelmap = nullptr;
+    return ""; // No error
+  }
+
+  DvhComputationSettings slabSettings = settings;
+  slabSettings.FixedOversampledDoseVolume = slabGeometry;
+  PrepareSegmentLabelmapJob(job, slabSettings);
+  return job.ErrorMessage;
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::ComputeSegmentDvhJobsStreaming(
+  vtkMRMLDoseVolumeHistogramNode* parameterNode, const std::vector<std::string>& segmentIDs,
+  const std::vector<double>& oversamplingFactors, vtkOrientedImageData* doseImageData, const DvhComputationSettings& settings,
+  std::vector<SegmentDvhJob>& jobs)
+{
+  vtkSegmentation* selectedSegmentation = parameterNode->GetSegmentationNode()->GetSegmentation();
+  size_t numberOfSegments = segmentIDs.size();
+  jobs.resize(numberOfSegments);
+  std::vector<DvhAccumulator> accumulators(numberOfSegments);
+
+  // Segments on the same lattice share the resampled dose slabs (all segments if oversampling is fixed).
+  // Each segment is converted in its own segmentation, so that only one labelmap is in memory at a time.
+  std::map<double, std::vector<size_t> > segmentIndicesByOversamplingFactor;
+  std::vector<vtkSmartPointer<vtkSegmentation> > segmentationCopies(numberOfSegments);
+  for (size_t segmentIndex = 0; segmentIndex < numberOfSegments; ++segmentIndex)
+  {
+    jobs[segmentIndex].SegmentID = segmentIDs[segmentIndex];
+    segmentIndicesByOversamplingFactor[oversamplingFactors[segmentIndex]].push_back(segmentIndex);
+    if (settings.AutomaticOversampling)
+    {
+      parameterNode->AddAutomaticOversamplingFactor(segmentIDs[segmentIndex], oversamplingFactors[segmentIndex]);
+    }
+
+    vtkSmartPointer<vtkSegmentation> segmentationCopy = vtkSmartPointer<vtkSegmentation>::New();
+#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
+    segmentationCopy->SetSourceRepresentationName(selectedSegmentation->GetSourceRepresentationName());
+#else
+    segmentationCopy->SetMasterRepresentationName(selectedSegmentation->GetMasterRepresentationName());
+#endif
+    segmentationCopy->CopyConversionParameters(selectedSegmentation);
+    segmentationCopy->CopySegmentFromSegmentation(selectedSegmentation, segmentIDs[segmentIndex]);
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    segmentationCopy->SetConversionParameter(vtkClosedSurfaceToBinaryLabelmapConversionRule::GetCollapseLabelmapsParameterName(), "0");
+#endif
+    segmentationCopies[segmentIndex] = segmentationCopy;
+  }
+
+  // Oversampled lattices and the number of slabs they are processed in
+  std::map<double, vtkSmartPointer<vtkOrientedImageData> > oversampledGeometries;
+  std::map<double, int> numberOfSlicesPerSlab;
+  int numberOfSlabs = 0;
+  for (std::map<double, std::vector<size_t> >::iterator groupIt = segmentIndicesByOversamplingFactor.begin();
+    groupIt != segmentIndicesByOversamplingFactor.end(); ++groupIt)
+  {
+    vtkSmartPointer<vtkOrientedImageData> geometry = CreateOversampledGeometry(doseImageData, groupIt->first);
+    int slicesPerSlab = GetNumberOfSlicesPerSlab(geometry, doseImageData->GetScalarSize(), parameterNode->GetMemoryLimitMB());
+    int* extent = geometry->GetExtent();
+    oversampledGeometries[groupIt->first] = geometry;
+    numberOfSlicesPerSlab[groupIt->first] = slicesPerSlab;
+    numberOfSlabs += (extent[5] - extent[4] + slicesPerSlab) / slicesPerSlab;
+  }
+
+  // The dose axis is known in advance for dose volumes, so statistics and histograms are accumulated in the same pass.
+  // For other volumes the axis depends on the intensity range within the segment, so an additional pass is needed
+  double startValue = 0.0;
+  double stepSize = 0.0;
+  int numberOfSamples = 0;
+  if (settings.IsDoseVolume)
+  {
+    ComputeDvhBins(settings, 0.0, 0.0, startValue, stepSize, numberOfSamples);
+    for (DvhAccumulator& accumulator : accumulators)
+    {
+      accumulator.StartValue = startValue;
+      accumulator.StepSize = stepSize;
+      accumulator.Histogram.assign(std::max(numberOfSamples, 0), 0.0);
+    }
+  }
+  int numberOfPasses = (settings.IsDoseVolume ? 1 : 2);
+  int numberOfProcessedSlabs = 0;
+
+  for (int pass = 0; pass < numberOfPasses; ++pass)
+  {
+    bool computeStatistics = (pass == 0);
+    bool computeHistogram = (settings.IsDoseVolume || pass == 1);
+    std::vector<bool> segmentsToProcess(numberOfSegments, true);
+    if (!settings.IsDoseVolume && computeHistogram)
+    {
+      for (size_t segmentIndex = 0; segmentIndex < numberOfSegments; ++segmentIndex)
+      {
+        DvhAccumulator& accumulator = accumulators[segmentIndex];
+        if (accumulator.VoxelCount < 1)
+        {
+          segmentsToProcess[segmentIndex] = false;
+          continue;
+        }
+        ComputeDvhBins(settings, accumulator.Min, accumulator.Max, startValue, stepSize, numberOfSamples);
+        accumulator.StartValue = startValue;
+        accumulator.StepSize = stepSize;
+        accumulator.Histogram.assign(std::max(numberOfSamples, 0), 0.0);
+      }
+    }
+
+    for (std::map<double, std::vector<size_t> >::iterator groupIt = segmentIndicesByOversamplingFactor.begin();
+      groupIt != segmentIndicesByOversamplingFactor.end(); ++groupIt)
+    {
+      vtkOrientedImageData* geometry = oversampledGeometries[groupIt->first];
+      int slicesPerSlab = numberOfSlicesPerSlab[groupIt->first];
+      int extent[6] = {0,-1,0,-1,0,-1};
+      geometry->GetExtent(extent);
+      for (int firstSlice = extent[4]; firstSlice <= extent[5]; firstSlice += slicesPerSlab)
+      {
+        vtkSmartPointer<vtkOrientedImageData> slabGeometry = vtkSmartPointer<vtkOrientedImageData>::New();
+        slabGeometry->SetExtent(extent[0], extent[1], extent[2], extent[3], firstSlice, std::min(firstSlice + slicesPerSlab - 1, extent[5]));
+        slabGeometry->SetOrigin(geometry->GetOrigin());
+        slabGeometry->SetSpacing(geometry->GetSpacing());
+        slabGeometry->CopyDirections(geometry);
+
+        // Same interpolation as in the in-core computation
+        bool linearInterpolation = (settings.AutomaticOversampling ? settings.UseLinearInterpolationForDoseVolume : true);
+        vtkSmartPointer<vtkOrientedImageData> slabDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+        if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+          doseImageData, slabGeometry, slabDoseVolume, linearInterpolation ) )
+        {
+          return "Failed to resample dose volume";
+        }
+
+        for (size_t segmentIndex : groupIt->second)
+        {
+          if (!segmentsToProcess[segmentIndex])
+          {
+            continue;
+          }
+          SegmentDvhJob& job = jobs[segmentIndex];
+          std::string errorMessage = RasterizeSegmentSlab(segmentationCopies[segmentIndex], slabGeometry, settings, job);
+          if (!errorMessage.empty())
+          {
+            return errorMessage;
+          }
+          if (!job.SegmentLabelmap)
+          {
+            continue;
+          }
+
+          DvhAccumulator& accumulator = accumulators[segmentIndex];
+          InitializeDvhAccumulator(accumulator, job.SegmentLabelmap, settings);
+          std::vector<DvhAccumulator*> segmentAccumulators(1, &accumulator);
+          vtkAccumulateDvhSinglePass(slabDoseVolume, segmentAccumulators, computeStatistics, computeHistogram);
+          accumulator.Labelmap = nullptr;
+          job.SegmentLabelmap = nullptr;
+        }
+
+        double progress = static_cast<double>(++numberOfProcessedSlabs) / static_cast<double>(numberOfSlabs * numberOfPasses);
+        this->External->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
+      }
+    }
+  }
+
+  // Assemble statistics in the order of the segments, until the first failure
+  for (size_t segmentIndex = 0; segmentIndex < numberOfSegments; ++segmentIndex)
+  {
+    vtkOrientedImageData* geometry = oversampledGeometries[oversamplingFactors[segmentIndex]];
+    double* spacing = geometry->GetSpacing();
+    int extent[6] = {0,-1,0,-1,0,-1};
+    geometry->GetExtent(extent);
+    SegmentDvhJob& job = jobs[segmentIndex];
+    job.ErrorMessage = GetDvhStatisticsFromAccumulator(accumulators[segmentIndex], extent,
+      spacing[0] * spacing[1] * spacing[2], settings, job.Statistics);
+    if (!job.ErrorMessage.empty())
+    {
+      break;
+    }
+  }
+
+  return ""; // No error
+}
+
+//---------------------------------------------------------------------------
+const std::vector<double>& vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetMetricNumbers(const char* metricString)
+{
+  std::string metricStr(metricString ? metricString : "");
+  std::map<std::string, std::vector<double> >::iterator parsedIt = this->ParsedMetricStrings.find(metricStr);
+  if (parsedIt == this->ParsedMetricStrings.end())
+  {
+    // The metric strings are edited by the user, so the strings parsed earlier are not expected to be used again
+    if (this->ParsedMetricStrings.size() >= MAXIMUM_NUMBER_OF_PARSED_METRIC_STRINGS)
+    {
+      this->ParsedMetricStrings.clear();
+    }
+    parsedIt = this->ParsedMetricStrings.insert(std::make_pair(metricStr, std::vector<double>())).first;
+    this->External->GetNumbersFromMetricString(metricStr, parsedIt->second);
+  }
+  return parsedIt->second;
+}
+
+//---------------------------------------------------------------------------
+const vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::DvhTableIndex*
+vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetDvhTableIndex(vtkMRMLTableNode* dvhTableNode)
+{
+  vtkTable* table = (dvhTableNode ? dvhTableNode->GetTable() : nullptr);
+  if (!table || !dvhTableNode->GetID() || table->GetNumberOfColumns() < 2 || table->GetNumberOfRows() < 1)
+  {
+    return nullptr;
+  }
+  vtkAbstractArray* doseColumn = table->GetColumn(0);
+  vtkAbstractArray* volumeColumn = table->GetColumn(1);
+  vtkMTimeType mtime = std::max(table->GetMTime(), std::max(doseColumn->GetMTime(), volumeColumn->GetMTime()));
+
+  DvhTableIndex& index = this->DvhTableIndices[dvhTableNode->GetID()];
+  if (index.MTime == mtime)
+  {
+    return &index;
+  }
+
+  // Read the columns directly if they are numeric (DVHs read from CSV may contain strings)
+  vtkDataArray* doseArray = vtkDataArray::SafeDownCast(doseColumn);
+  vtkDataArray* volumeArray = vtkDataArray::SafeDownCast(volumeColumn);
+  vtkIdType numberOfRows = table->GetNumberOfRows();
+  std::vector<std::pair<double, double> > rows(numberOfRows);
+  for (vtkIdType row = 0; row < numberOfRows; ++row)
+  {
+    rows[row].first = (doseArray ? doseArray->GetTuple1(row) : doseColumn->GetVariantValue(row).ToDouble());
+    rows[row].second = (volumeArray ? volumeArray->GetTuple1(row) : volumeColumn->GetVariantValue(row).ToDouble());
+  }
+  if (!std::is_sorted(rows.begin(), rows.end()))
+  {
+    std::stable_sort(rows.begin(), rows.end(),
+      [](const std::pair<double, double>& a, const std::pair<double, double>& b) { return a.first < b.first; });
+  }
+
+  // Cumulative volume cannot increase with the dose, which allows binary search on both columns
+  index.Doses.resize(numberOfRows);
+  index.VolumesPercent.resize(numberOfRows);
+  for (vtkIdType row = 0; row < numberOfRows; ++row)
+  {
+    index.Doses[row] = rows[row].first;
+    index.VolumesPercent[row] = (row > 0 ? std::min(rows[row].second, index.VolumesPercent[row-1]) : rows[row].second);
+  }
+  index.MTime = mtime;
+  return &index;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::GetDvhMetricTargets(
+  vtkMRMLTableNode* metricsTableNode, const char* callerName, std::vector<DvhMetricTarget>& targets)
+{
+  targets.clear();
+  vtkTable* metricsTable = metricsTableNode->GetTable();
+
+  std::vector<std::string> roles;
+  metricsTableNode->GetNodeReferenceRoles(roles);
+  for (std::vector<std::string>::iterator roleIt=roles.begin(); roleIt!=roles.end(); ++roleIt)
+  {
+    if ( roleIt->substr(0, vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX.size()).compare(
+      vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX ) )
+    {
+      // Not a DVH reference
+      continue;
+    }
+
+    // Get DVH node
+    vtkMRMLTableNode* dvhTableNode = vtkMRMLTableNode::SafeDownCast(metricsTableNode->GetNodeReference(roleIt->c_str()));
+    if (!dvhTableNode)
+    {
+      vtkErrorWithObjectMacro(this->External, << callerName << ": Metrics table node reference '" << (*roleIt) << "' does not contain DVH node");
+      continue;
+    }
+
+    // Get corresponding table row
+    DvhMetricTarget target;
+    std::stringstream ss;
+    ss << dvhTableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str());
+    ss >> target.TableRow;
+    if (ss.fail() || target.TableRow < 0 || target.TableRow >= metricsTable->GetNumberOfRows())
+    {
+      vtkErrorWithObjectMacro(this->External, << callerName << ": Failed to get metrics table row from DVH node " << dvhTableNode->GetName());
+      continue;
+    }
+
+    // Get structure volume
+    target.StructureVolume = metricsTable->GetValue(target.TableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnVolumeCc).ToDouble();
+    if (target.StructureVolume == 0)
+    {
+      vtkErrorWithObjectMacro(this->External, << callerName << ": Failed to get structure volume for structure "
+        << metricsTable->GetValue(target.TableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnStructure).ToString());
+      continue;
+    }
+
+    target.Index = this->GetDvhTableIndex(dvhTableNode);
+    if (!target.Index)
+    {
+      vtkErrorWithObjectMacro(this->External, << callerName << ": Invalid DVH table in node " << dvhTableNode->GetName());
+      continue;
+    }
+
+    targets.push_back(target);
+  } // For all DVHs
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::EvaluateDvhMetricQueries(
+  const std::vector<DvhMetricQuery>& queries, const std::vector<DvhMetricTarget>& targets, std::vector<double>& results)
+{
+  results.resize(targets.size() * queries.size());
+  std::vector<double>::iterator resultIt = results.begin();
+  for (std::vector<DvhMetricTarget>::const_iterator targetIt = targets.begin(); targetIt != targets.end(); ++targetIt)
+  {
+    const DvhTableIndex& index = *(targetIt->Index);
+    double structureVolume = targetIt->StructureVolume;
+    for (std::vector<DvhMetricQuery>::const_iterator queryIt = queries.begin(); queryIt != queries.end(); ++queryIt, ++resultIt)
+    {
+      switch (queryIt->Type)
+      {
+      case DvhMetricQuery::VolumeCc:
+        (*resultIt) = LookupVolumePercent(index, queryIt->Value) * structureVolume / 100.0;
+        break;
+      case DvhMetricQuery::VolumePercent:
+        (*resultIt) = LookupVolumePercent(index, queryIt->Value);
+        break;
+      case DvhMetricQuery::DoseForVolumeCc:
+        (*resultIt) = LookupDose(index, queryIt->Value, structureVolume);
+        break;
+      case DvhMetricQuery::DoseForVolumePercent:
+        (*resultIt) = LookupDose(index, queryIt->Value * structureVolume / 100.0, structureVolume);
+        break;
+      }
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::WriteDvhMetricResults(vtkTable* metricsTable, int firstColumn,
+  size_t numberOfQueries, const std::vector<DvhMetricTarget>& targets, const std::vector<double>& results)
+{
+  for (size_t queryIndex = 0; queryIndex < numberOfQueries; ++queryIndex)
+  {
+    vtkAbstractArray* column = metricsTable->GetColumn(firstColumn + static_cast<int>(queryIndex));
+    if (!column)
+    {
+      continue;
+    }
+    // Set the values in the column array directly, so that the table is only modified once per column
+    for (size_t targetIndex = 0; targetIndex < targets.size(); ++targetIndex)
+    {
+      column->SetVariantValue(targets[targetIndex].TableRow, vtkVariant(results[targetIndex * numberOfQueries + queryIndex]));
+    }
+    column->Modified();
+  }
+  metricsTable->Modified();
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::LookupVolumePercent(const DvhTableIndex& index, double dose)
+{
+  // Clamp to the first and last DVH points
+  const std::vector<double>& doses = index.Doses;
+  if (dose <= doses.front())
+  {
+    return index.VolumesPercent.front();
+  }
+  if (dose >= doses.back())
+  {
+    return index.VolumesPercent.back();
+  }
+
+  size_t next = std::upper_bound(doses.begin(), doses.end(), dose) - doses.begin();
+  size_t previous = next - 1;
+  return index.VolumesPercent[previous] + (index.VolumesPercent[next] - index.VolumesPercent[previous])
+    * (dose - doses[previous]) / (doses[next] - doses[previous]);
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::LookupDose(const DvhTableIndex& index, double volumeCc, double structureVolume)
+{
+  const std::vector<double>& volumes = index.VolumesPercent;
+  // Check if the given volume is above the highest (first) in the array then assign no dose
+  if (volumeCc >= volumes.front() / 100.0 * structureVolume)
+  {
+    return 0.0;
+  }
+  // If volume is below the lowest (last) in the array then assign maximum dose
+  if (volumeCc < volumes.back() / 100.0 * structureVolume)
+  {
+    return index.Doses.back();
+  }
+
+  // Find the first point with volume not above the given volume, and interpolate from the previous point
+  size_t next = std::partition_point(volumes.begin(), volumes.end(),
+    [volumeCc, structureVolume](double volumePercent) { return volumePercent / 100.0 * structureVolume > volumeCc; }) - volumes.begin();
+  size_t previous = next - 1;
+  double volumePrevious = volumes[previous] / 100.0 * structureVolume;
+  double volumeNext = volumes[next] / 100.0 * structureVolume;
+  return index.Doses[previous] + (index.Doses[next] - index.Doses[previous]) * (volumeCc - volumePrevious) / (volumeNext - volumePrevious);
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::vtkInternal::StoreDvhStatistics(
+  vtkMRMLDoseVolumeHistogramNode* parameterNode, vtkMRMLScalarVolumeNode* doseVolumeNode, std::string segmentID, const DvhStatistics& statistics)
+{
+  vtkMRMLScene* scene = this->External->GetMRMLScene();
+  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
+  std::string segmentName = segmentationNode->GetSegmentation()->GetSegment(segmentID)->GetName();
+  bool isDoseVolume = vtkSlicerRtCommon::IsDoseVolumeNode(doseVolumeNode);
+  bool useFractionalLabelmap = parameterNode->GetUseFractionalLabelmap();
+
+  // Get metrics table for the parameter node; Create one if missing
+  vtkMRMLTableNode* metricsTableNode = parameterNode->GetMetricsTableNode();
+  vtkTable* metricsTable = metricsTableNode->GetTable();
+  // Setup table if empty
+  if (metricsTable->GetNumberOfColumns() == 0)
+  {
+    this->External->InitializeMetricsTable(parameterNode);
+  }
+
+  // Get DVH table node for the inputs (dose volume, segmentation, segment).
+  // If found, then it gets overwritten by the new computation, otherwise
+  std::string structureDvhNodeRef = parameterNode->AssembleDvhNodeReference(segmentID, doseVolumeNode);
+  vtkMRMLTableNode* tableNode = vtkMRMLTableNode::SafeDownCast(metricsTableNode->GetNodeReference(structureDvhNodeRef.c_str()));
+  int tableRow = -1;
+  if (!tableNode)
+  {
+    // Create DVH table node
+    tableNode = vtkMRMLTableNode::New();
+    std::string dvhTableNodeName = segmentID + DVH_TABLE_NODE_NAME_POSTFIX;
+    dvhTableNodeName = scene->GenerateUniqueName(dvhTableNodeName);
+    tableNode->SetName(dvhTableNodeName.c_str());
+    tableNode->SetAttribute(DVH_DVH_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1");
+    vtkNew<vtkTable> table;
+    tableNode->SetAndObserveTable(table);
+    scene->AddNode(tableNode);
+
+    //TODO: Add schema?
+
+    // Add new row in metrics table
+    tableRow = metricsTable->GetNumberOfRows();
+    std::stringstream ss;
+    ss << tableRow;
+    tableNode->SetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str(), ss.str().c_str());
+    tableNode->Delete(); // Release ownership to scene only
+    metricsTable->InsertNextBlankRow();
+
+    // Dose surface histogram attributes
+    if (parameterNode->GetDoseSurfaceHistogram())
+    {
+      tableNode->SetAttribute(DVH_SURFACE_ATTRIBUTE_NAME.c_str(), "1");
+      tableNode->SetAttribute(DVH_SURFACE_INSIDE_ATTRIBUTE_NAME.c_str(), parameterNode->GetUseInsideDoseSurface() ? "1" : "0");
+    }
+
+    // Set node references
+    metricsTableNode->SetNodeReferenceID(structureDvhNodeRef.c_str(), tableNode->GetID());
+    tableNode->SetNodeReferenceID(vtkMRMLDoseVolumeHistogramNode::DOSE_VOLUME_REFERENCE_ROLE, doseVolumeNode->GetID());
+    tableNode->SetNodeReferenceID(vtkMRMLDoseVolumeHistogramNode::SEGMENTATION_REFERENCE_ROLE, segmentationNode->GetID());
+    tableNode->SetNodeReferenceID(vtkMRMLDoseVolumeHistogramNode::DVH_METRICS_TABLE_REFERENCE_ROLE, metricsTableNode->GetID());
+  }
+  else if (tableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str()))
+  {
+    tableRow = vtkVariant(tableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str())).ToInt();
+  }
+  else
+  {
+    return "Failed to find metrics table row for structure " + segmentName;
+  }
+
+  // Set table node attributes:
+  // Structure name and segment color for visualization in the chart view
+  tableNode->SetAttribute(DVH_SEGMENT_ID_ATTRIBUTE_NAME.c_str(), segmentID.c_str());
+  // Oversampling factor
+  std::ostringstream oversamplingAttrValueStream;
+  oversamplingAttrValueStream << (parameterNode->GetAutomaticOversampling() ? (-1.0) : this->External->DefaultDoseVolumeOversamplingFactor);
+  tableNode->SetAttribute(DVH_DOSE_VOLUME_OVERSAMPLING_FACTOR_ATTRIBUTE_NAME.c_str(), oversamplingAttrValueStream.str().c_str());
+
+  double ccPerCubicMM = 0.001;
+
+  // Set default column values
+
+  // Structure name
+  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnStructure, vtkVariant(segmentName));
+  // Volume name
+  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnDoseVolume, vtkVariant(doseVolumeNode->GetName()));
+  // Volume (cc) - save as attribute too (the DVH contains percentages that often need to be converted to volume)
+  double volumeCc = statistics.VoxelCount * statistics.CubicMMPerVoxel * ccPerCubicMM;
+  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnVolumeCc, vtkVariant(volumeCc));
+  std::ostringstream attributeNameStream;
+  std::ostringstream attributeValueStream;
+  attributeNameStream << vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX << vtkSlicerDoseVolumeHistogramModuleLogic::DVH_METRIC_TOTAL_VOLUME_CC;
+  attributeValueStream << volumeCc;
+  tableNode->SetAttribute(attributeNameStream.str().c_str(), attributeValueStream.str().c_str());
+  // Mean dose
+  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMeanDose, vtkVariant(statistics.MeanDose));
+  // Min dose
+  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMinDose, vtkVariant(statistics.MinDose));
+  // Max dose
+  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMaxDose, vtkVariant(statistics.MaxDose));
+
+  // Create DVH plot values
+  int numSamples = static_cast<int>(statistics.Histogram.size());
+  double startValue = statistics.StartValue;
+  double stepSize = statistics.StepSize;
+
+  // We put a fixed point at (0.0, 100%), but only if there are only positive values in the histogram
+  // Negative values can occur when the user requests histogram for an image, such as s CT volume (in
+  // this case Intensity Volume Histogram is computed), or the startValue became negative for the dose
+  // volume because the range minimum was smaller than the original start value.
+  bool insertPointAtOrigin = true;
+  if (startValue < 0.0)
+  {
+    insertPointAtOrigin = false;
+  }
+
+  // Allocate table
+  vtkTable* table = tableNode->GetTable();
+  int numberOfRows = numSamples + (insertPointAtOrigin?1:0);
+  vtkNew<vtkDoubleArray> columnDose;
+  columnDose->SetName(isDoseVolume ? "Dose" : "Intensity");
+  columnDose->SetNumberOfTuples(numberOfRows);
+  table->AddColumn(columnDose);
+  vtkNew<vtkDoubleArray> columnVolume;
+  columnVolume->SetName("Volume");
+  columnVolume->SetNumberOfTuples(numberOfRows);
+  table->AddColumn(columnVolume);
+  table->SetNumberOfRows(numberOfRows);
+
+  int rowIndex = 0;
+
+  if (insertPointAtOrigin)
+  {
+    // Add first fixed point at (0.0, 100%)
+    table->SetValue(rowIndex, 0, 0.0);
+    table->SetValue(rowIndex, 1, 100.0);
+    table->SetValue(rowIndex, 2, 0);
+    ++rowIndex;
+  }
+
+  double voxelBelowDose = statistics.VoxelsBelowStartValue;
+  double totalVoxels = statistics.VoxelCount;
+  for (int sampleIndex=0; sampleIndex<numSamples; ++sampleIndex)
+  {
+    double voxelsInBin = statistics.Histogram[sampleIndex];
+    table->SetValue(rowIndex, 0, startValue + sampleIndex * stepSize);
+    if (useFractionalLabelmap)
+    {
+      table->SetValue(rowIndex, 1, std::max(0.0, (1.0-(double)voxelBelowDose/(double)totalVoxels)*100.0));
+    }
+    else
+    {
+      table->SetValue(rowIndex, 1, (1.0-(double)voxelBelowDose/(double)totalVoxels)*100.0);
+    }
+    table->SetValue(rowIndex, 2, 0);
+    ++rowIndex;
+    voxelBelowDose += voxelsInBin;
+  }
+
+  // Set the start of the first bin to 0 if the volume contains dose and the start value was negative
+  if (isDoseVolume && !insertPointAtOrigin)
+  {
+    table->SetValue(0, 0, 0.0);
+  }
+
+  // Setup DVH subject hierarchy items
+  vtkMRMLSubjectHierarchyNode* shNode = vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(scene);
+  if (!shNode)
+  {
+    return "Failed to access subject hierarchy node";
+  }
+  vtkIdType doseShItemID = shNode->GetItemByDataNode(doseVolumeNode);
+
+  // Add metrics table and chart to under the study of the dose in subject hierarchy
+  vtkIdType studyItemID = shNode->GetItemAncestorAtLevel(doseShItemID, vtkMRMLSubjectHierarchyConstants::GetDICOMLevelStudy());
+  if (studyItemID != vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID)
+  {
+    vtkIdType metricsShItemID = shNode->CreateItem(studyItemID, metricsTableNode);
+    shNode->CreateItem(metricsShItemID, tableNode);
+
+    vtkMRMLPlotChartNode* chartNode = parameterNode->GetChartNode();
+    shNode->CreateItem(studyItemID, chartNode);
+  }
+
+  // Add connection attribute to input segmentation and dose volume nodes
+  segmentationNode->AddNodeReferenceID(DVH_CREATED_DVH_NODE_REFERENCE_ROLE.c_str(), tableNode->GetID());
+  doseVolumeNode->AddNodeReferenceID(DVH_CREATED_DVH_NODE_REFERENCE_ROLE.c_str(), tableNode->GetID());
+
+  return ""; // No error
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerDoseVolumeHistogramModuleLogic::vtkSlicerDoseVolumeHistogramModuleLogic()
+{
+  this->StartValue = 0.1;
+  this->StepSize = 0.2;
+  this->NumberOfSamplesForNonDoseVolumes = 100;
+  this->DefaultDoseVolumeOversamplingFactor = 2.0;
+  this->UseLinearInterpolationForDoseVolume = true;
+  this->UseSinglePassAccumulation = true;
+  this->UseComputationCache = true;
+  this->UseSegmentExtentCropping = true;
+
+  this->LogSpeedMeasurements = false;
+
+  this->Internal = new vtkInternal(this);
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerDoseVolumeHistogramModuleLogic::~vtkSlicerDoseVolumeHistogramModuleLogic()
+{
+  delete this->Internal;
+  this->Internal = nullptr;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::EndCloseEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  this->SetAndObserveMRMLSceneEvents(newScene, events.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::RegisterNodes()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    vtkErrorMacro("RegisterNodes: Invalid MRML scene");
+    return;
+  }
+  if (!scene->IsNodeClassRegistered("vtkMRMLDoseVolumeHistogramNode"))
+  {
+    scene->RegisterNodeClass(vtkSmartPointer<vtkMRMLDoseVolumeHistogramNode>::New());
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::OnMRMLSceneEndClose()
+{
+  if (!this->GetMRMLScene())
+  {
+    vtkErrorMacro("OnMRMLSceneEndClose: Invalid MRML scene");
+    return;
+  }
+
+  this->ClearCache();
+
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  if (!node || !node->IsA("vtkMRMLTableNode") || !node->GetID())
+  {
+    return;
+  }
+
+  // Remove lookup index of the removed DVH table
+  this->Internal->DvhTableIndices.erase(node->GetID());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerDoseVolumeHistogramModuleLogic::ClearCache()
+{
+  this->Internal->ClearCache();
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolumeHistogramNode* parameterNode)
+{
+  if (!this->GetMRMLScene() || !parameterNode)
+  {
+    std::string errorMessage("Invalid MRML scene or parameter set node");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
+  }
+
+  parameterNode->ClearAutomaticOversamplingFactors();
+  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
+  vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
+  if ( !segmentationNode || !doseVolumeNode )
+  {
+    std::string errorMessage("Both segmentation node and dose volume node need to be set");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
+  }
+
+  // Fire only one modified event when the computation is done
+  this->SetDisableModifiedEvent(1);
+  int disabledNodeModify = parameterNode->StartModify();
+
+  // Get maximum dose from dose volume for number of DVH bins
+  vtkNew<vtkImageAccumulate> doseStat;
+  doseStat->SetInputData(doseVolumeNode->GetImageData());
+  doseStat->Update();
+  double maxDose = doseStat->GetMax()[0];
+
+  // Get selected segmentation
+  vtkSegmentation* selectedSegmentation = segmentationNode->GetSegmentation();
+
+  // If segment IDs list is empty then include all segments
+  std::vector<std::string> segmentIDs;
+  parameterNode->GetSelectedSegmentIDs(segmentIDs);
+  if (segmentIDs.empty())
+  {
+    selectedSegmentation->GetSegmentIDs(segmentIDs);
+  }
+
+  // Create oriented image data from dose volume
+  vtkSmartPointer<vtkOrientedImageData> doseImageData = vtkSmartPointer<vtkOrientedImageData>::Take(
+    vtkSlicerSegmentationsModuleLogic::CreateOrientedImageDataFromVolumeNode(doseVolumeNode) );
+  if (!doseImageData.GetPointer())
+  {
+    std::string errorMessage("Failed to get image data from dose volume");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
+  }
+
+  vtkInternal::DvhComputationSettings settings;
+  this->Internal->InitializeComputationSettings(parameterNode, doseVolumeNode, maxDose, settings);
+  // Get parent transform here, as the worker threads must not access the MRML scene
+  vtkMRMLTransformNode* parentTransformNode = segmentationNode->GetParentTransformNode();
+  if (parentTransformNode)
+  {
+    vtkSmartPointer<vtkGeneralTransform> segmentationToWorldTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+    parentTransformNode->GetTransformToWorld(segmentationToWorldTransform);
+    segmentationToWorldTransform->Update();
+    settings.SegmentationToWorldTransform = segmentationToWorldTransform;
+  }
+
+  //
+  // Compute DVH for each selected segment
+  //
+  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
+  double checkpointStart = timer->GetUniversalTime();
+  UNUSED_VARIABLE(checkpointStart); // Although it is used later, a warning is logged so needs to be suppressed
+
+  std::vector<vtkInternal::SegmentDvhJob> jobs;
+  std::vector<double> oversamplingFactors;
+  std::string computeErrorMessage;
+  if (this->Internal->IsStreamingRequired(parameterNode, segmentIDs, doseImageData, settings, oversamplingFactors))
+  {
+    // The oversampled dose and the segment labelmaps would not fit in the memory limit, so the dose is processed in slabs.
+    // The slab-wise computation does not use the cache, and the cached images would take up the memory
+    this->Internal->ReleaseCachedImages();
+    computeErrorMessage = this->Internal->ComputeSegmentDvhJobsStreaming(parameterNode, segmentIDs, oversamplingFactors, doseImageData, settings, jobs);
+  }
+  else
+  {
+    computeErrorMessage = this->Internal->ComputeSegmentDvhJobsInCore(parameterNode, segmentIDs, doseImageData, settings, jobs);
+  }
+  if (!computeErrorMessage.empty())
+  {
+    vtkErrorMacro("ComputeDvh: " << computeErrorMessage);
+    return computeErrorMessage;
+  }
+
+  // Store results in the order of the segments, so that the output does not depend on the number of threads
+  for (std::vector<vtkInternal::SegmentDvhJob>::iterator jobIt = jobs.begin(); jobIt != jobs.end(); ++jobIt)
+  {
+    std::string errorMessage = jobIt->ErrorMessage;
+    if (errorMessage.empty())
+    {
+      errorMessage = this->Internal->StoreDvhStatistics(parameterNode, doseVolumeNode, jobIt->SegmentID, jobIt->Statistics);
+    }
+    if (!errorMessage.empty())
+    {
+      vtkErrorMacro("ComputeDvh: " << errorMessage);
+      return errorMessage;
+    }
+  } // For each segment
+
+  // Log measured time
+  double checkpointEnd = timer->GetUniversalTime();
+  UNUSED_VARIABLE(checkpointEnd); // Although it is used just below, a warning is logged so needs to be suppressed
+  if (this->LogSpeedMeasurements)
+  {
+    vtkDebugMacro("ComputeDvh: DVH computation time for " << jobs.size() << " structures: " << checkpointEnd-checkpointStart << " s");
+  }
+
+  // Fire only one modified event when the computation is done
+  this->SetDisableModifiedEvent(0);
+  this->Modified();
+  parameterNode->EndModify(disabledNodeModify);
+  // Trigger update of table
+  if (parameterNode->GetMetricsTableNode())
+  {
+    parameterNode->GetMetricsTableNode()->Modified();
+  }
+
+  return "";
+}
+
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvhBatch(vtkMRMLDoseVolumeHistogramNode* parameterNode)
+{
+  if (!this->GetMRMLScene() || !parameterNode)
+  {
+    std::string errorMessage("Invalid MRML scene or parameter set node");
+    vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+    return errorMessage;
+  }
+
+  parameterNode->ClearAutomaticOversamplingFactors();
+  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
+  int numberOfDoseVolumes = parameterNode->GetNumberOfBatchDoseVolumeNodes();
+  if (!segmentationNode || numberOfDoseVolumes == 0)
+  {
+    std::string errorMessage("Segmentation node and at least one batch dose volume node need to be set");
+    vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+    return errorMessage;
+  }
+  for (int doseIndex = 0; doseIndex < numberOfDoseVolumes; ++doseIndex)
+  {
+    vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetNthBatchDoseVolumeNode(doseIndex);
+    if (!doseVolumeNode || !doseVolumeNode->GetImageData())
+    {
+      std::string errorMessage("Invalid batch dose volume node");
+      vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+      return errorMessage;
+    }
+  }
+  // The metrics table columns are assembled using the dose volume of the parameter node
+  if (!parameterNode->GetDoseVolumeNode())
+  {
+    std::string errorMessage("Dose volume node needs to be set for assembling the metric names");
+    vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+    return errorMessage;
+  }
+
+  // Fire only one modified event when the computation is done
+  this->SetDisableModifiedEvent(1);
+  int disabledNodeModify = parameterNode->StartModify();
+
+  // If segment IDs list is empty then include all segments
+  std::vector<std::string> segmentIDs;
+  parameterNode->GetSelectedSegmentIDs(segmentIDs);
+  if (segmentIDs.empty())
+  {
+    segmentationNode->GetSegmentation()->GetSegmentIDs(segmentIDs);
+  }
+
+  // Get parent transform here, as the worker threads must not access the MRML scene
+  vtkSmartPointer<vtkGeneralTransform> segmentationToWorldTransform;
+  vtkMRMLTransformNode* parentTransformNode = segmentationNode->GetParentTransformNode();
+  if (parentTransformNode)
+  {
+    segmentationToWorldTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+    parentTransformNode->GetTransformToWorld(segmentationToWorldTransform);
+    segmentationToWorldTransform->Update();
+  }
+
+  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
+  double checkpointStart = timer->GetUniversalTime();
+  UNUSED_VARIABLE(checkpointStart); // Although it is used later, a warning is logged so needs to be suppressed
+
+  //
+  // Set up one task for each dose volume, and group the doses by geometry
+  //
+  std::vector<vtkInternal::DoseDvhTask> tasks(numberOfDoseVolumes);
+  std::vector<std::string> doseGeometries;
+  std::map<std::string, std::vector<size_t> > taskIndicesByGeometry;
+  for (int doseIndex = 0; doseIndex < numberOfDoseVolumes; ++doseIndex)
+  {
+    vtkInternal::DoseDvhTask& task = tasks[doseIndex];
+    task.DoseVolumeNode = parameterNode->GetNthBatchDoseVolumeNode(doseIndex);
+
+    // Get maximum dose from dose volume for number of DVH bins
+    vtkNew<vtkImageAccumulate> doseStat;
+    doseStat->SetInputData(task.DoseVolumeNode->GetImageData());
+    doseStat->Update();
+    double maxDose = doseStat->GetMax()[0];
+
+    task.DoseImageData = vtkSmartPointer<vtkOrientedImageData>::Take(
+      vtkSlicerSegmentationsModuleLogic::CreateOrientedImageDataFromVolumeNode(task.DoseVolumeNode) );
+    if (!task.DoseImageData.GetPointer())
+    {
+      std::string errorMessage("Failed to get image data from dose volume");
+      vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+      return errorMessage;
+    }
+
+    this->Internal->InitializeComputationSettings(parameterNode, task.DoseVolumeNode, maxDose, task.Settings);
+    task.Settings.SegmentationToWorldTransform = segmentationToWorldTransform;
+    task.Settings.DoseCache = &task.DoseCache;
+    task.Settings.ReportProgress = false;
+
+    if (this->Internal->IsStreamingRequired(parameterNode, segmentIDs, task.DoseImageData, task.Settings, task.OversamplingFactors))
+    {
+      task.Streaming = true;
+      continue;
+    }
+    std::string doseGeometry = vtkSegmentationConverter::SerializeImageGeometry(task.DoseImageData);
+    if (taskIndicesByGeometry.find(doseGeometry) == taskIndicesByGeometry.end())
+    {
+      doseGeometries.push_back(doseGeometry);
+    }
+    taskIndicesByGeometry[doseGeometry].push_back(doseIndex);
+  }
+
+  //
+  // Convert and prepare the segment labelmaps once for each dose geometry
+  //
+  for (std::vector<std::string>::iterator geometryIt = doseGeometries.begin(); geometryIt != doseGeometries.end(); ++geometryIt)
+  {
+    std::vector<size_t>& taskIndices = taskIndicesByGeometry[*geometryIt];
+    vtkInternal::DoseDvhTask& firstTask = tasks[taskIndices[0]];
+
+    std::vector<vtkInternal::SegmentLabelmapCacheEntry> segmentLabelmaps;
+    std::string errorMessage = this->Internal->GetSegmentLabelmaps(parameterNode, segmentIDs, firstTask.DoseImageData, firstTask.Settings, segmentLabelmaps);
+    if (!errorMessage.empty())
+    {
+      vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+      return errorMessage;
+    }
+
+    // Only the geometry of the oversampled dose is needed for preparing the labelmaps
+    vtkInternal::DvhComputationSettings prepareSettings = firstTask.Settings;
+    if (!prepareSettings.AutomaticOversampling)
+    {
+      prepareSettings.FixedOversampledDoseVolume = vtkInternal::CreateOversampledGeometry(firstTask.DoseImageData, this->DefaultDoseVolumeOversamplingFactor);
+    }
+
+    std::vector<vtkInternal::SegmentDvhJob> preparedJobs(segmentIDs.size());
+    for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+    {
+      vtkInternal::SegmentDvhJob& job = preparedJobs[segmentIndex];
+      job.SegmentID = segmentIDs[segmentIndex];
+      if (!segmentLabelmaps[segmentIndex].Labelmap)
+      {
+        errorMessage = "Failed to get labelmap for segments";
+        vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+        return errorMessage;
+      }
+      job.SegmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      job.SegmentLabelmap->ShallowCopy(segmentLabelmaps[segmentIndex].Labelmap);
+      job.LabelValue = segmentLabelmaps[segmentIndex].LabelValue;
+      job.ResamplingRequired = segmentLabelmaps[segmentIndex].ResamplingRequired;
+    }
+    this->Internal->ComputeSegmentDvhJobs(preparedJobs, prepareSettings, parameterNode->GetNumberOfThreads(),
+      vtkInternal::PrepareSegmentLabelmapJob);
+
+    // Each dose of the group gets its own shallow copies of the prepared labelmaps
+    for (std::vector<size_t>::iterator taskIndexIt = taskIndices.begin(); taskIndexIt != taskIndices.end(); ++taskIndexIt)
+    {
+      vtkInternal::DoseDvhTask& task = tasks[*taskIndexIt];
+      task.Settings.FixedOversampledDoseVolume = prepareSettings.FixedOversampledDoseVolume;
+      task.Jobs.resize(segmentIDs.size());
+      for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+      {
+        vtkInternal::SegmentDvhJob& preparedJob = preparedJobs[segmentIndex];
+        vtkInternal::SegmentDvhJob& job = task.Jobs[segmentIndex];
+        job.SegmentID = preparedJob.SegmentID;
+        job.ErrorMessage = preparedJob.ErrorMessage;
+        if (preparedJob.SegmentLabelmap)
+        {
+          job.SegmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+          job.SegmentLabelmap->ShallowCopy(preparedJob.SegmentLabelmap);
+        }
+        job.LabelValue = preparedJob.LabelValue;
+        job.BackgroundValue = preparedJob.BackgroundValue;
+        job.LabelmapPrepared = true;
+      }
+    }
   }
-  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnVolumeCc, vtkVariant(volumeCc));
-  std::ostringstream attributeNameStream;
-  std::ostringstream attributeValueStream;
-  attributeNameStream << vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX << vtkSlicerDoseVolumeHistogramModuleLogic::DVH_METRIC_TOTAL_VOLUME_CC;
-  attributeValueStream << volumeCc;
-  tableNode->SetAttribute(attributeNameStream.str().c_str(), attributeValueStream.str().c_str());
-  // Mean dose
-  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMeanDose, vtkVariant(structureStat->GetMean()[0]));
-  // Min dose
-  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMinDose, vtkVariant(structureStat->GetMin()[0]));
-  // Max dose
-  metricsTable->SetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMaxDose, vtkVariant(structureStat->GetMax()[0]));
 
-  // Create DVH plot values
-  int numSamples = 0;
-  double startValue = 0.0;
-  double stepSize = 0.0;
-  double rangeMin = structureStat->GetMin()[0];
-  double rangeMax = structureStat->GetMax()[0];
-  if (isDoseVolume)
+  //
+  // Compute DVH for each dose volume. Doses are distributed among the threads, and the segments of one dose are computed on the same thread
+  //
+  std::vector<vtkInternal::DoseDvhTask*> inCoreTasks;
+  for (std::vector<vtkInternal::DoseDvhTask>::iterator taskIt = tasks.begin(); taskIt != tasks.end(); ++taskIt)
   {
-    if (rangeMin<0)
+    if (!taskIt->Streaming)
     {
-      std::string errorMessage("The dose volume contains negative dose values");
-      vtkErrorMacro("ComputeDvh: " << errorMessage);
-      return errorMessage;
+      inCoreTasks.push_back(&(*taskIt));
     }
-
-    startValue = this->StartValue;
-    stepSize = this->StepSize;
-    numSamples = (int)ceil( (maxDoseGy-startValue)/stepSize ) + 1;
   }
-  else
+  this->Internal->ComputeDoseDvhTasks(inCoreTasks, parameterNode->GetNumberOfThreads());
+
+  // Doses that do not fit in the memory limit are processed one at a time in slabs
+  for (std::vector<vtkInternal::DoseDvhTask>::iterator taskIt = tasks.begin(); taskIt != tasks.end(); ++taskIt)
   {
-    startValue = rangeMin;
-    numSamples = this->NumberOfSamplesForNonDoseVolumes;
-    stepSize = (rangeMax - rangeMin) / (double)(numSamples-1);
+    if (taskIt->Streaming)
+    {
+      this->Internal->ReleaseCachedImages();
+      taskIt->ErrorMessage = this->Internal->ComputeSegmentDvhJobsStreaming(
+        parameterNode, segmentIDs, taskIt->OversamplingFactors, taskIt->DoseImageData, taskIt->Settings, taskIt->Jobs);
+      taskIt->DoseImageData = nullptr;
+    }
   }
 
-  // Get the number of voxels with smaller dose than at the start value
-  structureStat->SetComponentExtent(0,1,0,0,0,0);
-  structureStat->SetComponentOrigin(0,0,0);
-  structureStat->SetComponentSpacing(startValue,1,1);
-  structureStat->Update();
-  double voxelBelowDose = structureStat->GetOutput()->GetScalarComponentAsDouble(0,0,0,0);
+  // Store results in the order of the doses and the segments, so that the output does not depend on the number of threads
+  for (std::vector<vtkInternal::DoseDvhTask>::iterator taskIt = tasks.begin(); taskIt != tasks.end(); ++taskIt)
+  {
+    if (!taskIt->ErrorMessage.empty())
+    {
+      vtkErrorMacro("ComputeDvhBatch: " << taskIt->ErrorMessage);
+      return taskIt->ErrorMessage;
+    }
+    for (std::vector<vtkInternal::SegmentDvhJob>::iterator jobIt = taskIt->Jobs.begin(); jobIt != taskIt->Jobs.end(); ++jobIt)
+    {
+      std::string errorMessage = jobIt->ErrorMessage;
+      if (errorMessage.empty())
+      {
+        errorMessage = this->Internal->StoreDvhStatistics(parameterNode, taskIt->DoseVolumeNode, jobIt->SegmentID, jobIt->Statistics);
+      }
+      if (!errorMessage.empty())
+      {
+        vtkErrorMacro("ComputeDvhBatch: " << errorMessage);
+        return errorMessage;
+      }
+    } // For each segment
+  } // For each dose volume
 
-  // We put a fixed point at (0.0, 100%), but only if there are only positive values in the histogram
-  // Negative values can occur when the user requests histogram for an image, such as s CT volume (in
-  // this case Intensity Volume Histogram is computed), or the startValue became negative for the dose
-  // volume because the range minimum was smaller than the original start value.
-  bool insertPointAtOrigin = true;
-  if (startValue < 0.0)
+  // Log measured time
+  double checkpointEnd = timer->GetUniversalTime();
+  UNUSED_VARIABLE(checkpointEnd); // Although it is used just below, a warning is logged so needs to be suppressed
+  if (this->LogSpeedMeasurements)
   {
-    insertPointAtOrigin = false;
+    vtkDebugMacro("ComputeDvhBatch: DVH computation time for " << numberOfDoseVolumes << " dose volumes and "
+      << segmentIDs.size() << " structures: " << checkpointEnd-checkpointStart << " s");
   }
 
-  structureStat->SetComponentExtent(0,numSamples-1,0,0,0,0);
-  structureStat->SetComponentOrigin(startValue,0,0);
-  structureStat->SetComponentSpacing(stepSize,1,1);
-  structureStat->Update();
-
-  // Allocate table
-  vtkTable* table = tableNode->GetTable();
-  int numberOfRows = numSamples + (insertPointAtOrigin?1:0);
-  vtkNew<vtkDoubleArray> columnDose;
-  columnDose->SetName(isDoseVolume ? "Dose" : "Intensity");
-  columnDose->SetNumberOfTuples(numberOfRows);
-  table->AddColumn(columnDose);
-  vtkNew<vtkDoubleArray> columnVolume;
-  columnVolume->SetName("Volume");
-  columnVolume->SetNumberOfTuples(numberOfRows);
-  table->AddColumn(columnVolume);
-  table->SetNumberOfRows(numberOfRows);
+  // Fire only one modified event when the computation is done
+  this->SetDisableModifiedEvent(0);
+  this->Modified();
+  parameterNode->EndModify(disabledNodeModify);
+  // Trigger update of table
+  if (parameterNode->GetMetricsTableNode())
+  {
+    parameterNode->GetMetricsTableNode()->Modified();
+  }
 
-  int rowIndex = 0;
+  return "";
+}
 
-  if (insertPointAtOrigin)
+//---------------------------------------------------------------------------
+std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolumeHistogramNode* parameterNode, vtkOrientedImageData* segmentLabelmap, vtkOrientedImageData* oversampledDoseVolume, std::string segmentID, double maxDoseGy)
+{
+  if (!this->GetMRMLScene() || !parameterNode)
   {
-    // Add first fixed point at (0.0, 100%)
-    table->SetValue(rowIndex, 0, 0.0);
-    table->SetValue(rowIndex, 1, 100.0);
-    table->SetValue(rowIndex, 2, 0);
-    ++rowIndex;
+    std::string errorMessage("Invalid MRML scene or parameter set node");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
   }
-
-  vtkImageData* statArray = structureStat->GetOutput();
-  double totalVoxels = 0;
-  if (useFractionalLabelmap)
+  if (!segmentLabelmap)
   {
-    totalVoxels = vtkFractionalImageAccumulate::SafeDownCast(structureStat)->GetFractionalVoxelCount();
+    std::string errorMessage("Invalid segment labelmap");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
   }
-  else
+  if (!oversampledDoseVolume)
   {
-    totalVoxels = structureStat->GetVoxelCount();
+    std::string errorMessage("Invalid oversampled dose volume");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
   }
-
-  for (int sampleIndex=0; sampleIndex<numSamples; ++sampleIndex)
+  vtkMRMLSegmentationNode* segmentationNode = parameterNode->GetSegmentationNode();
+  vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
+  if ( !segmentationNode || !doseVolumeNode )
   {
-    double voxelsInBin = statArray->GetScalarComponentAsDouble(sampleIndex,0,0,0);
-    table->SetValue(rowIndex, 0, startValue + sampleIndex * stepSize);
-    if (useFractionalLabelmap)
-    {
-      table->SetValue(rowIndex, 1, std::max(0.0, (1.0-(double)voxelBelowDose/(double)totalVoxels)*100.0));
-    }
-    else
-    {
-      table->SetValue(rowIndex, 1, (1.0-(double)voxelBelowDose/(double)totalVoxels)*100.0);
-    }
-    table->SetValue(rowIndex, 2, 0);
-    ++rowIndex;
-    voxelBelowDose += voxelsInBin;
+    std::string errorMessage("Both segmentation node and dose volume node need to be set");
+    vtkErrorMacro("ComputeDvh: " << errorMessage);
+    return errorMessage;
   }
 
-  // Set the start of the first bin to 0 if the volume contains dose and the start value was negative
-  if (isDoseVolume && !insertPointAtOrigin)
+  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
+  double checkpointStart = timer->GetUniversalTime();
+  UNUSED_VARIABLE(checkpointStart); // Although it is used later, a warning is logged so needs to be suppressed
+
+  vtkInternal::DvhComputationSettings settings;
+  this->Internal->InitializeComputationSettings(parameterNode, doseVolumeNode, maxDoseGy, settings);
+
+  vtkInternal::DvhStatistics statistics;
+  std::string errorMessage = vtkInternal::ComputeDvhStatistics(segmentLabelmap, oversampledDoseVolume, settings, statistics);
+  if (errorMessage.empty())
   {
-    table->SetValue(0, 0, 0.0);
+    errorMessage = this->Internal->StoreDvhStatistics(parameterNode, doseVolumeNode, segmentID, statistics);
   }
-
-  // Setup DVH subject hierarchy items
-  vtkMRMLSubjectHierarchyNode* shNode = vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(this->GetMRMLScene());
-  if (!shNode)
+  if (!errorMessage.empty())
   {
-    std::string errorMessage("Failed to access subject hierarchy node");
     vtkErrorMacro("ComputeDvh: " << errorMessage);
     return errorMessage;
   }
-  vtkIdType doseShItemID = shNode->GetItemByDataNode(doseVolumeNode);
-
-  // Add metrics table and chart to under the study of the dose in subject hierarchy
-  vtkIdType studyItemID = shNode->GetItemAncestorAtLevel(doseShItemID, vtkMRMLSubjectHierarchyConstants::GetDICOMLevelStudy());
-  if (studyItemID != vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID)
-  {
-    vtkIdType metricsShItemID = shNode->CreateItem(studyItemID, metricsTableNode);
-    shNode->CreateItem(metricsShItemID, tableNode);
-
-    vtkMRMLPlotChartNode* chartNode = parameterNode->GetChartNode();
-    shNode->CreateItem(studyItemID, chartNode);
-  }
-
-  // Add connection attribute to input segmentation and dose volume nodes
-  segmentationNode->AddNodeReferenceID(DVH_CREATED_DVH_NODE_REFERENCE_ROLE.c_str(), tableNode->GetID());
-  doseVolumeNode->AddNodeReferenceID(DVH_CREATED_DVH_NODE_REFERENCE_ROLE.c_str(), tableNode->GetID());
 
   // Log measured time
   double checkpointEnd = timer->GetUniversalTime();
@@ -1225,13 +3320,12 @@ bool vtkSlicerDoseVolumeHistogramModuleLogic::ComputeVMetrics(vtkMRMLDoseVolumeH
   }
 
   // Get V metric dose values from input string
-  std::string doseValuesStr(parameterNode->GetVDoseValues()?parameterNode->GetVDoseValues():"");
-  std::vector<double> doseValues;
-  this->GetNumbersFromMetricString(doseValuesStr, doseValues);
+  const std::vector<double>& doseValues = this->Internal->GetMetricNumbers(parameterNode->GetVDoseValues());
 
   // Create table columns for requested V metrics
   int numberOfColumnsBefore = metricsTable->GetNumberOfColumns();
-  for (std::vector<double>::iterator doseValueIt=doseValues.begin(); doseValueIt!=doseValues.end(); ++doseValueIt)
+  std::vector<vtkInternal::DvhMetricQuery> queries;
+  for (std::vector<double>::const_iterator doseValueIt=doseValues.begin(); doseValueIt!=doseValues.end(); ++doseValueIt)
   {
     if (parameterNode->GetShowVMetricsCc())
     {
@@ -1240,6 +3334,11 @@ bool vtkSlicerDoseVolumeHistogramModuleLogic::ComputeVMetrics(vtkMRMLDoseVolumeH
       vtkAbstractArray* newColumn = metricsTableNode->AddColumn();
       newColumn->SetName(newColumnName.str().c_str());
       metricsTable->AddColumn(newColumn);
+
+      vtkInternal::DvhMetricQuery query;
+      query.Type = vtkInternal::DvhMetricQuery::VolumeCc;
+      query.Value = (*doseValueIt);
+      queries.push_back(query);
     }
     if (parameterNode->GetShowVMetricsPercent())
     {
@@ -1248,83 +3347,20 @@ bool vtkSlicerDoseVolumeHistogramModuleLogic::ComputeVMetrics(vtkMRMLDoseVolumeH
       vtkAbstractArray* newColumn = metricsTableNode->AddColumn();
       newColumn->SetName(newColumnName.str().c_str());
       metricsTable->AddColumn(newColumn);
-    }
-  }
-
-  // Traverse all DVH nodes referenced from metrics table and calculate V metrics
-  std::vector<std::string> roles;
-  metricsTableNode->GetNodeReferenceRoles(roles);
-  for (std::vector<std::string>::iterator roleIt=roles.begin(); roleIt!=roles.end(); ++roleIt)
-  {
-    if ( roleIt->substr(0, vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX.size()).compare(
-      vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX ) )
-    {
-      // Not a DVH reference
-      continue;
-    }
-
-    // Get DVH node
-    vtkMRMLTableNode* dvhTableNode = vtkMRMLTableNode::SafeDownCast(metricsTableNode->GetNodeReference(roleIt->c_str()));
-    if (!dvhTableNode)
-    {
-      vtkErrorMacro("ComputeVMetrics: Metrics table node reference '" << (*roleIt) << "' does not contain DVH node");
-      continue;
-    }
-
-    // Get corresponding table row
-    int tableRow = -1;
-    std::stringstream ss;
-    ss << dvhTableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str());
-    ss >> tableRow;
-    if (ss.fail())
-    {
-      vtkErrorMacro("ComputeVMetrics: Failed to get metrics table row from DVH node " << dvhTableNode->GetName());
-      continue;
-    }
-
-    // Get structure volume
-    double structureVolume = metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnVolumeCc).ToDouble();
-    if (structureVolume == 0)
-    {
-      vtkErrorMacro("ComputeVMetrics: Failed to get structure volume for structure " << metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnStructure).ToString());
-      continue;
-    }
-
-    // Compute volume for all V's
-    vtkTable* table = dvhTableNode->GetTable();
-    vtkNew<vtkPiecewiseFunction> interpolator;
-    interpolator->ClampingOn();
 
-    // Starting from second point, because BuildFunctionFromTable needs uniform distance between X coordinates
-    //  and the first point may be 0 (with different distance to neighbors than the second)
-    double* dvhArrayDouble = new double[table->GetNumberOfRows()-1];
-    for (int i=1; i<table->GetNumberOfRows(); ++i)
-    {
-      dvhArrayDouble[i-1] = table->GetValue(i, 1).ToDouble();
+      vtkInternal::DvhMetricQuery query;
+      query.Type = vtkInternal::DvhMetricQuery::VolumePercent;
+      query.Value = (*doseValueIt);
+      queries.push_back(query);
     }
-    interpolator->BuildFunctionFromTable(
-      table->GetValue(1, 0).ToDouble(), table->GetValue(table->GetNumberOfRows()-1, 0).ToDouble(), table->GetNumberOfRows()-1,
-      dvhArrayDouble );
-
-    // Add first point
-    interpolator->AddPoint(table->GetValue(0, 0).ToDouble(), table->GetValue(0, 1).ToDouble());
+  }
 
-    // Calculate metrics and set table entries
-    int tableColumn = numberOfColumnsBefore;
-    for (std::vector<double>::iterator it = doseValues.begin(); it != doseValues.end(); ++it)
-    {
-      double volumePercentEstimated = interpolator->GetValue(*it);
-      if (parameterNode->GetShowVMetricsCc())
-      {
-        metricsTable->SetValue( tableRow, tableColumn++, vtkVariant(volumePercentEstimated*structureVolume/100.0) );
-      }
-      if (parameterNode->GetShowVMetricsPercent())
-      {
-        metricsTable->SetValue( tableRow, tableColumn++, vtkVariant(volumePercentEstimated) );
-      }
-    }
-    delete[] dvhArrayDouble;
-  } // For all DVHs
+  // Evaluate the V metrics for all DVHs referenced from metrics table, then set the table entries
+  std::vector<vtkInternal::DvhMetricTarget> targets;
+  this->Internal->GetDvhMetricTargets(metricsTableNode, "ComputeVMetrics", targets);
+  std::vector<double> results;
+  vtkInternal::EvaluateDvhMetricQueries(queries, targets, results);
+  vtkInternal::WriteDvhMetricResults(metricsTable, numberOfColumnsBefore, queries.size(), targets, results);
 
   metricsTableNode->Modified();
   return true;
@@ -1412,91 +3448,46 @@ bool vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDMetrics(vtkMRMLDoseVolumeH
     return true;
   }
 
-  // Get D metric dose values from input string
-  std::vector<double> volumeValuesCc;
-  std::vector<double> volumeValuesPercent;
-  if (parameterNode->GetDVolumeValuesCc())
-  {
-    std::string volumeValuesCcStr(parameterNode->GetDVolumeValuesCc()?parameterNode->GetDVolumeValuesCc():"");
-    this->GetNumbersFromMetricString(volumeValuesCcStr, volumeValuesCc);
-  }
-  if (parameterNode->GetDVolumeValuesPercent())
-  {
-    std::string volumeValuesPercentStr(parameterNode->GetDVolumeValuesPercent()?parameterNode->GetDVolumeValuesPercent():"");
-    this->GetNumbersFromMetricString(volumeValuesPercentStr, volumeValuesPercent);
-  }
+  // Get D metric volume values from input strings
+  const std::vector<double>& volumeValuesCc = this->Internal->GetMetricNumbers(parameterNode->GetDVolumeValuesCc());
+  const std::vector<double>& volumeValuesPercent = this->Internal->GetMetricNumbers(parameterNode->GetDVolumeValuesPercent());
 
   // Create table columns for requested D metrics
   int numberOfColumnsBefore = metricsTable->GetNumberOfColumns();
-  for (std::vector<double>::iterator ccIt=volumeValuesCc.begin(); ccIt!=volumeValuesCc.end(); ++ccIt)
+  std::vector<vtkInternal::DvhMetricQuery> queries;
+  for (std::vector<double>::const_iterator ccIt=volumeValuesCc.begin(); ccIt!=volumeValuesCc.end(); ++ccIt)
   {
     std::stringstream newColumnName;
     newColumnName << "D" << (*ccIt) << "cc" << doseUnitPostfix;
     vtkAbstractArray* newColumn = metricsTableNode->AddColumn();
     newColumn->SetName(newColumnName.str().c_str());
     metricsTable->AddColumn(newColumn);
+
+    vtkInternal::DvhMetricQuery query;
+    query.Type = vtkInternal::DvhMetricQuery::DoseForVolumeCc;
+    query.Value = (*ccIt);
+    queries.push_back(query);
   }
-  for (std::vector<double>::iterator percentIt=volumeValuesPercent.begin(); percentIt!=volumeValuesPercent.end(); ++percentIt)
+  for (std::vector<double>::const_iterator percentIt=volumeValuesPercent.begin(); percentIt!=volumeValuesPercent.end(); ++percentIt)
   {
     std::stringstream newColumnName;
     newColumnName << "D" << (*percentIt) << "%" << doseUnitPostfix;
     vtkAbstractArray* newColumn = metricsTableNode->AddColumn();
     newColumn->SetName(newColumnName.str().c_str());
     metricsTable->AddColumn(newColumn);
-  }
-
-  // Traverse all DVH nodes referenced from metrics table and calculate V metrics
-  std::vector<std::string> roles;
-  metricsTableNode->GetNodeReferenceRoles(roles);
-  for (std::vector<std::string>::iterator roleIt=roles.begin(); roleIt!=roles.end(); ++roleIt)
-  {
-    if ( roleIt->substr(0, vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX.size()).compare(
-      vtkMRMLDoseVolumeHistogramNode::DVH_ATTRIBUTE_PREFIX ) )
-    {
-      // Not a DVH reference
-      continue;
-    }
-
-    // Get DVH node
-    vtkMRMLTableNode* dvhTableNode = vtkMRMLTableNode::SafeDownCast(metricsTableNode->GetNodeReference(roleIt->c_str()));
-    if (!dvhTableNode)
-    {
-      vtkErrorMacro("ComputeDMetrics: Metrics table node reference '" << (*roleIt) << "' does not contain DVH node");
-      continue;
-    }
-
-    // Get corresponding table row
-    int tableRow = -1;
-    std::stringstream ss;
-    ss << dvhTableNode->GetAttribute(DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str());
-    ss >> tableRow;
-    if (ss.fail())
-    {
-      vtkErrorMacro("ComputeDMetrics: Failed to get metrics table row from DVH node " << dvhTableNode->GetName());
-      continue;
-    }
 
-    // Get structure volume
-    double structureVolume = metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnVolumeCc).ToDouble();
-    if (structureVolume == 0)
-    {
-      vtkErrorMacro("ComputeDMetrics: Failed to get structure volume for structure " << metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnStructure).ToString());
-      continue;
-    }
+    vtkInternal::DvhMetricQuery query;
+    query.Type = vtkInternal::DvhMetricQuery::DoseForVolumePercent;
+    query.Value = (*percentIt);
+    queries.push_back(query);
+  }
 
-    // Calculate metrics and set table entries
-    int tableColumn = numberOfColumnsBefore;
-    for (std::vector<double>::iterator ccIt=volumeValuesCc.begin(); ccIt!=volumeValuesCc.end(); ++ccIt)
-    {
-      double d = ComputeDMetric(dvhTableNode, (*ccIt), structureVolume, false);
-      metricsTable->SetValue(tableRow, tableColumn++, vtkVariant(d));
-    }
-    for (std::vector<double>::iterator percentIt=volumeValuesPercent.begin(); percentIt!=volumeValuesPercent.end(); ++percentIt)
-    {
-      double d = ComputeDMetric(dvhTableNode, (*percentIt), structureVolume, true);
-      metricsTable->SetValue(tableRow, tableColumn++, vtkVariant(d));
-    }
-  } // For all DVHs
+  // Evaluate the D metrics for all DVHs referenced from metrics table, then set the table entries
+  std::vector<vtkInternal::DvhMetricTarget> targets;
+  this->Internal->GetDvhMetricTargets(metricsTableNode, "ComputeDMetrics", targets);
+  std::vector<double> results;
+  vtkInternal::EvaluateDvhMetricQueries(queries, targets, results);
+  vtkInternal::WriteDvhMetricResults(metricsTable, numberOfColumnsBefore, queries.size(), targets, results);
 
   metricsTableNode->Modified();
   return true;
@@ -1516,49 +3507,15 @@ double vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDMetric(vtkMRMLTableNode*
     return 0.0;
   }
 
-  vtkTable* table = tableNode->GetTable();
-  double volumeSize = 0.0;
-  double doseForVolume = 0.0;
-
-  if (isPercent)
-  {
-    volumeSize = volume * structureVolume / 100.0;
-  }
-  else
-  {
-    volumeSize = volume;
-  }
-
-  // Check if the given volume is above the highest (first) in the array then assign no dose
-  if (volumeSize >= table->GetValue(0, 1).ToDouble() / 100.0 * structureVolume)
-  {
-    doseForVolume = 0.0;
-  }
-  // If volume is below the lowest (last) in the array then assign maximum dose
-  else if (volumeSize < table->GetValue(table->GetNumberOfRows()-1, 1).ToDouble() / 100.0 * structureVolume)
-  {
-    doseForVolume = table->GetValue(table->GetNumberOfRows()-1, 0).ToDouble();
-  }
-  else
+  const vtkInternal::DvhTableIndex* index = this->Internal->GetDvhTableIndex(tableNode);
+  if (!index)
   {
-    for (int i=0; i<table->GetNumberOfRows()-1; ++i)
-    {
-      double volumePrevious = table->GetValue(i, 1).ToDouble() / 100.0 * structureVolume;
-      double volumeNext = table->GetValue(i+1, 1).ToDouble() / 100.0 * structureVolume;
-      if (volumePrevious > volumeSize && volumeSize >= volumeNext)
-      {
-        // Compute the dose using linear interpolation
-        double dosePrevious = table->GetValue(i, 0).ToDouble();
-        double doseNext = table->GetValue(i+1, 0).ToDouble();
-        double doseEstimated = dosePrevious + (doseNext-dosePrevious)*(volumeSize-volumePrevious)/(volumeNext-volumePrevious);
-        doseForVolume = doseEstimated;
-
-        break;
-      }
-    }
+    vtkErrorMacro("ComputeDMetric: Invalid DVH table in node " << tableNode->GetName());
+    return 0.0;
   }
 
-  return doseForVolume;
+  double volumeSize = (isPercent ? volume * structureVolume / 100.0 : volume);
+  return vtkInternal::LookupDose(*index, volumeSize, structureVolume);
 }
 
 //---------------------------------------------------------------------------
@@ -84,12 +84,23 @@ public:
   /// Compute DVH based on parameter node selections (dose volume, segmentation, segment IDs)
   std::string ComputeDvh(vtkMRMLDoseVolumeHistogramNode* parameterNode);
 
+  /// Compute DVHs of the selected segments for each dose volume selected for batch computation in the parameter node.
+  /// The segments are rasterized once for each distinct dose geometry, and the DVH tables of all dose volumes are added
+  /// to the metrics table of the parameter node. The number of threads set in the parameter node is used for computing
+  /// the dose volumes concurrently (the segments of each dose volume are then computed on the same thread).
+  /// The dose volume of the parameter node needs to be set as well, as the metric names are assembled from it.
+  /// \return Error message, empty string if no error
+  std::string ComputeDvhBatch(vtkMRMLDoseVolumeHistogramNode* parameterNode);
+
   /// Compute V metrics for existing DVHs using the given dose values and add them in the metrics table
   bool ComputeVMetrics(vtkMRMLDoseVolumeHistogramNode* parameterNode);
 
   /// Compute D metrics for existing DVHs using the given dose values and add them in the metrics table
   bool ComputeDMetrics(vtkMRMLDoseVolumeHistogramNode* parameterNode);
 
+  /// Remove the segment labelmaps and oversampled dose volumes cached from previous DVH computations
+  void ClearCache();
+
   /// Add dose volume histogram of a structure (ROI) to the selected plot given its table node
   /// \return Plot series node corresponding to the given table in the given chart
   vtkMRMLPlotSeriesNode* AddDvhToChart(vtkMRMLPlotChartNode* chartNode, vtkMRMLTableNode* tableNode);
@@ -138,6 +149,18 @@ public:
   vtkSetMacro(UseLinearInterpolationForDoseVolume, bool);
   vtkBooleanMacro(UseLinearInterpolationForDoseVolume, bool);
 
+  vtkGetMacro(UseSinglePassAccumulation, bool);
+  vtkSetMacro(UseSinglePassAccumulation, bool);
+  vtkBooleanMacro(UseSinglePassAccumulation, bool);
+
+  vtkGetMacro(UseComputationCache, bool);
+  vtkSetMacro(UseComputationCache, bool);
+  vtkBooleanMacro(UseComputationCache, bool);
+
+  vtkGetMacro(UseSegmentExtentCropping, bool);
+  vtkSetMacro(UseSegmentExtentCropping, bool);
+  vtkBooleanMacro(UseSegmentExtentCropping, bool);
+
   vtkGetMacro(LogSpeedMeasurements, bool);
   vtkSetMacro(LogSpeedMeasurements, bool);
   vtkBooleanMacro(LogSpeedMeasurements, bool);
@@ -188,6 +211,9 @@ protected:
 
   void OnMRMLSceneEndClose() override;
 
+  /// Remove the cached lookup index of removed DVH tables
+  void OnMRMLSceneNodeRemoved(vtkMRMLNode* node) override;
+
 private:
   vtkSlicerDoseVolumeHistogramModuleLogic(const vtkSlicerDoseVolumeHistogramModuleLogic&) = delete;
   void operator=(const vtkSlicerDoseVolumeHistogramModuleLogic&) = delete;
@@ -211,8 +237,30 @@ protected:
   /// does not reach the end of the dose voxel. False by default
   bool UseLinearInterpolationForDoseVolume;
 
+  /// Flag determining whether the histograms of all segments are accumulated in one sweep over the dose volume,
+  /// instead of stenciling and accumulating the dose separately for each segment. The results are identical for binary
+  /// labelmaps, and differ only by floating point rounding for fractional labelmaps (relative difference below 1e-12).
+  /// Only used with fixed oversampling and without dose surface histogram. True by default
+  bool UseSinglePassAccumulation;
+
+  /// Flag determining whether segment labelmaps converted to the dose geometry and oversampled dose volumes are kept
+  /// between DVH computations. Cached labelmaps are reused while the segment, the conversion parameters, the dose geometry
+  /// and the oversampling are unchanged; cached dose volumes while the dose volume is unchanged. Labelmaps of removed
+  /// segments are evicted, and if a memory limit is set in the parameter node then the least recently used labelmaps are
+  /// evicted to keep the cache within the limit (and the cache is emptied when the dose is processed in slabs). True by default
+  bool UseComputationCache;
+
+  /// Flag determining whether the dose and the segment labelmap are cropped to the extent of the segment (plus a one voxel margin)
+  /// before computing the DVH of a segment, instead of padding the labelmap to the full dose extent. The results are identical.
+  /// True by default
+  bool UseSegmentExtentCropping;
+
   /// Flag telling whether the speed measurements are logged on standard output
   bool LogSpeedMeasurements;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+  friend class vtkInternal; // For access to the computation settings
 };
 
 #endif
@@ -40,6 +40,7 @@
 
 //------------------------------------------------------------------------------
 const char* vtkMRMLDoseVolumeHistogramNode::DOSE_VOLUME_REFERENCE_ROLE = "doseVolumeRef";
+const char* vtkMRMLDoseVolumeHistogramNode::BATCH_DOSE_VOLUME_REFERENCE_ROLE = "batchDoseVolumeRef";
 const char* vtkMRMLDoseVolumeHistogramNode::SEGMENTATION_REFERENCE_ROLE = "segmentationRef";
 const char* vtkMRMLDoseVolumeHistogramNode::DVH_METRICS_TABLE_REFERENCE_ROLE = "dvhMetricsTableRef";
 static const char* CHART_REFERENCE_ROLE = "chartRef";
@@ -66,6 +67,8 @@ vtkMRMLDoseVolumeHistogramNode::vtkMRMLDoseVolumeHistogramNode()
   this->UseFractionalLabelmap = false;
   this->DoseSurfaceHistogram = 0;
   this->UseInsideDoseSurface = true;
+  this->NumberOfThreads = 1;
+  this->MemoryLimitMB = 0;
 
   this->HideFromEditors = false;
 }
@@ -105,6 +108,8 @@ void vtkMRMLDoseVolumeHistogramNode::WriteXML(ostream& of, int nIndent)
 
   of << " ShowDoseVolumesOnly=\"" << (this->ShowDoseVolumesOnly ? "true" : "false") << "\"";
   of << " AutomaticOversampling=\"" << (this->AutomaticOversampling ? "true" : "false") << "\"";
+  of << " NumberOfThreads=\"" << this->NumberOfThreads << "\"";
+  of << " MemoryLimitMB=\"" << this->MemoryLimitMB << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -175,6 +180,14 @@ void vtkMRMLDoseVolumeHistogramNode::ReadXMLAttributes(const char** atts)
       {
       this->AutomaticOversampling = (strcmp(attValue,"true") ? false : true);
       }
+    else if (!strcmp(attName, "NumberOfThreads")) 
+      {
+      this->NumberOfThreads = vtkVariant(attValue).ToInt();
+      }
+    else if (!strcmp(attName, "MemoryLimitMB")) 
+      {
+      this->MemoryLimitMB = vtkVariant(attValue).ToInt();
+      }
     }
 }
 
@@ -200,6 +213,8 @@ void vtkMRMLDoseVolumeHistogramNode::Copy(vtkMRMLNode *anode)
   this->ShowDMetrics = node->ShowDMetrics;
   this->ShowDoseVolumesOnly = node->ShowDoseVolumesOnly;
   this->AutomaticOversampling = node->AutomaticOversampling;
+  this->NumberOfThreads = node->NumberOfThreads;
+  this->MemoryLimitMB = node->MemoryLimitMB;
 
   this->DisableModifiedEventOff();
   this->InvokePendingModifiedEvent();
@@ -228,6 +243,8 @@ void vtkMRMLDoseVolumeHistogramNode::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "ShowDMetrics:   " << (this->ShowDMetrics ? "true" : "false") << "\n";
   os << indent << "ShowDoseVolumesOnly:   " << (this->ShowDoseVolumesOnly ? "true" : "false") << "\n";
   os << indent << "AutomaticOversampling:   " << (this->AutomaticOversampling ? "true" : "false") << "\n";
+  os << indent << "NumberOfThreads:   " << this->NumberOfThreads << "\n";
+  os << indent << "MemoryLimitMB:   " << this->MemoryLimitMB << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -248,6 +265,36 @@ void vtkMRMLDoseVolumeHistogramNode::SetAndObserveDoseVolumeNode(vtkMRMLScalarVo
   this->SetNodeReferenceID(DOSE_VOLUME_REFERENCE_ROLE, (node ? node->GetID() : nullptr));
 }
 
+//----------------------------------------------------------------------------
+int vtkMRMLDoseVolumeHistogramNode::GetNumberOfBatchDoseVolumeNodes()
+{
+  return this->GetNumberOfNodeReferences(BATCH_DOSE_VOLUME_REFERENCE_ROLE);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkMRMLDoseVolumeHistogramNode::GetNthBatchDoseVolumeNode(int n)
+{
+  return vtkMRMLScalarVolumeNode::SafeDownCast( this->GetNthNodeReference(BATCH_DOSE_VOLUME_REFERENCE_ROLE, n) );
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLDoseVolumeHistogramNode::AddBatchDoseVolumeNode(vtkMRMLScalarVolumeNode* node)
+{
+  if (!node || this->Scene != node->GetScene())
+    {
+    vtkErrorMacro("Cannot add reference: the referenced and referencing node are not in the same scene");
+    return;
+    }
+
+  this->AddNodeReferenceID(BATCH_DOSE_VOLUME_REFERENCE_ROLE, node->GetID());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLDoseVolumeHistogramNode::RemoveAllBatchDoseVolumeNodes()
+{
+  this->RemoveNodeReferenceIDs(BATCH_DOSE_VOLUME_REFERENCE_ROLE);
+}
+
 //----------------------------------------------------------------------------
 vtkMRMLSegmentationNode* vtkMRMLDoseVolumeHistogramNode::GetSegmentationNode()
 {
@@ -342,14 +389,20 @@ void vtkMRMLDoseVolumeHistogramNode::SetAndObserveChartNode(vtkMRMLPlotChartNode
 //----------------------------------------------------------------------------
 std::string vtkMRMLDoseVolumeHistogramNode::AssembleDvhNodeReference(std::string segmentID)
 {
-  if (!this->GetSegmentationNode() || !this->GetDoseVolumeNode() || segmentID.empty())
+  return this->AssembleDvhNodeReference(segmentID, this->GetDoseVolumeNode());
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMRMLDoseVolumeHistogramNode::AssembleDvhNodeReference(std::string segmentID, vtkMRMLScalarVolumeNode* doseVolumeNode)
+{
+  if (!this->GetSegmentationNode() || !doseVolumeNode || segmentID.empty())
   {
     vtkErrorMacro("AssembleDvhNodeReference: Invalid input selection");
     return "";
   }
   
   std::string referenceRole = DVH_ATTRIBUTE_PREFIX;
-  referenceRole.append(this->GetDoseVolumeNode()->GetID());
+  referenceRole.append(doseVolumeNode->GetID());
   referenceRole.append("_");
   referenceRole.append(this->GetSegmentationNode()->GetID());
   referenceRole.append("_");
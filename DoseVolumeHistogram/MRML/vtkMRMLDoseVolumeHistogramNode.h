@@ -42,6 +42,7 @@ class vtkMRMLTableNode;
 /// Parameter set node for DVH computation.
 /// Node references:
 ///   Parameter -> Dose Volume (DOSE_VOLUME_REFERENCE_ROLE)
+///             -> Dose Volumes for batch computation (BATCH_DOSE_VOLUME_REFERENCE_ROLE, multiple)
 ///             -> Segmentation Node (SEGMENTATION_REFERENCE_ROLE)
 ///             -> Metrics Table (mandatory, unique to parameter) (DVH_METRICS_TABLE_REFERENCE_ROLE)
 ///             -> Chart (mandatory, unique to parameter) (CHART_REFERENCE_ROLE)
@@ -57,6 +58,7 @@ public:
   // DoseVolumeHistogram constants
   static const std::string DVH_ATTRIBUTE_PREFIX;
   static const char* DOSE_VOLUME_REFERENCE_ROLE;
+  static const char* BATCH_DOSE_VOLUME_REFERENCE_ROLE;
   static const char* SEGMENTATION_REFERENCE_ROLE;
   static const char* DVH_METRICS_TABLE_REFERENCE_ROLE;
 
@@ -99,6 +101,15 @@ public:
   /// Set and observe dose volume node
   void SetAndObserveDoseVolumeNode(vtkMRMLScalarVolumeNode* node);
 
+  /// Get number of dose volumes selected for batch computation
+  int GetNumberOfBatchDoseVolumeNodes();
+  /// Get n-th dose volume selected for batch computation
+  vtkMRMLScalarVolumeNode* GetNthBatchDoseVolumeNode(int n);
+  /// Add dose volume to the batch computation
+  void AddBatchDoseVolumeNode(vtkMRMLScalarVolumeNode* node);
+  /// Remove all dose volumes from the batch computation
+  void RemoveAllBatchDoseVolumeNodes();
+
   /// Get segmentation node
   vtkMRMLSegmentationNode* GetSegmentationNode();
   /// Set and observe segmentation node
@@ -143,6 +154,8 @@ public:
 
   /// Assemble DVH node reference role for current input selection and specific segment
   std::string AssembleDvhNodeReference(std::string segmentID);
+  /// Assemble DVH node reference role for the current segmentation, and specific dose volume and segment
+  std::string AssembleDvhNodeReference(std::string segmentID, vtkMRMLScalarVolumeNode* doseVolumeNode);
 
   /// Collect DVH Table nodes belonging to this parameter set node
   void GetDvhTableNodes(std::vector<vtkMRMLTableNode*> &dvhTableNodes);
@@ -196,7 +209,10 @@ public:
   /// Set automatic oversampling flag
   vtkBooleanMacro(AutomaticOversampling, bool);
 
-  /// Get fractional labelmap flag
+  /// Get fractional labelmap flag.
+  /// Note: with fixed oversampling, fractional labelmaps of planar contour segments are computed from the exact
+  /// coverage of the contours (vtkPlanarContourToFractionalLabelmapConversionRule) instead of through the closed
+  /// surface, so the fractional volumes differ slightly from those computed by earlier versions.
   vtkGetMacro(UseFractionalLabelmap, bool);
   /// Set fractional labelmap flag
   vtkSetMacro(UseFractionalLabelmap, bool);
@@ -217,6 +233,19 @@ public:
   /// Get if the surface histogram should be calculated using internal/external voxels
   vtkBooleanMacro(UseInsideDoseSurface, bool);
 
+  /// Get number of worker threads used for computing the DVH of the segments
+  vtkGetMacro(NumberOfThreads, int);
+  /// Set number of worker threads used for computing the DVH of the segments.
+  /// 1 computes the segments one after the other, 0 uses as many threads as processor cores
+  vtkSetClampMacro(NumberOfThreads, int, 0, VTK_INT_MAX);
+
+  /// Get memory budget of the DVH computation in megabytes
+  vtkGetMacro(MemoryLimitMB, int);
+  /// Set memory budget of the DVH computation in megabytes.
+  /// If the oversampled dose and the segment labelmaps would not fit, then the dose is processed in slabs.
+  /// 0 means no limit (the whole dose volume is processed at once)
+  vtkSetClampMacro(MemoryLimitMB, int, 0, VTK_INT_MAX);
+
 protected:
   /// Set and observe DVH metrics table node
   /// Metrics table node is unique and mandatory for each DVH node, so it is created within the node.
@@ -278,6 +307,15 @@ protected:
 
   /// Whether to calculate the dose volume histogram from voxels inside/outside the structure
   bool UseInsideDoseSurface;
+
+  /// Number of worker threads computing the DVH of the selected segments concurrently.
+  /// The results are merged into the metrics and DVH tables on the main thread in the order of the segments.
+  /// 1 by default (serial computation), 0 means one thread per processor core
+  int NumberOfThreads;
+
+  /// Memory budget in megabytes for the oversampled dose and segment labelmaps.
+  /// If the budget is exceeded then the DVH is computed slab by slab. 0 by default (no limit)
+  int MemoryLimitMB;
 };
 
 #endif
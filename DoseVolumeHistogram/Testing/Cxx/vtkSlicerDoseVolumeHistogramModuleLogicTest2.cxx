@@ -0,0 +1,583 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// Test the consistency of the alternative DVH computation paths (slab-wise computation within a memory limit,
+// cached labelmaps, batch computation of multiple dose volumes) with the default in-core computation on the same scene,
+// and the parallel fractional accumulation with a serial accumulation
+
+// DoseVolumeHistogram includes
+#include "vtkSlicerDoseVolumeHistogramModuleLogic.h"
+#include "vtkMRMLDoseVolumeHistogramNode.h"
+
+// SlicerRt includes
+#include "vtkSlicerRtCommon.h"
+#include "vtkFractionalImageAccumulate.h"
+#include "vtkPlanarContourToClosedSurfaceConversionRule.h"
+
+// Segmentations includes
+#include "vtkMRMLSegmentationNode.h"
+#include "vtkSlicerSegmentationsModuleLogic.h"
+
+// SegmentationCore includes
+#include "vtkSegmentationConverterFactory.h"
+#include "vtkSegmentation.h"
+#include "vtkSegment.h"
+
+// MRML includes
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSubjectHierarchyNode.h>
+#include <vtkMRMLTableNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkTable.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+
+// ITK includes
+#include "itkFactoryRegistration.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Slicer includes
+#include <vtkSlicerVersionConfigureMinimal.h>
+
+namespace
+{
+  //-----------------------------------------------------------------------------
+  /// Accumulate a fractional labelmap that is split into many slabs, and compare the results with a serial
+  /// accumulation in raster order. The partial sums of the slabs are added in a different order than the serial sums,
+  /// so the results are only required to be equal up to floating point rounding.
+  bool TestFractionalAccumulation()
+  {
+    const int dimensions[3] = { 23, 17, 150 };
+    const double minimumFractionalValue = -108.0;
+    const double maximumFractionalValue = 108.0;
+    const int numberOfBins = 1000;
+    const double binSpacing = 0.01;
+    const double tolerance = 1e-12;
+
+    vtkNew<vtkImageData> dose;
+    dose->SetDimensions(dimensions[0], dimensions[1], dimensions[2]);
+    dose->AllocateScalars(VTK_FLOAT, 1);
+    vtkNew<vtkImageData> fractionalLabelmap;
+    fractionalLabelmap->SetDimensions(dimensions[0], dimensions[1], dimensions[2]);
+    fractionalLabelmap->AllocateScalars(VTK_CHAR, 1);
+    float* dosePtr = static_cast<float*>(dose->GetScalarPointer());
+    char* fractionalPtr = static_cast<char*>(fractionalLabelmap->GetScalarPointer());
+    vtkIdType numberOfVoxels = dose->GetNumberOfPoints();
+    for (vtkIdType voxel = 0; voxel < numberOfVoxels; ++voxel)
+    {
+      // Values that are not exactly representable, so that the order of the summation matters
+      dosePtr[voxel] = static_cast<float>(((voxel * 7919) % 9973) * 0.001 + 0.1 / (1 + voxel % 13));
+      fractionalPtr[voxel] = static_cast<char>((voxel * 31) % 217 - 108);
+    }
+
+    vtkNew<vtkFractionalImageAccumulate> accumulate;
+    accumulate->SetInputData(dose);
+    accumulate->UseFractionalLabelmapOn();
+    accumulate->SetFractionalLabelmap(fractionalLabelmap);
+    accumulate->SetMinimumFractionalValue(minimumFractionalValue);
+    accumulate->SetMaximumFractionalValue(maximumFractionalValue);
+    accumulate->SetComponentExtent(0, numberOfBins - 1, 0, 0, 0, 0);
+    accumulate->SetComponentOrigin(0, 0, 0);
+    accumulate->SetComponentSpacing(binSpacing, 1, 1);
+    accumulate->Update();
+
+    // Serial accumulation in raster order
+    std::vector<double> histogram(numberOfBins, 0.0);
+    double sum = 0.0;
+    double fractionalVoxelCount = 0.0;
+    double minimum = VTK_DOUBLE_MAX;
+    double maximum = VTK_DOUBLE_MIN;
+    for (vtkIdType voxel = 0; voxel < numberOfVoxels; ++voxel)
+    {
+      double v = static_cast<double>(dosePtr[voxel]);
+      double f = (fractionalPtr[voxel] - minimumFractionalValue) / (maximumFractionalValue - minimumFractionalValue);
+      sum += v * f;
+      fractionalVoxelCount += f;
+      minimum = std::min(minimum, v);
+      maximum = std::max(maximum, v);
+      int bin = vtkMath::Floor(v / binSpacing);
+      if (bin >= 0 && bin < numberOfBins)
+      {
+        histogram[bin] += f;
+      }
+    }
+
+    bool result = true;
+    auto isEqual = [tolerance](double a, double b)
+    {
+      return std::fabs(a - b) <= tolerance * std::max(std::fabs(a), std::fabs(b));
+    };
+    if (accumulate->GetVoxelCount() != numberOfVoxels || accumulate->GetMin()[0] != minimum || accumulate->GetMax()[0] != maximum)
+    {
+      std::cerr << "ERROR: Fractional accumulation: voxel count or dose range differs from serial accumulation" << std::endl;
+      result = false;
+    }
+    if (!isEqual(accumulate->GetFractionalVoxelCount(), fractionalVoxelCount) || !isEqual(accumulate->GetMean()[0], sum / fractionalVoxelCount))
+    {
+      std::cerr << "ERROR: Fractional accumulation: fractional voxel count " << accumulate->GetFractionalVoxelCount()
+        << " or mean " << accumulate->GetMean()[0] << " differs from serial accumulation ("
+        << fractionalVoxelCount << ", " << sum / fractionalVoxelCount << ")" << std::endl;
+      result = false;
+    }
+    double* histogramPtr = static_cast<double*>(accumulate->GetOutput()->GetScalarPointer());
+    for (int bin = 0; bin < numberOfBins; ++bin)
+    {
+      if (!isEqual(histogramPtr[bin], histogram[bin]))
+      {
+        std::cerr << "ERROR: Fractional accumulation: bin " << bin << " is " << histogramPtr[bin]
+          << " instead of " << histogram[bin] << std::endl;
+        result = false;
+        break;
+      }
+    }
+    return result;
+  }
+
+  /// DVH and metrics of one segment, copied from the tables so that they are kept when the DVH is recomputed
+  struct DvhResult
+  {
+    std::string SegmentID;
+    std::vector<double> MetricValues;
+    std::vector<std::vector<double> > DvhColumns;
+  };
+
+  //-----------------------------------------------------------------------------
+  /// Copy the DVH tables and metrics of the given dose volume from the tables of the parameter node
+  bool GetDvhResults(vtkMRMLDoseVolumeHistogramNode* paramNode, vtkMRMLScalarVolumeNode* doseVolumeNode, std::vector<DvhResult>& results)
+  {
+    results.clear();
+    vtkTable* metricsTable = paramNode->GetMetricsTableNode()->GetTable();
+    std::vector<vtkMRMLTableNode*> dvhNodes;
+    paramNode->GetDvhTableNodes(dvhNodes);
+    for (vtkMRMLTableNode* dvhNode : dvhNodes)
+    {
+      if (dvhNode->GetNodeReference(vtkMRMLDoseVolumeHistogramNode::DOSE_VOLUME_REFERENCE_ROLE) != doseVolumeNode)
+      {
+        continue;
+      }
+      DvhResult result;
+      result.SegmentID = dvhNode->GetAttribute(vtkSlicerDoseVolumeHistogramModuleLogic::DVH_SEGMENT_ID_ATTRIBUTE_NAME.c_str());
+      int tableRow = vtkVariant(dvhNode->GetAttribute(vtkSlicerDoseVolumeHistogramModuleLogic::DVH_TABLE_ROW_ATTRIBUTE_NAME.c_str())).ToInt();
+      result.MetricValues.push_back(metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnVolumeCc).ToDouble());
+      result.MetricValues.push_back(metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMeanDose).ToDouble());
+      result.MetricValues.push_back(metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMinDose).ToDouble());
+      result.MetricValues.push_back(metricsTable->GetValue(tableRow, vtkMRMLDoseVolumeHistogramNode::MetricColumnMaxDose).ToDouble());
+
+      vtkTable* dvhTable = dvhNode->GetTable();
+      result.DvhColumns.resize(dvhTable->GetNumberOfColumns());
+      for (vtkIdType column = 0; column < dvhTable->GetNumberOfColumns(); ++column)
+      {
+        for (vtkIdType row = 0; row < dvhTable->GetNumberOfRows(); ++row)
+        {
+          result.DvhColumns[column].push_back(dvhTable->GetValue(row, column).ToDouble());
+        }
+      }
+      results.push_back(result);
+    }
+    if (results.empty())
+    {
+      std::cerr << "ERROR: No DVH was computed for dose volume " << doseVolumeNode->GetName() << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  bool ComputeDvhResults(vtkSlicerDoseVolumeHistogramModuleLogic* dvhLogic, vtkMRMLDoseVolumeHistogramNode* paramNode,
+    std::vector<DvhResult>& results)
+  {
+    results.clear();
+    std::string errorMessage = dvhLogic->ComputeDvh(paramNode);
+    if (!errorMessage.empty())
+    {
+      std::cerr << "ERROR: DVH computation failed: " << errorMessage << std::endl;
+      return false;
+    }
+    return GetDvhResults(paramNode, paramNode->GetDoseVolumeNode(), results);
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compare DVH results. Values are accepted if their difference is within the tolerance relative to the larger value
+  bool CompareDvhResults(const std::vector<DvhResult>& results, const std::vector<DvhResult>& baselineResults,
+    double tolerance, const std::string& description)
+  {
+    if (results.size() != baselineResults.size())
+    {
+      std::cerr << "ERROR: " << description << ": Number of DVHs differ (" << results.size() << " != " << baselineResults.size() << ")" << std::endl;
+      return false;
+    }
+    double maximumDifference = 0.0;
+    for (size_t resultIndex = 0; resultIndex < results.size(); ++resultIndex)
+    {
+      const DvhResult& result = results[resultIndex];
+      const DvhResult& baselineResult = baselineResults[resultIndex];
+      if (result.SegmentID != baselineResult.SegmentID || result.DvhColumns.size() != baselineResult.DvhColumns.size())
+      {
+        std::cerr << "ERROR: " << description << ": DVH tables of segment " << result.SegmentID << " differ in structure" << std::endl;
+        return false;
+      }
+
+      std::vector<std::pair<const std::vector<double>*, const std::vector<double>*> > valueLists;
+      valueLists.push_back(std::make_pair(&result.MetricValues, &baselineResult.MetricValues));
+      for (size_t column = 0; column < result.DvhColumns.size(); ++column)
+      {
+        valueLists.push_back(std::make_pair(&result.DvhColumns[column], &baselineResult.DvhColumns[column]));
+      }
+      for (size_t listIndex = 0; listIndex < valueLists.size(); ++listIndex)
+      {
+        const std::vector<double>& values = *valueLists[listIndex].first;
+        const std::vector<double>& baselineValues = *valueLists[listIndex].second;
+        if (values.size() != baselineValues.size())
+        {
+          std::cerr << "ERROR: " << description << ": Number of DVH values of segment " << result.SegmentID << " differ ("
+            << values.size() << " != " << baselineValues.size() << ")" << std::endl;
+          return false;
+        }
+        for (size_t valueIndex = 0; valueIndex < values.size(); ++valueIndex)
+        {
+          double difference = fabs(values[valueIndex] - baselineValues[valueIndex]);
+          double scale = std::max(1.0, std::max(fabs(values[valueIndex]), fabs(baselineValues[valueIndex])));
+          maximumDifference = std::max(maximumDifference, difference / scale);
+          if (difference > tolerance * scale)
+          {
+            std::cerr << "ERROR: " << description << ": Value " << valueIndex << " of list " << listIndex << " of segment " << result.SegmentID
+              << " differs: " << values[valueIndex] << " != " << baselineValues[valueIndex] << std::endl;
+            return false;
+          }
+        }
+      }
+    }
+    std::cout << description << ": DVHs match (maximum relative difference: " << maximumDifference << ")" << std::endl;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compute the DVHs within a memory limit that only allows processing a few slices at once, and compare to the in-core computation
+  bool TestStreamingComputation(vtkSlicerDoseVolumeHistogramModuleLogic* dvhLogic, vtkMRMLDoseVolumeHistogramNode* paramNode)
+  {
+    const int memoryLimitMB = 8;
+
+    // Make sure that the dose is split into multiple slabs: one slice of the dose oversampled with the default factor
+    // needs the resampled dose and two labelmap slices in memory
+    int* doseExtent = paramNode->GetDoseVolumeNode()->GetImageData()->GetExtent();
+    double oversamplingFactor = dvhLogic->GetDefaultDoseVolumeOversamplingFactor();
+    double bytesPerSlice = (doseExtent[1]-doseExtent[0]+1) * oversamplingFactor * (doseExtent[3]-doseExtent[2]+1) * oversamplingFactor
+      * (paramNode->GetDoseVolumeNode()->GetImageData()->GetScalarSize() + 2);
+    double numberOfSlices = (doseExtent[5]-doseExtent[4]+1) * oversamplingFactor;
+    int numberOfSlabs = static_cast<int>(ceil(numberOfSlices / floor(memoryLimitMB * 1024.0 * 1024.0 / bytesPerSlice)));
+    if (numberOfSlabs < 2)
+    {
+      std::cerr << "ERROR: The test dose volume is too small to be split into slabs" << std::endl;
+      return false;
+    }
+    std::cout << "Computing DVH in " << numberOfSlabs << " slabs" << std::endl;
+
+    std::vector<DvhResult> inCoreResults;
+    paramNode->SetMemoryLimitMB(0);
+    if (!ComputeDvhResults(dvhLogic, paramNode, inCoreResults))
+    {
+      return false;
+    }
+
+    std::vector<DvhResult> streamedResults;
+    paramNode->SetMemoryLimitMB(memoryLimitMB);
+    bool success = ComputeDvhResults(dvhLogic, paramNode, streamedResults);
+    paramNode->SetMemoryLimitMB(0);
+    if (!success)
+    {
+      return false;
+    }
+
+    // The slabs are accumulated in the raster order of the in-core sweep
+    return CompareDvhResults(streamedResults, inCoreResults, 1e-9, "Slab-wise computation");
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compute the DVHs from cached labelmaps, then edit a segment and make sure that its cached labelmap is not used
+  bool TestComputationCache(vtkSlicerDoseVolumeHistogramModuleLogic* dvhLogic, vtkMRMLDoseVolumeHistogramNode* paramNode)
+  {
+    dvhLogic->UseComputationCacheOn();
+    dvhLogic->ClearCache();
+
+    std::vector<DvhResult> convertedResults;
+    std::vector<DvhResult> cachedResults;
+    if (!ComputeDvhResults(dvhLogic, paramNode, convertedResults) || !ComputeDvhResults(dvhLogic, paramNode, cachedResults))
+    {
+      return false;
+    }
+    if (!CompareDvhResults(cachedResults, convertedResults, 0.0, "Cached labelmaps"))
+    {
+      return false;
+    }
+
+    // Move the first segment by replacing its source representation
+    vtkSegmentation* segmentation = paramNode->GetSegmentationNode()->GetSegmentation();
+#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
+    std::string sourceRepresentationName = segmentation->GetSourceRepresentationName();
+#else
+    std::string sourceRepresentationName = segmentation->GetMasterRepresentationName();
+#endif
+    vtkSegment* editedSegment = segmentation->GetSegment(convertedResults[0].SegmentID);
+    vtkPolyData* sourceRepresentation = vtkPolyData::SafeDownCast(editedSegment->GetRepresentation(sourceRepresentationName));
+    if (!sourceRepresentation)
+    {
+      std::cerr << "ERROR: Failed to get source representation of segment " << convertedResults[0].SegmentID << std::endl;
+      return false;
+    }
+    vtkNew<vtkTransform> translation;
+    translation->Translate(5.0, 0.0, 0.0);
+    vtkNew<vtkTransformPolyDataFilter> transformFilter;
+    transformFilter->SetInputData(sourceRepresentation);
+    transformFilter->SetTransform(translation);
+    transformFilter->Update();
+    vtkNew<vtkPolyData> movedSourceRepresentation;
+    movedSourceRepresentation->DeepCopy(transformFilter->GetOutput());
+    editedSegment->AddRepresentation(sourceRepresentationName, movedSourceRepresentation);
+#if Slicer_VERSION_MAJOR >= 5 && Slicer_VERSION_MINOR >= 3
+    segmentation->InvalidateNonSourceRepresentations();
+#else
+    segmentation->InvalidateNonMasterRepresentations();
+#endif
+
+    // The DVH of the edited segment computed with the cache must be the same as without it
+    std::vector<DvhResult> editedCachedResults;
+    std::vector<DvhResult> editedConvertedResults;
+    if (!ComputeDvhResults(dvhLogic, paramNode, editedCachedResults))
+    {
+      return false;
+    }
+    dvhLogic->ClearCache();
+    if (!ComputeDvhResults(dvhLogic, paramNode, editedConvertedResults))
+    {
+      return false;
+    }
+    if (!CompareDvhResults(editedCachedResults, editedConvertedResults, 0.0, "Cached labelmaps after segment edit"))
+    {
+      return false;
+    }
+    if (editedCachedResults[0].MetricValues == convertedResults[0].MetricValues)
+    {
+      std::cerr << "ERROR: DVH of segment " << convertedResults[0].SegmentID << " did not change after moving the segment" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Create a dose volume from the voxels of an existing dose volume, scaled by the given factor,
+  /// and shifted along the X axis by the given fraction of the voxel spacing
+  vtkMRMLScalarVolumeNode* CreateDerivedDoseVolume(vtkMRMLScene* scene, vtkMRMLScalarVolumeNode* doseVolumeNode,
+    const std::string& name, double scale, double shiftInVoxels)
+  {
+    vtkNew<vtkImageData> imageData;
+    imageData->DeepCopy(doseVolumeNode->GetImageData());
+    vtkDataArray* scalars = imageData->GetPointData()->GetScalars();
+    for (vtkIdType voxelIndex = 0; voxelIndex < scalars->GetNumberOfTuples(); ++voxelIndex)
+    {
+      scalars->SetTuple1(voxelIndex, scalars->GetTuple1(voxelIndex) * scale);
+    }
+
+    vtkNew<vtkMRMLScalarVolumeNode> derivedDoseVolumeNode;
+    derivedDoseVolumeNode->SetName(name.c_str());
+    derivedDoseVolumeNode->CopyOrientation(doseVolumeNode);
+    double origin[3] = { 0.0, 0.0, 0.0 };
+    derivedDoseVolumeNode->GetOrigin(origin);
+    origin[0] += shiftInVoxels * derivedDoseVolumeNode->GetSpacing()[0];
+    derivedDoseVolumeNode->SetOrigin(origin);
+    derivedDoseVolumeNode->SetAndObserveImageData(imageData);
+    derivedDoseVolumeNode->SetAttribute(vtkSlicerRtCommon::DICOMRTIMPORT_DOSE_VOLUME_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1");
+    scene->AddNode(derivedDoseVolumeNode);
+    return derivedDoseVolumeNode.GetPointer();
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compute the DVHs of several dose volumes in one batch, and compare the results of each dose volume with a separate
+  /// computation on that dose volume. The batch contains the dose volume of the parameter node, a scaled copy with the same
+  /// geometry (sharing the segment labelmaps), and a shifted copy with a different geometry.
+  bool TestBatchComputation(vtkSlicerDoseVolumeHistogramModuleLogic* dvhLogic, vtkMRMLDoseVolumeHistogramNode* paramNode)
+  {
+    vtkMRMLScene* scene = paramNode->GetScene();
+    vtkMRMLScalarVolumeNode* doseVolumeNode = paramNode->GetDoseVolumeNode();
+    std::vector<vtkMRMLScalarVolumeNode*> batchDoseVolumeNodes;
+    batchDoseVolumeNodes.push_back(doseVolumeNode);
+    batchDoseVolumeNodes.push_back(CreateDerivedDoseVolume(scene, doseVolumeNode, "BatchDoseSameGeometry", 0.5, 0.0));
+    batchDoseVolumeNodes.push_back(CreateDerivedDoseVolume(scene, doseVolumeNode, "BatchDoseShiftedGeometry", 1.0, 0.5));
+
+    // Separate computation on each dose volume
+    std::vector<std::vector<DvhResult> > separateResults(batchDoseVolumeNodes.size());
+    for (size_t doseIndex = 0; doseIndex < batchDoseVolumeNodes.size(); ++doseIndex)
+    {
+      paramNode->SetAndObserveDoseVolumeNode(batchDoseVolumeNodes[doseIndex]);
+      bool success = ComputeDvhResults(dvhLogic, paramNode, separateResults[doseIndex]);
+      paramNode->SetAndObserveDoseVolumeNode(doseVolumeNode);
+      if (!success)
+      {
+        return false;
+      }
+    }
+
+    // Batch computation, with the dose volumes distributed among the threads
+    paramNode->RemoveAllBatchDoseVolumeNodes();
+    for (vtkMRMLScalarVolumeNode* batchDoseVolumeNode : batchDoseVolumeNodes)
+    {
+      paramNode->AddBatchDoseVolumeNode(batchDoseVolumeNode);
+    }
+    int numberOfThreads = paramNode->GetNumberOfThreads();
+    paramNode->SetNumberOfThreads(2);
+    std::string errorMessage = dvhLogic->ComputeDvhBatch(paramNode);
+    paramNode->SetNumberOfThreads(numberOfThreads);
+    paramNode->RemoveAllBatchDoseVolumeNodes();
+    if (!errorMessage.empty())
+    {
+      std::cerr << "ERROR: Batch DVH computation failed: " << errorMessage << std::endl;
+      return false;
+    }
+    if (paramNode->GetDoseVolumeNode() != doseVolumeNode)
+    {
+      std::cerr << "ERROR: Batch DVH computation changed the dose volume of the parameter node" << std::endl;
+      return false;
+    }
+
+    for (size_t doseIndex = 0; doseIndex < batchDoseVolumeNodes.size(); ++doseIndex)
+    {
+      std::vector<DvhResult> batchResults;
+      if (!GetDvhResults(paramNode, batchDoseVolumeNodes[doseIndex], batchResults)
+        || !CompareDvhResults(batchResults, separateResults[doseIndex], 1e-9,
+          std::string("Batch computation of ") + batchDoseVolumeNodes[doseIndex]->GetName()))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkSlicerDoseVolumeHistogramModuleLogicTest2( int argc, char * argv[] )
+{
+  int argIndex = 1;
+
+  // TestSceneFile
+  const char *testSceneFileName  = nullptr;
+  if (argc > argIndex+1)
+  {
+    if (STRCASECMP(argv[argIndex], "-TestSceneFile") == 0)
+    {
+      testSceneFileName = argv[argIndex+1];
+      std::cout << "Test MRML scene file name: " << testSceneFileName << std::endl;
+      argIndex += 2;
+    }
+    else
+    {
+      testSceneFileName = "";
+    }
+  }
+  else
+  {
+    std::cerr << "Invalid arguments" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Make sure NRRD reading works
+  itk::itkFactoryRegistration();
+
+  // Register planar contour to closed surface conversion rule
+  vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
+    vtkSmartPointer<vtkPlanarContourToClosedSurfaceConversionRule>::New() );
+
+  // Create scene
+  vtkSmartPointer<vtkMRMLScene> mrmlScene = vtkSmartPointer<vtkMRMLScene>::New();
+
+  // Create Segmentations logic
+  vtkSmartPointer<vtkSlicerSegmentationsModuleLogic> segmentationsLogic = vtkSmartPointer<vtkSlicerSegmentationsModuleLogic>::New();
+  segmentationsLogic->SetMRMLScene(mrmlScene);
+
+  // Load test scene
+  mrmlScene->SetURL(testSceneFileName);
+  mrmlScene->Import();
+  vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(mrmlScene);
+
+  // Get dose volume
+  vtkMRMLScalarVolumeNode* doseScalarVolumeNode = nullptr;
+  std::vector<vtkMRMLNode*> volumeNodes;
+  mrmlScene->GetNodesByClass("vtkMRMLScalarVolumeNode", volumeNodes);
+  for (std::vector<vtkMRMLNode*>::iterator volumeNodeIt=volumeNodes.begin(); volumeNodeIt!=volumeNodes.end(); ++volumeNodeIt)
+  {
+    if (vtkSlicerRtCommon::IsDoseVolumeNode(*volumeNodeIt))
+    {
+      doseScalarVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(*volumeNodeIt);
+    }
+  }
+  if (!doseScalarVolumeNode)
+  {
+    std::cerr << "ERROR: Failed to get dose volume" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Get segmentation node
+  vtkSmartPointer<vtkCollection> segmentationNodes = vtkSmartPointer<vtkCollection>::Take(
+    mrmlScene->GetNodesByClass("vtkMRMLSegmentationNode") );
+  if (segmentationNodes->GetNumberOfItems() != 1)
+  {
+    std::cerr << "ERROR: Failed to get segmentation" << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(segmentationNodes->GetItemAsObject(0));
+
+  // Create and set up logic
+  vtkSmartPointer<vtkSlicerDoseVolumeHistogramModuleLogic> dvhLogic = vtkSmartPointer<vtkSlicerDoseVolumeHistogramModuleLogic>::New();
+  dvhLogic->SetMRMLScene(mrmlScene);
+
+  // Create and set up parameter set MRML node
+  vtkSmartPointer<vtkMRMLDoseVolumeHistogramNode> paramNode = vtkSmartPointer<vtkMRMLDoseVolumeHistogramNode>::New();
+  mrmlScene->AddNode(paramNode);
+  paramNode->SetAndObserveDoseVolumeNode(doseScalarVolumeNode);
+  paramNode->SetAndObserveSegmentationNode(segmentationNode);
+
+  if (!TestFractionalAccumulation())
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestStreamingComputation(dvhLogic, paramNode))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestComputationCache(dvhLogic, paramNode))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestBatchComputation(dvhLogic, paramNode))
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkIsodoseSliceLineExtractor.h"
+
+// VTK includes
+#include <vtkFlyingEdges2D.h>
+#include <vtkImageData.h>
+#include <vtkImageReslice.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+
+// STD includes
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkIsodoseSliceLineExtractor);
+
+//----------------------------------------------------------------------------
+vtkIsodoseSliceLineExtractor::vtkIsodoseSliceLineExtractor()
+{
+  this->InputImageData = nullptr;
+  this->IJKToRASMatrix = nullptr;
+  this->SliceXYToRASMatrix = nullptr;
+  this->SliceDimensions[0] = 0;
+  this->SliceDimensions[1] = 0;
+  this->Output = vtkSmartPointer<vtkPolyData>::New();
+}
+
+//----------------------------------------------------------------------------
+vtkIsodoseSliceLineExtractor::~vtkIsodoseSliceLineExtractor()
+{
+  this->SetInputImageData(nullptr);
+  this->SetIJKToRASMatrix(nullptr);
+  this->SetSliceXYToRASMatrix(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkIsodoseSliceLineExtractor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "IsoLevels:";
+  for (std::vector<double>::iterator levelIt = this->IsoLevels.begin(); levelIt != this->IsoLevels.end(); ++levelIt)
+  {
+    os << " " << (*levelIt);
+  }
+  os << "\n";
+  os << indent << "SliceDimensions: " << this->SliceDimensions[0] << " " << this->SliceDimensions[1] << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkIsodoseSliceLineExtractor::SetIsoLevels(const std::vector<double>& isoLevels)
+{
+  this->IsoLevels = isoLevels;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkIsodoseSliceLineExtractor::GetOutput()
+{
+  return this->Output;
+}
+
+//----------------------------------------------------------------------------
+bool vtkIsodoseSliceLineExtractor::Update()
+{
+  this->Output = vtkSmartPointer<vtkPolyData>::New();
+  if (!this->InputImageData || !this->InputImageData->GetPointData()->GetScalars())
+  {
+    vtkErrorMacro("Update: Invalid input image data");
+    return false;
+  }
+  if (!this->SliceXYToRASMatrix)
+  {
+    vtkErrorMacro("Update: Invalid slice XY to RAS matrix");
+    return false;
+  }
+  if (this->SliceDimensions[0] < 2 || this->SliceDimensions[1] < 2 || this->IsoLevels.empty())
+  {
+    // Nothing to contour
+    return true;
+  }
+
+  // Slice XY to dose IJK transform
+  vtkNew<vtkMatrix4x4> rasToIJKMatrix;
+  if (this->IJKToRASMatrix)
+  {
+    vtkMatrix4x4::Invert(this->IJKToRASMatrix, rasToIJKMatrix);
+  }
+  vtkNew<vtkMatrix4x4> xyToIJKMatrix;
+  vtkMatrix4x4::Multiply4x4(rasToIJKMatrix, this->SliceXYToRASMatrix, xyToIJKMatrix);
+
+  // Resample dose on the slice pixels. Floating point output makes the contour scalars equal to the isolevels
+  vtkNew<vtkImageReslice> reslice;
+  reslice->SetInputData(this->InputImageData);
+  reslice->SetResliceAxes(xyToIJKMatrix);
+  reslice->SetOutputOrigin(0, 0, 0);
+  reslice->SetOutputSpacing(1, 1, 1);
+  reslice->SetOutputExtent(0, this->SliceDimensions[0]-1, 0, this->SliceDimensions[1]-1, 0, 0);
+  reslice->SetInterpolationModeToLinear();
+  reslice->SetOutputScalarType(VTK_FLOAT);
+  reslice->SetBackgroundLevel(0.0);
+  reslice->Update();
+
+  // Contour all levels in one pass
+  std::vector<double> contourValues(this->IsoLevels);
+  std::sort(contourValues.begin(), contourValues.end());
+  contourValues.erase(std::unique(contourValues.begin(), contourValues.end()), contourValues.end());
+
+  vtkNew<vtkFlyingEdges2D> flyingEdges;
+  flyingEdges->SetInputConnection(reslice->GetOutputPort());
+  flyingEdges->SetNumberOfContours(static_cast<int>(contourValues.size()));
+  for (size_t valueIndex = 0; valueIndex < contourValues.size(); ++valueIndex)
+  {
+    flyingEdges->SetValue(static_cast<int>(valueIndex), contourValues[valueIndex]);
+  }
+  flyingEdges->ComputeScalarsOn();
+
+  // Transform lines from slice XY to RAS
+  vtkNew<vtkTransform> xyToRASTransform;
+  xyToRASTransform->SetMatrix(this->SliceXYToRASMatrix);
+  vtkNew<vtkTransformPolyDataFilter> transformPolyData;
+  transformPolyData->SetInputConnection(flyingEdges->GetOutputPort());
+  transformPolyData->SetTransform(xyToRASTransform);
+  transformPolyData->Update();
+
+  this->Output->ShallowCopy(transformPolyData->GetOutput());
+  return true;
+}
@@ -0,0 +1,94 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#ifndef __vtkIsodoseSliceLineExtractor_h
+#define __vtkIsodoseSliceLineExtractor_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerIsodoseModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+/// \ingroup SlicerRt_QtModules_Isodose
+/// \brief Extract isodose lines of multiple dose levels on a slice plane.
+///
+/// The dose is resliced on the pixel grid of the slice view, and the lines of all isolevels are
+/// contoured on the resliced image in one pass using flying edges (marching squares), so the cost
+/// depends on the slice size and not on the size of the dose volume.
+class VTK_SLICER_ISODOSE_LOGIC_EXPORT vtkIsodoseSliceLineExtractor : public vtkObject
+{
+public:
+  static vtkIsodoseSliceLineExtractor *New();
+  vtkTypeMacro(vtkIsodoseSliceLineExtractor, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Extract the lines of all isolevels
+  /// \return Success flag
+  bool Update();
+
+  /// Dose image in IJK space (origin 0, spacing 1)
+  vtkGetObjectMacro(InputImageData, vtkImageData);
+  vtkSetObjectMacro(InputImageData, vtkImageData);
+
+  /// Transform from the IJK space of the input image to RAS. Identity if not set
+  vtkGetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+  vtkSetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+
+  /// Transform from the XY (pixel) space of the slice to RAS (see vtkMRMLSliceNode::GetXYToRAS)
+  vtkGetObjectMacro(SliceXYToRASMatrix, vtkMatrix4x4);
+  vtkSetObjectMacro(SliceXYToRASMatrix, vtkMatrix4x4);
+
+  /// Number of pixels of the slice along X and Y
+  vtkGetVector2Macro(SliceDimensions, int);
+  vtkSetVector2Macro(SliceDimensions, int);
+
+  /// Set isolevels to extract
+  void SetIsoLevels(const std::vector<double>& isoLevels);
+
+  /// Get extracted lines of all isolevels in RAS. The point scalars contain the isolevel of the lines
+  vtkPolyData* GetOutput();
+
+protected:
+  vtkIsodoseSliceLineExtractor();
+  ~vtkIsodoseSliceLineExtractor() override;
+
+protected:
+  vtkImageData* InputImageData;
+  vtkMatrix4x4* IJKToRASMatrix;
+  vtkMatrix4x4* SliceXYToRASMatrix;
+  int SliceDimensions[2];
+
+  std::vector<double> IsoLevels;
+  vtkSmartPointer<vtkPolyData> Output;
+
+private:
+  vtkIsodoseSliceLineExtractor(const vtkIsodoseSliceLineExtractor&) = delete;
+  void operator=(const vtkIsodoseSliceLineExtractor&) = delete;
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkIsodoseSurfaceExtractor.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkIdList.h>
+#include <vtkImageCast.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkSMPTools.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+#include <vtkWindowedSincPolyDataFilter.h>
+
+// STD includes
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+namespace
+{
+
+/// Builds the surface of each contour value from the combined contour output, then smooths it,
+/// computes its normals, and transforms it to RAS
+class IsoLevelSurfaceFunctor
+{
+public:
+  vtkPolyData* Contours{nullptr};
+  /// Triangle IDs of each contour value
+  const std::vector<std::vector<vtkIdType> >* LevelTriangles{nullptr};
+  /// Point ID in the level surface for each contour point. Points belong to one level only
+  std::vector<vtkIdType>* PointIdMap{nullptr};
+  std::vector<vtkSmartPointer<vtkPolyData> >* LevelSurfaces{nullptr};
+  vtkMatrix4x4* IJKToRASMatrix{nullptr};
+  int NumberOfSmoothingIterations{0};
+  double SmoothingPassBand{0.1};
+  double FeatureAngle{60.0};
+
+  void operator()(vtkIdType levelBegin, vtkIdType levelEnd) const
+  {
+    vtkNew<vtkIdList> trianglePointIds;
+    double point[3] = {0.0, 0.0, 0.0};
+    for (vtkIdType level = levelBegin; level < levelEnd; ++level)
+    {
+      const std::vector<vtkIdType>& triangles = (*this->LevelTriangles)[level];
+      vtkSmartPointer<vtkPolyData> levelSurface = vtkSmartPointer<vtkPolyData>::New();
+      (*this->LevelSurfaces)[level] = levelSurface;
+      if (triangles.empty())
+      {
+        continue;
+      }
+
+      vtkNew<vtkPoints> levelPoints;
+      levelPoints->SetDataType(this->Contours->GetPoints()->GetDataType());
+      vtkNew<vtkCellArray> levelPolys;
+      for (std::vector<vtkIdType>::const_iterator triangleIt = triangles.begin(); triangleIt != triangles.end(); ++triangleIt)
+      {
+        this->Contours->GetCellPoints(*triangleIt, trianglePointIds);
+        levelPolys->InsertNextCell(trianglePointIds->GetNumberOfIds());
+        for (vtkIdType index = 0; index < trianglePointIds->GetNumberOfIds(); ++index)
+        {
+          vtkIdType pointId = trianglePointIds->GetId(index);
+          vtkIdType& levelPointId = (*this->PointIdMap)[pointId];
+          if (levelPointId < 0)
+          {
+            this->Contours->GetPoint(pointId, point);
+            levelPointId = levelPoints->InsertNextPoint(point);
+          }
+          levelPolys->InsertCellPoint(levelPointId);
+        }
+      }
+      vtkNew<vtkPolyData> levelContour;
+      levelContour->SetPoints(levelPoints);
+      levelContour->SetPolys(levelPolys);
+
+      vtkSmartPointer<vtkPolyData> smoothedContour = levelContour.GetPointer();
+      if (this->NumberOfSmoothingIterations > 0)
+      {
+        vtkNew<vtkWindowedSincPolyDataFilter> smootherSinc;
+        smootherSinc->SetInputData(levelContour);
+        smootherSinc->SetPassBand(this->SmoothingPassBand);
+        smootherSinc->SetNumberOfIterations(this->NumberOfSmoothingIterations);
+        smootherSinc->FeatureEdgeSmoothingOff();
+        smootherSinc->BoundarySmoothingOff();
+        smootherSinc->Update();
+        smoothedContour = smootherSinc->GetOutput();
+      }
+
+      vtkNew<vtkPolyDataNormals> normals;
+      normals->SetInputData(smoothedContour);
+      normals->ComputePointNormalsOn();
+      normals->SetFeatureAngle(this->FeatureAngle);
+
+      vtkNew<vtkTransform> ijkToRasTransform;
+      if (this->IJKToRASMatrix)
+      {
+        ijkToRasTransform->SetMatrix(this->IJKToRASMatrix);
+      }
+      vtkNew<vtkTransformPolyDataFilter> transformPolyData;
+      transformPolyData->SetInputConnection(normals->GetOutputPort());
+      transformPolyData->SetTransform(ijkToRasTransform);
+      transformPolyData->Update();
+      levelSurface->ShallowCopy(transformPolyData->GetOutput());
+    }
+  }
+};
+
+} // namespace
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkIsodoseSurfaceExtractor);
+
+//----------------------------------------------------------------------------
+vtkIsodoseSurfaceExtractor::vtkIsodoseSurfaceExtractor()
+{
+  this->InputImageData = nullptr;
+  this->IJKToRASMatrix = nullptr;
+  this->NumberOfSmoothingIterations = 2;
+  this->SmoothingPassBand = 0.1;
+  this->FeatureAngle = 60.0;
+}
+
+//----------------------------------------------------------------------------
+vtkIsodoseSurfaceExtractor::~vtkIsodoseSurfaceExtractor()
+{
+  this->SetInputImageData(nullptr);
+  this->SetIJKToRASMatrix(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkIsodoseSurfaceExtractor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "IsoLevels:";
+  for (std::vector<double>::iterator levelIt = this->IsoLevels.begin(); levelIt != this->IsoLevels.end(); ++levelIt)
+  {
+    os << " " << (*levelIt);
+  }
+  os << "\n";
+  os << indent << "NumberOfSmoothingIterations: " << this->NumberOfSmoothingIterations << "\n";
+  os << indent << "SmoothingPassBand: " << this->SmoothingPassBand << "\n";
+  os << indent << "FeatureAngle: " << this->FeatureAngle << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkIsodoseSurfaceExtractor::SetIsoLevels(const std::vector<double>& isoLevels)
+{
+  this->IsoLevels = isoLevels;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double vtkIsodoseSurfaceExtractor::GetIsoLevel(int levelIndex)
+{
+  if (levelIndex < 0 || levelIndex >= static_cast<int>(this->IsoLevels.size()))
+  {
+    vtkErrorMacro("GetIsoLevel: Invalid level index " << levelIndex);
+    return 0.0;
+  }
+  return this->IsoLevels[levelIndex];
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkIsodoseSurfaceExtractor::GetIsoLevelSurface(int levelIndex)
+{
+  if (levelIndex < 0 || levelIndex >= static_cast<int>(this->IsoLevelSurfaces.size()))
+  {
+    vtkErrorMacro("GetIsoLevelSurface: Invalid level index " << levelIndex);
+    return nullptr;
+  }
+  return this->IsoLevelSurfaces[levelIndex];
+}
+
+//----------------------------------------------------------------------------
+bool vtkIsodoseSurfaceExtractor::Update()
+{
+  this->IsoLevelSurfaces.clear();
+  if (!this->InputImageData || !this->InputImageData->GetPointData()->GetScalars())
+  {
+    vtkErrorMacro("Update: Invalid input image data");
+    return false;
+  }
+
+  // The contour value of each output point identifies its level. Use floating point input so that
+  // the contour values are stored exactly in the output scalars
+  vtkSmartPointer<vtkImageData> doseImage = this->InputImageData;
+  if (doseImage->GetScalarType() != VTK_FLOAT && doseImage->GetScalarType() != VTK_DOUBLE)
+  {
+    vtkNew<vtkImageCast> imageCast;
+    imageCast->SetInputData(this->InputImageData);
+    imageCast->SetOutputScalarTypeToFloat();
+    imageCast->Update();
+    doseImage = imageCast->GetOutput();
+  }
+
+  // Contour values are the distinct isolevels, as represented in the dose image scalar type
+  bool floatScalars = (doseImage->GetScalarType() == VTK_FLOAT);
+  std::vector<double> contourValues;
+  for (std::vector<double>::iterator levelIt = this->IsoLevels.begin(); levelIt != this->IsoLevels.end(); ++levelIt)
+  {
+    contourValues.push_back(floatScalars ? static_cast<double>(static_cast<float>(*levelIt)) : (*levelIt));
+  }
+  std::sort(contourValues.begin(), contourValues.end());
+  contourValues.erase(std::unique(contourValues.begin(), contourValues.end()), contourValues.end());
+
+  // Extract all levels in one pass
+  std::vector<vtkSmartPointer<vtkPolyData> > contourSurfaces(contourValues.size());
+  if (!contourValues.empty())
+  {
+    vtkNew<vtkFlyingEdges3D> flyingEdges;
+    flyingEdges->SetInputData(doseImage);
+    flyingEdges->SetNumberOfContours(static_cast<int>(contourValues.size()));
+    for (size_t valueIndex = 0; valueIndex < contourValues.size(); ++valueIndex)
+    {
+      flyingEdges->SetValue(static_cast<int>(valueIndex), contourValues[valueIndex]);
+    }
+    flyingEdges->ComputeScalarsOn();
+    flyingEdges->ComputeNormalsOff();
+    flyingEdges->ComputeGradientsOff();
+    flyingEdges->InterpolateAttributesOff();
+    flyingEdges->Update();
+    vtkPolyData* contours = flyingEdges->GetOutput();
+
+    // Sort triangles by contour value
+    std::vector<std::vector<vtkIdType> > levelTriangles(contourValues.size());
+    vtkDataArray* contourScalars = contours->GetPointData()->GetScalars();
+    vtkIdType numberOfCells = contours->GetNumberOfCells();
+    if (contourScalars && numberOfCells > 0)
+    {
+      contours->BuildCells();
+      vtkNew<vtkIdList> trianglePointIds;
+      for (vtkIdType cellId = 0; cellId < numberOfCells; ++cellId)
+      {
+        contours->GetCellPoints(cellId, trianglePointIds);
+        if (trianglePointIds->GetNumberOfIds() == 0)
+        {
+          continue;
+        }
+        double value = contourScalars->GetTuple1(trianglePointIds->GetId(0));
+        std::vector<double>::iterator valueIt = std::lower_bound(contourValues.begin(), contourValues.end(), value);
+        if (valueIt == contourValues.end() || (*valueIt) != value)
+        {
+          vtkErrorMacro("Update: Failed to find isolevel of contour value " << value);
+          return false;
+        }
+        levelTriangles[valueIt - contourValues.begin()].push_back(cellId);
+      }
+    }
+
+    // Post-process levels in parallel
+    std::vector<vtkIdType> pointIdMap(contours->GetNumberOfPoints(), -1);
+    IsoLevelSurfaceFunctor functor;
+    functor.Contours = contours;
+    functor.LevelTriangles = &levelTriangles;
+    functor.PointIdMap = &pointIdMap;
+    functor.LevelSurfaces = &contourSurfaces;
+    functor.IJKToRASMatrix = this->IJKToRASMatrix;
+    functor.NumberOfSmoothingIterations = this->NumberOfSmoothingIterations;
+    functor.SmoothingPassBand = this->SmoothingPassBand;
+    functor.FeatureAngle = this->FeatureAngle;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(contourValues.size()), 1, functor);
+  }
+
+  // Assign surfaces to the requested levels
+  for (std::vector<double>::iterator levelIt = this->IsoLevels.begin(); levelIt != this->IsoLevels.end(); ++levelIt)
+  {
+    double contourValue = (floatScalars ? static_cast<double>(static_cast<float>(*levelIt)) : (*levelIt));
+    size_t valueIndex = std::lower_bound(contourValues.begin(), contourValues.end(), contourValue) - contourValues.begin();
+    this->IsoLevelSurfaces.push_back(contourSurfaces[valueIndex]);
+  }
+
+  return true;
+}
@@ -0,0 +1,104 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#ifndef __vtkIsodoseSurfaceExtractor_h
+#define __vtkIsodoseSurfaceExtractor_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerIsodoseModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+/// \ingroup SlicerRt_QtModules_Isodose
+/// \brief Extract isodose surfaces of multiple dose levels from a dose image.
+///
+/// All isolevels are contoured in a single multithreaded pass using flying edges, then the
+/// surface of each level is smoothed, its normals are computed, and it is transformed to RAS,
+/// with the levels processed in parallel.
+class VTK_SLICER_ISODOSE_LOGIC_EXPORT vtkIsodoseSurfaceExtractor : public vtkObject
+{
+public:
+  static vtkIsodoseSurfaceExtractor *New();
+  vtkTypeMacro(vtkIsodoseSurfaceExtractor, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Extract the surfaces of all isolevels
+  /// \return Success flag
+  bool Update();
+
+  /// Dose image in IJK space (origin 0, spacing 1, or the downsampling factor for a subsampled dose)
+  vtkGetObjectMacro(InputImageData, vtkImageData);
+  vtkSetObjectMacro(InputImageData, vtkImageData);
+
+  /// Transform from the IJK space of the input image to RAS. Identity if not set
+  vtkGetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+  vtkSetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+
+  /// Set isolevels to extract
+  void SetIsoLevels(const std::vector<double>& isoLevels);
+  /// Get number of isolevels
+  int GetNumberOfIsoLevels() { return static_cast<int>(this->IsoLevels.size()); };
+  /// Get isolevel value
+  double GetIsoLevel(int levelIndex);
+
+  /// Get extracted surface of an isolevel in RAS. Empty polydata if the dose does not reach the level
+  vtkPolyData* GetIsoLevelSurface(int levelIndex);
+
+  /// Number of iterations of the windowed sinc smoothing. No smoothing if zero
+  vtkGetMacro(NumberOfSmoothingIterations, int);
+  vtkSetMacro(NumberOfSmoothingIterations, int);
+
+  /// Pass band of the windowed sinc smoothing
+  vtkGetMacro(SmoothingPassBand, double);
+  vtkSetMacro(SmoothingPassBand, double);
+
+  /// Feature angle used in the normals computation
+  vtkGetMacro(FeatureAngle, double);
+  vtkSetMacro(FeatureAngle, double);
+
+protected:
+  vtkIsodoseSurfaceExtractor();
+  ~vtkIsodoseSurfaceExtractor() override;
+
+protected:
+  vtkImageData* InputImageData;
+  vtkMatrix4x4* IJKToRASMatrix;
+
+  std::vector<double> IsoLevels;
+  std::vector<vtkSmartPointer<vtkPolyData> > IsoLevelSurfaces;
+
+  int NumberOfSmoothingIterations;
+  double SmoothingPassBand;
+  double FeatureAngle;
+
+private:
+  vtkIsodoseSurfaceExtractor(const vtkIsodoseSurfaceExtractor&) = delete;
+  void operator=(const vtkIsodoseSurfaceExtractor&) = delete;
+};
+
+#endif
@@ -25,6 +25,8 @@
 // Isodose includes
 #include "vtkSlicerIsodoseModuleLogic.h"
 #include "vtkMRMLIsodoseNode.h"
+#include "vtkIsodoseSurfaceExtractor.h"
+#include "vtkIsodoseSliceLineExtractor.h"
 
 // Subject Hierarchy includes
 #include "vtkMRMLSubjectHierarchyConstants.h"
@@ -41,6 +43,7 @@
 #include <vtkMRMLModelNode.h>
 #include <vtkMRMLScalarVolumeNode.h>
 #include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
 #include <vtkMRMLTransformNode.h>
 #include <vtkMRMLScalarVolumeDisplayNode.h>
 
@@ -52,23 +55,29 @@
 #include <vtkGeneralTransform.h>
 #include <vtkImageChangeInformation.h>
 #include <vtkImageData.h>
-#include <vtkImageMarchingCubes.h>
 #include <vtkImageReslice.h>
+#include <vtkImageShrink3D.h>
 #include <vtkLookupTable.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
-#include <vtkPolyDataNormals.h>
 #include <vtkSmartPointer.h>
-#include <vtkTransformPolyDataFilter.h>
-#include <vtkTriangleFilter.h>
-#include <vtkWindowedSincPolyDataFilter.h>
+#include <vtkTransform.h>
 #include <vtkAppendPolyData.h>
 #include <vtkPointData.h>
+#include <vtkPolyData.h>
 #include <vtkUnsignedCharArray.h>
 #include <vtkFloatArray.h>
 
 #include "vtksys/SystemTools.hxx"
 
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+
 //----------------------------------------------------------------------------
 const char* DEFAULT_ISODOSE_COLOR_TABLE_FILE_NAME = "Isodose_ColorTable.ctbl";
 const char* DEFAULT_ISODOSE_COLOR_TABLE_NODE_NAME = "Isodose_ColorTable_Default";
@@ -79,14 +88,193 @@ const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_COLOR_TABLE_NODE_NAME_POS
 
 std::string vtkSlicerIsodoseModuleLogic::IsodoseColorNodeCopyUniqueName = DEFAULT_ISODOSE_COLOR_TABLECOPY_NODE_NAME;
 
+//----------------------------------------------------------------------------
+class vtkSlicerIsodoseModuleLogic::vtkInternal
+{
+public:
+  /// Dose volume prepared for contouring and the isodose surfaces already extracted from it
+  struct DoseCacheEntry
+  {
+    /// Identifies the dose image, its modification time, and the geometry it was resliced with
+    std::string Key;
+    /// Dose in the IJK space of the dose volume. The dose image itself if no reslicing was needed
+    vtkSmartPointer<vtkImageData> ReslicedDoseImage;
+    /// Downsampled dose used for the preview surfaces
+    vtkSmartPointer<vtkImageData> PreviewDoseImage;
+    int PreviewDownsamplingFactor{0};
+    /// Isodose surfaces in RAS by isolevel, for full quality and for preview
+    std::map<double, vtkSmartPointer<vtkPolyData> > IsoLevelSurfaces;
+    std::map<double, vtkSmartPointer<vtkPolyData> > PreviewIsoLevelSurfaces;
+  };
+
+  /// Get cache key of a dose image and the geometry used to reslice it
+  /// \param parentTransformMatrix Matrix of the parent transform of the dose volume, nullptr if not transformed
+  static std::string GetDoseCacheKey(vtkImageData* doseImage, vtkMatrix4x4* ijkToRasMatrix, vtkMatrix4x4* parentTransformMatrix);
+
+  /// Get cache entry of a dose volume with the dose resliced to its IJK space. The cached surfaces are
+  /// discarded if the dose or its geometry changed since the last call
+  DoseCacheEntry& GetDoseCacheEntry(vtkMRMLScalarVolumeNode* doseVolumeNode);
+
+  /// Get isolevels in dose units from the isodose color table
+  static std::vector<double> GetIsoLevels(vtkMRMLIsodoseNode* parameterNode, vtkMRMLColorTableNode* colorTableNode, bool relativeFlag);
+
+  /// Get the slice geometry the isodose lines are contoured on: XYToRAS matrix elements followed by the slice dimensions
+  static std::vector<double> GetSliceGeometry(vtkMRMLSliceNode* sliceNode);
+
+  /// Cache entries by dose volume node ID
+  std::map<std::string, DoseCacheEntry> DoseCache;
+
+  /// Slice geometry of the current isodose lines. Map key is the isodose parameter node ID and the slice node ID
+  std::map<std::string, std::vector<double> > SliceIsolinesGeometries;
+};
+
+//----------------------------------------------------------------------------
+static const char* ISODOSE_SLICE_NODE_ID_ATTRIBUTE_NAME = "IsodoseSliceNodeID";
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerIsodoseModuleLogic::vtkInternal::GetDoseCacheKey(vtkImageData* doseImage,
+  vtkMatrix4x4* ijkToRasMatrix, vtkMatrix4x4* parentTransformMatrix)
+{
+  std::ostringstream keyStream;
+  keyStream.precision(17);
+  keyStream << doseImage << ":" << doseImage->GetMTime() << "|";
+  for (int i = 0; i < 16; ++i)
+  {
+    keyStream << ijkToRasMatrix->GetElement(i / 4, i % 4) << " ";
+  }
+  keyStream << "|";
+  if (parentTransformMatrix)
+  {
+    for (int i = 0; i < 16; ++i)
+    {
+      keyStream << parentTransformMatrix->GetElement(i / 4, i % 4) << " ";
+    }
+  }
+  return keyStream.str();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerIsodoseModuleLogic::vtkInternal::DoseCacheEntry& vtkSlicerIsodoseModuleLogic::vtkInternal::GetDoseCacheEntry(
+  vtkMRMLScalarVolumeNode* doseVolumeNode)
+{
+  vtkNew<vtkMatrix4x4> inputIJK2RASMatrix;
+  doseVolumeNode->GetIJKToRASMatrix(inputIJK2RASMatrix);
+  vtkNew<vtkMatrix4x4> inputRAS2IJKMatrix;
+  doseVolumeNode->GetRASToIJKMatrix(inputRAS2IJKMatrix);
+
+  vtkSmartPointer<vtkMRMLTransformNode> inputVolumeNodeTransformNode = doseVolumeNode->GetParentTransformNode();
+  vtkNew<vtkMatrix4x4> inputRAS2RASMatrix;
+  if (inputVolumeNodeTransformNode!=nullptr)
+  {
+    inputVolumeNodeTransformNode->GetMatrixTransformToWorld(inputRAS2RASMatrix);
+  }
+
+  vtkImageData* doseImage = doseVolumeNode->GetImageData();
+  std::string doseCacheKey = GetDoseCacheKey(doseImage, inputIJK2RASMatrix,
+    (inputVolumeNodeTransformNode != nullptr ? inputRAS2RASMatrix.GetPointer() : nullptr) );
+  DoseCacheEntry& doseCacheEntry = this->DoseCache[doseVolumeNode->GetID()];
+  if (doseCacheEntry.Key != doseCacheKey)
+  {
+    doseCacheEntry = DoseCacheEntry();
+    doseCacheEntry.Key = doseCacheKey;
+
+    int extent[6] = {0, -1, 0, -1, 0, -1};
+    doseImage->GetExtent(extent);
+    double origin[3] = {0.0, 0.0, 0.0};
+    doseImage->GetOrigin(origin);
+    double spacing[3] = {1.0, 1.0, 1.0};
+    doseImage->GetSpacing(spacing);
+    if ( inputVolumeNodeTransformNode == nullptr
+      && extent[0] == 0 && extent[2] == 0 && extent[4] == 0
+      && origin[0] == 0.0 && origin[1] == 0.0 && origin[2] == 0.0
+      && spacing[0] == 1.0 && spacing[1] == 1.0 && spacing[2] == 1.0 )
+    {
+      // Reslicing would be an identity, so the dose image is contoured directly
+      doseCacheEntry.ReslicedDoseImage = doseImage;
+    }
+    else
+    {
+      vtkNew<vtkTransform> outputIJK2IJKResliceTransform;
+      outputIJK2IJKResliceTransform->Identity();
+      outputIJK2IJKResliceTransform->PostMultiply();
+      outputIJK2IJKResliceTransform->SetMatrix(inputIJK2RASMatrix);
+      if (inputVolumeNodeTransformNode!=nullptr)
+      {
+        outputIJK2IJKResliceTransform->Concatenate(inputRAS2RASMatrix);
+      }
+      outputIJK2IJKResliceTransform->Concatenate(inputRAS2IJKMatrix);
+      outputIJK2IJKResliceTransform->Inverse();
+
+      int dimensions[3] = {0, 0, 0};
+      doseImage->GetDimensions(dimensions);
+      vtkNew<vtkImageReslice> reslice;
+      reslice->SetInputData(doseImage);
+      reslice->SetOutputOrigin(0, 0, 0);
+      reslice->SetOutputSpacing(1, 1, 1);
+      reslice->SetOutputExtent(0, dimensions[0]-1, 0, dimensions[1]-1, 0, dimensions[2]-1);
+      reslice->SetResliceTransform(outputIJK2IJKResliceTransform);
+      reslice->Update();
+      doseCacheEntry.ReslicedDoseImage = reslice->GetOutput();
+    }
+  }
+
+  return doseCacheEntry;
+}
+
+//----------------------------------------------------------------------------
+std::vector<double> vtkSlicerIsodoseModuleLogic::vtkInternal::GetIsoLevels(vtkMRMLIsodoseNode* parameterNode,
+  vtkMRMLColorTableNode* colorTableNode, bool relativeFlag)
+{
+  // reference value for relative representation
+  double referenceValue = parameterNode->GetReferenceDoseValue();
+
+  std::vector<double> isoLevels;
+  for (int i = 0; i < colorTableNode->GetNumberOfColors(); i++)
+  {
+    const char* strIsoLevel = colorTableNode->GetColorName(i);
+    double isoLevel = vtkVariant(strIsoLevel).ToDouble();
+    // change isoLevel value for relative representation
+    if (relativeFlag)
+    {
+      if (parameterNode->GetDoseUnits() != vtkMRMLIsodoseNode::Relative)
+      {
+        isoLevel = isoLevel * referenceValue / 100.;
+      }
+    }
+    isoLevels.push_back(isoLevel);
+  }
+  return isoLevels;
+}
+
+//----------------------------------------------------------------------------
+std::vector<double> vtkSlicerIsodoseModuleLogic::vtkInternal::GetSliceGeometry(vtkMRMLSliceNode* sliceNode)
+{
+  std::vector<double> geometry;
+  vtkMatrix4x4* xyToRasMatrix = sliceNode->GetXYToRAS();
+  for (int i = 0; i < 16; ++i)
+  {
+    geometry.push_back(xyToRasMatrix->GetElement(i / 4, i % 4));
+  }
+  geometry.push_back(sliceNode->GetDimensions()[0]);
+  geometry.push_back(sliceNode->GetDimensions()[1]);
+  return geometry;
+}
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerIsodoseModuleLogic);
 
 //----------------------------------------------------------------------------
-vtkSlicerIsodoseModuleLogic::vtkSlicerIsodoseModuleLogic() = default;
+vtkSlicerIsodoseModuleLogic::vtkSlicerIsodoseModuleLogic()
+{
+  this->Internal = new vtkInternal();
+}
 
 //----------------------------------------------------------------------------
-vtkSlicerIsodoseModuleLogic::~vtkSlicerIsodoseModuleLogic() = default;
+vtkSlicerIsodoseModuleLogic::~vtkSlicerIsodoseModuleLogic()
+{
+  delete this->Internal;
+  this->Internal = nullptr;
+}
 
 //----------------------------------------------------------------------------
 void vtkSlicerIsodoseModuleLogic::PrintSelf(ostream& os, vtkIndent indent)
@@ -172,6 +360,8 @@ void vtkSlicerIsodoseModuleLogic::OnMRMLSceneEndClose()
     return;
   }
 
+  this->ClearIsodoseSurfaceCache();
+  this->Internal->SliceIsolinesGeometries.clear();
   this->Modified();
 }
 
@@ -211,6 +401,10 @@ void vtkSlicerIsodoseModuleLogic::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
     return;
   }
 
+  if (node->IsA("vtkMRMLScalarVolumeNode") && node->GetID())
+  {
+    this->Internal->DoseCache.erase(node->GetID());
+  }
   if (node->IsA("vtkMRMLScalarVolumeNode") || node->IsA("vtkMRMLIsodoseNode"))
   {
     this->Modified();
@@ -652,114 +846,121 @@ bool vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
     doseUnitName = "%";
   }
 
+  // Preview surfaces are created from downsampled dose without smoothing. Progress is not reported during
+  // interactive updates
+  bool preview = parameterNode->GetPreview();
+  bool interactive = parameterNode->GetRealTime() || preview;
+
   // Progress
   int progressStepCount = colorTableNode->GetNumberOfColors() + 1 /* reslice step */;
   int currentProgressStep = 0;
 
-  // Reslice dose volume
+  // Get dose in the IJK space of the dose volume. The resliced dose is cached until the dose or its geometry changes
   vtkNew<vtkMatrix4x4> inputIJK2RASMatrix;
   doseVolumeNode->GetIJKToRASMatrix(inputIJK2RASMatrix);
-  vtkNew<vtkMatrix4x4> inputRAS2IJKMatrix;
-  doseVolumeNode->GetRASToIJKMatrix(inputRAS2IJKMatrix);
-
-  vtkNew<vtkTransform> outputIJK2IJKResliceTransform;
-  outputIJK2IJKResliceTransform->Identity();
-  outputIJK2IJKResliceTransform->PostMultiply();
-  outputIJK2IJKResliceTransform->SetMatrix(inputIJK2RASMatrix);
+  vtkInternal::DoseCacheEntry& doseCacheEntry = this->Internal->GetDoseCacheEntry(doseVolumeNode);
 
-  vtkSmartPointer<vtkMRMLTransformNode> inputVolumeNodeTransformNode = doseVolumeNode->GetParentTransformNode();
-  vtkNew<vtkMatrix4x4> inputRAS2RASMatrix;
-  if (inputVolumeNodeTransformNode!=nullptr)
+  // Downsample dose for preview. The image keeps the IJK coordinates of the dose volume through its spacing
+  vtkImageData* contouredDoseImage = doseCacheEntry.ReslicedDoseImage;
+  if (preview)
   {
-    inputVolumeNodeTransformNode->GetMatrixTransformToWorld(inputRAS2RASMatrix);
-    outputIJK2IJKResliceTransform->Concatenate(inputRAS2RASMatrix);
+    int downsamplingFactor = parameterNode->GetPreviewDownsamplingFactor();
+    if (doseCacheEntry.PreviewDownsamplingFactor != downsamplingFactor)
+    {
+      if (downsamplingFactor > 1)
+      {
+        vtkNew<vtkImageShrink3D> shrink;
+        shrink->SetInputData(doseCacheEntry.ReslicedDoseImage);
+        shrink->SetShrinkFactors(downsamplingFactor, downsamplingFactor, downsamplingFactor);
+        shrink->MeanOn();
+        shrink->Update();
+        // Each output voxel is the mean of a block of input voxels, but it is placed at the first voxel of the block.
+        // Move the origin to the center of the first block so that the preview surfaces are not shifted
+        double previewOrigin[3] = {0.0, 0.0, 0.0};
+        shrink->GetOutput()->GetOrigin(previewOrigin);
+        double doseSpacing[3] = {1.0, 1.0, 1.0};
+        doseCacheEntry.ReslicedDoseImage->GetSpacing(doseSpacing);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          previewOrigin[axis] += 0.5 * (downsamplingFactor - 1) * doseSpacing[axis];
+        }
+        doseCacheEntry.PreviewDoseImage = vtkSmartPointer<vtkImageData>::New();
+        doseCacheEntry.PreviewDoseImage->ShallowCopy(shrink->GetOutput());
+        doseCacheEntry.PreviewDoseImage->SetOrigin(previewOrigin);
+      }
+      else
+      {
+        doseCacheEntry.PreviewDoseImage = doseCacheEntry.ReslicedDoseImage;
+      }
+      doseCacheEntry.PreviewDownsamplingFactor = downsamplingFactor;
+      doseCacheEntry.PreviewIsoLevelSurfaces.clear();
+    }
+    contouredDoseImage = doseCacheEntry.PreviewDoseImage;
   }
 
-  outputIJK2IJKResliceTransform->Concatenate(inputRAS2IJKMatrix);
-  outputIJK2IJKResliceTransform->Inverse();
-
-  int dimensions[3] = {0, 0, 0};
-  doseVolumeNode->GetImageData()->GetDimensions(dimensions);
-  vtkNew<vtkImageReslice> reslice;
-  reslice->SetInputData(doseVolumeNode->GetImageData());
-  reslice->SetOutputOrigin(0, 0, 0);
-  reslice->SetOutputSpacing(1, 1, 1);
-  reslice->SetOutputExtent(0, dimensions[0]-1, 0, dimensions[1]-1, 0, dimensions[2]-1);
-  reslice->SetResliceTransform(outputIJK2IJKResliceTransform);
-  reslice->Update();
-  vtkSmartPointer<vtkImageData> reslicedDoseVolumeImage = reslice->GetOutput();
-
   // Report progress
   ++currentProgressStep;
   double progress = (double)(currentProgressStep) / (double)progressStepCount;
-  if (!parameterNode->GetRealTime())
+  if (!interactive)
   {
     this->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
   }
 
-  // reference value for relative representation
-  double referenceValue = parameterNode->GetReferenceDoseValue();
+  // Collect isolevels
+  std::vector<double> isoLevels = vtkInternal::GetIsoLevels(parameterNode, colorTableNode, relativeFlag);
+
+  // Reuse the cached surfaces of unchanged isolevels and drop the ones no longer used
+  std::map<double, vtkSmartPointer<vtkPolyData> >& cachedIsoLevelSurfaces =
+    (preview ? doseCacheEntry.PreviewIsoLevelSurfaces : doseCacheEntry.IsoLevelSurfaces);
+  std::map<double, vtkSmartPointer<vtkPolyData> > isoLevelSurfaces;
+  std::vector<double> newIsoLevels;
+  for (double isoLevel : isoLevels)
+  {
+    std::map<double, vtkSmartPointer<vtkPolyData> >::iterator surfaceIt = cachedIsoLevelSurfaces.find(isoLevel);
+    if (surfaceIt != cachedIsoLevelSurfaces.end())
+    {
+      isoLevelSurfaces[isoLevel] = surfaceIt->second;
+    }
+    else
+    {
+      newIsoLevels.push_back(isoLevel);
+    }
+  }
+
+  // Create isodose surfaces of the new levels in one pass
+  if (!newIsoLevels.empty())
+  {
+    vtkNew<vtkIsodoseSurfaceExtractor> isodoseSurfaceExtractor;
+    isodoseSurfaceExtractor->SetInputImageData(contouredDoseImage);
+    isodoseSurfaceExtractor->SetIJKToRASMatrix(inputIJK2RASMatrix);
+    isodoseSurfaceExtractor->SetIsoLevels(newIsoLevels);
+    if (preview)
+    {
+      isodoseSurfaceExtractor->SetNumberOfSmoothingIterations(0);
+    }
+    if (!isodoseSurfaceExtractor->Update())
+    {
+      vtkErrorMacro("CreateIsodoseSurfaces: Failed to extract isodose surfaces for dose volume " << doseVolumeNode->GetName());
+      return false;
+    }
+    for (int i = 0; i < isodoseSurfaceExtractor->GetNumberOfIsoLevels(); i++)
+    {
+      isoLevelSurfaces[isodoseSurfaceExtractor->GetIsoLevel(i)] = isodoseSurfaceExtractor->GetIsoLevelSurface(i);
+    }
+  }
+  cachedIsoLevelSurfaces.swap(isoLevelSurfaces);
 
-  // Create isodose surfaces
   vtkNew<vtkAppendPolyData> append;
   vtkNew<vtkFloatArray> colors;
   colors->SetNumberOfComponents(1);
   colors->SetName("isolevels");
 
-  for (int i = 0; i < colorTableNode->GetNumberOfColors(); i++)
+  for (double isoLevel : isoLevels)
   {
-    const char* strIsoLevel = colorTableNode->GetColorName(i);
-    double isoLevel = vtkVariant(strIsoLevel).ToDouble();
-    // change isoLevel value for relative representation
-    if (relativeFlag)
+    vtkPolyData* isoSurface = cachedIsoLevelSurfaces[isoLevel];
+    if (isoSurface && isoSurface->GetNumberOfPoints() >= 1)
     {
-      if (doseUnits != vtkMRMLIsodoseNode::Relative)
-      {
-        isoLevel = isoLevel * referenceValue / 100.;
-      }
-    }
-
-    vtkNew<vtkImageMarchingCubes> marchingCubes;
-    marchingCubes->SetInputData(reslicedDoseVolumeImage);
-    marchingCubes->SetNumberOfContours(1);
-    marchingCubes->SetValue(0, isoLevel);
-    marchingCubes->ComputeScalarsOff();
-    marchingCubes->ComputeGradientsOff();
-    marchingCubes->ComputeNormalsOff();
-    marchingCubes->Update();
-
-    vtkSmartPointer<vtkPolyData> isoPolyData = marchingCubes->GetOutput();
-    if (isoPolyData->GetNumberOfPoints() >= 1)
-    {
-      vtkNew<vtkTriangleFilter> triangleFilter;
-      triangleFilter->SetInputData(marchingCubes->GetOutput());
-      triangleFilter->Update();
-
-      vtkNew<vtkWindowedSincPolyDataFilter> smootherSinc;
-      smootherSinc->SetPassBand(0.1);
-      smootherSinc->SetInputData(triangleFilter->GetOutput());
-      smootherSinc->SetNumberOfIterations(2);
-      smootherSinc->FeatureEdgeSmoothingOff();
-      smootherSinc->BoundarySmoothingOff();
-      smootherSinc->Update();
-
-      vtkNew<vtkPolyDataNormals> normals;
-      normals->SetInputData(smootherSinc->GetOutput());
-      normals->ComputePointNormalsOn();
-      normals->SetFeatureAngle(60);
-      normals->Update();
-
-      vtkNew<vtkTransform> inputIJKToRASTransform;
-      inputIJKToRASTransform->Identity();
-      inputIJKToRASTransform->SetMatrix(inputIJK2RASMatrix);
-
-      vtkNew<vtkTransformPolyDataFilter> transformPolyData;
-      transformPolyData->SetInputData(normals->GetOutput());
-      transformPolyData->SetTransform(inputIJKToRASTransform);
-      transformPolyData->Update();
-
-      vtkPolyData* isoSurface = transformPolyData->GetOutput();
-      for (vtkIdType i = 0; i < isoSurface->GetNumberOfPoints(); ++i)
+      for (vtkIdType pointIndex = 0; pointIndex < isoSurface->GetNumberOfPoints(); ++pointIndex)
       {
         colors->InsertNextTuple1(static_cast<float>(isoLevel));
       }
@@ -770,7 +971,7 @@ bool vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
     // Report progress
     ++currentProgressStep;
     progress = (double)(currentProgressStep) / (double)progressStepCount;
-    if (!parameterNode->GetRealTime())
+    if (!interactive)
     {
       this->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
     }
@@ -821,7 +1022,7 @@ bool vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
     isodoseModelNode->SetAndObservePolyData(isoSurfaces);
 
     // Update dose color table based on isodose
-    if (!parameterNode->GetRealTime())
+    if (!interactive)
     {
       this->UpdateDoseColorTableFromIsodose(parameterNode);
     }
@@ -833,7 +1034,7 @@ bool vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
       vtkNew<vtkPolyData> emptyPolyData;
       isodoseModelNode->SetAndObservePolyData(emptyPolyData);
     }
-    if (!parameterNode->GetRealTime())
+    if (!interactive)
     {
       vtkErrorMacro("CreateIsodoseSurfaces: Failed to create isosurfaces for dose volume " << doseVolumeNode->GetName());
     }
@@ -843,6 +1044,242 @@ bool vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
   return true;
 }
 
+//---------------------------------------------------------------------------
+void vtkSlicerIsodoseModuleLogic::ClearIsodoseSurfaceCache()
+{
+  this->Internal->DoseCache.clear();
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerIsodoseModuleLogic::CreateIsodoseLinesInSliceViews(vtkMRMLIsodoseNode* parameterNode)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene || !parameterNode)
+  {
+    vtkErrorMacro("CreateIsodoseLinesInSliceViews: Invalid scene or parameter set node");
+    return false;
+  }
+  vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
+  if (!doseVolumeNode || !doseVolumeNode->GetImageData())
+  {
+    vtkErrorMacro("CreateIsodoseLinesInSliceViews: Invalid dose volume");
+    return false;
+  }
+
+  std::vector<vtkMRMLNode*> sliceNodes;
+  scene->GetNodesByClass("vtkMRMLSliceNode", sliceNodes);
+  bool success = true;
+  for (vtkMRMLNode* node : sliceNodes)
+  {
+    vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast(node);
+
+    // Observe the slice node so that the lines follow the displayed slice
+    if (!vtkIsObservedMRMLNodeEventMacro(sliceNode, vtkCommand::ModifiedEvent))
+    {
+      vtkNew<vtkIntArray> events;
+      events->InsertNextValue(vtkCommand::ModifiedEvent);
+      vtkObserveMRMLNodeEventsMacro(sliceNode, events);
+    }
+
+    success = this->UpdateIsodoseLinesInSliceView(parameterNode, sliceNode) && success;
+  }
+  this->UpdateSliceIsolinesVisibility(parameterNode);
+
+  if (!parameterNode->GetRealTime())
+  {
+    this->UpdateDoseColorTableFromIsodose(parameterNode);
+  }
+  return success;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerIsodoseModuleLogic::UpdateIsodoseLinesInSliceView(vtkMRMLIsodoseNode* parameterNode, vtkMRMLSliceNode* sliceNode)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene || !parameterNode || !sliceNode || !sliceNode->GetID())
+  {
+    vtkErrorMacro("UpdateIsodoseLinesInSliceView: Invalid scene, parameter set node, or slice node");
+    return false;
+  }
+  vtkMRMLScalarVolumeNode* doseVolumeNode = parameterNode->GetDoseVolumeNode();
+  if (!doseVolumeNode || !doseVolumeNode->GetImageData())
+  {
+    vtkErrorMacro("UpdateIsodoseLinesInSliceView: Invalid dose volume");
+    return false;
+  }
+  vtkMRMLColorTableNode* colorTableNode = parameterNode->GetColorTableNode();
+  if (!colorTableNode)
+  {
+    vtkErrorMacro("UpdateIsodoseLinesInSliceView: Failed to get isodose color table node for dose volume " << doseVolumeNode->GetName());
+    return false;
+  }
+
+  // Check if that absolute of relative values
+  bool relativeFlag = false;
+  vtkMRMLIsodoseNode::DoseUnitsType doseUnits = parameterNode->GetDoseUnits();
+  if (parameterNode->GetRelativeRepresentationFlag()
+    && (doseUnits == vtkMRMLIsodoseNode::Gy || doseUnits == vtkMRMLIsodoseNode::Unknown))
+  {
+    relativeFlag = true;
+  }
+  else if (doseUnits == vtkMRMLIsodoseNode::Relative)
+  {
+    relativeFlag = true;
+  }
+
+  // Contour the resliced dose on the pixels of the slice view
+  vtkNew<vtkMatrix4x4> inputIJK2RASMatrix;
+  doseVolumeNode->GetIJKToRASMatrix(inputIJK2RASMatrix);
+  vtkInternal::DoseCacheEntry& doseCacheEntry = this->Internal->GetDoseCacheEntry(doseVolumeNode);
+
+  std::vector<double> isoLevels = vtkInternal::GetIsoLevels(parameterNode, colorTableNode, relativeFlag);
+  vtkNew<vtkIsodoseSliceLineExtractor> isodoseLineExtractor;
+  isodoseLineExtractor->SetInputImageData(doseCacheEntry.ReslicedDoseImage);
+  isodoseLineExtractor->SetIJKToRASMatrix(inputIJK2RASMatrix);
+  isodoseLineExtractor->SetSliceXYToRASMatrix(sliceNode->GetXYToRAS());
+  isodoseLineExtractor->SetSliceDimensions(sliceNode->GetDimensions()[0], sliceNode->GetDimensions()[1]);
+  isodoseLineExtractor->SetIsoLevels(isoLevels);
+  if (!isodoseLineExtractor->Update())
+  {
+    vtkErrorMacro("UpdateIsodoseLinesInSliceView: Failed to extract isodose lines for dose volume " << doseVolumeNode->GetName());
+    return false;
+  }
+  if (parameterNode->GetID())
+  {
+    this->Internal->SliceIsolinesGeometries[std::string(parameterNode->GetID()) + "|" + sliceNode->GetID()] =
+      vtkInternal::GetSliceGeometry(sliceNode);
+  }
+  vtkPolyData* isoLines = isodoseLineExtractor->GetOutput();
+  if (isoLines->GetPointData()->GetScalars())
+  {
+    isoLines->GetPointData()->GetScalars()->SetName("isolevels");
+  }
+
+  // Find isolines model node of the slice view
+  vtkMRMLModelNode* isolinesModelNode = nullptr;
+  for (int i = 0; i < parameterNode->GetNumberOfSliceIsolinesModelNodes(); ++i)
+  {
+    vtkMRMLModelNode* modelNode = parameterNode->GetNthSliceIsolinesModelNode(i);
+    const char* sliceNodeID = (modelNode ? modelNode->GetAttribute(ISODOSE_SLICE_NODE_ID_ATTRIBUTE_NAME) : nullptr);
+    if (sliceNodeID && !std::strcmp(sliceNodeID, sliceNode->GetID()))
+    {
+      isolinesModelNode = modelNode;
+      break;
+    }
+  }
+  if (!isolinesModelNode)
+  {
+    // Create and setup isolines model node, which is only displayed in its slice view
+    std::string baseName = std::string(doseVolumeNode->GetName()) + vtkSlicerIsodoseModuleLogic::ISODOSE_MODEL_NODE_NAME_POSTFIX
+      + "_" + (sliceNode->GetName() ? sliceNode->GetName() : "");
+    std::string uniqueName = scene->GenerateUniqueName(baseName.c_str());
+    isolinesModelNode = vtkMRMLModelNode::SafeDownCast(scene->AddNewNodeByClass("vtkMRMLModelNode", uniqueName));
+    isolinesModelNode->SetSelectable(1);
+    isolinesModelNode->SetAttribute(vtkSlicerRtCommon::DICOMRTIMPORT_ISODOSE_MODEL_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1");
+    isolinesModelNode->SetAttribute(ISODOSE_SLICE_NODE_ID_ATTRIBUTE_NAME, sliceNode->GetID());
+    isolinesModelNode->CreateDefaultDisplayNodes();
+
+    // Add the new node as a child of dose volume
+    vtkMRMLSubjectHierarchyNode* shNode = vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(scene);
+    vtkIdType isolinesModelItemID = (shNode ? shNode->GetItemByDataNode(isolinesModelNode) : 0);
+    vtkIdType doseShItemID = (shNode ? shNode->GetItemByDataNode(doseVolumeNode) : 0);
+    if (isolinesModelItemID && doseShItemID) // There is no automatic SH creation in automatic tests
+    {
+      shNode->SetItemParent(isolinesModelItemID, doseShItemID);
+    }
+
+    // The lines lie in the slice plane, so they are shown projected instead of intersected with the slice
+    vtkMRMLModelDisplayNode* displayNode = isolinesModelNode->GetModelDisplayNode();
+    displayNode->AddViewNodeID(sliceNode->GetID());
+    displayNode->SetSliceDisplayModeToProjection();
+    displayNode->Visibility2DOn();
+    displayNode->VisibilityOn();
+    displayNode->SetActiveScalarName("isolevels");
+    displayNode->SetAndObserveColorNodeID(colorTableNode->GetID());
+    displayNode->SetScalarVisibility(true);
+
+    parameterNode->AddAndObserveSliceIsolinesModelNode(isolinesModelNode);
+  }
+
+  // A slice usually only intersects some of the isodose levels, so the scalar range is set to all isolevels
+  // instead of the range of the lines, so that each isolevel has the same color in every slice view
+  vtkMRMLModelDisplayNode* isolinesDisplayNode = isolinesModelNode->GetModelDisplayNode();
+  if (isolinesDisplayNode && !isoLevels.empty())
+  {
+    isolinesDisplayNode->SetAutoScalarRange(false);
+    isolinesDisplayNode->SetScalarRange(
+      *std::min_element(isoLevels.begin(), isoLevels.end()), *std::max_element(isoLevels.begin(), isoLevels.end()) );
+  }
+
+  isolinesModelNode->SetAndObservePolyData(isoLines);
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerIsodoseModuleLogic::UpdateSliceIsolinesVisibility(vtkMRMLIsodoseNode* parameterNode)
+{
+  if (!parameterNode)
+  {
+    vtkErrorMacro("UpdateSliceIsolinesVisibility: Invalid parameter set node");
+    return;
+  }
+
+  for (int i = 0; i < parameterNode->GetNumberOfSliceIsolinesModelNodes(); ++i)
+  {
+    vtkMRMLModelNode* modelNode = parameterNode->GetNthSliceIsolinesModelNode(i);
+    if (modelNode && modelNode->GetDisplayNode())
+    {
+      modelNode->GetDisplayNode()->SetVisibility(parameterNode->GetSlicePlaneIsolines());
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerIsodoseModuleLogic::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData)
+{
+  Superclass::ProcessMRMLNodesEvents(caller, event, callData);
+
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    vtkErrorMacro("ProcessMRMLNodesEvents: Invalid MRML scene");
+    return;
+  }
+  if (scene->IsBatchProcessing())
+  {
+    return;
+  }
+
+  vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast(caller);
+  if (!sliceNode || !sliceNode->GetID() || event != vtkCommand::ModifiedEvent)
+  {
+    return;
+  }
+  std::vector<double> sliceGeometry = vtkInternal::GetSliceGeometry(sliceNode);
+
+  // Update slice plane isodose lines that have been created for the slice view
+  std::vector<vtkMRMLNode*> isodoseNodes;
+  scene->GetNodesByClass("vtkMRMLIsodoseNode", isodoseNodes);
+  for (vtkMRMLNode* node : isodoseNodes)
+  {
+    vtkMRMLIsodoseNode* parameterNode = vtkMRMLIsodoseNode::SafeDownCast(node);
+    if ( !parameterNode->GetSlicePlaneIsolines() || parameterNode->GetNumberOfSliceIsolinesModelNodes() == 0
+      || !parameterNode->GetDoseVolumeNode() || !parameterNode->GetDoseVolumeNode()->GetImageData() || !parameterNode->GetID() )
+    {
+      continue;
+    }
+
+    // Slice nodes are modified for many reasons (e.g. layout, annotations), the lines only depend on the slice plane
+    std::map<std::string, std::vector<double> >::iterator geometryIt =
+      this->Internal->SliceIsolinesGeometries.find(std::string(parameterNode->GetID()) + "|" + sliceNode->GetID());
+    if (geometryIt == this->Internal->SliceIsolinesGeometries.end() || geometryIt->second == sliceGeometry)
+    {
+      continue;
+    }
+    this->UpdateIsodoseLinesInSliceView(parameterNode, sliceNode);
+  }
+}
+
 //---------------------------------------------------------------------------
 void vtkSlicerIsodoseModuleLogic::UpdateDoseColorTableFromIsodose(vtkMRMLIsodoseNode* parameterNode)
 {
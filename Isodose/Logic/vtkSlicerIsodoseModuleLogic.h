@@ -38,6 +38,7 @@ class vtkMRMLColorTableNode;
 class vtkMRMLIsodoseNode;
 class vtkMRMLModelHierarchyNode;
 class vtkMRMLScalarVolumeNode;
+class vtkMRMLSliceNode;
 
 class vtkSlicerColorLogic;
 
@@ -57,11 +58,26 @@ public:
   /// Set number of isodose levels
   void SetNumberOfIsodoseLevels(vtkMRMLIsodoseNode* parameterNode, int newNumberOfColors);
 
-  /// Create dose isolevels surfaces for dose volume associated with the parameterNode
+  /// Create dose isolevels surfaces for dose volume associated with the parameterNode.
+  /// The resliced dose and the surfaces of the isolevels are cached per dose volume, so only the
+  /// isolevels that were added or changed since the last call are contoured, unless the dose changes.
   /// \param parameterNode isodose node parameters
   /// \return true if success, false otherwise
   bool CreateIsodoseSurfaces(vtkMRMLIsodoseNode* parameterNode);
 
+  /// Release the cached resliced dose volumes and isodose surfaces
+  void ClearIsodoseSurfaceCache();
+
+  /// Create isodose lines on the planes displayed in the slice views for dose volume associated with the parameterNode.
+  /// Only the resliced dose of each slice view is contoured. The lines are updated when a slice view changes
+  /// while the slice plane isolines flag of the parameter node is enabled.
+  /// \param parameterNode isodose node parameters
+  /// \return true if success, false otherwise
+  bool CreateIsodoseLinesInSliceViews(vtkMRMLIsodoseNode* parameterNode);
+
+  /// Show the slice plane isodose lines of the parameterNode if its slice plane isolines flag is enabled, hide them otherwise
+  void UpdateSliceIsolinesVisibility(vtkMRMLIsodoseNode* parameterNode);
+
   /// Make sure a dose volume has a valid associated isodose color table node
   vtkMRMLColorTableNode* SetupColorTableNodeForDoseVolumeNode(vtkMRMLScalarVolumeNode* doseVolumeNode);
 
@@ -90,6 +106,10 @@ protected:
   /// \return The loaded color table node if loading succeeded, nullptr otherwise
   vtkMRMLColorTableNode* LoadDefaultIsodoseColorTable();
 
+  /// Update isodose lines of the parameterNode in one slice view. Creates the isolines model node of the view if needed
+  /// \return true if success, false otherwise
+  bool UpdateIsodoseLinesInSliceView(vtkMRMLIsodoseNode* parameterNode, vtkMRMLSliceNode* sliceNode);
+
 protected:
   void SetMRMLSceneInternal(vtkMRMLScene* newScene) override;
 
@@ -100,6 +120,10 @@ protected:
   void OnMRMLSceneNodeRemoved(vtkMRMLNode* node) override;
   void OnMRMLSceneEndClose() override;
 
+  /// Handles slice node changes to update the slice plane isodose lines. The lines are only updated if the
+  /// slice plane or the slice dimensions changed
+  void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData) override;
+
 protected:
   vtkSlicerIsodoseModuleLogic();
   ~vtkSlicerIsodoseModuleLogic() override;
@@ -109,6 +133,9 @@ private:
   void operator=(const vtkSlicerIsodoseModuleLogic&) = delete;
   /// Unique name of the copy of default isodose color table node
   static std::string IsodoseColorNodeCopyUniqueName;
+
+  class vtkInternal;
+  vtkInternal* Internal;
 };
 
 #endif
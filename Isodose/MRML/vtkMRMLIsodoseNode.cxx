@@ -41,6 +41,7 @@
 //------------------------------------------------------------------------------
 static const char* DOSE_VOLUME_REFERENCE_ROLE = "doseVolumeRef";
 static const char* ISOSURFACES_MODEL_REFERENCE_ROLE = "isosurfacesModelRef";
+static const char* SLICE_ISOLINES_MODEL_REFERENCE_ROLE = "sliceIsolinesModelRef";
 const char* vtkMRMLIsodoseNode::COLOR_TABLE_REFERENCE_ROLE = "colorTableRef";
 
 //------------------------------------------------------------------------------
@@ -69,6 +70,9 @@ void vtkMRMLIsodoseNode::WriteXML(ostream& of, int nIndent)
   vtkMRMLWriteXMLFloatMacro(ReferenceDoseValue, ReferenceDoseValue);
   vtkMRMLWriteXMLBooleanMacro(RelativeRepresentationFlag, RelativeRepresentationFlag);
   vtkMRMLWriteXMLBooleanMacro(RealTime, RealTime);
+  vtkMRMLWriteXMLBooleanMacro(Preview, Preview);
+  vtkMRMLWriteXMLIntMacro(PreviewDownsamplingFactor, PreviewDownsamplingFactor);
+  vtkMRMLWriteXMLBooleanMacro(SlicePlaneIsolines, SlicePlaneIsolines);
 
   vtkMRMLWriteXMLEndMacro();
 }
@@ -87,6 +91,9 @@ void vtkMRMLIsodoseNode::ReadXMLAttributes(const char** atts)
   vtkMRMLReadXMLFloatMacro(ReferenceDoseValue, ReferenceDoseValue);
   vtkMRMLReadXMLBooleanMacro(RelativeRepresentationFlag, RelativeRepresentationFlag);
   vtkMRMLReadXMLBooleanMacro(RealTime, RealTime);
+  vtkMRMLReadXMLBooleanMacro(Preview, Preview);
+  vtkMRMLReadXMLIntMacro(PreviewDownsamplingFactor, PreviewDownsamplingFactor);
+  vtkMRMLReadXMLBooleanMacro(SlicePlaneIsolines, SlicePlaneIsolines);
   vtkMRMLReadXMLEndMacro();
 
   this->EndModify(disabledModify);
@@ -109,6 +116,9 @@ void vtkMRMLIsodoseNode::Copy(vtkMRMLNode *anode)
   vtkMRMLCopyFloatMacro(ReferenceDoseValue);
   vtkMRMLCopyBooleanMacro(RelativeRepresentationFlag);
   vtkMRMLCopyBooleanMacro(RealTime);
+  vtkMRMLCopyBooleanMacro(Preview);
+  vtkMRMLCopyIntMacro(PreviewDownsamplingFactor);
+  vtkMRMLCopyBooleanMacro(SlicePlaneIsolines);
   vtkMRMLCopyEndMacro();
 
   this->EndModify(disabledModify);
@@ -127,6 +137,9 @@ void vtkMRMLIsodoseNode::PrintSelf(ostream& os, vtkIndent indent)
   vtkMRMLPrintFloatMacro(ReferenceDoseValue);
   vtkMRMLPrintBooleanMacro(RelativeRepresentationFlag);
   vtkMRMLPrintBooleanMacro(RealTime);
+  vtkMRMLPrintBooleanMacro(Preview);
+  vtkMRMLPrintIntMacro(PreviewDownsamplingFactor);
+  vtkMRMLPrintBooleanMacro(SlicePlaneIsolines);
   vtkMRMLPrintEndMacro();
 }
 
@@ -198,6 +211,36 @@ void vtkMRMLIsodoseNode::SetAndObserveIsosurfacesModelNode(vtkMRMLModelNode* nod
   this->SetNodeReferenceID(ISOSURFACES_MODEL_REFERENCE_ROLE, (node ? node->GetID() : nullptr));
 }
 
+//----------------------------------------------------------------------------
+int vtkMRMLIsodoseNode::GetNumberOfSliceIsolinesModelNodes()
+{
+  return this->GetNumberOfNodeReferences(SLICE_ISOLINES_MODEL_REFERENCE_ROLE);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLModelNode* vtkMRMLIsodoseNode::GetNthSliceIsolinesModelNode(int n)
+{
+  return vtkMRMLModelNode::SafeDownCast( this->GetNthNodeReference(SLICE_ISOLINES_MODEL_REFERENCE_ROLE, n) );
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLIsodoseNode::AddAndObserveSliceIsolinesModelNode(vtkMRMLModelNode* node)
+{
+  if (!node || this->Scene != node->GetScene())
+  {
+    vtkErrorMacro("Cannot add reference: the referenced and referencing node are not in the same scene");
+    return;
+  }
+
+  this->AddNodeReferenceID(SLICE_ISOLINES_MODEL_REFERENCE_ROLE, node->GetID());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLIsodoseNode::RemoveAllSliceIsolinesModelNodes()
+{
+  this->RemoveNodeReferenceIDs(SLICE_ISOLINES_MODEL_REFERENCE_ROLE);
+}
+
 //---------------------------------------------------------------------------
 void vtkMRMLIsodoseNode::SetDoseUnits(int id)
 {
@@ -75,6 +75,15 @@ public:
   /// Set and observe isosurfaces model node
   void SetAndObserveIsosurfacesModelNode(vtkMRMLModelNode* node);
 
+  /// Get number of slice isolines model nodes (one for each slice view)
+  int GetNumberOfSliceIsolinesModelNodes();
+  /// Get slice isolines model node
+  vtkMRMLModelNode* GetNthSliceIsolinesModelNode(int n);
+  /// Add and observe slice isolines model node
+  void AddAndObserveSliceIsolinesModelNode(vtkMRMLModelNode* node);
+  /// Remove references to all slice isolines model nodes
+  void RemoveAllSliceIsolinesModelNodes();
+
   /// Get/Set show isodose lines checkbox state
   vtkGetMacro(ShowIsodoseLines, bool);
   vtkSetMacro(ShowIsodoseLines, bool);
@@ -121,6 +130,26 @@ public:
   vtkBooleanMacro(RealTime, bool);
   //@}
 
+  //@{
+  /// Get/Set preview flag
+  vtkGetMacro(Preview, bool);
+  vtkSetMacro(Preview, bool);
+  vtkBooleanMacro(Preview, bool);
+  //@}
+
+  //@{
+  /// Get/Set dose downsampling factor used in preview mode
+  vtkGetMacro(PreviewDownsamplingFactor, int);
+  vtkSetClampMacro(PreviewDownsamplingFactor, int, 1, 8);
+  //@}
+
+  //@{
+  /// Get/Set slice plane isolines flag
+  vtkGetMacro(SlicePlaneIsolines, bool);
+  vtkSetMacro(SlicePlaneIsolines, bool);
+  vtkBooleanMacro(SlicePlaneIsolines, bool);
+  //@}
+
 protected:
   vtkMRMLIsodoseNode();
   ~vtkMRMLIsodoseNode();
@@ -156,6 +185,19 @@ protected:
   /// Instead, top-level isodose model nodes are re-used (by node name) at every computation. It is useful when isodose is needed
   /// to be computed on-the-fly for streamed dose data, when one set of isodose surfaces is all that is needed to be kept and displayed.
   bool RealTime{false};
+
+  /// Flag for interactive updates (e.g. while dragging the reference dose slider). When enabled, the isodose
+  /// surfaces are created from a downsampled dose volume without smoothing, which is fast but coarse.
+  /// The surfaces are expected to be recreated with the flag disabled when the interaction ends.
+  bool Preview{false};
+
+  /// Factor by which the dose volume is downsampled along each axis for the preview surfaces
+  int PreviewDownsamplingFactor{2};
+
+  /// Whether to create isodose lines only on the planes displayed in the slice views instead of 3D isodose surfaces.
+  /// The lines are contoured on the resliced dose of each slice view and updated when the slice views change,
+  /// so the cost scales with the slice area instead of the dose volume size.
+  bool SlicePlaneIsolines{false};
 };
 
 #endif
@@ -28,29 +28,353 @@
 
 // MRML includes
 #include <vtkMRMLColorTableNode.h>
+#include <vtkMRMLModelDisplayNode.h>
 #include <vtkMRMLModelNode.h>
 #include <vtkMRMLScalarVolumeNode.h>
 #include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
 #include <vtkMRMLSubjectHierarchyNode.h>
 
 // VTK includes
+#include <vtkCenterOfMass.h>
 #include <vtkCollection.h>
+#include <vtkDataArray.h>
 #include <vtkDoubleArray.h>
 #include <vtkImageData.h>
 #include <vtkMassProperties.h>
 #include <vtkNew.h>
 #include <vtkPolyData.h>
 #include <vtkPolyDataReader.h>
+#include <vtkPointData.h>
 
 // ITK includes
 #include "itkFactoryRegistration.h"
 
 // STD includes
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 // VTKSYS includes
 #include <vtksys/SystemTools.hxx>
 
+namespace
+{
+  /// Volume and center of the isodose surfaces of one computation
+  struct IsodoseSurfaceProperties
+  {
+    vtkIdType NumberOfPoints{0};
+    double Volume{0.0};
+    double Center[3] = {0.0, 0.0, 0.0};
+  };
+
+  //-----------------------------------------------------------------------------
+  bool ComputeIsodoseSurfaceProperties(vtkSlicerIsodoseModuleLogic* isodoseLogic, vtkMRMLIsodoseNode* paramNode,
+    IsodoseSurfaceProperties& properties)
+  {
+    if (!isodoseLogic->CreateIsodoseSurfaces(paramNode) || !paramNode->GetIsosurfacesModelNode()
+      || !paramNode->GetIsosurfacesModelNode()->GetPolyData())
+    {
+      std::cerr << "ERROR: Unable to compute isosurfaces model" << std::endl;
+      return false;
+    }
+    vtkPolyData* isoSurfaces = paramNode->GetIsosurfacesModelNode()->GetPolyData();
+    properties.NumberOfPoints = isoSurfaces->GetNumberOfPoints();
+
+    vtkNew<vtkMassProperties> massProperties;
+    massProperties->SetInputData(isoSurfaces);
+    massProperties->Update();
+    properties.Volume = massProperties->GetVolume();
+
+    vtkNew<vtkCenterOfMass> centerOfMass;
+    centerOfMass->SetInputData(isoSurfaces);
+    centerOfMass->SetUseScalarsAsWeights(false);
+    centerOfMass->Update();
+    centerOfMass->GetCenter(properties.Center);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  bool AreIsodoseSurfacePropertiesEqual(const IsodoseSurfaceProperties& properties1, const IsodoseSurfaceProperties& properties2)
+  {
+    return properties1.NumberOfPoints == properties2.NumberOfPoints && properties1.Volume == properties2.Volume
+      && properties1.Center[0] == properties2.Center[0] && properties1.Center[1] == properties2.Center[1]
+      && properties1.Center[2] == properties2.Center[2];
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compute the surfaces with the cache after a change, and compare them with the surfaces computed without cache
+  bool TestChangedDoseSurfaces(vtkSlicerIsodoseModuleLogic* isodoseLogic, vtkMRMLIsodoseNode* paramNode,
+    const IsodoseSurfaceProperties& originalProperties, const char* changeName)
+  {
+    IsodoseSurfaceProperties cachedProperties;
+    IsodoseSurfaceProperties uncachedProperties;
+    if (!ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, cachedProperties))
+    {
+      return false;
+    }
+    isodoseLogic->ClearIsodoseSurfaceCache();
+    if (!ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, uncachedProperties))
+    {
+      return false;
+    }
+    if (!AreIsodoseSurfacePropertiesEqual(cachedProperties, uncachedProperties))
+    {
+      std::cerr << "ERROR: Isodose surfaces are not recomputed after " << changeName << ": volume " << cachedProperties.Volume
+        << " instead of " << uncachedProperties.Volume << std::endl;
+      return false;
+    }
+    if (cachedProperties.Volume == originalProperties.Volume)
+    {
+      std::cerr << "ERROR: Isodose surfaces did not change after " << changeName << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Check that the cached surfaces are reused while the dose is unchanged, and recomputed when the dose image,
+  /// its modification time or its geometry changes
+  bool TestIsodoseSurfaceCache(vtkSlicerIsodoseModuleLogic* isodoseLogic, vtkMRMLIsodoseNode* paramNode,
+    vtkMRMLScalarVolumeNode* doseVolumeNode)
+  {
+    IsodoseSurfaceProperties originalProperties;
+    IsodoseSurfaceProperties cachedProperties;
+    if (!ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, originalProperties)
+      || !ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, cachedProperties))
+    {
+      return false;
+    }
+    if (!AreIsodoseSurfacePropertiesEqual(originalProperties, cachedProperties))
+    {
+      std::cerr << "ERROR: Isodose surfaces differ when computed again from the cache" << std::endl;
+      return false;
+    }
+
+    // Modify the dose values in place
+    vtkNew<vtkImageData> originalDoseImage;
+    originalDoseImage->DeepCopy(doseVolumeNode->GetImageData());
+    vtkDataArray* doseScalars = doseVolumeNode->GetImageData()->GetPointData()->GetScalars();
+    for (vtkIdType voxel = 0; voxel < doseScalars->GetNumberOfTuples(); ++voxel)
+    {
+      doseScalars->SetTuple1(voxel, doseScalars->GetTuple1(voxel) * 1.25);
+    }
+    doseScalars->Modified();
+    doseVolumeNode->GetImageData()->Modified();
+    if (!TestChangedDoseSurfaces(isodoseLogic, paramNode, originalProperties, "modifying the dose values"))
+    {
+      return false;
+    }
+
+    // Replace the dose image
+    vtkNew<vtkImageData> replacedDoseImage;
+    replacedDoseImage->DeepCopy(originalDoseImage);
+    doseScalars = replacedDoseImage->GetPointData()->GetScalars();
+    for (vtkIdType voxel = 0; voxel < doseScalars->GetNumberOfTuples(); ++voxel)
+    {
+      doseScalars->SetTuple1(voxel, doseScalars->GetTuple1(voxel) * 0.8);
+    }
+    doseVolumeNode->SetAndObserveImageData(replacedDoseImage);
+    if (!TestChangedDoseSurfaces(isodoseLogic, paramNode, originalProperties, "replacing the dose image"))
+    {
+      return false;
+    }
+    doseVolumeNode->SetAndObserveImageData(originalDoseImage);
+
+    // Change the geometry
+    double originalSpacing[3] = {1.0, 1.0, 1.0};
+    doseVolumeNode->GetSpacing(originalSpacing);
+    doseVolumeNode->SetSpacing(originalSpacing[0] * 1.1, originalSpacing[1] * 1.1, originalSpacing[2] * 1.1);
+    if (!TestChangedDoseSurfaces(isodoseLogic, paramNode, originalProperties, "changing the dose geometry"))
+    {
+      return false;
+    }
+    doseVolumeNode->SetSpacing(originalSpacing);
+
+    // Back to the original dose
+    if (!ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, cachedProperties))
+    {
+      return false;
+    }
+    if (!AreIsodoseSurfacePropertiesEqual(originalProperties, cachedProperties))
+    {
+      std::cerr << "ERROR: Isodose surfaces of the restored dose differ from the original ones" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Compute preview surfaces from downsampled dose, then full quality surfaces. The preview must be close to the
+  /// full quality surfaces and must not shift them, and the full quality surfaces must not be affected by the preview
+  bool TestPreviewThenFullQuality(vtkSlicerIsodoseModuleLogic* isodoseLogic, vtkMRMLIsodoseNode* paramNode,
+    vtkMRMLScalarVolumeNode* doseVolumeNode)
+  {
+    IsodoseSurfaceProperties fullQualityProperties;
+    if (!ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, fullQualityProperties))
+    {
+      return false;
+    }
+
+    const int downsamplingFactor = 3;
+    paramNode->SetPreview(true);
+    paramNode->SetPreviewDownsamplingFactor(downsamplingFactor);
+    IsodoseSurfaceProperties previewProperties;
+    bool result = ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, previewProperties);
+    paramNode->SetPreview(false);
+    if (!result)
+    {
+      return false;
+    }
+
+    // Without compensating the origin the preview would be shifted by one dose voxel along each axis
+    double spacing[3] = {1.0, 1.0, 1.0};
+    doseVolumeNode->GetSpacing(spacing);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      if (std::fabs(previewProperties.Center[axis] - fullQualityProperties.Center[axis]) > 0.5 * spacing[axis])
+      {
+        std::cerr << "ERROR: Preview isodose surfaces are shifted by " << previewProperties.Center[axis] - fullQualityProperties.Center[axis]
+          << " mm along axis " << axis << std::endl;
+        return false;
+      }
+    }
+    if (std::fabs(previewProperties.Volume - fullQualityProperties.Volume) > 0.2 * fullQualityProperties.Volume)
+    {
+      std::cerr << "ERROR: Preview isodose volume " << previewProperties.Volume << " differs from full quality volume "
+        << fullQualityProperties.Volume << std::endl;
+      return false;
+    }
+
+    IsodoseSurfaceProperties fullQualityAfterPreviewProperties;
+    if (!ComputeIsodoseSurfaceProperties(isodoseLogic, paramNode, fullQualityAfterPreviewProperties))
+    {
+      return false;
+    }
+    if (!AreIsodoseSurfacePropertiesEqual(fullQualityProperties, fullQualityAfterPreviewProperties))
+    {
+      std::cerr << "ERROR: Full quality isodose surfaces differ after computing the preview" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  vtkPolyData* GetSliceIsolines(vtkMRMLIsodoseNode* paramNode)
+  {
+    if (paramNode->GetNumberOfSliceIsolinesModelNodes() != 1 || !paramNode->GetNthSliceIsolinesModelNode(0))
+    {
+      std::cerr << "ERROR: Expected one slice isolines model, found " << paramNode->GetNumberOfSliceIsolinesModelNodes() << std::endl;
+      return nullptr;
+    }
+    vtkPolyData* isolines = paramNode->GetNthSliceIsolinesModelNode(0)->GetPolyData();
+    if (!isolines)
+    {
+      std::cerr << "ERROR: Slice isolines model has no poly data" << std::endl;
+    }
+    return isolines;
+  }
+
+  //-----------------------------------------------------------------------------
+  /// Create isodose lines in an axial slice view through the center of the dose. Test that the lines follow
+  /// slice plane changes only, that they are colored by the range of the isolevels, and that they are hidden
+  /// when the slice plane isolines are turned off
+  bool TestSliceIsolines(vtkSlicerIsodoseModuleLogic* isodoseLogic, vtkMRMLIsodoseNode* paramNode,
+    vtkMRMLScalarVolumeNode* doseVolumeNode)
+  {
+    vtkMRMLScene* scene = paramNode->GetScene();
+    double doseBounds[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    doseVolumeNode->GetRASBounds(doseBounds);
+    double doseCenter[3] = {
+      (doseBounds[0] + doseBounds[1]) / 2.0, (doseBounds[2] + doseBounds[3]) / 2.0, (doseBounds[4] + doseBounds[5]) / 2.0 };
+
+    vtkNew<vtkMRMLSliceNode> sliceNode;
+    sliceNode->SetLayoutName("Red");
+    sliceNode->SetName("Red");
+    scene->AddNode(sliceNode);
+    sliceNode->SetOrientationToAxial();
+    sliceNode->SetDimensions(256, 256, 1);
+    double fieldOfView = 1.5 * std::max(doseBounds[1] - doseBounds[0], doseBounds[3] - doseBounds[2]);
+    sliceNode->SetFieldOfView(fieldOfView, fieldOfView, 1.0);
+    sliceNode->JumpSliceByCentering(doseCenter[0], doseCenter[1], doseCenter[2]);
+
+    paramNode->SetSlicePlaneIsolines(true);
+    if (!isodoseLogic->CreateIsodoseLinesInSliceViews(paramNode))
+    {
+      std::cerr << "ERROR: Failed to create slice plane isodose lines" << std::endl;
+      return false;
+    }
+    vtkPolyData* isolines = GetSliceIsolines(paramNode);
+    if (!isolines)
+    {
+      return false;
+    }
+    if (isolines->GetNumberOfPoints() == 0 || !isolines->GetPointData()->GetScalars())
+    {
+      std::cerr << "ERROR: No isodose lines in the slice through the dose center" << std::endl;
+      return false;
+    }
+
+    // All lines are of the single isolevel, so the explicit scalar range must be the isolevel itself
+    vtkMRMLModelDisplayNode* displayNode = paramNode->GetNthSliceIsolinesModelNode(0)->GetModelDisplayNode();
+    if (!displayNode || displayNode->GetAutoScalarRange() || !displayNode->GetVisibility())
+    {
+      std::cerr << "ERROR: Slice isolines must be visible and must use an explicit scalar range" << std::endl;
+      return false;
+    }
+    double linesRange[2] = {0.0, 0.0};
+    isolines->GetPointData()->GetScalars()->GetRange(linesRange);
+    double displayRange[2] = {0.0, 0.0};
+    displayNode->GetScalarRange(displayRange);
+    if (std::fabs(displayRange[0] - linesRange[0]) > EPSILON || std::fabs(displayRange[1] - linesRange[1]) > EPSILON)
+    {
+      std::cerr << "ERROR: Slice isolines scalar range [" << displayRange[0] << ", " << displayRange[1]
+        << "] differs from the isolevel range [" << linesRange[0] << ", " << linesRange[1] << "]" << std::endl;
+      return false;
+    }
+
+    // Modifications that do not change the slice plane must not recompute the lines
+    sliceNode->SetName("Red slice");
+    if (GetSliceIsolines(paramNode) != isolines)
+    {
+      std::cerr << "ERROR: Slice isolines recomputed when the slice plane did not change" << std::endl;
+      return false;
+    }
+
+    // Move the slice out of the dose, then back
+    sliceNode->JumpSliceByCentering(doseCenter[0], doseCenter[1], doseBounds[5] + 100.0);
+    isolines = GetSliceIsolines(paramNode);
+    if (!isolines || isolines->GetNumberOfPoints() != 0)
+    {
+      std::cerr << "ERROR: Slice isolines not updated when the slice was moved out of the dose" << std::endl;
+      return false;
+    }
+    sliceNode->JumpSliceByCentering(doseCenter[0], doseCenter[1], doseCenter[2]);
+    isolines = GetSliceIsolines(paramNode);
+    if (!isolines || isolines->GetNumberOfPoints() == 0)
+    {
+      std::cerr << "ERROR: Slice isolines not updated when the slice was moved back into the dose" << std::endl;
+      return false;
+    }
+
+    // Turn off the slice plane isolines: lines are hidden and not updated any more
+    paramNode->SetSlicePlaneIsolines(false);
+    isodoseLogic->UpdateSliceIsolinesVisibility(paramNode);
+    if (displayNode->GetVisibility())
+    {
+      std::cerr << "ERROR: Slice isolines visible after turning them off" << std::endl;
+      return false;
+    }
+    sliceNode->JumpSliceByCentering(doseCenter[0], doseCenter[1], doseBounds[5] + 100.0);
+    if (GetSliceIsolines(paramNode) != isolines)
+    {
+      std::cerr << "ERROR: Slice isolines updated while turned off" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
 //-----------------------------------------------------------------------------
 int vtkSlicerIsodoseModuleLogicTest1( int argc, char * argv[] )
 {
@@ -230,5 +554,18 @@ int vtkSlicerIsodoseModuleLogicTest1( int argc, char * argv[] )
     return EXIT_FAILURE;
   }
 
+  if (!TestIsodoseSurfaceCache(isodoseLogic, paramNode, doseScalarVolumeNode))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestPreviewThenFullQuality(isodoseLogic, paramNode, doseScalarVolumeNode))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!TestSliceIsolines(isodoseLogic, paramNode, doseScalarVolumeNode))
+  {
+    return EXIT_FAILURE;
+  }
+
   return EXIT_SUCCESS;
 }
@@ -23,6 +23,10 @@
 #include <QCheckBox>
 #include <QDebug>
 
+// CTK includes
+#include <ctkDoubleSlider.h>
+#include <ctkSliderWidget.h>
+
 // SlicerQt includes
 #include "qSlicerIsodoseModuleWidget.h"
 #include "ui_qSlicerIsodoseModule.h"
@@ -229,6 +233,7 @@ void qSlicerIsodoseModuleWidget::updateWidgetFromMRML()
 
     d->checkBox_Isoline->setChecked(d->IsodoseNode->GetShowIsodoseLines());
     d->checkBox_Isosurface->setChecked(d->IsodoseNode->GetShowIsodoseSurfaces());
+    d->checkBox_SlicePlaneIsolines->setChecked(d->IsodoseNode->GetSlicePlaneIsolines());
     d->checkBox_ShowDoseVolumesOnly->setChecked(d->IsodoseNode->GetShowDoseVolumesOnly());
 
     if (d->IsodoseNode->GetIsosurfacesModelNode())
@@ -275,9 +280,11 @@ void qSlicerIsodoseModuleWidget::setup()
   connect( d->checkBox_ShowDoseVolumesOnly, SIGNAL( stateChanged(int) ), this, SLOT( showDoseVolumesOnlyCheckboxChanged(int) ) );
   connect( d->checkBox_Isoline, SIGNAL(toggled(bool)), this, SLOT( setIsolineVisibility(bool) ) );
   connect( d->checkBox_Isosurface, SIGNAL(toggled(bool)), this, SLOT( setIsosurfaceVisibility(bool) ) );
+  connect( d->checkBox_SlicePlaneIsolines, SIGNAL(toggled(bool)), this, SLOT( setSlicePlaneIsolines(bool) ) );
   connect( d->pushButton_Apply, SIGNAL(clicked()), this, SLOT(applyClicked()) );
   connect( d->groupBox_RelativeIsolevels, SIGNAL(toggled(bool)), this, SLOT(setRelativeIsolevelsFlag(bool)));
   connect( d->sliderWidget_ReferenceDose, SIGNAL(valueChanged(double)), this, SLOT(setReferenceDoseValue(double)));
+  connect( d->sliderWidget_ReferenceDose->slider(), SIGNAL(sliderReleased()), this, SLOT(onReferenceDoseSliderReleased()));
 
   d->pushButton_Apply->setMinimumSize(d->pushButton_Apply->sizeHint().width() + 50, d->pushButton_Apply->sizeHint().height() + 20);
 
@@ -615,6 +622,52 @@ void qSlicerIsodoseModuleWidget::setReferenceDoseValue(double value)
     break;
   }
   d->IsodoseNode->DisableModifiedEventOff();
+
+  // Coarse update while dragging, full quality update when the slider is released
+  this->updateIsodoseSurfacesForReferenceDose(d->sliderWidget_ReferenceDose->slider()->isSliderDown());
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerIsodoseModuleWidget::onReferenceDoseSliderReleased()
+{
+  this->updateIsodoseSurfacesForReferenceDose(false);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerIsodoseModuleWidget::updateIsodoseSurfacesForReferenceDose(bool preview)
+{
+  Q_D(qSlicerIsodoseModuleWidget);
+
+  // Only existing surfaces of relative isolevels in absolute dose depend on the reference dose
+  if (!d->IsodoseNode || !d->IsodoseNode->GetRelativeRepresentationFlag()
+    || d->IsodoseNode->GetDoseUnits() == vtkMRMLIsodoseNode::Relative || d->IsodoseNode->GetReferenceDoseValue() <= 0.)
+  {
+    return;
+  }
+
+  // Slice plane isodose lines are fast enough to be recomputed in full quality
+  if (d->IsodoseNode->GetSlicePlaneIsolines())
+  {
+    if (d->IsodoseNode->GetNumberOfSliceIsolinesModelNodes() > 0)
+    {
+      d->logic()->CreateIsodoseLinesInSliceViews(d->IsodoseNode);
+    }
+    return;
+  }
+  if (!d->IsodoseNode->GetIsosurfacesModelNode())
+  {
+    return;
+  }
+
+  d->IsodoseNode->DisableModifiedEventOn();
+  d->IsodoseNode->SetPreview(preview);
+  d->IsodoseNode->DisableModifiedEventOff();
+
+  d->logic()->CreateIsodoseSurfaces(d->IsodoseNode);
+
+  d->IsodoseNode->DisableModifiedEventOn();
+  d->IsodoseNode->SetPreview(false);
+  d->IsodoseNode->DisableModifiedEventOff();
 }
 
 //-----------------------------------------------------------------------------
@@ -691,6 +744,32 @@ void qSlicerIsodoseModuleWidget::setIsosurfaceVisibility(bool visible)
   }
 }
 
+//------------------------------------------------------------------------------
+void qSlicerIsodoseModuleWidget::setSlicePlaneIsolines(bool slicePlaneIsolines)
+{
+  Q_D(qSlicerIsodoseModuleWidget);
+
+  if (!d->IsodoseNode)
+  {
+    return;
+  }
+
+  d->IsodoseNode->DisableModifiedEventOn();
+  d->IsodoseNode->SetSlicePlaneIsolines(slicePlaneIsolines);
+  d->IsodoseNode->DisableModifiedEventOff();
+
+  // Slice views may have changed while the lines were turned off, so existing lines are recomputed when turned on
+  if ( slicePlaneIsolines && d->IsodoseNode->GetNumberOfSliceIsolinesModelNodes() > 0
+    && d->IsodoseNode->GetDoseVolumeNode() && d->IsodoseNode->GetDoseVolumeNode()->GetImageData() )
+  {
+    d->logic()->CreateIsodoseLinesInSliceViews(d->IsodoseNode);
+  }
+  else
+  {
+    d->logic()->UpdateSliceIsolinesVisibility(d->IsodoseNode);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerIsodoseModuleWidget::applyClicked()
 {
@@ -709,6 +788,14 @@ void qSlicerIsodoseModuleWidget::applyClicked()
 
   QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
 
+  // Only contour the planes displayed in the slice views
+  if (d->IsodoseNode->GetSlicePlaneIsolines())
+  {
+    d->logic()->CreateIsodoseLinesInSliceViews(d->IsodoseNode);
+    QApplication::restoreOverrideCursor();
+    return;
+  }
+
   // Compute the isodose surface for the selected dose volume and create color legend node if isosurfaces
   // model node has been calculated successfully
   bool res = d->logic()->CreateIsodoseSurfaces(d->IsodoseNode);
@@ -87,6 +87,9 @@ protected slots:
   /// Slot for changing isosurface visibility
   void setIsosurfaceVisibility(bool);
 
+  /// Slot for switching between 3D isodose surfaces and isodose lines in the slice views only
+  void setSlicePlaneIsolines(bool);
+
   /// Slot handling clicking the Apply button
   void applyClicked();
 
@@ -102,6 +105,9 @@ protected slots:
   /// Slot called to set reference dose value
   void setReferenceDoseValue(double value);
 
+  /// Slot called when the reference dose slider is released. Replaces the preview isodose surfaces by full quality ones
+  void onReferenceDoseSliderReleased();
+
   /// Updates color legend widget
   void updateColorLegendFromMRML();
 
@@ -112,6 +118,11 @@ protected:
   /// Updates button states
   void updateButtonsState();
 
+  /// Recompute existing isodose surfaces after a change of the reference dose.
+  /// Surfaces are only updated if they depend on the reference dose (relative isolevels)
+  /// \param preview Create coarse surfaces quickly, used while the slider is being dragged
+  void updateIsodoseSurfacesForReferenceDose(bool preview);
+
 protected:
   QScopedPointer<qSlicerIsodoseModuleWidgetPrivate> d_ptr;
   
@@ -24,20 +24,355 @@
 
 // VTK includes
 #include <vtkObjectFactory.h>
+#include <vtkImageStencilData.h>
 #include <vtkImageStencilIterator.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
 #include <vtkStreamingDemandDrivenPipeline.h>
 #include <vtkFieldData.h>
 #include <vtkMath.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <vector>
+
+// SIMD includes
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SLICERRT_FRACTIONAL_ACCUMULATE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SLICERRT_FRACTIONAL_ACCUMULATE_SSE2
+#endif
 
 vtkStandardNewMacro(vtkFractionalImageAccumulate);
 
+namespace
+{
+  /// Maximum number of slabs the input is split into for parallel accumulation.
+  /// The split only depends on the input, so the results do not depend on the number of threads.
+  /// The partial sums of the slabs are added in slab order, which differs from summing all voxels in raster order
+  /// by floating point rounding only.
+  const vtkIdType MAXIMUM_NUMBER_OF_SLABS = 64;
+
+  /// Maximum total number of bins in the partial histograms of the slabs
+  const vtkIdType MAXIMUM_NUMBER_OF_PARTIAL_BINS = 16*1024*1024;
+
+  /// Number of voxels processed together by the float kernel
+  const int SIMD_BATCH_SIZE = 64;
+
+  //----------------------------------------------------------------------------
+  /// Accumulation settings common for all slabs
+  struct vtkFractionalImageAccumulateParameters
+  {
+    vtkImageData* InData{nullptr};
+    vtkImageData* FractionalLabelmap{nullptr};
+    vtkImageStencilData* Stencil{nullptr};
+    bool ReverseStencil{false};
+    bool IgnoreZero{false};
+    bool UseFractionalLabelmap{false};
+    double MinimumFractionalValue{0.0};
+    double FractionalRange{1.0};
+    int NumberOfComponents{1};
+    int OutExtent[6];
+    vtkIdType OutIncrements[3];
+    double Origin[3];
+    double Spacing[3];
+  };
+
+  //----------------------------------------------------------------------------
+  /// Statistics and histogram accumulated over one slab of the input
+  struct vtkFractionalImageAccumulatePartial
+  {
+    double Sum[3]{0.0, 0.0, 0.0};
+    double SumSqr[3]{0.0, 0.0, 0.0};
+    double Min[3]{VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, VTK_DOUBLE_MAX};
+    double Max[3]{VTK_DOUBLE_MIN, VTK_DOUBLE_MIN, VTK_DOUBLE_MIN};
+    vtkIdType VoxelCount{0};
+    double FractionalVoxelCount{0.0};
+    std::vector<double> Histogram;
+  };
+
+  //----------------------------------------------------------------------------
+  /// Accumulate one single-component voxel with dose value v, fraction f, and precomputed bin index
+  inline void vtkFractionalImageAccumulateVoxel(double v, double f, double binIndex,
+    const vtkFractionalImageAccumulateParameters& parameters, vtkFractionalImageAccumulatePartial& partial)
+  {
+    double total = 0.0;
+    if (!parameters.IgnoreZero || v != 0)
+      {
+      // gather statistics
+      partial.Sum[0] += v*f;
+      partial.SumSqr[0] += v*v*f*f;
+      if (v > partial.Max[0])
+        {
+        partial.Max[0] = v;
+        }
+      if (v < partial.Min[0])
+        {
+        partial.Min[0] = v;
+        }
+      partial.VoxelCount++;
+      partial.FractionalVoxelCount += f;
+      total += f;
+      }
+
+    // verify that the bin is in range
+    if (binIndex >= parameters.OutExtent[0] && binIndex <= parameters.OutExtent[1])
+      {
+      partial.Histogram[static_cast<vtkIdType>(binIndex - parameters.OutExtent[0]) * parameters.OutIncrements[0]] += total;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Generic kernel for one stencil span, for any scalar types and up to three components
+  template <class BaseImageScalarType, class FractionalImageScalarType>
+  void vtkFractionalImageAccumulateSpan(const BaseImageScalarType* inPtr, const BaseImageScalarType* spanEndPtr,
+    const FractionalImageScalarType* fractionalPtr, const vtkFractionalImageAccumulateParameters& parameters,
+    vtkFractionalImageAccumulatePartial& partial)
+  {
+    int numC = parameters.NumberOfComponents;
+    while (inPtr != spanEndPtr)
+      {
+      // find the bin for this pixel.
+      bool outOfBounds = false;
+      vtkIdType outIndex = 0;
+      double total = 0.0;
+
+      for (int idxC = 0; idxC < numC; ++idxC)
+        {
+        double v = static_cast<double>(*inPtr++);
+        double f = 1.0;
+
+        if (parameters.UseFractionalLabelmap)
+          {
+          f = ( (*fractionalPtr++) - parameters.MinimumFractionalValue ) / parameters.FractionalRange;
+          }
+
+        if (!parameters.IgnoreZero || v != 0)
+          {
+          // gather statistics
+          partial.Sum[idxC] += v*f;
+          partial.SumSqr[idxC] += v*v*f*f;
+          if (v > partial.Max[idxC])
+            {
+            partial.Max[idxC] = v;
+            }
+          if (v < partial.Min[idxC])
+            {
+            partial.Min[idxC] = v;
+            }
+          partial.VoxelCount++;
+          partial.FractionalVoxelCount += f;
+          total += f;
+          }
+
+        // compute the index
+        int outIdx = vtkMath::Floor((v - parameters.Origin[idxC]) / parameters.Spacing[idxC]);
+
+        // verify that it is in range
+        if (outIdx >= parameters.OutExtent[idxC*2] && outIdx <= parameters.OutExtent[idxC*2+1])
+          {
+          outIndex += (outIdx - parameters.OutExtent[idxC*2]) * parameters.OutIncrements[idxC];
+          }
+        else
+          {
+          outOfBounds = true;
+          }
+        }
+
+      // increment the bin
+      if (!outOfBounds)
+        {
+        partial.Histogram[outIndex] += total;
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Kernel for one stencil span of single-component float dose with 8 or 16 bit fractional labels.
+  /// The fractions and bin indices are computed with packed double precision arithmetic, which gives the same
+  /// results as the scalar computation. Statistics and histogram are then accumulated in a scalar loop in voxel order.
+  template <class FractionalImageScalarType>
+  void vtkFractionalImageAccumulateFloatSpan(const float* inPtr, const float* spanEndPtr,
+    const FractionalImageScalarType* fractionalPtr, const vtkFractionalImageAccumulateParameters& parameters,
+    vtkFractionalImageAccumulatePartial& partial)
+  {
+    double values[SIMD_BATCH_SIZE];
+    double fractions[SIMD_BATCH_SIZE];
+    double bins[SIMD_BATCH_SIZE];
+
+    const double origin = parameters.Origin[0];
+    const double spacing = parameters.Spacing[0];
+    const double minimumFractionalValue = parameters.MinimumFractionalValue;
+    const double fractionalRange = parameters.FractionalRange;
+
+    while (inPtr < spanEndPtr)
+      {
+      int batchSize = static_cast<int>(std::min<vtkIdType>(spanEndPtr - inPtr, SIMD_BATCH_SIZE));
+      for (int index = 0; index < batchSize; ++index)
+        {
+        fractions[index] = static_cast<double>(fractionalPtr[index]);
+        }
+
+      int index = 0;
+#if defined(SLICERRT_FRACTIONAL_ACCUMULATE_AVX2)
+      const __m256d originPacked = _mm256_set1_pd(origin);
+      const __m256d spacingPacked = _mm256_set1_pd(spacing);
+      const __m256d minimumPacked = _mm256_set1_pd(minimumFractionalValue);
+      const __m256d rangePacked = _mm256_set1_pd(fractionalRange);
+      for (; index + 4 <= batchSize; index += 4)
+        {
+        __m256d v = _mm256_cvtps_pd(_mm_loadu_ps(inPtr + index));
+        __m256d f = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(fractions + index), minimumPacked), rangePacked);
+        __m256d b = _mm256_floor_pd(_mm256_div_pd(_mm256_sub_pd(v, originPacked), spacingPacked));
+        _mm256_storeu_pd(values + index, v);
+        _mm256_storeu_pd(fractions + index, f);
+        _mm256_storeu_pd(bins + index, b);
+        }
+#elif defined(SLICERRT_FRACTIONAL_ACCUMULATE_SSE2)
+      const __m128d originPacked = _mm_set1_pd(origin);
+      const __m128d spacingPacked = _mm_set1_pd(spacing);
+      const __m128d minimumPacked = _mm_set1_pd(minimumFractionalValue);
+      const __m128d rangePacked = _mm_set1_pd(fractionalRange);
+      for (; index + 2 <= batchSize; index += 2)
+        {
+        __m128d v = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(inPtr + index))));
+        __m128d f = _mm_div_pd(_mm_sub_pd(_mm_loadu_pd(fractions + index), minimumPacked), rangePacked);
+        __m128d b = _mm_div_pd(_mm_sub_pd(v, originPacked), spacingPacked);
+        _mm_storeu_pd(values + index, v);
+        _mm_storeu_pd(fractions + index, f);
+        // SSE2 has no packed floor
+        _mm_storeu_pd(bins + index, b);
+        bins[index] = vtkMath::Floor(bins[index]);
+        bins[index+1] = vtkMath::Floor(bins[index+1]);
+        }
+#endif
+      // Scalar remainder (and fallback if no SIMD instruction set is available)
+      for (; index < batchSize; ++index)
+        {
+        values[index] = static_cast<double>(inPtr[index]);
+        fractions[index] = (fractions[index] - minimumFractionalValue) / fractionalRange;
+        bins[index] = vtkMath::Floor((values[index] - origin) / spacing);
+        }
+
+      for (index = 0; index < batchSize; ++index)
+        {
+        vtkFractionalImageAccumulateVoxel(values[index], fractions[index], bins[index], parameters, partial);
+        }
+
+      inPtr += batchSize;
+      fractionalPtr += batchSize;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Select kernel for a span. The float kernel is used for float input with char or short fractional labelmap
+  template <class BaseImageScalarType, class FractionalImageScalarType>
+  struct vtkFractionalImageAccumulateSpanKernel
+  {
+    static void Execute(const BaseImageScalarType* inPtr, const BaseImageScalarType* spanEndPtr,
+      const FractionalImageScalarType* fractionalPtr, const vtkFractionalImageAccumulateParameters& parameters,
+      vtkFractionalImageAccumulatePartial& partial)
+    {
+      vtkFractionalImageAccumulateSpan(inPtr, spanEndPtr, fractionalPtr, parameters, partial);
+    }
+  };
+
+#define SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL(FractionalImageScalarType) \
+  template <> \
+  struct vtkFractionalImageAccumulateSpanKernel<float, FractionalImageScalarType> \
+  { \
+    static void Execute(const float* inPtr, const float* spanEndPtr, \
+      const FractionalImageScalarType* fractionalPtr, const vtkFractionalImageAccumulateParameters& parameters, \
+      vtkFractionalImageAccumulatePartial& partial) \
+    { \
+      if (parameters.NumberOfComponents == 1 && parameters.UseFractionalLabelmap) \
+        { \
+        vtkFractionalImageAccumulateFloatSpan(inPtr, spanEndPtr, fractionalPtr, parameters, partial); \
+        } \
+      else \
+        { \
+        vtkFractionalImageAccumulateSpan(inPtr, spanEndPtr, fractionalPtr, parameters, partial); \
+        } \
+    } \
+  };
+  SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL(char)
+  SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL(signed char)
+  SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL(unsigned char)
+  SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL(short)
+  SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL(unsigned short)
+#undef SLICERRT_FRACTIONAL_ACCUMULATE_FLOAT_KERNEL
+
+  //----------------------------------------------------------------------------
+  /// Accumulate the slabs of the update extent in parallel, each slab into its own partial result
+  template <class BaseImageScalarType, class FractionalImageScalarType>
+  class vtkFractionalImageAccumulateFunctor
+  {
+  public:
+    vtkFractionalImageAccumulateFunctor(const vtkFractionalImageAccumulateParameters& parameters, int* updateExtent,
+      int slicesPerSlab, std::vector<vtkFractionalImageAccumulatePartial>& partials)
+      : Parameters(parameters)
+      , UpdateExtent(updateExtent)
+      , SlicesPerSlab(slicesPerSlab)
+      , Partials(partials)
+    {
+    }
+
+    void operator()(vtkIdType beginSlab, vtkIdType endSlab)
+    {
+      for (vtkIdType slab = beginSlab; slab < endSlab; ++slab)
+        {
+        int slabExtent[6] = { this->UpdateExtent[0], this->UpdateExtent[1], this->UpdateExtent[2], this->UpdateExtent[3],
+          this->UpdateExtent[4] + static_cast<int>(slab) * this->SlicesPerSlab, 0 };
+        slabExtent[5] = std::min(slabExtent[4] + this->SlicesPerSlab - 1, this->UpdateExtent[5]);
+        this->AccumulateSlab(slabExtent, this->Partials[slab]);
+        }
+    }
+
+  protected:
+    void AccumulateSlab(int slabExtent[6], vtkFractionalImageAccumulatePartial& partial)
+    {
+      const vtkFractionalImageAccumulateParameters& parameters = this->Parameters;
+      bool reverseStencil = parameters.ReverseStencil;
+
+      // Progress is not reported by the iterators, as they run on multiple threads
+      vtkImageStencilIterator<BaseImageScalarType> inIter(parameters.InData, parameters.Stencil, slabExtent, nullptr);
+      vtkImageStencilIterator<FractionalImageScalarType> fractionalIter(
+        parameters.FractionalLabelmap, parameters.Stencil, slabExtent, nullptr);
+
+      while (!inIter.IsAtEnd())
+        {
+        if (inIter.IsInStencil() ^ reverseStencil)
+          {
+          BaseImageScalarType *inPtr = inIter.BeginSpan();
+          BaseImageScalarType *spanEndPtr = inIter.EndSpan();
+          FractionalImageScalarType* fractionalPtr = fractionalIter.BeginSpan();
+          vtkFractionalImageAccumulateSpanKernel<BaseImageScalarType, FractionalImageScalarType>::Execute(
+            inPtr, spanEndPtr, fractionalPtr, parameters, partial);
+          }
+        fractionalIter.NextSpan();
+        inIter.NextSpan();
+        }
+    }
+
+  private:
+    const vtkFractionalImageAccumulateParameters& Parameters;
+    int* UpdateExtent;
+    int SlicesPerSlab;
+    std::vector<vtkFractionalImageAccumulatePartial>& Partials;
+  };
+}
+
 //----------------------------------------------------------------------------
 vtkFractionalImageAccumulate::vtkFractionalImageAccumulate()
 {
   this->MinimumFractionalValue = 0;
   this->MaximumFractionalValue = 1.0;
+  this->FractionalLabelmap = nullptr;
+  this->FractionalVoxelCount = 0.0;
+  this->UseFractionalLabelmap = false;
 }
 
 //----------------------------------------------------------------------------
@@ -96,6 +431,8 @@ int vtkFractionalImageAccumulateExecute(vtkFractionalImageAccumulate *self,
 
 //----------------------------------------------------------------------------
 // This templated function executes the filter for any type of data.
+// The update extent is split into slabs along the third axis that are accumulated in parallel,
+// then the partial results are combined in slab order.
 template <class BaseImageScalarType, class FractionalImageScalarType>
 int vtkFractionalImageAccumulateExecute2(vtkFractionalImageAccumulate *self,
                               BaseImageScalarType* vtkNotUsed(baseTypePtr),
@@ -126,111 +463,78 @@ int vtkFractionalImageAccumulateExecute2(vtkFractionalImageAccumulate *self,
     }
 
   // input's number of components is used as output dimensionality
-  int numC = inData->GetNumberOfScalarComponents();
-  if (numC > 3)
+  vtkFractionalImageAccumulateParameters parameters;
+  parameters.NumberOfComponents = inData->GetNumberOfScalarComponents();
+  if (parameters.NumberOfComponents > 3)
     {
     return 0;
     }
 
   // get information for output data
-  int outExtent[6];
-  outData->GetExtent(outExtent);
-  vtkIdType outIncs[3];
-  outData->GetIncrements(outIncs);
-  double origin[3];
-  outData->GetOrigin(origin);
-  double spacing[3];
-  outData->GetSpacing(spacing);
+  outData->GetExtent(parameters.OutExtent);
+  outData->GetIncrements(parameters.OutIncrements);
+  outData->GetOrigin(parameters.Origin);
+  outData->GetSpacing(parameters.Spacing);
 
   // zero count in every bin
   vtkIdType size = 1;
-  size *= (outExtent[1] - outExtent[0] + 1);
-  size *= (outExtent[3] - outExtent[2] + 1);
-  size *= (outExtent[5] - outExtent[4] + 1);
+  size *= (parameters.OutExtent[1] - parameters.OutExtent[0] + 1);
+  size *= (parameters.OutExtent[3] - parameters.OutExtent[2] + 1);
+  size *= (parameters.OutExtent[5] - parameters.OutExtent[4] + 1);
   for (vtkIdType j = 0; j < size; j++)
     {
     outPtr[j] = 0;
     }
 
-  vtkImageStencilData *stencil = self->GetStencil();
-  bool reverseStencil = (self->GetReverseStencil() != 0);
-  bool ignoreZero = (self->GetIgnoreZero() != 0);
+  parameters.InData = inData;
+  parameters.FractionalLabelmap = self->GetFractionalLabelmap();
+  parameters.Stencil = self->GetStencil();
+  parameters.ReverseStencil = (self->GetReverseStencil() != 0);
+  parameters.IgnoreZero = (self->GetIgnoreZero() != 0);
+  parameters.UseFractionalLabelmap = self->GetUseFractionalLabelmap();
+  parameters.MinimumFractionalValue = self->GetMinimumFractionalValue();
+  parameters.FractionalRange = self->GetMaximumFractionalValue() - self->GetMinimumFractionalValue();
+
+  // Split the update extent into slabs. The number of slabs only depends on the input,
+  // so that the partial results are always combined the same way.
+  int numberOfSlices = updateExtent[5] - updateExtent[4] + 1;
+  if (numberOfSlices < 1 || updateExtent[1] < updateExtent[0] || updateExtent[3] < updateExtent[2])
+    {
+    return 1;
+    }
+  vtkIdType numberOfSlabs = std::min<vtkIdType>(numberOfSlices, MAXIMUM_NUMBER_OF_SLABS);
+  numberOfSlabs = std::max<vtkIdType>(1, std::min<vtkIdType>(numberOfSlabs, MAXIMUM_NUMBER_OF_PARTIAL_BINS / size));
+  int slicesPerSlab = static_cast<int>((numberOfSlices + numberOfSlabs - 1) / numberOfSlabs);
+  numberOfSlabs = (numberOfSlices + slicesPerSlab - 1) / slicesPerSlab;
 
-  vtkImageStencilIterator<BaseImageScalarType> inIter(inData, stencil, updateExtent, self);
+  std::vector<vtkFractionalImageAccumulatePartial> partials(numberOfSlabs);
+  for (vtkFractionalImageAccumulatePartial& partial : partials)
+    {
+    partial.Histogram.assign(size, 0.0);
+    }
 
-  vtkImageData* fractionalLabelmap = self->GetFractionalLabelmap();
-  vtkImageStencilIterator<FractionalImageScalarType> fractionalIter(fractionalLabelmap, stencil, updateExtent, self);
+  vtkFractionalImageAccumulateFunctor<BaseImageScalarType, FractionalImageScalarType> functor(
+    parameters, updateExtent, slicesPerSlab, partials);
+  vtkSMPTools::For(0, numberOfSlabs, 1, functor);
 
-  while (!inIter.IsAtEnd())
+  // Combine partial results in slab order
+  for (const vtkFractionalImageAccumulatePartial& partial : partials)
     {
-    if (inIter.IsInStencil() ^ reverseStencil)
+    for (int idxC = 0; idxC < 3; ++idxC)
       {
-      BaseImageScalarType *inPtr = inIter.BeginSpan();
-      BaseImageScalarType *spanEndPtr = inIter.EndSpan();
-
-      FractionalImageScalarType* fractionalPtr = (FractionalImageScalarType*)fractionalIter.BeginSpan();
-
-      while (inPtr != spanEndPtr)
-        {
-        // find the bin for this pixel.
-        bool outOfBounds = false;
-        double *outPtrC = outPtr;
-        double total  = 0.0;
-
-        for (int idxC = 0; idxC < numC; ++idxC)
-          {
-
-          double v = static_cast<double>(*inPtr++);
-          double f = 1.0;
-
-          if (self->GetUseFractionalLabelmap())
-          {
-            f = ( (*fractionalPtr++) - self->GetMinimumFractionalValue() ) / (self->GetMaximumFractionalValue() - self->GetMinimumFractionalValue());
-          }
-
-          if (!ignoreZero || v != 0)
-            {
-            // gather statistics
-            sum[idxC] += v*f;
-            sumSqr[idxC] += v*v*f*f;
-            if (v > max[idxC])
-              {
-              max[idxC] = v;
-              }
-            if (v < min[idxC])
-              {
-              min[idxC] = v;
-              }
-            (*voxelCount)++;
-            (*fractionalVoxelCount)+=f;
-            total+=f;
-            }
-
-          // compute the index
-          int outIdx = vtkMath::Floor((v - origin[idxC]) / spacing[idxC]);
-
-          // verify that it is in range
-          if (outIdx >= outExtent[idxC*2] && outIdx <= outExtent[idxC*2+1])
-            {
-            outPtrC += (outIdx - outExtent[idxC*2]) * outIncs[idxC];
-            }
-          else
-            {
-              outOfBounds = true;
-            }
-
-          }
-
-        // increment the bin
-        if (!outOfBounds)
-          {
-            (*outPtrC) += total;
-          }
-        }
+      sum[idxC] += partial.Sum[idxC];
+      sumSqr[idxC] += partial.SumSqr[idxC];
+      min[idxC] = std::min(min[idxC], partial.Min[idxC]);
+      max[idxC] = std::max(max[idxC], partial.Max[idxC]);
+      }
+    *voxelCount += partial.VoxelCount;
+    *fractionalVoxelCount += partial.FractionalVoxelCount;
+    for (vtkIdType j = 0; j < size; j++)
+      {
+      outPtr[j] += partial.Histogram[j];
       }
-    fractionalIter.NextSpan();
-    inIter.NextSpan();
     }
+  self->UpdateProgress(1.0);
 
   // initialize the statistics
   mean[0] = 0;